@@ -187,12 +187,24 @@ CONSTANT(int, Xapian, DB_BACKEND_GLASS);
 CONSTANT(int, Xapian, DB_BACKEND_HONEY);
 CONSTANT(int, Xapian, DB_BACKEND_INMEMORY);
 CONSTANT(int, Xapian, DB_BACKEND_STUB);
+CONSTANT(int, Xapian, DB_BLOCK_CHECKSUMS);
+CONSTANT(int, Xapian, DB_PACKED_POSITIONS);
+CONSTANT(int, Xapian, DB_ADAPTIVE_CHUNKS);
+CONSTANT(int, Xapian, DB_PACKED_POSTINGS);
+CONSTANT(int, Xapian, DB_EYTZINGER_INDEX);
+CONSTANT(int, Xapian, DB_BLOOM_FILTERS);
+CONSTANT(int, Xapian, DB_ALIGNED_POSITIONS);
+CONSTANT(int, Xapian, DB_LOAD_INTO_MEMORY);
+CONSTANT(int, Xapian, DB_CACHE_DOCLENS);
 CONSTANT(int, Xapian, DB_RETRY_LOCK);
+CONSTANT(int, Xapian, DB_COMPRESS_LZ4);
+CONSTANT(int, Xapian, DB_COMPRESS_ZSTD);
 CONSTANT(int, Xapian, DBCHECK_SHORT_TREE);
 CONSTANT(int, Xapian, DBCHECK_FULL_TREE);
 CONSTANT(int, Xapian, DBCHECK_SHOW_FREELIST);
 CONSTANT(int, Xapian, DBCHECK_SHOW_STATS);
 CONSTANT(int, Xapian, DBCHECK_FIX);
+CONSTANT(int, Xapian, DBCHECK_SHOW_PROGRESS);
 CONSTANT(int, Xapian, DBCOMPACT_MULTIPASS);
 CONSTANT(int, Xapian, DBCOMPACT_NO_RENUMBER);
 CONSTANT(int, Xapian, DBCOMPACT_SINGLE_FILE);
@@ -411,6 +423,9 @@ STANDARD_IGNORES(Xapian, Weight)
 SUBCLASSABLE(Xapian, Compactor)
 %include <xapian/compactor.h>
 
+STANDARD_IGNORES(Xapian, BulkLoader)
+%include <xapian/bulkloader.h>
+
 SUBCLASSABLE(Xapian, PostingSource)
 // Suppress warning that Xapian::Internal::opt_intrusive_base is unknown.
 %warnfilter(SWIGWARN_TYPE_UNDEFINED_CLASS) Xapian::PostingSource;
@@ -20,6 +20,7 @@ EXTRA_DIST +=\
 	api/Makefile
 
 lib_src +=\
+	api/bulkloader.cc\
 	api/compactor.cc\
 	api/constinfo.cc\
 	api/database.cc\
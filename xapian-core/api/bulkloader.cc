@@ -0,0 +1,387 @@
+/** @file
+ * @brief Build a new database from scratch in bulk.
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include <xapian/bulkloader.h>
+
+#include <xapian/compactor.h>
+#include <xapian/constants.h>
+#include <xapian/database.h>
+#include <xapian/document.h>
+#include <xapian/error.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "debuglog.h"
+#include "filetests.h"
+#include "fileutils.h"
+#include "parseint.h"
+#include "safesysstat.h"
+#include "safeunistd.h"
+#include "str.h"
+
+#ifdef XAPIAN_HAS_GLASS_BACKEND
+# include "backends/glass/glass_database.h"
+#else
+class GlassWritableDatabase;
+#endif
+
+using namespace std;
+
+namespace Xapian {
+
+/// Default value for the memory limit.
+static const size_t DEFAULT_MEMORY_LIMIT = 256 * 1024 * 1024;
+
+class BulkLoader::Internal : public Xapian::Internal::intrusive_base {
+    friend class BulkLoader;
+
+    /// The path of the database to create.
+    string path;
+
+    /// Flags to pass to Database::compact().
+    int flags;
+
+    /// Block size to use for the output.
+    int block_size;
+
+    /// Directory the runs are created in.
+    string tmpdir;
+
+    /// Paths of the runs written so far (including the current run).
+    vector<string> runs;
+
+    /// The run currently being built.
+    WritableDatabase current;
+
+    /// The internals of current, or NULL if there's no current run.
+    GlassWritableDatabase* current_internal = NULL;
+
+    /// Last docid allocated.
+    Xapian::docid last_docid = 0;
+
+    /// Write out the current run once it uses this much memory.
+    size_t memory_limit = DEFAULT_MEMORY_LIMIT;
+
+    /// User metadata, written to the final run.
+    map<string, string> metadata;
+
+    /// Has finish() been called?
+    bool finished = false;
+
+    /** Has adding to the current run failed?
+     *
+     *  The changes buffered for the current run can't be kept when this
+     *  happens, so the docids already returned are no longer valid and we
+     *  don't allow the BulkLoader to be used further.
+     */
+    bool failed = false;
+
+    /** Throw InvalidOperationError if finish() has been called or an earlier
+     *  error has left the BulkLoader unusable.
+     */
+    void check_usable(const char* method) const {
+	if (rare(finished || failed)) {
+	    string msg = "BulkLoader::";
+	    msg += method;
+	    msg += finished ? "() called after finish()" :
+			      "() called after an earlier error";
+	    throw Xapian::InvalidOperationError(msg);
+	}
+    }
+
+    /// Start a new run.
+    void start_run();
+
+    /// Write out the current run.
+    void end_run();
+
+    /// Remove the runs and the temporary directory.
+    void cleanup();
+
+    void finish(Xapian::Compactor* compactor);
+
+  public:
+    Internal(const string& path_, int flags_, int block_size_);
+
+    ~Internal();
+};
+
+BulkLoader::Internal::Internal(const string& path_, int flags_,
+			       int block_size_)
+    : path(path_), flags(flags_), block_size(block_size_)
+{
+#ifndef XAPIAN_HAS_GLASS_BACKEND
+    throw Xapian::FeatureUnavailableError("BulkLoader requires the glass "
+					  "backend, which was disabled at "
+					  "build time");
+#endif
+    if (path_exists(path)) {
+	throw Xapian::DatabaseCreateError("Can't bulk load to '" + path +
+					  "' as it already exists");
+    }
+
+    const char* p = getenv("XAPIAN_FLUSH_MEMORY");
+    if (p && *p) {
+	if (!parse_unsigned(p, memory_limit) || memory_limit == 0) {
+	    throw Xapian::InvalidArgumentError("XAPIAN_FLUSH_MEMORY must "
+					       "be a positive integer");
+	}
+    }
+
+    tmpdir = path;
+    tmpdir += ".bulkload";
+    if (mkdir(tmpdir.c_str(), 0755) < 0) {
+	throw Xapian::DatabaseCreateError("Couldn't create directory '" +
+					  tmpdir + "'", errno);
+    }
+}
+
+BulkLoader::Internal::~Internal()
+{
+    try {
+	cleanup();
+    } catch (...) {
+	// Ignore any exceptions, since we're in a destructor.
+    }
+}
+
+void
+BulkLoader::Internal::start_run()
+{
+#ifdef XAPIAN_HAS_GLASS_BACKEND
+    string run_path = tmpdir;
+    run_path += "/run";
+    run_path += str(runs.size());
+    // The runs are temporary so there's no point syncing them, and updating
+    // them in place avoids copying blocks which are written more than once.
+    int run_flags = Xapian::DB_CREATE | Xapian::DB_NO_SYNC |
+		    Xapian::DB_DANGEROUS;
+    // The block size of the output is set when merging the runs, so just
+    // use the default for the runs.
+    current_internal = new GlassWritableDatabase(run_path, run_flags, 0);
+    current = WritableDatabase(current_internal);
+    // We decide when to flush, so disable the automatic thresholds.
+    current_internal->set_flush_thresholds(Xapian::doccount(-1), 0);
+    runs.push_back(run_path);
+#endif
+}
+
+void
+BulkLoader::Internal::end_run()
+{
+    current.close();
+    current = WritableDatabase();
+    current_internal = NULL;
+}
+
+void
+BulkLoader::Internal::cleanup()
+{
+    if (current_internal) {
+	current = WritableDatabase();
+	current_internal = NULL;
+    }
+    for (auto&& run : runs) {
+	removedir(run);
+    }
+    runs.clear();
+    if (!tmpdir.empty()) {
+	(void)rmdir(tmpdir.c_str());
+	tmpdir.clear();
+    }
+}
+
+void
+BulkLoader::Internal::finish(Xapian::Compactor* compactor)
+{
+    if (finished) {
+	throw Xapian::InvalidOperationError("BulkLoader::finish() already "
+					    "called");
+    }
+    check_usable("finish");
+    finished = true;
+
+    try {
+	if (!current_internal && (runs.empty() || !metadata.empty())) {
+	    // We need a run to hold the metadata, or to give us an empty
+	    // database to compact if no documents were added.
+	    start_run();
+	}
+	for (auto&& i : metadata) {
+	    current.set_metadata(i.first, i.second);
+	}
+	if (current_internal) end_run();
+
+	Database src;
+	for (auto&& run : runs) {
+	    src.add_database(Database(run));
+	}
+	// The runs have contiguous disjoint docid ranges, so we don't need
+	// to renumber.
+	int compact_flags = flags | Xapian::DBCOMPACT_NO_RENUMBER |
+			    Xapian::DBCOMPACT_MULTIPASS;
+	if (compactor) {
+	    src.compact(path, compact_flags, block_size, *compactor);
+	} else {
+	    src.compact(path, compact_flags, block_size);
+	}
+    } catch (...) {
+	cleanup();
+	throw;
+    }
+    cleanup();
+}
+
+BulkLoader::BulkLoader(const BulkLoader&) = default;
+
+BulkLoader&
+BulkLoader::operator=(const BulkLoader&) = default;
+
+BulkLoader::BulkLoader(BulkLoader&&) = default;
+
+BulkLoader&
+BulkLoader::operator=(BulkLoader&&) = default;
+
+BulkLoader::BulkLoader(const string& path, int flags, int block_size)
+    : internal(new BulkLoader::Internal(path, flags, block_size))
+{
+    LOGCALL_CTOR(API, "BulkLoader", path | flags | block_size);
+}
+
+BulkLoader::~BulkLoader()
+{
+    LOGCALL_DTOR(API, "BulkLoader");
+}
+
+void
+BulkLoader::set_memory_limit(size_t bytes)
+{
+    LOGCALL_VOID(API, "BulkLoader::set_memory_limit", bytes);
+    if (bytes == 0) {
+	throw Xapian::InvalidArgumentError("BulkLoader memory limit must be "
+					   "positive");
+    }
+    internal->memory_limit = bytes;
+}
+
+Xapian::docid
+BulkLoader::add_document(const Xapian::Document& doc)
+{
+    LOGCALL(API, Xapian::docid, "BulkLoader::add_document", doc);
+    internal->check_usable("add_document");
+    Xapian::docid did = internal->last_docid + 1;
+    if (rare(did == 0)) {
+	throw Xapian::DatabaseError("Run out of docids");
+    }
+#ifdef XAPIAN_HAS_GLASS_BACKEND
+    // Reject a document which glass can't add before touching the current
+    // run, so a bad document doesn't cost us the run.
+    GlassWritableDatabase::check_document(doc);
+#endif
+    try {
+	if (!internal->current_internal) internal->start_run();
+	// If this fails then the changes buffered for the current run can't
+	// be kept, including the documents already added to it.
+	internal->current.replace_document(did, doc);
+	internal->last_docid = did;
+
+	if (internal->current.get_buffered_memory() >=
+	    internal->memory_limit) {
+	    internal->end_run();
+	}
+    } catch (...) {
+	internal->failed = true;
+	throw;
+    }
+    RETURN(did);
+}
+
+void
+BulkLoader::add_spelling(const string& word, Xapian::termcount freqinc)
+{
+    LOGCALL_VOID(API, "BulkLoader::add_spelling", word | freqinc);
+    internal->check_usable("add_spelling");
+    // Frequencies for the same word in different runs are summed when the
+    // runs are merged.
+    try {
+	if (!internal->current_internal) internal->start_run();
+	internal->current.add_spelling(word, freqinc);
+    } catch (...) {
+	internal->failed = true;
+	throw;
+    }
+}
+
+void
+BulkLoader::add_synonym(const string& term, const string& synonym)
+{
+    LOGCALL_VOID(API, "BulkLoader::add_synonym", term | synonym);
+    internal->check_usable("add_synonym");
+    // Synonyms for the same term in different runs are combined when the
+    // runs are merged.
+    try {
+	if (!internal->current_internal) internal->start_run();
+	internal->current.add_synonym(term, synonym);
+    } catch (...) {
+	internal->failed = true;
+	throw;
+    }
+}
+
+void
+BulkLoader::set_metadata(const string& key, const string& value)
+{
+    LOGCALL_VOID(API, "BulkLoader::set_metadata", key | value);
+    internal->check_usable("set_metadata");
+    if (rare(key.empty())) {
+	throw Xapian::InvalidArgumentError("Empty metadata keys are invalid");
+    }
+    internal->metadata[key] = value;
+}
+
+Xapian::doccount
+BulkLoader::get_doccount() const
+{
+    LOGCALL(API, Xapian::doccount, "BulkLoader::get_doccount", NO_ARGS);
+    RETURN(internal->last_docid);
+}
+
+void
+BulkLoader::finish()
+{
+    LOGCALL_VOID(API, "BulkLoader::finish", NO_ARGS);
+    internal->finish(NULL);
+}
+
+void
+BulkLoader::finish(Xapian::Compactor& compactor)
+{
+    LOGCALL_VOID(API, "BulkLoader::finish", &compactor);
+    internal->finish(&compactor);
+}
+
+}
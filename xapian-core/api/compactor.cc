@@ -26,6 +26,7 @@
 
 #include <algorithm>
 #include <fstream>
+#include <map>
 #include <vector>
 
 #include <cerrno>
@@ -55,6 +56,7 @@
 
 #ifdef XAPIAN_HAS_HONEY_BACKEND
 #include "backends/honey/honey_database.h"
+#include "backends/honey/honey_overlay.h"
 #include "backends/honey/honey_version.h"
 #endif
 
@@ -62,7 +64,11 @@
 
 #include <xapian/constants.h>
 #include <xapian/database.h>
+#include <xapian/document.h>
 #include <xapian/error.h>
+#include <xapian/keymaker.h>
+#include <xapian/postingiterator.h>
+#include <xapian/termiterator.h>
 
 using namespace std;
 
@@ -120,6 +126,94 @@ backend_mismatch(const Xapian::Database::Internal* db, int backend1,
     throw Xapian::InvalidArgumentError(msg);
 }
 
+/** Copy a database to a temporary glass database and compact that.
+ *
+ *  Along with the documents, the user metadata, spelling and synonym data
+ *  are copied.  The temporary database is removed afterwards.
+ *
+ *  @param db		The database to copy.
+ *  @param tmpdir	Path to create the temporary database at.
+ *  @param compactor	Used to resolve user metadata keys which are set in
+ *			more than one shard of @a db (may be NULL).
+ *  @param copy_documents	Called with the temporary database to copy the
+ *				documents to it.
+ *  @param compact	Called with the temporary database to compact it.
+ */
+template<typename C, typename D>
+static void
+compact_via_copy(const Xapian::Database& db, const string& tmpdir,
+		 Xapian::Compactor* compactor, C copy_documents, D compact)
+{
+    using namespace Xapian;
+
+    // Create the temporary database outside the try block so we don't
+    // remove a directory which already existed.
+    WritableDatabase tmp(tmpdir, DB_CREATE | DB_BACKEND_GLASS | DB_NO_SYNC);
+    try {
+	copy_documents(tmp);
+
+	// The user metadata for a database with several shards only comes
+	// from the first, so read each shard's and resolve any duplicates as
+	// compacting the shards would.
+	map<string, vector<string>> metadata;
+	auto copy_metadata = [&](const Database& shard) {
+	    for (auto t = shard.metadata_keys_begin();
+		 t != shard.metadata_keys_end(); ++t) {
+		const string& key = *t;
+		metadata[key].push_back(shard.get_metadata(key));
+	    }
+	};
+	auto n_shards = db.internal->size();
+	if (n_shards > 1) {
+	    auto multi_db = static_cast<MultiDatabase*>(db.internal.get());
+	    for (size_t i = 0; i != n_shards; ++i) {
+		copy_metadata(Database(multi_db->get_shard(i)));
+	    }
+	} else {
+	    copy_metadata(db);
+	}
+	for (auto&& entry : metadata) {
+	    const string& key = entry.first;
+	    const vector<string>& tags = entry.second;
+	    if (tags.size() > 1 && compactor) {
+		const string& resolved_tag =
+		    compactor->resolve_duplicate_metadata(key, tags.size(),
+							  &tags[0]);
+		if (!resolved_tag.empty())
+		    tmp.set_metadata(key, resolved_tag);
+	    } else {
+		tmp.set_metadata(key, tags[0]);
+	    }
+	}
+	map<string, vector<string>>().swap(metadata);
+
+	for (auto t = db.spellings_begin(); t != db.spellings_end(); ++t) {
+	    tmp.add_spelling(*t, t.get_termfreq());
+	}
+	for (auto t = db.synonym_keys_begin(); t != db.synonym_keys_end();
+	     ++t) {
+	    const string& key = *t;
+	    for (auto s = db.synonyms_begin(key); s != db.synonyms_end(key);
+		 ++s) {
+		tmp.add_synonym(key, *s);
+	    }
+	}
+	tmp.commit();
+	tmp.close();
+
+	compact(Database(tmpdir));
+    } catch (...) {
+	// Report the original error rather than any from cleaning up.
+	try {
+	    tmp.close();
+	    removedir(tmpdir);
+	} catch (...) {
+	}
+	throw;
+    }
+    removedir(tmpdir);
+}
+
 namespace Xapian {
 
 void
@@ -151,6 +245,7 @@ Database::compact_(const string * output_ptr, int fd, unsigned flags,
     }
 
     auto n_shards = internal->size();
+
     Xapian::docid tot_off = 0;
     Xapian::docid last_docid = 0;
 
@@ -194,6 +289,19 @@ Database::compact_(const string * output_ptr, int fd, unsigned flags,
 		}
 		backend = type;
 		break;
+	    case BACKEND_HONEY_OVERLAY:
+		if (n_shards > 1) {
+		    throw InvalidOperationError("A honey database with an "
+						"overlay can only be compacted "
+						"on its own");
+		}
+		if (!output_ptr) {
+		    throw InvalidOperationError("Compacting a honey database "
+						"with an overlay to a file "
+						"descriptor isn't supported");
+		}
+		backend = type;
+		break;
 	    default:
 		throw DatabaseError("Only glass and honey databases can be "
 				    "compacted");
@@ -429,6 +537,30 @@ Database::compact_(const string * output_ptr, int fd, unsigned flags,
 		throw Xapian::UnimplementedError("Honey can only be "
 						 "compacted to itself");
 	}
+    } else if (backend == BACKEND_HONEY_OVERLAY) {
+	switch (output_backend) {
+	    case 0:
+	    case Xapian::DB_BACKEND_HONEY: {
+#ifdef XAPIAN_HAS_HONEY_BACKEND
+		// Honey isn't block based.
+		(void)block_size;
+		auto overlay =
+		    static_cast<const HoneyOverlayDatabase*>(internals[0]);
+		HoneyDatabase::compact_overlay(compactor, destdir.c_str(),
+					       overlay, offset[0],
+					       compaction, flags, last_docid);
+		break;
+#else
+		(void)fd;
+		(void)last_docid;
+		throw Xapian::FeatureUnavailableError("Honey backend disabled "
+						      "at build time");
+#endif
+	    }
+	    default:
+		throw Xapian::UnimplementedError("Honey can only be "
+						 "compacted to itself");
+	}
     }
 
     if (compact_to_stub) {
@@ -451,3 +583,241 @@ Database::compact_(const string * output_ptr, int fd, unsigned flags,
 }
 
 }
+
+/// Read the lines of stub database file @a stub_file into @a lines.
+static void
+read_stub_lines(const string& stub_file, vector<string>& lines)
+{
+    ifstream stub(stub_file.c_str());
+    if (!stub) {
+	string msg = "Couldn't open stub database file: ";
+	msg += stub_file;
+	throw Xapian::DatabaseNotFoundError(msg, errno);
+    }
+    string line;
+    while (getline(stub, line)) {
+	lines.push_back(line);
+    }
+}
+
+/** Parse a line from a stub database file listing a local database.
+ *
+ *  @return The backend flag to open it with, or -1 if this line doesn't
+ *	    list a local database.
+ */
+static int
+parse_stub_line(const string& line, const string& stub_file, string& path)
+{
+    int backend;
+    if (startswith(line, "auto ")) {
+	backend = 0;
+    } else if (startswith(line, "glass ")) {
+	backend = Xapian::DB_BACKEND_GLASS;
+    } else if (startswith(line, "honey ")) {
+	backend = Xapian::DB_BACKEND_HONEY;
+    } else {
+	return -1;
+    }
+    path.assign(line, line.find(' ') + 1, string::npos);
+    if (path.empty()) return -1;
+    resolve_relative_path(path, stub_file);
+    return backend;
+}
+
+namespace Xapian {
+
+vector<string>
+merge_shards(const string& stub, unsigned merge_factor, unsigned flags,
+	     int block_size, Xapian::Compactor* compactor)
+{
+    LOGCALL_STATIC(API, vector<string>, "Xapian::merge_shards", stub | merge_factor | flags | block_size | compactor);
+
+    if (merge_factor < 2) {
+	throw InvalidArgumentError("merge_factor must be at least 2");
+    }
+
+    string stub_file = stub;
+    string destdir = stub;
+    if (dir_exists(stub)) {
+	stub_file += "/XAPIANDB";
+	destdir += '/';
+    } else {
+	destdir += '_';
+    }
+
+    vector<string> lines;
+    read_stub_lines(stub_file, lines);
+
+    // Assign each local shard to a tier based on its document count.
+    vector<unsigned> tiers(lines.size(), unsigned(-1));
+    map<unsigned, unsigned> tier_sizes;
+    for (size_t i = 0; i != lines.size(); ++i) {
+	string path;
+	int backend = parse_stub_line(lines[i], stub_file, path);
+	if (backend < 0) continue;
+	Database shard(path, backend);
+	// Leave alone any shards which are themselves stub databases.
+	if (shard.size() != 1) continue;
+	Xapian::doccount n = shard.get_doccount();
+	unsigned tier = 0;
+	while (n >= merge_factor) {
+	    n /= merge_factor;
+	    ++tier;
+	}
+	tiers[i] = tier;
+	++tier_sizes[tier];
+    }
+
+    unsigned tier_to_merge = unsigned(-1);
+    for (auto&& t : tier_sizes) {
+	if (t.second >= merge_factor) {
+	    tier_to_merge = t.first;
+	    break;
+	}
+    }
+
+    vector<string> merged;
+    if (tier_to_merge == unsigned(-1)) RETURN(merged);
+
+    Database src;
+    vector<string> merged_lines;
+    for (size_t i = 0; i != lines.size(); ++i) {
+	if (tiers[i] != tier_to_merge) continue;
+	string path;
+	int backend = parse_stub_line(lines[i], stub_file, path);
+	src.add_database(Database(path, backend));
+	merged.push_back(path);
+	merged_lines.push_back(lines[i]);
+    }
+
+    // Pick a new directory to put the merged shard in, as we do when
+    // compacting to a stub database.
+    size_t sfx = destdir.size();
+    time_t now = time(NULL);
+    while (true) {
+	destdir.resize(sfx);
+	destdir += str(now++);
+	if (mkdir(destdir.c_str(), 0755) == 0)
+	    break;
+	if (errno != EEXIST) {
+	    string msg = destdir;
+	    msg += ": mkdir failed";
+	    throw Xapian::DatabaseError(msg, errno);
+	}
+    }
+
+    try {
+	if (compactor) {
+	    src.compact(destdir, flags, block_size, *compactor);
+	} else {
+	    src.compact(destdir, flags, block_size);
+	}
+
+	// Reread the stub in case shards have been added while we were
+	// merging, and replace the merged shards with the new one.  Another
+	// process may append to the stub while we're writing the new version,
+	// so check the stub is unchanged just before we rename the new version
+	// into place, and start again if it isn't.
+	string new_stub_file = destdir;
+	new_stub_file += "/new_stub.tmp";
+	size_t slash = destdir.find_last_of(DIR_SEPS);
+	vector<string> current_lines;
+	do {
+	    lines.clear();
+	    read_stub_lines(stub_file, lines);
+	    ofstream new_stub(new_stub_file.c_str());
+	    size_t j = 0;
+	    for (auto&& line : lines) {
+		if (j != merged_lines.size() && line == merged_lines[j]) {
+		    if (j++ == 0) {
+			new_stub << "auto " << destdir.substr(slash + 1)
+				 << '\n';
+		    }
+		    continue;
+		}
+		new_stub << line << '\n';
+	    }
+	    if (j != merged_lines.size()) {
+		string msg = stub_file;
+		msg += ": shards were removed while merging";
+		throw Xapian::DatabaseModifiedError(msg);
+	    }
+	    new_stub.close();
+	    if (!new_stub) {
+		string msg = new_stub_file;
+		msg += ": write failed";
+		throw Xapian::DatabaseError(msg, errno);
+	    }
+	    current_lines.clear();
+	    read_stub_lines(stub_file, current_lines);
+	} while (current_lines != lines);
+	if (!io_tmp_rename(new_stub_file, stub_file)) {
+	    string msg = "Cannot rename '";
+	    msg += new_stub_file;
+	    msg += "' to '";
+	    msg += stub_file;
+	    msg += '\'';
+	    throw Xapian::DatabaseError(msg, errno);
+	}
+    } catch (...) {
+	// Don't leave a partial shard behind, but report the original error.
+	try {
+	    removedir(destdir);
+	} catch (...) {
+	}
+	throw;
+    }
+
+    RETURN(merged);
+}
+
+void
+compact_reordered(const Database& db, const string& output,
+		  const KeyMaker& sorter, unsigned flags, int block_size,
+		  Xapian::Compactor* compactor)
+{
+    LOGCALL_STATIC_VOID(API, "Xapian::compact_reordered", db | output | &sorter | flags | block_size | compactor);
+
+    if (flags & DBCOMPACT_NO_RENUMBER) {
+	throw InvalidArgumentError("DBCOMPACT_NO_RENUMBER can't be used when "
+				   "reordering documents");
+    }
+
+    const string table = "reorder";
+    if (compactor) compactor->set_status(table, string());
+
+    // Find the new order.  Sort by key, then by the existing docid to keep
+    // documents with equal keys in their existing order.
+    vector<pair<string, Xapian::docid>> order;
+    order.reserve(db.get_doccount());
+    for (auto i = db.postlist_begin(string()); i != db.postlist_end(string());
+	 ++i) {
+	Xapian::docid did = *i;
+	order.emplace_back(sorter(db.get_document(did, DOC_ASSUME_VALID)),
+			   did);
+    }
+    sort(order.begin(), order.end());
+
+    compact_via_copy(db, output + ".reorder", compactor,
+		     [&](WritableDatabase& tmp) {
+			 for (auto&& entry : order) {
+			     tmp.add_document(db.get_document(entry.second));
+			 }
+			 // Free the keys before the compaction.
+			 vector<pair<string, Xapian::docid>>().swap(order);
+		     },
+		     [&](Database tmp) {
+			 if (compactor) {
+			     compactor->set_status(table,
+						   "Reordered " +
+						   str(db.get_doccount()) +
+						   " documents");
+			     tmp.compact(output, flags, block_size,
+					 *compactor);
+			 } else {
+			     tmp.compact(output, flags, block_size);
+			 }
+		     });
+}
+
+}
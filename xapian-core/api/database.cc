@@ -92,6 +92,11 @@ Database::~Database()
 bool
 Database::reopen()
 {
+    Internal* replacement = internal->open_replacement();
+    if (replacement) {
+	internal = replacement;
+	return true;
+    }
     return internal->reopen();
 }
 
@@ -523,6 +528,12 @@ Database::get_revision() const
     return internal->get_revision();
 }
 
+size_t
+Database::get_memory_footprint() const
+{
+    return internal->get_memory_footprint();
+}
+
 string
 Database::reconstruct_text(Xapian::docid did,
 			   size_t length,
@@ -539,6 +550,12 @@ WritableDatabase::commit()
     internal->commit();
 }
 
+size_t
+WritableDatabase::get_buffered_memory() const
+{
+    return internal->get_buffered_memory();
+}
+
 void
 WritableDatabase::begin_transaction(bool flushed)
 {
@@ -557,6 +574,13 @@ WritableDatabase::add_document(const Document& doc)
     return internal->add_document(doc);
 }
 
+Xapian::docid
+WritableDatabase::add_documents_(const vector<Document>& docs,
+				 unsigned threads)
+{
+    return internal->add_documents(docs, threads);
+}
+
 void
 WritableDatabase::delete_document(Xapian::docid did)
 {
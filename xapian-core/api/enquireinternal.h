@@ -113,6 +113,10 @@ class Enquire::Internal : public Xapian::Internal::intrusive_base {
     void request_document(docid did) const {
 	db.internal->request_document(did);
     }
+
+    void request_documents(const std::vector<docid>& dids) const {
+	db.internal->request_documents(dids);
+    }
 };
 
 }
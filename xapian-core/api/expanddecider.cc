@@ -29,12 +29,26 @@ namespace Xapian {
 
 ExpandDecider::~ExpandDecider() { }
 
+string
+ExpandDecider::get_required_prefix() const
+{
+    return string();
+}
+
 bool
 ExpandDeciderAnd::operator()(const string &term) const
 {
     return (*first)(term) && (*second)(term);
 }
 
+string
+ExpandDeciderAnd::get_required_prefix() const
+{
+    string prefix1 = first->get_required_prefix();
+    string prefix2 = second->get_required_prefix();
+    return prefix1.size() >= prefix2.size() ? prefix1 : prefix2;
+}
+
 bool
 ExpandDeciderFilterTerms::operator()(const string &term) const
 {
@@ -52,4 +66,10 @@ ExpandDeciderFilterPrefix::operator()(const string &term) const
     return startswith(term, prefix);
 }
 
+string
+ExpandDeciderFilterPrefix::get_required_prefix() const
+{
+    return prefix;
+}
+
 }
@@ -23,6 +23,7 @@
 #include "msetinternal.h"
 #include "xapian/mset.h"
 
+#include "backends/documentinternal.h"
 #include "net/serialise.h"
 #include "matcher/msetcmp.h"
 #include "pack.h"
@@ -34,6 +35,7 @@
 #include <algorithm>
 #include <cfloat>
 #include <string>
+#include <vector>
 
 using namespace std;
 
@@ -58,7 +60,11 @@ MSet::~MSet() {}
 void
 MSet::fetch_(Xapian::doccount first, Xapian::doccount last) const
 {
-    internal->fetch(first, last);
+    // The arguments are offsets from the end, as MSetIterator stores.
+    Xapian::doccount size = internal->items.size();
+    if (first > size) first = size;
+    if (last > first) return;
+    internal->fetch(size - first, size - last);
 }
 
 void
@@ -211,24 +217,48 @@ MSet::Internal::get_document(Xapian::doccount index) const
 	throw Xapian::RangeError(msg);
     }
     Assert(enquire.get());
-    return enquire->get_document(items[index].get_docid());
+    Xapian::docid did = items[index].get_docid();
+    Xapian::Document doc = enquire->get_document(did);
+    auto i = fetched_data.find(did);
+    if (i != fetched_data.end()) {
+	// Give each caller its own copy of the data we read in fetch() so
+	// changes made via one Document object aren't seen via another.  This
+	// doesn't count as modifying the data, so replacing the document
+	// without changing its data doesn't rewrite it.
+	doc.internal->set_fetched_data(i->second);
+    }
+    return doc;
 }
 
 void
 MSet::Internal::fetch(Xapian::doccount first_, Xapian::doccount last) const
 {
-    if (items.empty() || enquire.get() == NULL) {
+    if (enquire.get() == NULL) {
 	return;
     }
-    if (last > items.size() - 1) {
-	last = items.size() - 1;
+    if (last > items.size()) {
+	last = items.size();
     }
-    if (first_ <= last) {
-	Xapian::doccount n = last - first_;
-	for (Xapian::doccount i = 0; i <= n; ++i) {
-	    enquire->request_document(items[i].get_docid());
+
+    vector<Xapian::docid> dids;
+    for (Xapian::doccount i = first_; i < last; ++i) {
+	Xapian::docid did = items[i].get_docid();
+	if (fetched_data.find(did) == fetched_data.end()) {
+	    dids.push_back(did);
 	}
     }
+    if (dids.empty()) {
+	return;
+    }
+
+    // Read the documents in docid order, which is the order they're stored
+    // in, so the backend can issue the preread hints for all of them before
+    // we start reading and each block only needs to be read once.
+    sort(dids.begin(), dids.end());
+    enquire->request_documents(dids);
+    for (Xapian::docid did : dids) {
+	fetched_data.emplace(did, enquire->get_document(did).get_data());
+    }
 }
 
 void
@@ -26,6 +26,7 @@
 #include "result.h"
 #include "weight/weightinternal.h"
 
+#include "xapian/document.h"
 #include "xapian/intrusive_ptr.h"
 #include "xapian/mset.h"
 #include "xapian/types.h"
@@ -54,6 +55,9 @@ class MSet::Internal : public Xapian::Internal::intrusive_base {
     /// Relevance weights for non-query terms for generating snippets.
     mutable std::unordered_map<std::string, double> snippet_bg_relevance;
 
+    /// Document data read by fetch(), indexed by docid.
+    mutable std::unordered_map<Xapian::docid, std::string> fetched_data;
+
     /// The items in the MSet.
     std::vector<Result> items;
 
@@ -123,6 +127,14 @@ class MSet::Internal : public Xapian::Internal::intrusive_base {
 
     Xapian::Document get_document(Xapian::doccount index) const;
 
+    /** Read the documents for a range of items.
+     *
+     *  The document data is read for the items in docid order and the
+     *  documents are kept so get_document() can return them.
+     *
+     *  @param first	Index of the first item.
+     *  @param last	Index one past the last item.
+     */
     void fetch(Xapian::doccount first, Xapian::doccount last) const;
 
     void set_item_weight(Xapian::doccount i, double weight);
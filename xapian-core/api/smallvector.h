@@ -457,6 +457,17 @@ class SmallVectorI : public SmallVector_ {
 	return begin()[idx];
     }
 
+    // Replace the element at index idx with elt.
+    void replace(size_type idx, TI* elt) {
+	if (elt)
+	    ++elt->_refs;
+	TI* old = begin()[idx];
+	const_cast<void**>(do_begin())[idx] =
+	    const_cast<void*>(static_cast<const void*>(elt));
+	if (old && --old->_refs == 0)
+	    delete old;
+    }
+
     TI* front() const {
 	return *(begin());
     }
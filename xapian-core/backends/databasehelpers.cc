@@ -34,11 +34,15 @@
 #include "posixy_wrapper.h"
 
 #include <algorithm>
+#include <cstdlib>
 #include <cstring>
 #include <string>
 #include <sys/types.h>
 #include "safesysstat.h"
 #include "safeunistd.h"
+#ifdef HAVE_STD_THREAD
+# include <thread>
+#endif
 
 using namespace std;
 
@@ -118,3 +122,22 @@ test_if_single_file_db(const struct stat& sb,
 #endif
     return BACKEND_UNKNOWN;
 }
+
+unsigned
+get_compact_threads()
+{
+    const char* p = getenv("XAPIAN_COMPACT_THREADS");
+    if (p && *p) {
+	unsigned n;
+	if (!parse_unsigned(p, n) || n == 0) {
+	    throw Xapian::InvalidArgumentError("XAPIAN_COMPACT_THREADS must "
+					       "be a positive integer");
+	}
+	return n;
+    }
+#ifdef HAVE_STD_THREAD
+    return max(thread::hardware_concurrency(), 1u);
+#else
+    return 1;
+#endif
+}
@@ -66,6 +66,15 @@ test_if_single_file_db(const struct stat& sb,
 		       const std::string& path,
 		       int* fd_ptr);
 
+/** Return how many threads compaction should use.
+ *
+ *  This is the value of the environment variable XAPIAN_COMPACT_THREADS if
+ *  that is set, and otherwise the number of CPUs (or 1 if that isn't known,
+ *  or if threads aren't supported).
+ */
+unsigned
+get_compact_threads();
+
 /** Open, read and process a stub database file.
  *
  *  Implemented as a template with separate actions for each database type.
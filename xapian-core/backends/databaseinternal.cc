@@ -34,6 +34,7 @@
 #include <algorithm>
 #include <memory>
 #include <string>
+#include <vector>
 
 using namespace std;
 using Xapian::Internal::intrusive_ptr;
@@ -176,6 +177,18 @@ Database::Internal::add_document(const Xapian::Document &)
 		      "read-only shard");
 }
 
+Xapian::docid
+Database::Internal::add_documents(const vector<Xapian::Document>& docs,
+				  unsigned)
+{
+    Xapian::docid first = 0;
+    for (auto&& doc : docs) {
+	Xapian::docid did = add_document(doc);
+	if (!first) first = did;
+    }
+    return first;
+}
+
 void
 Database::Internal::delete_document(Xapian::docid)
 {
@@ -374,11 +387,25 @@ Database::Internal::reopen()
     return false;
 }
 
+Database::Internal*
+Database::Internal::open_replacement() const
+{
+    return NULL;
+}
+
 void
 Database::Internal::request_document(Xapian::docid) const
 {
 }
 
+void
+Database::Internal::request_documents(const vector<Xapian::docid>& dids) const
+{
+    for (Xapian::docid did : dids) {
+	request_document(did);
+    }
+}
+
 void
 Database::Internal::write_changesets_to_fd(int, const string&, bool, ReplicationInfo*)
 {
@@ -391,6 +418,18 @@ Database::Internal::get_revision() const
     throw Xapian::UnimplementedError("This backend doesn't provide access to revision information");
 }
 
+size_t
+Database::Internal::get_buffered_memory() const
+{
+    return 0;
+}
+
+size_t
+Database::Internal::get_memory_footprint() const
+{
+    return 0;
+}
+
 string
 Database::Internal::get_uuid() const
 {
@@ -34,6 +34,7 @@
 #include <xapian/valueiterator.h>
 
 #include <string>
+#include <vector>
 
 typedef Xapian::TermIterator::Internal TermList;
 typedef Xapian::PositionIterator::Internal PositionList;
@@ -368,6 +369,19 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
      */
     virtual bool reopen();
 
+    /** Open a replacement if this database now needs a different backend.
+     *
+     *  This is called when reopening, and allows a backend to handle the
+     *  database changing so it needs to be read in a different way (e.g. a
+     *  honey database which has had an overlay of updates created since it
+     *  was opened).
+     *
+     *  @return A new object to use in place of this one, or NULL if this
+     *		one can still be used (which is what the default
+     *		implementation always returns).
+     */
+    virtual Internal* open_replacement() const;
+
     /** Close the database */
     virtual void close() = 0;
 
@@ -389,6 +403,18 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
 
     virtual docid add_document(const Document& document);
 
+    /** Add several documents.
+     *
+     *  The default implementation calls add_document() for each document in
+     *  turn.  Backends can override this to split the work between up to
+     *  @a threads threads (0 meaning pick a suitable number).
+     *
+     *  @return The docid of the first document added (the others have
+     *		consecutive docids), or 0 if @a docs is empty.
+     */
+    virtual docid add_documents(const std::vector<Document>& docs,
+				unsigned threads);
+
     virtual void delete_document(docid did);
 
     /** Delete any documents indexed by a term from the database. */
@@ -418,6 +444,19 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
      */
     virtual void request_document(docid did) const;
 
+    /** Request several documents.
+     *
+     *  Like request_document(), but for a batch of documents which the
+     *  caller is about to read in turn, which allows a backend to look up
+     *  where they are all stored in a single pass and issue the preread
+     *  hints together.
+     *
+     *  @param dids	The document ids, in ascending order.
+     *
+     *  The default implementation calls request_document() for each.
+     */
+    virtual void request_documents(const std::vector<docid>& dids) const;
+
     /** Write a set of changesets to a file descriptor.
      *
      *  This call may reopen the database, leaving it pointing to a more
@@ -431,6 +470,24 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
     /// Get revision number of database (if meaningful).
     virtual Xapian::rev get_revision() const;
 
+    /** Get an estimate of the memory used by buffered modifications.
+     *
+     *  See WritableDatabase::get_buffered_memory() for more information.
+     *
+     *  The default implementation returns 0, which is appropriate for
+     *  backends which don't buffer changes in memory between commits.
+     */
+    virtual size_t get_buffered_memory() const;
+
+    /** Get the amount of memory used to hold data loaded from the database.
+     *
+     *  See Database::get_memory_footprint() for more information.
+     *
+     *  The default implementation returns 0, which is appropriate for
+     *  backends which don't load data into memory when opened.
+     */
+    virtual size_t get_memory_footprint() const;
+
     /** Get a UUID for the database.
      *
      *  The UUID will persist for the lifetime of the database.
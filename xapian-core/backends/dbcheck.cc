@@ -46,22 +46,34 @@
 #include "omassert.h"
 #include "stringutils.h"
 
+#include <exception>
 #include <ostream>
+#include <sstream>
 #include <stdexcept>
+#include <vector>
+#if defined HAVE_STD_THREAD && !defined XAPIAN_DEBUG_LOG
+# include <system_error>
+# include <thread>
+#endif
 
 using namespace std;
 
 #ifdef XAPIAN_HAS_GLASS_BACKEND
-// Tables to check for a glass database.  Note: it's important to check
-// termlist before postlist so that we can cross-check the document lengths.
-static const struct { char name[9]; } glass_tables[] = {
-    { "docdata" },
-    { "termlist" },
-    { "postlist" },
-    { "position" },
-    { "spelling" },
-    { "synonym" }
+// Tables to check for a glass database, in the order we report on them.
+// Tables in different groups are checked in parallel, while those in the same
+// group are checked in order.  Note: it's important to check termlist before
+// position so that we can cross-check which documents have terms.
+static const struct { char name[9]; unsigned group; } glass_tables[] = {
+    { "docdata", 0 },
+    { "termlist", 1 },
+    { "postlist", 2 },
+    { "position", 1 },
+    { "spelling", 3 },
+    { "synonym", 3 }
 };
+
+/// The number of groups in glass_tables.
+static const unsigned GLASS_CHECK_GROUPS = 4;
 #endif
 
 #ifdef XAPIAN_HAS_HONEY_BACKEND
@@ -78,10 +90,11 @@ static const struct { char name[9]; } honey_tables[] = {
 #endif
 
 // FIXME: We don't currently cross-check wdf between postlist and termlist.
-// It's hard to see how to efficiently.  We do cross-check doclens, but that
-// "only" requires (4 * last_docid()) bytes.
+// It's hard to see how to efficiently.  We do cross-check doclens - for glass
+// that's done by reading the termlist table in step with the postlist table,
+// while for honey it "only" requires (4 * last_docid()) bytes.
 
-#if defined XAPIAN_HAS_GLASS_BACKEND
+#if defined XAPIAN_HAS_HONEY_BACKEND
 static void
 reserve_doclens(vector<Xapian::termcount>& doclens, Xapian::docid last_docid,
 		ostream * out)
@@ -112,6 +125,103 @@ reserve_doclens(vector<Xapian::termcount>& doclens, Xapian::docid last_docid,
 }
 #endif
 
+#ifdef XAPIAN_HAS_GLASS_BACKEND
+/// The result of checking a glass table.
+struct GlassTableResult {
+    /// Output from checking the table.
+    ostringstream output;
+
+    /// The number of errors found.
+    size_t errors = 0;
+
+    /// Any exception thrown while checking the table.
+    exception_ptr error;
+};
+
+/// Check the tables of a glass database which are in group @a group.
+static void
+check_glass_group(unsigned group, const string& path, int fd, off_t offset,
+		  const GlassVersion& version_file, int opts,
+		  GlassCheckContext& context,
+		  vector<GlassTableResult>& results, bool want_output)
+{
+    for (size_t i = 0; i != results.size(); ++i) {
+	if (glass_tables[i].group != group) continue;
+	GlassTableResult& result = results[i];
+	try {
+	    result.errors = check_glass_table(glass_tables[i].name, path, fd,
+					      offset, version_file, opts,
+					      context,
+					      want_output ?
+					      &result.output : NULL);
+	} catch (...) {
+	    // The remaining tables in this group may depend on this one.
+	    result.error = current_exception();
+	    return;
+	}
+    }
+}
+
+/** Check all the tables of a glass database.
+ *
+ *  The tables are checked in parallel if possible, but the output for each
+ *  table is buffered and written in table order, so it's the same as if the
+ *  tables had been checked one after another.
+ */
+static size_t
+check_glass_tables(const string& path, int fd, off_t offset,
+		   const GlassVersion& version_file, int opts,
+		   std::ostream* out)
+{
+    GlassCheckContext context;
+    if (!context.enable_cross_checks(version_file.get_last_docid())) {
+	if (out)
+	    *out << "Couldn't allocate enough memory for cross-checking "
+		    "between the tables, so skipping those checks" << endl;
+    }
+    if (opts & Xapian::DBCHECK_SHOW_PROGRESS)
+	context.set_progress_out(out);
+
+    const size_t n_tables = sizeof(glass_tables) / sizeof(glass_tables[0]);
+    vector<GlassTableResult> results(n_tables);
+#if defined HAVE_STD_THREAD && !defined XAPIAN_DEBUG_LOG
+    // The debug log isn't thread-safe, so we don't use threads if it's
+    // enabled.
+    vector<thread> workers;
+    workers.reserve(GLASS_CHECK_GROUPS - 1);
+    for (unsigned group = 1; group < GLASS_CHECK_GROUPS; ++group) {
+	try {
+	    workers.emplace_back(check_glass_group, group, cref(path), fd,
+				 offset, cref(version_file), opts,
+				 ref(context), ref(results), out != NULL);
+	} catch (const system_error&) {
+	    // We couldn't start a thread, so do the work in this one.
+	    check_glass_group(group, path, fd, offset, version_file, opts,
+			      context, results, out != NULL);
+	}
+    }
+    check_glass_group(0, path, fd, offset, version_file, opts, context,
+		      results, out != NULL);
+    for (auto&& worker : workers) {
+	worker.join();
+    }
+#else
+    for (unsigned group = 0; group < GLASS_CHECK_GROUPS; ++group) {
+	check_glass_group(group, path, fd, offset, version_file, opts,
+			  context, results, out != NULL);
+    }
+#endif
+
+    size_t errors = 0;
+    for (auto&& result : results) {
+	if (out) *out << result.output.str();
+	if (result.error) rethrow_exception(result.error);
+	errors += result.errors;
+    }
+    return errors;
+}
+#endif
+
 static size_t
 check_db_dir(const string & path, int opts, std::ostream *out)
 {
@@ -123,7 +233,6 @@ check_db_dir(const string & path, int opts, std::ostream *out)
 	throw Xapian::FeatureUnavailableError("Glass database support isn't enabled");
 #else
 	// Check a whole glass database directory.
-	vector<Xapian::termcount> doclens;
 	size_t errors = 0;
 
 	try {
@@ -156,13 +265,9 @@ check_db_dir(const string & path, int opts, std::ostream *out)
 		     << doccount << endl;
 	    ++errors;
 	}
-	reserve_doclens(doclens, db_last_docid, out);
 
 	// Check all the tables.
-	for (auto t : glass_tables) {
-	    errors += check_glass_table(t.name, path, version_file, opts,
-					doclens, out);
-	}
+	errors += check_glass_tables(path, -1, 0, version_file, opts, out);
 	return errors;
 #endif
     }
@@ -270,9 +375,7 @@ check_db_table(const string& filename, int opts, std::ostream* out, int backend)
 	tablename += C_tolower(ch);
     }
 
-#if defined XAPIAN_HAS_GLASS_BACKEND
-    vector<Xapian::termcount> doclens;
-#else
+#if !defined XAPIAN_HAS_GLASS_BACKEND && !defined XAPIAN_HAS_HONEY_BACKEND
     (void)opts;
     (void)out;
 #endif
@@ -285,8 +388,11 @@ check_db_table(const string& filename, int opts, std::ostream* out, int backend)
 #else
 	GlassVersion version_file(dir);
 	version_file.read();
+	GlassCheckContext context;
+	if (opts & Xapian::DBCHECK_SHOW_PROGRESS)
+	    context.set_progress_out(out);
 	return check_glass_table(tablename.c_str(), dir, version_file, opts,
-				 doclens, out);
+				 context, out);
 #endif
       }
 
@@ -297,6 +403,7 @@ check_db_table(const string& filename, int opts, std::ostream* out, int backend)
 #else
 	HoneyVersion version_file(dir);
 	version_file.read();
+	vector<Xapian::termcount> doclens;
 	return check_honey_table(tablename.c_str(), dir, version_file, opts,
 				 doclens, out);
 #endif
@@ -358,15 +465,10 @@ check_db_fd(int fd, int opts, std::ostream* out, int backend)
 		     << doccount << endl;
 	    ++errors;
 	}
-	vector<Xapian::termcount> doclens;
-	reserve_doclens(doclens, db_last_docid, out);
 
 	// Check all the tables.
-	for (auto t : glass_tables) {
-	    errors += check_glass_table(t.name, fd, version_file.get_offset(),
-					version_file, opts, doclens,
-					out);
-	}
+	errors += check_glass_tables(string(), fd, version_file.get_offset(),
+				     version_file, opts, out);
 	break;
 #else
 	(void)opts;
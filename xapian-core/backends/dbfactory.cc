@@ -45,6 +45,7 @@
 #include "glass/glass_defs.h"
 #ifdef XAPIAN_HAS_HONEY_BACKEND
 # include "honey/honey_database.h"
+# include "honey/honey_overlay.h"
 #endif
 #include "honey/honey_defs.h"
 #ifdef XAPIAN_HAS_INMEMORY_BACKEND
@@ -54,30 +55,92 @@
 // Database::Internal.
 #include "backends/databaseinternal.h"
 
+#include <memory>
 #include <string>
 
 using namespace std;
 
 namespace Xapian {
 
+#ifdef XAPIAN_HAS_GLASS_BACKEND
+/// Apply any relevant flags to a newly opened read-only glass database.
+static GlassDatabase*
+glass_set_flags(GlassDatabase* db, int flags)
+{
+    if (flags & DB_CACHE_DOCLENS) {
+	unique_ptr<GlassDatabase> guard(db);
+	db->cache_doclens();
+	guard.release();
+    }
+    return db;
+}
+#endif
+
+#ifdef XAPIAN_HAS_HONEY_BACKEND
+/// Apply any relevant flags to a newly opened read-only honey database.
+template<typename T>
+static T*
+honey_set_flags(T* db, int flags)
+{
+    if (flags & DB_LOAD_INTO_MEMORY) {
+	unique_ptr<T> guard(db);
+	db->load_into_memory();
+	guard.release();
+    }
+    return db;
+}
+
+/// Open a honey database directory, with any overlay of updates to it.
+static Database::Internal*
+open_honey(const string& path, int flags)
+{
+    if (file_exists(path + "/" HONEY_OVERLAY_DIR "/iamglass")) {
+	return honey_set_flags(new HoneyOverlayDatabase(path), flags);
+    }
+    return honey_set_flags(new HoneyDatabase(path), flags);
+}
+
+/// Open a honey database directory for writing via an overlay.
+static Database::Internal*
+open_honey_writable(const string& path, int flags, int block_size)
+{
+    switch (flags & DB_ACTION_MASK_) {
+	case DB_CREATE:
+	    throw DatabaseCreateError("Can't create new database at '" +
+				      path + "': a database already exists "
+				      "and I was told not to overwrite it");
+	case DB_CREATE_OR_OVERWRITE:
+	    throw InvalidOperationError("Honey backend doesn't support "
+					"overwriting existing databases");
+    }
+    return new HoneyOverlayDatabase(path, flags, block_size);
+}
+#endif
+
 static void
-open_stub(Database& db, const string& file)
+open_stub(Database& db, const string& file, int flags)
 {
+    // Pass on flags other than the backend to the databases in the stub.
+    flags &= ~DB_BACKEND_MASK_;
     read_stub_file(file,
-		   [&db](const string& path) {
-		       db.add_database(Database(path));
+		   [&db, flags](const string& path) {
+		       db.add_database(Database(path, flags));
 		   },
-		   [&db](const string& path) {
+		   [&db, flags](const string& path) {
 #ifdef XAPIAN_HAS_GLASS_BACKEND
-		       db.add_database(Database(new GlassDatabase(path)));
+		       auto glass_db = new GlassDatabase(path);
+		       db.add_database(Database(glass_set_flags(glass_db,
+								flags)));
 #else
+		       (void)flags;
 		       (void)path;
 #endif
 		   },
-		   [&db](const string& path) {
+		   [&db, flags](const string& path) {
 #ifdef XAPIAN_HAS_HONEY_BACKEND
-		       db.add_database(Database(new HoneyDatabase(path)));
+		       db.add_database(Database(open_honey(path, flags)));
 #else
+		       (void)flags;
 		       (void)path;
 #endif
 		   },
@@ -166,20 +229,20 @@ Database::Database(const string& path, int flags)
 	    throw FeatureUnavailableError("Chert backend no longer supported");
 	case DB_BACKEND_GLASS:
 #ifdef XAPIAN_HAS_GLASS_BACKEND
-	    internal = new GlassDatabase(path);
+	    internal = glass_set_flags(new GlassDatabase(path), flags);
 	    return;
 #else
 	    throw FeatureUnavailableError("Glass backend disabled");
 #endif
 	case DB_BACKEND_HONEY:
 #ifdef XAPIAN_HAS_HONEY_BACKEND
-	    internal = new HoneyDatabase(path);
+	    internal = open_honey(path, flags);
 	    return;
 #else
 	    throw FeatureUnavailableError("Honey backend disabled");
 #endif
 	case DB_BACKEND_STUB:
-	    open_stub(*this, path);
+	    open_stub(*this, path, flags);
 	    return;
 	case DB_BACKEND_INMEMORY:
 #ifdef XAPIAN_HAS_INMEMORY_BACKEND
@@ -204,7 +267,7 @@ Database::Database(const string& path, int flags)
 	    case BACKEND_GLASS:
 #ifdef XAPIAN_HAS_GLASS_BACKEND
 		// Single file glass format.
-		internal = new GlassDatabase(fd);
+		internal = glass_set_flags(new GlassDatabase(fd), flags);
 		return;
 #else
 		throw FeatureUnavailableError("Glass backend disabled");
@@ -212,14 +275,14 @@ Database::Database(const string& path, int flags)
 	    case BACKEND_HONEY:
 #ifdef XAPIAN_HAS_HONEY_BACKEND
 		// Single file honey format.
-		internal = new HoneyDatabase(fd);
+		internal = honey_set_flags(new HoneyDatabase(fd), flags);
 		return;
 #else
 		throw FeatureUnavailableError("Honey backend disabled");
 #endif
 	}
 
-	open_stub(*this, path);
+	open_stub(*this, path, flags);
 	return;
     }
 
@@ -229,14 +292,14 @@ Database::Database(const string& path, int flags)
 
 #ifdef XAPIAN_HAS_GLASS_BACKEND
     if (file_exists(path + "/iamglass")) {
-	internal = new GlassDatabase(path);
+	internal = glass_set_flags(new GlassDatabase(path), flags);
 	return;
     }
 #endif
 
 #ifdef XAPIAN_HAS_HONEY_BACKEND
     if (file_exists(path + "/iamhoney")) {
-	internal = new HoneyDatabase(path);
+	internal = open_honey(path, flags);
 	return;
     }
 #endif
@@ -245,7 +308,7 @@ Database::Database(const string& path, int flags)
     string stub_file = path;
     stub_file += "/XAPIANDB";
     if (usual(file_exists(stub_file))) {
-	open_stub(*this, stub_file);
+	open_stub(*this, stub_file, flags);
 	return;
     }
 
@@ -297,11 +360,11 @@ database_factory(int fd, int flags)
     switch (type) {
 #ifdef XAPIAN_HAS_GLASS_BACKEND
 	case DB_BACKEND_GLASS:
-	    return new GlassDatabase(fd);
+	    return glass_set_flags(new GlassDatabase(fd), flags);
 #endif
 #ifdef XAPIAN_HAS_HONEY_BACKEND
 	case DB_BACKEND_HONEY:
-	    return new HoneyDatabase(fd);
+	    return honey_set_flags(new HoneyDatabase(fd), flags);
 #endif
     }
 #endif
@@ -356,9 +419,13 @@ WritableDatabase::WritableDatabase(const std::string &path, int flags, int block
 		throw FeatureUnavailableError("Glass backend disabled");
 #endif
 	    } else if (file_exists(path + "/iamhoney")) {
-		// Existing honey DB.
-		throw InvalidOperationError("Honey backend doesn't support "
-					    "updating existing databases");
+		// Existing honey DB, which we update via an overlay.
+#ifdef XAPIAN_HAS_HONEY_BACKEND
+		internal = open_honey_writable(path, flags, block_size);
+		return;
+#else
+		throw FeatureUnavailableError("Honey backend disabled");
+#endif
 	    } else if (file_exists(path + "/iamchert")) {
 		// Existing chert DB.
 		throw FeatureUnavailableError("Chert backend no longer supported");
@@ -390,8 +457,14 @@ WritableDatabase::WritableDatabase(const std::string &path, int flags, int block
 	    return;
 #endif
 	case DB_BACKEND_HONEY:
-	    throw InvalidArgumentError("Honey backend doesn't support "
-				       "updating existing databases");
+#ifdef XAPIAN_HAS_HONEY_BACKEND
+	    if (file_exists(path + "/iamhoney")) {
+		internal = open_honey_writable(path, flags, block_size);
+		return;
+	    }
+#endif
+	    throw InvalidArgumentError("Honey databases can only be created "
+				       "by compaction");
 	case DB_BACKEND_CHERT:
 	    throw FeatureUnavailableError("Chert backend no longer supported");
 	case DB_BACKEND_INMEMORY:
@@ -64,6 +64,13 @@ class Document::Internal : public Xapian::Internal::intrusive_base {
      */
     std::unique_ptr<std::string> data;
 
+    /** Document data which has already been read from the database.
+     *
+     *  If non-NULL, get_data() returns this rather than fetching the data
+     *  again.  Unlike @a data, this doesn't count as a modification.
+     */
+    std::unique_ptr<std::string> fetched_data;
+
     /** Terms in the document and their associated metadata.
      *
      *  If NULL, the terms haven't been fetched or set yet.
@@ -235,6 +242,8 @@ class Document::Internal : public Xapian::Internal::intrusive_base {
     std::string get_data() const {
 	if (data)
 	    return *data;
+	if (fetched_data)
+	    return *fetched_data;
 	return fetch_data();
     }
 
@@ -243,6 +252,23 @@ class Document::Internal : public Xapian::Internal::intrusive_base {
 	data.reset(new std::string(data_));
     }
 
+    /** Supply the document data which has already been read.
+     *
+     *  Used by MSet::fetch() so the data doesn't get read again.  Unlike
+     *  set_data(), this doesn't mark the data as modified.
+     */
+    void set_fetched_data(const std::string& data_) {
+	fetched_data.reset(new std::string(data_));
+    }
+
+    /** Ensure the terms and positions are held in this object.
+     *
+     *  After this call, iterating the terms of this document won't access
+     *  the database it came from, so different documents from the same
+     *  database can be iterated in different threads.
+     */
+    void fetch_terms() const { ensure_terms_fetched(); }
+
     /// Add a term to this document.
     void add_term(const std::string& term, Xapian::termcount wdf_inc) {
 	ensure_terms_fetched();
@@ -26,13 +26,21 @@
 
 #include "glass_check.h"
 #include "glass_version.h"
+#include "crc32c.h"
+#include "io_utils.h"
 #include "unicode/description_append.h"
+#include "wordaccess.h"
 #include "xapian/constants.h"
 
 #include <climits>
 #include <cstring>
 #include <memory>
 #include <ostream>
+#include <vector>
+#if defined HAVE_STD_THREAD && !defined XAPIAN_DEBUG_LOG
+# include <system_error>
+# include <thread>
+#endif
 
 using namespace Glass;
 using namespace std;
@@ -108,7 +116,7 @@ void GlassTableCheck::report_block_full(int m, int n, const uint8_t * p) const
 
 int GlassTableCheck::block_usage(const uint8_t * p) const
 {
-    int space = block_size - DIR_END(p);
+    int space = block_end() - DIR_END(p);
     int free = TOTAL_FREE(p);
     return (space - free) * 100 / space;  /* a percentage */
 }
@@ -164,7 +172,7 @@ GlassTableCheck::block_check(Glass::Cursor * C_, int j, int opts,
 
     size_t max_free = MAX_FREE(p);
     int dir_end = DIR_END(p);
-    int total_free = block_size - dir_end;
+    int total_free = block_end() - dir_end;
 
     if (!flcheck.mark_used(n))
 	failure("used more than once in the Btree", n);
@@ -172,7 +180,8 @@ GlassTableCheck::block_check(Glass::Cursor * C_, int j, int opts,
     if (j != GET_LEVEL(p))
 	failure("wrong level", n);
     // dir_end must be > DIR_START, fit within the block, and be odd.
-    if (dir_end <= DIR_START || dir_end > int(block_size) || (dir_end & 1) != 1)
+    if (dir_end <= DIR_START || dir_end > int(block_end()) ||
+	(dir_end & 1) != 1)
 	failure("directory end pointer invalid", n);
 
     if (opts & Xapian::DBCHECK_SHORT_TREE)
@@ -185,13 +194,13 @@ GlassTableCheck::block_check(Glass::Cursor * C_, int j, int opts,
 	for (c = DIR_START; c < dir_end; c += D2) {
 	    LeafItem item(p, c);
 	    int o = item.get_address() - p;
-	    if (o > int(block_size))
+	    if (o > int(block_end()))
 		failure("item starts outside block", n, c);
 	    if (o - dir_end < int(max_free))
 		failure("item overlaps directory", n, c);
 
 	    int kt_len = item.size();
-	    if (o + kt_len > int(block_size))
+	    if (o + kt_len > int(block_end()))
 		failure("item ends outside block", n, c);
 	    total_free -= kt_len;
 
@@ -202,13 +211,13 @@ GlassTableCheck::block_check(Glass::Cursor * C_, int j, int opts,
 	for (c = DIR_START; c < dir_end; c += D2) {
 	    BItem item(p, c);
 	    int o = item.get_address() - p;
-	    if (o > int(block_size))
+	    if (o > int(block_end()))
 		failure("item starts outside block", n, c);
 	    if (o - dir_end < int(max_free))
 		failure("item overlaps directory", n, c);
 
 	    int kt_len = item.size();
-	    if (o + kt_len > int(block_size))
+	    if (o + kt_len > int(block_end()))
 		failure("item ends outside block", n, c);
 	    total_free -= kt_len;
 
@@ -259,6 +268,102 @@ GlassTableCheck::block_check(Glass::Cursor * C_, int j, int opts,
     }
 }
 
+/// How many consecutive blocks each thread reads when checking checksums.
+static const uint4 CHECKSUM_CHUNK = 64;
+
+/** Check the checksums of the blocks in chunks t, t + n_threads, ...
+ *
+ *  Sets *first_bad to the lowest numbered block with a bad checksum, or end
+ *  if there isn't one.  Any exception is stored in *error so that this can
+ *  be run in a thread.
+ */
+void
+GlassTableCheck::check_checksums_range(uint4 end, unsigned t,
+				       unsigned n_threads,
+				       uint4 * first_bad,
+				       exception_ptr * error) const
+{
+    *first_bad = end;
+    try {
+	unique_ptr<uint8_t[]> buf(new uint8_t[block_size]);
+	char * p = reinterpret_cast<char *>(buf.get());
+	unsigned e = block_end();
+	uint4 n_chunks = end / CHECKSUM_CHUNK + (end % CHECKSUM_CHUNK != 0);
+	for (uint4 chunk = t; chunk < n_chunks; chunk += n_threads) {
+	    uint4 n = chunk * CHECKSUM_CHUNK;
+	    uint4 chunk_end = n + min(CHECKSUM_CHUNK, end - n);
+	    for ( ; n != chunk_end; ++n) {
+		io_read_block(handle, p, block_size, n, offset);
+		if (crc32c(p, e) == aligned_read4(buf.get() + e)) continue;
+		// A block which was allocated but never written (e.g. because
+		// a transaction was abandoned) will be all zeros.
+		if (p[0] == 0 && memcmp(p, p + 1, block_size - 1) == 0)
+		    continue;
+		*first_bad = n;
+		return;
+	    }
+	}
+    } catch (...) {
+	*error = current_exception();
+    }
+}
+
+/** Check the checksum of every block in the table.
+ *
+ *  The tree walk checks the checksums of the blocks it reads too, but this
+ *  reads the file sequentially, using several threads if possible, so it's
+ *  much faster for a large table and also checks blocks on the freelist.
+ *  It also means any corruption is reported before we try to interpret the
+ *  contents of a corrupt block.
+ */
+void
+GlassTableCheck::check_checksums() const
+{
+    uint4 end = free_list.get_first_unused_block();
+    unsigned n_threads = 1;
+#if defined HAVE_STD_THREAD && !defined XAPIAN_DEBUG_LOG
+    // The debug log isn't thread-safe, so we don't use threads if it's
+    // enabled.
+    n_threads = thread::hardware_concurrency();
+    if (n_threads > 8) n_threads = 8;
+    uint4 n_chunks = end / CHECKSUM_CHUNK + (end % CHECKSUM_CHUNK != 0);
+    if (n_threads > n_chunks) n_threads = n_chunks;
+    if (n_threads == 0) n_threads = 1;
+#endif
+    vector<uint4> first_bad(n_threads);
+    vector<exception_ptr> errors(n_threads);
+#if defined HAVE_STD_THREAD && !defined XAPIAN_DEBUG_LOG
+    vector<thread> workers;
+    workers.reserve(n_threads - 1);
+    for (unsigned t = 1; t < n_threads; ++t) {
+	try {
+	    workers.emplace_back(&GlassTableCheck::check_checksums_range, this,
+				 end, t, n_threads, &first_bad[t], &errors[t]);
+	} catch (const system_error&) {
+	    // We couldn't start a thread, so do the work in this one.
+	    check_checksums_range(end, t, n_threads, &first_bad[t],
+				  &errors[t]);
+	}
+    }
+#endif
+    check_checksums_range(end, 0, n_threads, &first_bad[0], &errors[0]);
+#if defined HAVE_STD_THREAD && !defined XAPIAN_DEBUG_LOG
+    for (auto&& worker : workers) {
+	worker.join();
+    }
+#endif
+
+    for (auto&& error : errors) {
+	if (error) rethrow_exception(error);
+    }
+    uint4 bad = end;
+    for (uint4 n : first_bad) {
+	if (n < bad) bad = n;
+    }
+    if (bad != end)
+	failure("checksum mismatch", bad);
+}
+
 GlassTableCheck *
 GlassTableCheck::check(const char * tablename, const string & path, int fd,
 		       off_t offset_,
@@ -315,6 +420,8 @@ GlassTableCheck::check(const char * tablename, const string & path, int fd,
 	if (out && opts)
 	    *out << "void ";
     } else {
+	if (B->checksums) B->check_checksums();
+
 	// We walk the Btree marking off the blocks which it uses, then walk
 	// the free list, marking the blocks which aren't used.  Any blocks not
 	// marked have been leaked.
@@ -27,6 +27,7 @@
 
 #include "glass_table.h"
 
+#include <exception>
 #include <iosfwd>
 #include <string>
 
@@ -51,6 +52,10 @@ class GlassTableCheck : public GlassTable {
 
     void block_check(Glass::Cursor * C_, int j, int opts,
 		     GlassFreeListChecker &flcheck);
+    void check_checksums() const;
+    void check_checksums_range(uint4 end, unsigned t, unsigned n_threads,
+			       uint4 * first_bad,
+			       std::exception_ptr * error) const;
     int block_usage(const uint8_t * p) const;
     void report_block(int m, int n, const uint8_t * p) const;
     void report_block_full(int m, int n, const uint8_t * p) const;
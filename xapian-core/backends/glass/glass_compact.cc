@@ -27,12 +27,19 @@
 #include "xapian/types.h"
 
 #include <algorithm>
+#include <exception>
+#include <functional>
 #include <memory>
 #include <queue>
+#include <system_error>
+#ifdef HAVE_STD_THREAD
+# include <thread>
+#endif
 
 #include <cerrno>
 #include <cstdio>
 
+#include "backends/databasehelpers.h"
 #include "backends/flint_lock.h"
 #include "glass_database.h"
 #include "glass_defs.h"
@@ -185,11 +192,17 @@ encode_valuestats(Xapian::doccount freq,
     return value;
 }
 
+/** Merge postlist tables.
+ *
+ *  @param rechunk	Split the posting lists into chunks again, using the
+ *			chunk sizes for @a out.
+ */
 static void
 merge_postlists(Xapian::Compactor * compactor,
 		GlassTable * out, vector<Xapian::docid>::const_iterator offset,
 		vector<const GlassTable*>::const_iterator b,
-		vector<const GlassTable*>::const_iterator e)
+		vector<const GlassTable*>::const_iterator e,
+		bool rechunk = false)
 {
     priority_queue<PostlistCursor *, vector<PostlistCursor *>, PostlistCursorGt> pq;
     for ( ; b != e; ++b, ++offset) {
@@ -347,12 +360,19 @@ merge_postlists(Xapian::Compactor * compactor,
 	Assert(cur == NULL || !is_user_metadata_key(cur->key));
 	if (cur == NULL || cur->key != last_key) {
 	    if (!tags.empty()) {
+		if (rechunk) {
+		    GlassPostListTable::rechunk(tags,
+						is_doclenchunk_key(last_key) ?
+						0 : tf,
+						out->get_adaptive_chunks());
+		}
 		string first_tag;
 		pack_uint(first_tag, tf);
 		pack_uint(first_tag, cf);
 		pack_uint(first_tag, tags[0].first - 1);
 		string tag = tags[0].second;
-		tag[0] = (tags.size() == 1) ? '1' : '0';
+		// The bottom bit of the first byte is the "last chunk" flag.
+		tag[0] = char((tag[0] & ~1) | (tags.size() == 1));
 		first_tag += tag;
 		out->add(last_key, first_tag);
 
@@ -367,7 +387,7 @@ merge_postlists(Xapian::Compactor * compactor,
 		auto i = tags.begin();
 		while (++i != tags.end()) {
 		    tag = i->second;
-		    tag[0] = (i + 1 == tags.end()) ? '1' : '0';
+		    tag[0] = char((tag[0] & ~1) | (i + 1 == tags.end()));
 		    out->add(pack_glass_postlist_key(term, i->first), tag);
 		}
 	    }
@@ -597,7 +617,8 @@ static void
 multimerge_postlists(Xapian::Compactor * compactor,
 		     GlassTable * out, const char * tmpdir,
 		     vector<const GlassTable *> tmp,
-		     vector<Xapian::docid> off)
+		     vector<Xapian::docid> off,
+		     bool rechunk)
 {
     unsigned int c = 0;
     while (tmp.size() > 3) {
@@ -643,7 +664,8 @@ multimerge_postlists(Xapian::Compactor * compactor,
 	swap(off, newoff);
 	++c;
     }
-    merge_postlists(compactor, out, off.begin(), tmp.begin(), tmp.end());
+    merge_postlists(compactor, out, off.begin(), tmp.begin(), tmp.end(),
+		    rechunk);
     if (c > 0) {
 	for (size_t k = 0; k < tmp.size(); ++k) {
 	    unlink(tmp[k]->get_path().c_str());
@@ -768,6 +790,169 @@ merge_docid_keyed(GlassTable *out, const vector<const GlassTable*> & inputs,
     }
 }
 
+/** Merge the @a inputs of a table into @a out.
+ *
+ *  Only merging the postlist table calls back into @a compactor.
+ */
+static void
+merge_table(Xapian::Compactor * compactor, Glass::table_type type,
+	    GlassTable * out, const char * tmpdir, bool multipass,
+	    const vector<const GlassTable*> & inputs,
+	    const vector<Xapian::docid> & offset)
+{
+    switch (type) {
+	case Glass::POSTLIST: {
+	    // If the output or any input uses adaptive chunk sizes, then the
+	    // chunks need resizing to suit the output.
+	    bool rechunk = out->get_adaptive_chunks();
+	    for (auto input : inputs) {
+		if (input->get_adaptive_chunks()) rechunk = true;
+	    }
+	    if (multipass && inputs.size() > 3) {
+		multimerge_postlists(compactor, out, tmpdir, inputs, offset,
+				     rechunk);
+	    } else {
+		merge_postlists(compactor, out, offset.begin(),
+				inputs.begin(), inputs.end(), rechunk);
+	    }
+	    break;
+	}
+	case Glass::SPELLING:
+	    merge_spellings(out, inputs.begin(), inputs.end());
+	    break;
+	case Glass::SYNONYM:
+	    merge_synonyms(out, inputs.begin(), inputs.end());
+	    break;
+	case Glass::POSITION:
+	    merge_positions(out, inputs, offset);
+	    break;
+	default:
+	    // DocData, Termlist
+	    merge_docid_keyed(out, inputs, offset);
+	    break;
+    }
+}
+
+static void
+report_table_status(Xapian::Compactor * compactor, const char * name,
+		    bool bad_stat, bool single_file_in,
+		    off_t in_size, off_t out_size)
+{
+    if (!compactor) return;
+    if (bad_stat) {
+	compactor->set_status(name, "Done (couldn't stat all the DB files)");
+    } else if (single_file_in) {
+	compactor->set_status(name, "Done (table sizes unknown for single file DB input)");
+    } else {
+	string status;
+	if (out_size == in_size) {
+	    status = "Size unchanged (";
+	} else {
+	    off_t delta;
+	    if (out_size < in_size) {
+		delta = in_size - out_size;
+		status = "Reduced by ";
+	    } else {
+		delta = out_size - in_size;
+		status = "INCREASED by ";
+	    }
+	    if (in_size) {
+		status += str(100 * delta / in_size);
+		status += "% ";
+	    }
+	    status += str(delta);
+	    status += "K (";
+	    status += str(in_size);
+	    status += "K -> ";
+	}
+	status += str(out_size);
+	status += "K)";
+	compactor->set_status(name, status);
+    }
+}
+
+#if defined HAVE_STD_THREAD && !defined XAPIAN_DEBUG_LOG
+/// A table which has been set up, ready to be merged.
+struct MergeJob {
+    const char * name;
+    Glass::table_type type;
+    /// The status to report if the output table isn't being created.
+    string status;
+    string dest;
+    vector<const GlassTable*> inputs;
+    off_t in_size = 0;
+    bool bad_stat = false;
+    bool single_file_in = false;
+    /// The output table, or NULL if it isn't being created.
+    GlassTable * out = NULL;
+    RootInfo * root_info = NULL;
+    /// Exception thrown while merging, if any.
+    exception_ptr error;
+};
+
+/// Merge and commit the table for @a job.
+static void
+run_merge_job(Xapian::Compactor * compactor, MergeJob & job,
+	      const char * tmpdir, bool multipass,
+	      const vector<Xapian::docid> & offset)
+{
+    try {
+	merge_table(compactor, job.type, job.out, tmpdir, multipass,
+		    job.inputs, offset);
+	// Commit as revision 1.
+	job.out->flush_db();
+	job.out->commit(1, job.root_info);
+	job.out->sync();
+    } catch (...) {
+	job.error = current_exception();
+    }
+}
+
+/** Merge the tables for @a jobs in parallel.
+ *
+ *  Each table has its own input and output files, so they can be merged
+ *  independently.  Merging the postlist table may call
+ *  compactor->resolve_duplicate_metadata(), which doesn't have to be
+ *  thread-safe, so we merge that table in the calling thread.
+ */
+static void
+merge_tables_in_parallel(Xapian::Compactor * compactor,
+			 vector<MergeJob> & jobs,
+			 const char * tmpdir, bool multipass,
+			 const vector<Xapian::docid> & offset)
+{
+    vector<thread> workers;
+    workers.reserve(jobs.size());
+    MergeJob * postlist_job = NULL;
+    for (auto&& job : jobs) {
+	if (!job.out) {
+	    // This table doesn't exist in the output.
+	    continue;
+	}
+	if (job.type == Glass::POSTLIST) {
+	    postlist_job = &job;
+	    continue;
+	}
+	try {
+	    workers.emplace_back(run_merge_job, compactor, ref(job),
+				 tmpdir, multipass, cref(offset));
+	} catch (const system_error&) {
+	    // We couldn't start a thread, so do the work in this one.
+	    run_merge_job(compactor, job, tmpdir, multipass, offset);
+	}
+    }
+    if (postlist_job)
+	run_merge_job(compactor, *postlist_job, tmpdir, multipass, offset);
+    for (auto&& worker : workers) {
+	worker.join();
+    }
+
+    for (auto&& job : jobs) {
+	if (job.error) rethrow_exception(job.error);
+    }
+}
+#endif
+
 }
 
 using namespace GlassCompact;
@@ -854,7 +1039,18 @@ GlassDatabase::compact(Xapian::Compactor * compactor,
 	version_file_out.reset(new GlassVersion(destdir));
     }
 
-    version_file_out->create(block_size);
+    // Position data is copied without being re-encoded, so if any source
+    // has bit-packed position lists then the output needs to be marked as
+    // possibly having them too.
+    int create_flags = flags;
+    for (auto source : sources) {
+	auto db = static_cast<const GlassDatabase*>(source);
+	if (db->version_file.get_root(Glass::POSITION).get_packed_positions()) {
+	    create_flags |= Xapian::DB_PACKED_POSITIONS;
+	    break;
+	}
+    }
+    version_file_out->create(block_size, create_flags);
     for (size_t i = 0; i != sources.size(); ++i) {
 	auto db = static_cast<const GlassDatabase*>(sources[i]);
 	version_file_out->merge_stats(db->version_file);
@@ -867,6 +1063,16 @@ GlassDatabase::compact(Xapian::Compactor * compactor,
 	fl.pack(fl_serialised);
     }
 
+#if defined HAVE_STD_THREAD && !defined XAPIAN_DEBUG_LOG
+    // If each table has its own file then they can be merged in parallel.
+    // The debug log isn't thread-safe, so we don't use threads if it's
+    // enabled.
+    bool parallel = !single_file && get_compact_threads() > 1;
+    vector<MergeJob> jobs;
+#else
+    const bool parallel = false;
+#endif
+
     vector<GlassTable *> tabs;
     tabs.reserve(tables_end - tables);
     off_t prev_size = block_size;
@@ -876,7 +1082,7 @@ GlassDatabase::compact(Xapian::Compactor * compactor,
 	// need special handling.  The other tables have keys sorted in
 	// docid order, so we can merge them by simply copying all the keys
 	// from each source table in turn.
-	if (compactor)
+	if (compactor && !parallel)
 	    compactor->set_status(t->name, string());
 
 	string dest;
@@ -956,23 +1162,32 @@ GlassDatabase::compact(Xapian::Compactor * compactor,
 	}
 
 	// If any inputs lack a termlist table, suppress it in the output.
+	string skip_status;
 	if (t->type == Glass::TERMLIST && inputs_present != sources.size()) {
 	    if (inputs_present != 0) {
-		if (compactor) {
-		    string m = str(inputs_present);
-		    m += " of ";
-		    m += str(sources.size());
-		    m += " inputs present, so suppressing output";
-		    compactor->set_status(t->name, m);
-		}
-		continue;
+		skip_status = str(inputs_present);
+		skip_status += " of ";
+		skip_status += str(sources.size());
+		skip_status += " inputs present, so suppressing output";
 	    }
 	    output_will_exist = false;
 	}
 
 	if (!output_will_exist) {
+	    if (skip_status.empty()) skip_status = "doesn't exist";
+#if defined HAVE_STD_THREAD && !defined XAPIAN_DEBUG_LOG
+	    if (parallel) {
+		// Report this once the tables before it have been merged.
+		MergeJob job;
+		job.name = t->name;
+		job.type = t->type;
+		job.status = skip_status;
+		jobs.push_back(job);
+		continue;
+	    }
+#endif
 	    if (compactor)
-		compactor->set_status(t->name, "doesn't exist");
+		compactor->set_status(t->name, skip_status);
 	    continue;
 	}
 
@@ -995,31 +1210,26 @@ GlassDatabase::compact(Xapian::Compactor * compactor,
 	out->set_full_compaction(compaction != compactor->STANDARD);
 	if (compaction == compactor->FULLER) out->set_max_item_size(1);
 
-	switch (t->type) {
-	    case Glass::POSTLIST: {
-		if (multipass && inputs.size() > 3) {
-		    multimerge_postlists(compactor, out, destdir,
-					 inputs, offset);
-		} else {
-		    merge_postlists(compactor, out, offset.begin(),
-				    inputs.begin(), inputs.end());
-		}
-		break;
-	    }
-	    case Glass::SPELLING:
-		merge_spellings(out, inputs.begin(), inputs.end());
-		break;
-	    case Glass::SYNONYM:
-		merge_synonyms(out, inputs.begin(), inputs.end());
-		break;
-	    case Glass::POSITION:
-		merge_positions(out, inputs, offset);
-		break;
-	    default:
-		// DocData, Termlist
-		merge_docid_keyed(out, inputs, offset);
-		break;
+#if defined HAVE_STD_THREAD && !defined XAPIAN_DEBUG_LOG
+	if (parallel) {
+	    // Merge and report on this table once all the tables are set up.
+	    MergeJob job;
+	    job.name = t->name;
+	    job.type = t->type;
+	    job.dest = dest;
+	    job.inputs = inputs;
+	    job.in_size = in_size;
+	    job.bad_stat = bad_stat;
+	    job.single_file_in = single_file_in;
+	    job.out = out;
+	    job.root_info = root_info;
+	    jobs.push_back(job);
+	    continue;
 	}
+#endif
+
+	merge_table(compactor, t->type, out, destdir, multipass,
+		    inputs, offset);
 
 	// Commit as revision 1.
 	out->flush_db();
@@ -1046,40 +1256,38 @@ GlassDatabase::compact(Xapian::Compactor * compactor,
 		bad_stat = (errno != ENOENT);
 	    }
 	}
-	if (bad_stat) {
-	    if (compactor)
-		compactor->set_status(t->name, "Done (couldn't stat all the DB files)");
-	} else if (single_file_in) {
+	report_table_status(compactor, t->name, bad_stat, single_file_in,
+			    in_size, out_size);
+    }
+
+#if defined HAVE_STD_THREAD && !defined XAPIAN_DEBUG_LOG
+    if (parallel) {
+	merge_tables_in_parallel(compactor, jobs, destdir, multipass, offset);
+
+	// Report on the tables in order.
+	for (auto&& job : jobs) {
+	    if (!job.out) {
+		if (compactor)
+		    compactor->set_status(job.name, job.status);
+		continue;
+	    }
 	    if (compactor)
-		compactor->set_status(t->name, "Done (table sizes unknown for single file DB input)");
-	} else {
-	    string status;
-	    if (out_size == in_size) {
-		status = "Size unchanged (";
-	    } else {
-		off_t delta;
-		if (out_size < in_size) {
-		    delta = in_size - out_size;
-		    status = "Reduced by ";
+		compactor->set_status(job.name, string());
+	    off_t out_size = 0;
+	    bool bad_stat = job.bad_stat;
+	    if (!bad_stat && !job.single_file_in) {
+		off_t db_size = file_size(job.dest + GLASS_TABLE_EXTENSION);
+		if (errno == 0) {
+		    out_size = db_size / 1024;
 		} else {
-		    delta = out_size - in_size;
-		    status = "INCREASED by ";
-		}
-		if (in_size) {
-		    status += str(100 * delta / in_size);
-		    status += "% ";
+		    bad_stat = (errno != ENOENT);
 		}
-		status += str(delta);
-		status += "K (";
-		status += str(in_size);
-		status += "K -> ";
 	    }
-	    status += str(out_size);
-	    status += "K)";
-	    if (compactor)
-		compactor->set_status(t->name, status);
+	    report_table_status(compactor, job.name, bad_stat,
+				job.single_file_in, job.in_size, out_size);
 	}
     }
+#endif
 
     // If compacting to a single file output and all the tables are empty, pad
     // the output so that it isn't mistaken for a stub database when we try to
@@ -39,6 +39,7 @@
 #include "glass_alltermslist.h"
 #include "glass_defs.h"
 #include "glass_docdata.h"
+#include "glass_doclencache.h"
 #include "glass_document.h"
 #include "../flint_lock.h"
 #include "glass_metadata.h"
@@ -69,8 +70,16 @@
 #include <algorithm>
 #include <cerrno>
 #include <cstdlib>
+#include <exception>
+#include <functional>
 #include <memory>
 #include <string>
+#include <system_error>
+#ifdef HAVE_STD_THREAD
+# include <thread>
+#endif
+#include <unordered_set>
+#include <vector>
 
 using namespace std;
 using namespace Xapian;
@@ -113,7 +122,8 @@ GlassDatabase::GlassDatabase(const string &glass_dir, int flags,
 	  spelling_table(db_dir, readonly),
 	  docdata_table(db_dir, readonly),
 	  lock(db_dir),
-	  changes(db_dir)
+	  changes(db_dir),
+	  use_doclen_cache(false)
 {
     LOGCALL_CTOR(DB, "GlassDatabase", glass_dir | flags | block_size);
 
@@ -178,7 +188,8 @@ GlassDatabase::GlassDatabase(int fd)
 	  spelling_table(fd, version_file.get_offset(), readonly),
 	  docdata_table(fd, version_file.get_offset(), readonly),
 	  lock(),
-	  changes(string())
+	  changes(string()),
+	  use_doclen_cache(false)
 {
     LOGCALL_CTOR(DB, "GlassDatabase", fd);
     open_tables(Xapian::DB_READONLY_);
@@ -204,7 +215,7 @@ GlassDatabase::create_and_open_tables(int flags, unsigned int block_size)
     // already exist.
 
     GlassVersion &v = version_file;
-    v.create(block_size);
+    v.create(block_size, flags);
 
     glass_revision_number_t rev = v.get_revision();
     const string& tmpfile = v.write(rev, flags);
@@ -260,6 +271,8 @@ GlassDatabase::open_tables(int flags)
 
     value_manager.reset();
 
+    if (use_doclen_cache) load_doclen_cache();
+
     if (!readonly) {
 	changes.set_oldest_changeset(version_file.get_oldest_changeset());
 	glass_revision_number_t revision = version_file.get_revision();
@@ -275,6 +288,41 @@ GlassDatabase::open_tables(int flags)
     return true;
 }
 
+void
+GlassDatabase::cache_doclens()
+{
+    LOGCALL_VOID(DB, "GlassDatabase::cache_doclens", NO_ARGS);
+    if (!readonly || use_doclen_cache) return;
+    use_doclen_cache = true;
+    load_doclen_cache();
+}
+
+void
+GlassDatabase::load_doclen_cache()
+{
+    LOGCALL_VOID(DB, "GlassDatabase::load_doclen_cache", NO_ARGS);
+    doclen_cache.reset();
+
+    Xapian::docid last_docid = version_file.get_last_docid();
+    // If the used docids are very sparse, the array would be mostly empty
+    // so just look up document lengths in the postlist table instead.
+    if (last_docid / 4 > version_file.get_doccount()) return;
+
+    // The UUID and revision together identify the contents of the database.
+    string key(version_file.get_uuid(), 16);
+    pack_uint(key, version_file.get_revision());
+    doclen_cache = GlassDoclenCache::lookup(key);
+    if (doclen_cache) return;
+
+    auto cache = make_shared<GlassDoclenCache>(
+	last_docid, version_file.get_doclength_upper_bound());
+    if (!postlist_table.load_doclengths(*cache)) {
+	// A document length exceeded the recorded upper bound.
+	return;
+    }
+    doclen_cache = GlassDoclenCache::publish(key, std::move(cache));
+}
+
 glass_revision_number_t
 GlassDatabase::get_next_revision_number() const
 {
@@ -350,12 +398,24 @@ GlassDatabase::set_revision_number(int flags, glass_revision_number_t new_revisi
     version_file.set_spelling_wordfreq_upper_bound(spelling_table.flush_db());
     docdata_table.flush_db();
 
-    postlist_table.commit(new_revision, version_file.root_to_set(Glass::POSTLIST));
-    position_table.commit(new_revision, version_file.root_to_set(Glass::POSITION));
-    termlist_table.commit(new_revision, version_file.root_to_set(Glass::TERMLIST));
-    synonym_table.commit(new_revision, version_file.root_to_set(Glass::SYNONYM));
-    spelling_table.commit(new_revision, version_file.root_to_set(Glass::SPELLING));
-    docdata_table.commit(new_revision, version_file.root_to_set(Glass::DOCDATA));
+    postlist_table.commit(new_revision,
+			  version_file.root_to_set(Glass::POSTLIST),
+			  retain_revisions);
+    position_table.commit(new_revision,
+			  version_file.root_to_set(Glass::POSITION),
+			  retain_revisions);
+    termlist_table.commit(new_revision,
+			  version_file.root_to_set(Glass::TERMLIST),
+			  retain_revisions);
+    synonym_table.commit(new_revision,
+			 version_file.root_to_set(Glass::SYNONYM),
+			 retain_revisions);
+    spelling_table.commit(new_revision,
+			  version_file.root_to_set(Glass::SPELLING),
+			  retain_revisions);
+    docdata_table.commit(new_revision,
+			 version_file.root_to_set(Glass::DOCDATA),
+			 retain_revisions);
 
     const string & tmpfile = version_file.write(new_revision, flags);
     if (!postlist_table.sync() ||
@@ -379,6 +439,12 @@ GlassDatabase::request_document(Xapian::docid did) const
     docdata_table.readahead_for_document(did);
 }
 
+void
+GlassDatabase::request_documents(const vector<Xapian::docid>& dids) const
+{
+    docdata_table.readahead_for_documents(dids);
+}
+
 void
 GlassDatabase::readahead_for_query(const Xapian::Query &query) const
 {
@@ -667,6 +733,19 @@ GlassDatabase::apply()
 	return;
     }
 
+    // Always check XAPIAN_RETAIN_REVISIONS for modification since the last
+    // commit.  Keeping blocks of older revisions allows readers to continue
+    // reading them for longer, but the database files will grow larger.
+    const char *p_retain = getenv("XAPIAN_RETAIN_REVISIONS");
+    if (p_retain && *p_retain) {
+	if (!parse_unsigned(p_retain, retain_revisions)) {
+	    throw Xapian::InvalidArgumentError("XAPIAN_RETAIN_REVISIONS must "
+					       "be a non-negative integer");
+	}
+    } else {
+	retain_revisions = 0;
+    }
+
     glass_revision_number_t new_revision = get_next_revision_number();
 
     int flags = postlist_table.get_flags();
@@ -735,6 +814,14 @@ GlassDatabase::get_doclength(Xapian::docid did) const
 {
     LOGCALL(DB, Xapian::termcount, "GlassDatabase::get_doclength", did);
     Assert(did != 0);
+    if (doclen_cache) {
+	Xapian::termcount doclen;
+	if (!doclen_cache->get(did, doclen)) {
+	    throw Xapian::DocNotFoundError("Document " + str(did) +
+					   " not found");
+	}
+	RETURN(doclen);
+    }
     intrusive_ptr<const GlassDatabase> ptrtothis(this);
     RETURN(postlist_table.get_doclength(did, ptrtothis));
 }
@@ -998,6 +1085,13 @@ GlassDatabase::get_revision() const
     RETURN(version_file.get_revision());
 }
 
+size_t
+GlassDatabase::get_memory_footprint() const
+{
+    LOGCALL(DB, size_t, "GlassDatabase::get_memory_footprint", NO_ARGS);
+    RETURN(doclen_cache ? doclen_cache->get_memory_used() : 0);
+}
+
 string
 GlassDatabase::get_uuid() const
 {
@@ -1073,6 +1167,7 @@ GlassWritableDatabase::GlassWritableDatabase(const string &dir, int flags,
 	: GlassDatabase(dir, flags, block_size),
 	  change_count(0),
 	  flush_threshold(0),
+	  flush_memory(0),
 	  modify_shortcut_document(NULL),
 	  modify_shortcut_docid(0)
 {
@@ -1085,8 +1180,18 @@ GlassWritableDatabase::GlassWritableDatabase(const string &dir, int flags,
 					       "be a non-negative integer");
 	}
     }
-    if (flush_threshold == 0)
-	flush_threshold = 10000;
+    p = getenv("XAPIAN_FLUSH_MEMORY");
+    if (p && *p) {
+	if (!parse_unsigned(p, flush_memory)) {
+	    throw Xapian::InvalidArgumentError("XAPIAN_FLUSH_MEMORY must "
+					       "be a non-negative integer");
+	}
+    }
+    if (flush_threshold == 0) {
+	// If only a memory threshold was specified, don't also impose the
+	// default document count threshold.
+	flush_threshold = flush_memory ? Xapian::doccount(-1) : 10000;
+    }
 }
 
 GlassWritableDatabase::~GlassWritableDatabase()
@@ -1107,10 +1212,10 @@ GlassWritableDatabase::commit()
 void
 GlassWritableDatabase::check_flush_threshold()
 {
-    // FIXME: this should be done by checking memory usage, not the number of
-    // changes.  We could also look at the amount of data the inverter object
-    // currently holds.
-    if (++change_count >= flush_threshold) {
+    // FIXME: The memory estimate only covers the inverter - changes to the
+    // other tables are buffered in their B-tree cursors and aren't counted.
+    if (++change_count >= flush_threshold ||
+	(flush_memory && inverter.get_memory_used() >= flush_memory)) {
 	flush_postlist_changes();
 	if (!transaction_active()) apply();
     }
@@ -1152,6 +1257,19 @@ GlassWritableDatabase::apply()
     GlassDatabase::apply();
 }
 
+void
+GlassWritableDatabase::check_document(const Xapian::Document& document)
+{
+    LOGCALL_STATIC_VOID(DB, "GlassWritableDatabase::check_document", document);
+    for (auto term = document.termlist_begin();
+	 term != document.termlist_end();
+	 ++term) {
+	string tname = *term;
+	if (tname.size() > MAX_SAFE_TERM_LENGTH)
+	    throw Xapian::InvalidArgumentError("Term too long (> " STRINGIZE(MAX_SAFE_TERM_LENGTH) "): " + tname);
+    }
+}
+
 Xapian::docid
 GlassWritableDatabase::add_document(const Xapian::Document & document)
 {
@@ -1216,6 +1334,180 @@ GlassWritableDatabase::add_document_(Xapian::docid did,
     RETURN(did);
 }
 
+#if defined HAVE_STD_THREAD && !defined XAPIAN_DEBUG_LOG
+namespace {
+
+/// The result of inverting a slice of a batch of documents.
+struct InvertedSlice {
+    /// Buffered postlist, positional and document length changes.
+    Inverter inverter;
+
+    /// Encoded termlist for each document.
+    vector<string> termlists;
+
+    /// Length of each document.
+    vector<Xapian::termcount> doclens;
+
+    /// Highest wdf of any term.
+    Xapian::termcount wdf_max = 0;
+
+    /// Exception thrown while inverting, if any.
+    exception_ptr error;
+};
+
+}
+
+/** Invert documents [begin, end) of @a docs, which get docids from @a did.
+ *
+ *  This only reads from @a position_table, so can be run in parallel for
+ *  different slices of @a docs.
+ */
+static void
+invert_documents(const GlassPositionListTable& position_table,
+		 bool want_termlists,
+		 const vector<Xapian::Document>& docs,
+		 size_t begin, size_t end,
+		 Xapian::docid did,
+		 InvertedSlice& out)
+{
+    try {
+	out.doclens.reserve(end - begin);
+	if (want_termlists) out.termlists.resize(end - begin);
+	for (size_t i = begin; i != end; ++i, ++did) {
+	    const Xapian::Document& document = docs[i];
+	    Xapian::termcount doclen = 0;
+	    Xapian::TermIterator term = document.termlist_begin();
+	    for ( ; term != document.termlist_end(); ++term) {
+		termcount wdf = term.get_wdf();
+		doclen += wdf;
+		if (wdf > out.wdf_max) out.wdf_max = wdf;
+
+		string tname = *term;
+		if (tname.size() > MAX_SAFE_TERM_LENGTH)
+		    throw Xapian::InvalidArgumentError("Term too long (> " STRINGIZE(MAX_SAFE_TERM_LENGTH) "): " + tname);
+
+		out.inverter.add_posting(did, tname, wdf);
+		out.inverter.set_positionlist(position_table, did, tname, term);
+	    }
+
+	    if (want_termlists) {
+		GlassTermListTable::encode_termlist(out.termlists[i - begin],
+						    document, doclen);
+	    }
+	    out.doclens.push_back(doclen);
+	    out.inverter.set_doclength(did, doclen, true);
+	}
+    } catch (...) {
+	out.error = current_exception();
+    }
+}
+#endif
+
+Xapian::docid
+GlassWritableDatabase::add_documents(const vector<Xapian::Document>& docs,
+				     unsigned threads)
+{
+    LOGCALL(DB, Xapian::docid, "GlassWritableDatabase::add_documents", docs.size() | threads);
+    // The debug log isn't thread-safe, so we don't use threads if it's
+    // enabled.
+#if defined HAVE_STD_THREAD && !defined XAPIAN_DEBUG_LOG
+    // Starting a thread has an overhead, so give each at least this many
+    // documents.
+    const size_t MIN_DOCS_PER_THREAD = 16;
+
+    size_t n = docs.size();
+    if (threads == 0) threads = thread::hardware_concurrency();
+    if (threads > n / MIN_DOCS_PER_THREAD)
+	threads = unsigned(n / MIN_DOCS_PER_THREAD);
+
+    if (threads > 1) {
+	// Iterating the terms of a document isn't safe to do in two threads at
+	// once, so handle a batch with the same document in more than once
+	// serially.  We also need to fetch the terms of documents read from a
+	// database here, since databases can't be used from multiple threads.
+	unordered_set<const Xapian::Document::Internal*> seen;
+	for (auto&& doc : docs) {
+	    if (!seen.insert(doc.internal.get()).second) {
+		threads = 1;
+		break;
+	    }
+	    doc.internal->fetch_terms();
+	}
+    }
+
+    if (threads > 1) {
+	if (GLASS_MAX_DOCID - version_file.get_last_docid() < n)
+	    throw Xapian::DatabaseError("Run out of docids - you'll have to use copydatabase to eliminate any gaps before you can add more documents");
+	Xapian::docid first = version_file.get_last_docid() + 1;
+
+	bool want_termlists = termlist_table.is_open();
+	vector<InvertedSlice> slices(threads);
+	vector<thread> workers;
+	workers.reserve(threads - 1);
+	for (unsigned t = 1; t < threads; ++t) {
+	    size_t begin = n * t / threads;
+	    size_t end = n * (t + 1) / threads;
+	    try {
+		workers.emplace_back(invert_documents, cref(position_table),
+				     want_termlists, cref(docs), begin, end,
+				     Xapian::docid(first + begin),
+				     ref(slices[t]));
+	    } catch (const system_error&) {
+		// We couldn't start a thread, so do the work in this one.
+		invert_documents(position_table, want_termlists, docs,
+				 begin, end, first + begin, slices[t]);
+	    }
+	}
+	invert_documents(position_table, want_termlists, docs,
+			 0, n / threads, first, slices[0]);
+	for (auto&& worker : workers) {
+	    worker.join();
+	}
+
+	// Nothing has been changed yet, but if any document failed we discard
+	// any uncommitted changes before reporting the first such failure, as
+	// happens when add_document() fails (and so when we don't use threads).
+	for (auto&& slice : slices) {
+	    if (slice.error) {
+		cancel();
+		rethrow_exception(slice.error);
+	    }
+	}
+
+	try {
+	    Xapian::docid did = first;
+	    for (auto&& slice : slices) {
+		for (size_t i = 0; i != slice.doclens.size(); ++i, ++did) {
+		    const Xapian::Document& document = docs[did - first];
+		    docdata_table.replace_document_data(did,
+							document.get_data());
+		    value_manager.add_document(did, document, value_stats);
+		    if (want_termlists)
+			termlist_table.set_termlist(did, slice.termlists[i]);
+		    version_file.add_document(slice.doclens[i]);
+		}
+		version_file.check_wdf(slice.wdf_max);
+		// The slices are in ascending docid order, so merging them in
+		// turn keeps the postlist changes for each term sorted.
+		inverter.merge(std::move(slice.inverter));
+	    }
+	    version_file.set_last_docid(first + n - 1);
+	} catch (...) {
+	    // As in add_document_(), discard the partial modifications.
+	    cancel();
+	    throw;
+	}
+
+	// Count the documents towards the automatic flush threshold.
+	change_count += Xapian::doccount(n - 1);
+	check_flush_threshold();
+
+	RETURN(first);
+    }
+#endif
+    RETURN(Database::Internal::add_documents(docs, threads));
+}
+
 void
 GlassWritableDatabase::delete_document(Xapian::docid did)
 {
@@ -1451,6 +1743,13 @@ GlassWritableDatabase::open_document(Xapian::docid did, bool lazy) const
     RETURN(modify_shortcut_document);
 }
 
+size_t
+GlassWritableDatabase::get_buffered_memory() const
+{
+    LOGCALL(DB, size_t, "GlassWritableDatabase::get_buffered_memory", NO_ARGS);
+    RETURN(inverter.get_memory_used());
+}
+
 Xapian::termcount
 GlassWritableDatabase::get_doclength(Xapian::docid did) const
 {
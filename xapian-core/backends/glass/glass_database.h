@@ -45,7 +45,9 @@
 #include "xapian/constants.h"
 
 #include <map>
+#include <memory>
 
+class GlassDoclenCache;
 class GlassTermList;
 class GlassAllDocsPostList;
 class HoneyDatabase;
@@ -116,6 +118,25 @@ class GlassDatabase : public Xapian::Database::Internal {
     /// Replication changesets.
     GlassChanges changes;
 
+    /** Number of older revisions to keep blocks for.
+     *
+     *  Set from XAPIAN_RETAIN_REVISIONS by apply().
+     */
+    unsigned retain_revisions = 0;
+
+    /** In-memory copy of the document lengths, or NULL.
+     *
+     *  This is only used for a read-only database, and is shared with any
+     *  other GlassDatabase objects open on the same revision.
+     */
+    std::shared_ptr<const GlassDoclenCache> doclen_cache;
+
+    /// Should doclen_cache be loaded when the tables are opened?
+    bool use_doclen_cache;
+
+    /// Load doclen_cache for the currently open revision.
+    void load_doclen_cache();
+
     /** Return true if a database exists at the path specified for this
      *  database.
      */
@@ -235,6 +256,13 @@ class GlassDatabase : public Xapian::Database::Internal {
 
     ~GlassDatabase();
 
+    /** Keep a copy of the document lengths in memory.
+     *
+     *  They're loaded now, and reloaded if the database is reopened at a
+     *  new revision.  This has no effect on a writable database.
+     */
+    void cache_doclens();
+
     /// Get a postlist table cursor (used by GlassValueList).
     GlassCursor * get_postlist_cursor() const {
 	return postlist_table.cursor_get();
@@ -299,7 +327,10 @@ class GlassDatabase : public Xapian::Database::Internal {
     Xapian::rev get_revision() const;
     string get_uuid() const;
 
+    size_t get_memory_footprint() const;
+
     void request_document(Xapian::docid /*did*/) const;
+    void request_documents(const std::vector<Xapian::docid>& dids) const;
     void readahead_for_query(const Xapian::Query &query) const;
     //@}
 
@@ -351,6 +382,13 @@ class GlassWritableDatabase : public GlassDatabase {
     /// If change_count reaches this threshold we automatically flush.
     Xapian::doccount flush_threshold;
 
+    /** If the inverter's estimated memory use reaches this many bytes we
+     *  automatically flush.
+     *
+     *  0 means no memory-based threshold is applied.
+     */
+    size_t flush_memory;
+
     /** A pointer to the last document which was returned by
      *  open_document(), or NULL if there is no such valid document.  This
      *  is used purely for comparing with a supplied document to help with
@@ -390,6 +428,8 @@ class GlassWritableDatabase : public GlassDatabase {
     Xapian::docid add_document(const Xapian::Document& document);
     Xapian::docid add_document_(Xapian::docid did,
 				const Xapian::Document& document);
+    Xapian::docid add_documents(const std::vector<Xapian::Document>& docs,
+				unsigned threads);
     // Stop the default implementation of delete_document(term) and
     // replace_document(term) from being hidden.  This isn't really
     // a problem as we only try to call them through the base class
@@ -403,9 +443,36 @@ class GlassWritableDatabase : public GlassDatabase {
     Xapian::Document::Internal * open_document(Xapian::docid did,
 					       bool lazy) const;
 
+    size_t get_buffered_memory() const;
+
     //@}
 
   public:
+    /** Set the thresholds for automatic flushing.
+     *
+     *  This overrides the values set from XAPIAN_FLUSH_THRESHOLD and
+     *  XAPIAN_FLUSH_MEMORY.  Used by BulkLoader, which decides for itself
+     *  when to flush.
+     *
+     *  @param threshold	Document count threshold.
+     *  @param memory		Memory threshold in bytes (0 for none).
+     */
+    void set_flush_thresholds(Xapian::doccount threshold, size_t memory) {
+	flush_threshold = threshold;
+	flush_memory = memory;
+    }
+
+    /** Check that @a document can be added to a glass database.
+     *
+     *  This checks for the problems with the document itself which would
+     *  cause add_document() to fail (currently just terms which are too
+     *  long), without changing anything.
+     *
+     *  @exception Xapian::InvalidArgumentError	if the document can't be
+     *						added.
+     */
+    static void check_document(const Xapian::Document& document);
+
     /** Create and open a writable glass database.
      *
      *  @exception Xapian::DatabaseOpeningError thrown if database can't
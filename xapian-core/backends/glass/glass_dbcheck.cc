@@ -34,13 +34,16 @@
 #include "glass_table.h"
 #include "glass_version.h"
 #include "pack.h"
+#include "packedpositions.h"
 #include "backends/valuestats.h"
 
 #include <xapian.h>
 
 #include "filetests.h"
 #include <memory>
+#include <new>
 #include <ostream>
+#include <stdexcept>
 #include <vector>
 
 using namespace std;
@@ -51,17 +54,218 @@ is_user_metadata_key(const string & key)
     return key.size() > 1 && key[0] == '\0' && key[1] == '\xc0';
 }
 
+/** Read the flags byte at the start of a posting list chunk header.
+ *
+ *  @return false if the flags byte isn't valid.
+ */
+static bool
+read_chunk_flags(const char ** p, const char * end,
+		 bool * is_last_chunk, bool * has_skips)
+{
+    unsigned flags;
+    if (*p == end || ((flags = unsigned(**p - '0')) & ~3u)) return false;
+    ++*p;
+    *is_last_chunk = (flags & 1);
+    *has_skips = (flags & 2);
+    return true;
+}
+
+/** Check the skip data in a posting list chunk.
+ *
+ *  @param pos	Pointer to the start of the skip data, which is updated to
+ *		point to the first entry in the chunk.
+ *  @param end	The end of the chunk.
+ *  @param did	The first docid in the chunk.
+ *  @param out	Stream to report the problem to (or NULL).
+ *
+ *  @return false if there's a problem with the skip data.
+ */
+static bool
+check_chunk_skips(const char ** pos, const char * end, Xapian::docid did,
+		  ostream * out)
+{
+    size_t len;
+    if (!unpack_uint(pos, end, &len) || len > size_t(end - *pos)) {
+	if (out)
+	    *out << "Failed to unpack skip data length" << endl;
+	return false;
+    }
+    const char * p = *pos;
+    const char * skips_end = p + len;
+    const char * entries = skips_end;
+
+    // The docid and wdf position of the entry we've reached in the chunk.
+    Xapian::docid entry_did = did;
+    const char * e = entries;
+    Xapian::docid skip_did = did;
+    size_t skip_offset = 0;
+    while (p != skips_end) {
+	Xapian::docid did_increase;
+	size_t offset_increase;
+	if (!unpack_uint(&p, skips_end, &did_increase) ||
+	    !unpack_uint(&p, skips_end, &offset_increase) ||
+	    did_increase == 0 || offset_increase == 0) {
+	    if (out)
+		*out << "Failed to unpack skip data" << endl;
+	    return false;
+	}
+	skip_did += did_increase;
+	skip_offset += offset_increase;
+	while (size_t(e - entries) < skip_offset) {
+	    Xapian::docid inc;
+	    if (!unpack_uint(&e, end, static_cast<Xapian::termcount*>(NULL)) ||
+		!unpack_uint(&e, end, &inc)) {
+		if (out)
+		    *out << "Skip data points past end of chunk" << endl;
+		return false;
+	    }
+	    entry_did += inc + 1;
+	}
+	if (size_t(e - entries) != skip_offset || entry_did != skip_did) {
+	    if (out)
+		*out << "Skip data doesn't match chunk entries" << endl;
+	    return false;
+	}
+    }
+    *pos = entries;
+    return true;
+}
+
 struct VStats : public ValueStats {
     Xapian::doccount freq_real;
 
     VStats() : ValueStats(), freq_real(0) {}
 };
 
+bool
+GlassCheckContext::enable_cross_checks(Xapian::docid last_docid)
+{
+    try {
+	docs_with_terms.resize(last_docid / 64 + 1);
+    } catch (const std::bad_alloc &) {
+	return false;
+    } catch (const std::length_error &) {
+	return false;
+    }
+    return true;
+}
+
+void
+GlassCheckContext::report_progress(const char * tablename, unsigned percent)
+{
+    if (!progress_out) return;
+#ifdef HAVE_STD_THREAD
+    lock_guard<mutex> lock(progress_mutex);
+#endif
+    *progress_out << tablename << ": " << percent << "% of entries checked"
+		  << endl;
+}
+
+/// Report progress through the entries in a table.
+class CheckProgress {
+    GlassCheckContext & context;
+
+    const char * tablename;
+
+    glass_tablesize_t total;
+
+    glass_tablesize_t done = 0;
+
+    unsigned last_percent = 0;
+
+  public:
+    CheckProgress(GlassCheckContext & context_, const char * tablename_,
+		  glass_tablesize_t total_)
+	: context(context_), tablename(tablename_), total(total_) { }
+
+    /// Note that we're about to check another entry.
+    void next() {
+	// The entry count could be wrong if the table is corrupt.
+	if (done == total) return;
+	++done;
+	unsigned percent = unsigned(done * 100 / total);
+	if (percent != last_percent) {
+	    last_percent = percent;
+	    context.report_progress(tablename, percent);
+	}
+    }
+};
+
+/** Read the document lengths from the termlist table in docid order.
+ *
+ *  The postlist table stores the document lengths in docid order too, so we
+ *  can cross-check them against the termlist table while only holding one
+ *  termlist in memory.  We open the termlist table separately rather than
+ *  gathering the lengths while checking it, so that the two tables can be
+ *  checked in parallel.
+ */
+class TermlistDoclens {
+    unique_ptr<GlassTable> table;
+
+    unique_ptr<GlassCursor> cursor;
+
+  public:
+    TermlistDoclens(const string & db_dir, int fd, off_t offset_,
+		    const GlassVersion & version_file) {
+	if (fd < 0) {
+	    table.reset(new GlassTable("termlist", db_dir + "/termlist.",
+				       true, true));
+	} else {
+	    table.reset(new GlassTable("termlist", fd, offset_, true, true));
+	}
+	table->open(0, version_file.get_root(Glass::TERMLIST),
+		    version_file.get_revision());
+	// If there's no termlist table, or it's empty, we can't cross-check.
+	if (table->get_entry_count() == 0) return;
+	cursor.reset(table->cursor_get());
+	if (!cursor) return;
+	cursor->rewind();
+	cursor->next(); // Skip the empty entry.
+    }
+
+    /// Can we cross-check against the termlist table?
+    bool usable() const { return bool(cursor); }
+
+    /** Return the length of document @a did according to its termlist.
+     *
+     *  Calls must be in ascending docid order.  A document without any terms
+     *  doesn't have a termlist, so we return 0 if there isn't one.  Problems
+     *  with the termlist table are reported when we check it, so we just
+     *  skip over anything we can't decode here.
+     */
+    Xapian::termcount get(Xapian::docid did) {
+	while (!cursor->after_end()) {
+	    const string & key = cursor->current_key;
+	    const char * pos = key.data();
+	    const char * end = pos + key.size();
+	    Xapian::docid tl_did;
+	    if (!unpack_uint_preserving_sort(&pos, end, &tl_did) ||
+		pos != end) {
+		// A value slots used entry, or a bad key.
+		cursor->next();
+		continue;
+	    }
+	    if (tl_did > did) break;
+	    if (tl_did == did) {
+		cursor->read_tag();
+		pos = cursor->current_tag.data();
+		end = pos + cursor->current_tag.size();
+		Xapian::termcount doclen;
+		if (pos == end || !unpack_uint(&pos, end, &doclen)) doclen = 0;
+		cursor->next();
+		return doclen;
+	    }
+	    cursor->next();
+	}
+	return 0;
+    }
+};
+
 size_t
 check_glass_table(const char * tablename, const string &db_dir, int fd,
 		  off_t offset_,
 		  const GlassVersion & version_file, int opts,
-		  vector<Xapian::termcount> & doclens, ostream * out)
+		  GlassCheckContext & context, ostream * out)
 {
     Xapian::docid db_last_docid = version_file.get_last_docid();
     if (out)
@@ -100,6 +304,8 @@ check_glass_table(const char * tablename, const string &db_dir, int fd,
     cursor->rewind();
     cursor->next(); // Skip the empty entry.
 
+    CheckProgress progress(context, tablename, table->get_entry_count());
+
     if (strcmp(tablename, "postlist") == 0) {
 	// Now check the structure of each postlist in the table.
 	map<Xapian::valueno, VStats> valuestats;
@@ -109,7 +315,15 @@ check_glass_table(const char * tablename, const string &db_dir, int fd,
 	Xapian::termcount tf = 0, cf = 0;
 	Xapian::doccount num_doclens = 0;
 
+	unique_ptr<TermlistDoclens> termlist_doclens;
+	if (context.cross_checks()) {
+	    termlist_doclens.reset(new TermlistDoclens(db_dir, fd, offset_,
+						       version_file));
+	    if (!termlist_doclens->usable()) termlist_doclens.reset();
+	}
+
 	for ( ; !cursor->after_end(); cursor->next()) {
+	    progress.next();
 	    string & key = cursor->current_key;
 
 	    if (is_user_metadata_key(key)) {
@@ -168,8 +382,8 @@ check_glass_table(const char * tablename, const string &db_dir, int fd,
 		    ++did;
 		}
 
-		bool is_last_chunk;
-		if (!unpack_bool(&pos, end, &is_last_chunk)) {
+		bool is_last_chunk, has_skips;
+		if (!read_chunk_flags(&pos, end, &is_last_chunk, &has_skips)) {
 		    if (out)
 			*out << "Failed to unpack last chunk flag for doclen" << endl;
 		    ++errors;
@@ -183,6 +397,10 @@ check_glass_table(const char * tablename, const string &db_dir, int fd,
 		    continue;
 		}
 		lastdid += did;
+		if (has_skips && !check_chunk_skips(&pos, end, did, out)) {
+		    ++errors;
+		    continue;
+		}
 		bool bad = false;
 		while (true) {
 		    Xapian::termcount doclen;
@@ -204,12 +422,11 @@ check_glass_table(const char * tablename, const string &db_dir, int fd,
 			++errors;
 		    }
 
-		    if (!doclens.empty()) {
+		    if (termlist_doclens) {
 			// In glass, a document without terms doesn't get a
 			// termlist entry.
-			Xapian::termcount termlist_doclen = 0;
-			if (did < doclens.size())
-			    termlist_doclen = doclens[did];
+			Xapian::termcount termlist_doclen =
+			    termlist_doclens->get(did);
 
 			if (doclen != termlist_doclen) {
 			    if (out)
@@ -497,8 +714,8 @@ check_glass_table(const char * tablename, const string &db_dir, int fd,
 		end = pos + cursor->current_tag.size();
 	    }
 
-	    bool is_last_chunk;
-	    if (!unpack_bool(&pos, end, &is_last_chunk)) {
+	    bool is_last_chunk, has_skips;
+	    if (!read_chunk_flags(&pos, end, &is_last_chunk, &has_skips)) {
 		if (out)
 		    *out << "Failed to unpack last chunk flag" << endl;
 		++errors;
@@ -512,6 +729,10 @@ check_glass_table(const char * tablename, const string &db_dir, int fd,
 		continue;
 	    }
 	    lastdid += did;
+	    if (has_skips && !check_chunk_skips(&pos, end, did, out)) {
+		++errors;
+		continue;
+	    }
 	    bool bad = false;
 	    while (true) {
 		Xapian::termcount wdf;
@@ -608,6 +829,7 @@ check_glass_table(const char * tablename, const string &db_dir, int fd,
 
 	// Now check the contents of the docdata table.
 	for ( ; !cursor->after_end(); cursor->next()) {
+	    progress.next();
 	    string & key = cursor->current_key;
 
 	    // Get docid from key.
@@ -650,6 +872,7 @@ check_glass_table(const char * tablename, const string &db_dir, int fd,
 	Xapian::doccount num_termlists = 0;
 	Xapian::doccount num_slotsused_entries = 0;
 	for ( ; !cursor->after_end(); cursor->next()) {
+	    progress.next();
 	    string & key = cursor->current_key;
 
 	    // Get docid from key.
@@ -838,9 +1061,7 @@ check_glass_table(const char * tablename, const string &db_dir, int fd,
 		++errors;
 	    }
 
-	    // + 1 so that did is a valid subscript.
-	    if (doclens.size() <= did) doclens.resize(did + 1);
-	    doclens[did] = actual_doclen;
+	    if (actual_doclen) context.set_has_terms(did);
 	}
 
 	Xapian::doccount doccount = version_file.get_doccount();
@@ -865,6 +1086,7 @@ check_glass_table(const char * tablename, const string &db_dir, int fd,
     } else if (strcmp(tablename, "position") == 0) {
 	// Now check the contents of the position table.
 	for ( ; !cursor->after_end(); cursor->next()) {
+	    progress.next();
 	    string & key = cursor->current_key;
 
 	    // Get docid from key.
@@ -900,11 +1122,11 @@ check_glass_table(const char * tablename, const string &db_dir, int fd,
 			    "is larger than get_last_docid() "
 			 << db_last_docid << endl;
 		++errors;
-	    } else if (!doclens.empty()) {
+	    } else if (context.cross_checks()) {
 		// In glass, a document without terms doesn't get a
 		// termlist entry, so we can't tell the difference
 		// easily.
-		if (did >= doclens.size() || doclens[did] == 0) {
+		if (!context.has_terms(did)) {
 		    if (out)
 			*out << "Position list entry for document " << did
 			     << " which doesn't exist or has no terms" << endl;
@@ -918,6 +1140,28 @@ check_glass_table(const char * tablename, const string &db_dir, int fd,
 	    pos = data.data();
 	    end = pos + data.size();
 
+	    if (is_packed_positions(pos, end)) {
+		// The decoder checks the entries are strictly increasing.
+		try {
+		    PackedPositionReader prd;
+		    Xapian::termpos pos_first, pos_last;
+		    Xapian::termcount n = prd.init(pos, end, pos_first, pos_last);
+		    while (--n) prd.decode_next();
+		    if (!prd.check_all_gone()) {
+			if (out)
+			    *out << tablename << " table: Junk after position "
+				    "data" << endl;
+			++errors;
+		    }
+		} catch (const Xapian::DatabaseCorruptError&) {
+		    if (out)
+			*out << tablename << " table: Position list data "
+				"corrupt" << endl;
+		    ++errors;
+		}
+		continue;
+	    }
+
 	    Xapian::termpos pos_last;
 	    if (!unpack_uint(&pos, end, &pos_last)) {
 		if (out)
@@ -25,37 +25,94 @@
 #include "xapian/types.h"
 
 #include <sys/types.h> // For size_t and off_t.
+#include <cstdint>
 #include <iosfwd>
+#ifdef HAVE_STD_THREAD
+# include <mutex>
+#endif
 #include <string>
 #include <vector>
 
 class GlassVersion;
 
+/** Information shared between the checks of the tables of a glass database.
+ *
+ *  The tables may be checked in parallel, so the postlist table check reads
+ *  the termlist table itself to cross-check the document lengths, while the
+ *  position table check relies on information gathered by the termlist table
+ *  check, so must be run after it.
+ */
+class GlassCheckContext {
+    /** Bitmap of the documents with a non-empty termlist.
+     *
+     *  Empty if we aren't cross-checking tables.
+     */
+    std::vector<uint64_t> docs_with_terms;
+
+    /// Where to report progress to (or NULL to not report progress).
+    std::ostream * progress_out = nullptr;
+
+#ifdef HAVE_STD_THREAD
+    /// Mutex to stop progress reports from different threads interleaving.
+    std::mutex progress_mutex;
+#endif
+
+  public:
+    /** Cross-check between the tables.
+     *
+     *  Only makes sense when checking a whole database.
+     *
+     *  @return false if there isn't enough memory to do so.
+     */
+    bool enable_cross_checks(Xapian::docid last_docid);
+
+    /// Are we cross-checking between the tables?
+    bool cross_checks() const { return !docs_with_terms.empty(); }
+
+    /// Note that document @a did has a non-empty termlist.
+    void set_has_terms(Xapian::docid did) {
+	if (did / 64 < docs_with_terms.size())
+	    docs_with_terms[did / 64] |= uint64_t(1) << (did % 64);
+    }
+
+    /// Does document @a did have a non-empty termlist?
+    bool has_terms(Xapian::docid did) const {
+	if (did / 64 >= docs_with_terms.size()) return false;
+	return (docs_with_terms[did / 64] >> (did % 64)) & 1;
+    }
+
+    /// Report progress to @a out.
+    void set_progress_out(std::ostream * out) { progress_out = out; }
+
+    /// Report that @a percent percent of the entries in a table are checked.
+    void report_progress(const char * tablename, unsigned percent);
+};
+
 size_t check_glass_table(const char * tablename, const std::string &db_dir,
 			 int fd, off_t offset_,
 			 const GlassVersion & version_file, int opts,
-			 std::vector<Xapian::termcount> & doclens,
+			 GlassCheckContext & context,
 			 std::ostream * out);
 
 inline size_t
 check_glass_table(const char * tablename, const std::string &db_dir,
 		  const GlassVersion & version_file, int opts,
-		  std::vector<Xapian::termcount> & doclens,
+		  GlassCheckContext & context,
 		  std::ostream * out)
 {
     return check_glass_table(tablename, db_dir, -1, 0, version_file, opts,
-			     doclens, out);
+			     context, out);
 }
 
 inline size_t
 check_glass_table(const char * tablename, int fd, off_t offset_,
 		  const GlassVersion & version_file, int opts,
-		  std::vector<Xapian::termcount> & doclens,
+		  GlassCheckContext & context,
 		  std::ostream * out)
 {
     return check_glass_table(tablename, std::string(), fd, offset_,
 			     version_file, opts,
-			     doclens, out);
+			     context, out);
 }
 
 #endif // XAPIAN_INCLUDED_GLASS_DBCHECK_H
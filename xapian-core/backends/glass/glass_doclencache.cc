@@ -0,0 +1,96 @@
+/** @file
+ * @brief In-memory copy of the document lengths in a glass database
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "glass_doclencache.h"
+
+#include <map>
+#ifdef HAVE_STD_THREAD
+# include <mutex>
+#endif
+
+using namespace std;
+
+GlassDoclenCache::GlassDoclenCache(Xapian::docid last_docid_,
+				   Xapian::termcount max_doclen)
+    : bits(1), last_docid(last_docid_)
+{
+    // We store doclen + 1 so that 0 can mean "no such document".
+    uint64_t max_value = uint64_t(max_doclen) + 1;
+    if (max_value == 0) {
+	// Overflowed (only possible with a 64-bit termcount).
+	bits = 64;
+    } else {
+	while (bits < 64 && (max_value >> bits) != 0) ++bits;
+    }
+    mask = (bits == 64) ? ~uint64_t(0) : (uint64_t(1) << bits) - 1;
+    // Allow for docids 0 to last_docid, plus a spare word so that get() and
+    // set() can always access the word after the one the entry starts in.
+    uint64_t total_bits = (uint64_t(last_docid) + 1) * bits;
+    data.resize(size_t(total_bits / 64) + 2);
+}
+
+/** Arrays which have been published, keyed by database UUID and revision.
+ *
+ *  We hold weak pointers so an array is freed once the last database using
+ *  it is closed or moves on to a newer revision.
+ */
+static map<string, weak_ptr<const GlassDoclenCache>> shared_caches;
+
+#ifdef HAVE_STD_THREAD
+/// Mutex protecting shared_caches.
+static mutex shared_caches_mutex;
+#endif
+
+shared_ptr<const GlassDoclenCache>
+GlassDoclenCache::lookup(const string& key)
+{
+#ifdef HAVE_STD_THREAD
+    lock_guard<mutex> lock(shared_caches_mutex);
+#endif
+    auto i = shared_caches.find(key);
+    if (i == shared_caches.end()) return shared_ptr<const GlassDoclenCache>();
+    return i->second.lock();
+}
+
+shared_ptr<const GlassDoclenCache>
+GlassDoclenCache::publish(const string& key,
+			  shared_ptr<const GlassDoclenCache> cache)
+{
+#ifdef HAVE_STD_THREAD
+    lock_guard<mutex> lock(shared_caches_mutex);
+#endif
+    // Tidy up entries for arrays which have been freed.
+    for (auto i = shared_caches.begin(); i != shared_caches.end(); ) {
+	if (i->second.expired()) {
+	    i = shared_caches.erase(i);
+	} else {
+	    ++i;
+	}
+    }
+
+    auto& entry = shared_caches[key];
+    auto existing = entry.lock();
+    if (existing) return existing;
+    entry = cache;
+    return cache;
+}
@@ -0,0 +1,128 @@
+/** @file
+ * @brief In-memory copy of the document lengths in a glass database
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_GLASS_DOCLENCACHE_H
+#define XAPIAN_INCLUDED_GLASS_DOCLENCACHE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "omassert.h"
+#include "xapian/types.h"
+
+/** Bit-packed array of the document lengths in a glass database revision.
+ *
+ *  Entry i holds one more than the length of document i, or 0 if there's no
+ *  such document, using the fewest bits which can represent the largest
+ *  document length.
+ *
+ *  Once filled in, an object of this class is never modified, so it can be
+ *  shared between all the Database objects open on the same revision of the
+ *  same database (see lookup() and publish()).
+ */
+class GlassDoclenCache {
+    /// The number of bits used for each entry.
+    unsigned bits;
+
+    /// Mask with the bottom @a bits bits set.
+    uint64_t mask;
+
+    /// The highest document id we have an entry for.
+    Xapian::docid last_docid;
+
+    /// The packed entries.
+    std::vector<uint64_t> data;
+
+  public:
+    /** Construct an empty array.
+     *
+     *  @param last_docid_	The highest document id to allow for.
+     *  @param max_doclen	An upper bound on the document lengths.
+     */
+    GlassDoclenCache(Xapian::docid last_docid_, Xapian::termcount max_doclen);
+
+    /** Set the length of document @a did.
+     *
+     *  Each document's length should only be set once.
+     *
+     *  @return	false if @a doclen is too large to store (which means the
+     *		max_doclen passed to the constructor wasn't actually an
+     *		upper bound).
+     */
+    bool set(Xapian::docid did, Xapian::termcount doclen) {
+	uint64_t v = uint64_t(doclen) + 1;
+	if (rare(v > mask || v == 0)) return false;
+	uint64_t bitpos = uint64_t(did) * bits;
+	size_t word = size_t(bitpos >> 6);
+	unsigned shift = unsigned(bitpos & 63);
+	data[word] |= v << shift;
+	if (shift + bits > 64) data[word + 1] |= v >> (64 - shift);
+	return true;
+    }
+
+    /** Look up the length of document @a did.
+     *
+     *  @return	false if there's no such document.
+     */
+    bool get(Xapian::docid did, Xapian::termcount& doclen) const {
+	if (did > last_docid) return false;
+	uint64_t bitpos = uint64_t(did) * bits;
+	size_t word = size_t(bitpos >> 6);
+	unsigned shift = unsigned(bitpos & 63);
+	uint64_t v = data[word] >> shift;
+	if (shift + bits > 64) v |= data[word + 1] << (64 - shift);
+	v &= mask;
+	if (v == 0) return false;
+	doclen = Xapian::termcount(v - 1);
+	return true;
+    }
+
+    /// Return the highest document id we have an entry for.
+    Xapian::docid get_last_docid() const { return last_docid; }
+
+    /// Return the number of bytes of memory used by the array.
+    size_t get_memory_used() const {
+	return data.size() * sizeof(uint64_t);
+    }
+
+    /** Find an existing shared array.
+     *
+     *  @param key	Identifies the database and revision.
+     *
+     *  @return	The array, or an empty pointer if there isn't one.
+     */
+    static std::shared_ptr<const GlassDoclenCache>
+    lookup(const std::string& key);
+
+    /** Make an array available to share.
+     *
+     *  If another array was published for @a key since lookup() was called
+     *  then that one is returned and @a cache is discarded, otherwise
+     *  @a cache is returned.
+     */
+    static std::shared_ptr<const GlassDoclenCache>
+    publish(const std::string& key,
+	    std::shared_ptr<const GlassDoclenCache> cache);
+};
+
+#endif // XAPIAN_INCLUDED_GLASS_DOCLENCACHE_H
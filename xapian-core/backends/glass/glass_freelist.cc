@@ -42,7 +42,8 @@ using namespace Glass;
     (8 + (GLASS_FREELIST_SIZE < 3 ? 3 : GLASS_FREELIST_SIZE) * 4)
 # define FREELIST_END (FREELIST_END_ < 2048 ? FREELIST_END_ : 2048)
 #else
-# define FREELIST_END block_size
+// Leave space for the checksum at the end of the block (if there is one).
+# define FREELIST_END B->block_end()
 #endif
 
 /** The first offset to use for storing free block info.
@@ -78,7 +79,7 @@ uint4
 GlassFreeList::get_block(const GlassTable *B, uint4 block_size,
 			 uint4 * blk_to_free)
 {
-    if (fl == fl_end) {
+    if (fl == reuse_end()) {
 	return first_unused_block++;
     }
 
@@ -199,6 +200,11 @@ GlassFreeList::mark_block_unused(const GlassTable * B, uint4 block_size, uint4 b
 	flw.c = C_BASE;
 	if (fl.c == 0) {
 	    fl = fl_end = flw;
+	    // Any retained revisions had an empty freelist, so the new one
+	    // starts at the same place for them.
+	    for (auto& c : retained) {
+		c = flw;
+	    }
 	}
 	flw_appending = (n == first_unused_block - 1);
 	aligned_write4(pw + FREELIST_END - 4, UNUSED);
@@ -232,8 +238,19 @@ GlassFreeList::mark_block_unused(const GlassTable * B, uint4 block_size, uint4 b
 }
 
 void
-GlassFreeList::commit(const GlassTable * B, uint4 block_size)
+GlassFreeList::commit(const GlassTable * B, uint4 block_size, unsigned retain)
 {
+    // Note where the freelist ended for the previous revision - blocks freed
+    // since then are still used by that revision.
+    if (retain) {
+	retained.push_back(fl_end);
+	if (retained.size() > retain) {
+	    retained.erase(retained.begin(), retained.end() - retain);
+	}
+    } else {
+	retained.clear();
+    }
+
     if (pw && flw.c != 0) {
 	memset(pw + flw.c, 255, FREELIST_END - flw.c - 4);
 #ifdef GLASS_FREELIST_SIZE
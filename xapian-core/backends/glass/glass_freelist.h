@@ -25,6 +25,8 @@
 #include "glass_defs.h"
 #include "pack.h"
 
+#include <vector>
+
 class GlassTable;
 
 class GlassFLCursor {
@@ -81,6 +83,13 @@ class GlassFreeList {
 
     bool flw_appending;
 
+    /** Freelist end positions at recent previous commits, oldest first.
+     *
+     *  Blocks which were freed after the oldest of these aren't reused, so
+     *  readers of the revisions in question can still read them.
+     */
+    std::vector<GlassFLCursor> retained;
+
   private:
     /// Current freelist block.
     uint8_t * p;
@@ -100,12 +109,21 @@ class GlassFreeList {
 	revision = 0;
 	first_unused_block = 0;
 	flw_appending = false;
+	retained.clear();
     }
 
     ~GlassFreeList() { delete [] p; delete [] pw; }
 
     bool empty() const { return fl == fl_end; }
 
+    /// The end of the part of the freelist which blocks can be reused from.
+    const GlassFLCursor& reuse_end() const {
+	return retained.empty() ? fl_end : retained.front();
+    }
+
+    /// Are blocks being kept for readers of older revisions?
+    bool has_retained() const { return !retained.empty(); }
+
     uint4 get_block(const GlassTable * B, uint4 block_size,
 		    uint4 * blk_to_free = NULL);
 
@@ -121,13 +139,26 @@ class GlassFreeList {
     // Used when compacting to a single file.
     void set_first_unused_block(uint4 base) { first_unused_block = base; }
 
-    void commit(const GlassTable * B, uint4 block_size);
+    /** Commit the freelist.
+     *
+     *  @param retain	Number of previous revisions to keep blocks from, in
+     *			addition to the current revision.
+     */
+    void commit(const GlassTable * B, uint4 block_size, unsigned retain = 0);
 
     void pack(std::string & buf) {
 	pack_uint(buf, revision);
 	pack_uint(buf, first_unused_block);
 	fl.pack(buf);
 	flw.pack(buf);
+	// Only append this if there is any so the encoding is unchanged
+	// otherwise.
+	if (!retained.empty()) {
+	    pack_uint(buf, retained.size());
+	    for (auto& c : retained) {
+		c.pack(buf);
+	    }
+	}
     }
 
     bool unpack(const char ** pstart, const char * end) {
@@ -138,6 +169,18 @@ class GlassFreeList {
 	if (r) {
 	    fl_end = flw;
 	    flw_appending = false;
+	    retained.clear();
+	    if (*pstart != end) {
+		size_t n;
+		if (!unpack_uint(pstart, end, &n) ||
+		    n > size_t(end - *pstart) / 2) {
+		    return false;
+		}
+		retained.resize(n);
+		for (auto& c : retained) {
+		    if (!c.unpack(pstart, end)) return false;
+		}
+	    }
 	}
 	return r;
     }
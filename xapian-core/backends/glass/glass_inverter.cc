@@ -27,8 +27,10 @@
 
 #include "api/termlist.h"
 
+#include <algorithm>
 #include <map>
 #include <string>
+#include <utility>
 
 using namespace std;
 
@@ -49,6 +51,8 @@ Inverter::store_positions(const GlassPositionListTable & position_table,
 	    if (j != m.end()) {
 		// Update existing entry.
 		swap(j->second, s);
+		pos_mem += j->second.size();
+		pos_mem -= s.size();
 		return;
 	    }
 	}
@@ -98,8 +102,21 @@ Inverter::set_positionlist(Xapian::docid did,
 			   const string & term,
 			   const string & s)
 {
-    pos_changes.insert(make_pair(term, map<Xapian::docid, string>()))
-	.first->second[did] = s;
+    auto i = pos_changes.find(term);
+    if (i == pos_changes.end()) {
+	i = pos_changes.insert(make_pair(term, map<Xapian::docid, string>()))
+	    .first;
+	pos_mem += map_entry_size<string, map<Xapian::docid, string>>();
+	pos_mem += term.size();
+    }
+    auto r = i->second.insert(make_pair(did, s));
+    if (r.second) {
+	pos_mem += map_entry_size<Xapian::docid, string>();
+    } else {
+	pos_mem -= r.first->second.size();
+	r.first->second = s;
+    }
+    pos_mem += s.size();
 }
 
 void
@@ -125,6 +142,51 @@ Inverter::get_positionlist(Xapian::docid did,
     return true;
 }
 
+void
+Inverter::merge(Inverter&& o)
+{
+    for (auto&& i : o.postlist_changes) {
+	auto j = postlist_changes.find(i.first);
+	if (j == postlist_changes.end()) {
+	    j = postlist_changes.insert(make_pair(i.first,
+						  std::move(i.second))).first;
+	    postlist_mem += postlist_memory(j->first, j->second);
+	} else {
+	    size_t old_capacity = j->second.capacity();
+	    j->second.merge(std::move(i.second));
+	    postlist_mem += (j->second.capacity() - old_capacity) *
+		sizeof(PostingChanges::change);
+	}
+    }
+
+    for (auto&& i : o.pos_changes) {
+	auto j = pos_changes.find(i.first);
+	if (j == pos_changes.end()) {
+	    pos_mem += map_entry_size<string, map<Xapian::docid, string>>();
+	    pos_mem += i.first.size();
+	    j = pos_changes.insert(make_pair(i.first,
+					     map<Xapian::docid, string>())).first;
+	}
+	map<Xapian::docid, string>& m = j->second;
+	for (auto&& k : i.second) {
+	    auto r = m.insert(make_pair(k.first, string()));
+	    if (r.second) {
+		pos_mem += map_entry_size<Xapian::docid, string>();
+	    } else {
+		pos_mem -= r.first->second.size();
+	    }
+	    swap(r.first->second, k.second);
+	    pos_mem += r.first->second.size();
+	}
+    }
+
+    for (auto&& i : o.doclen_changes) {
+	doclen_changes[i.first] = i.second;
+    }
+
+    o.clear();
+}
+
 bool
 Inverter::has_positions(const GlassPositionListTable & position_table) const
 {
@@ -155,14 +217,37 @@ Inverter::flush_doclengths(GlassPostListTable & table)
     doclen_changes.clear();
 }
 
+void
+Inverter::PostingChanges::finalise()
+{
+    if (sorted)
+	return;
+    // A stable sort keeps changes for the same docid in the order they were
+    // made, so the last in each run of equal docids is the current one.
+    stable_sort(pl_changes.begin(), pl_changes.end(),
+		[](const change& a, const change& b) {
+		    return a.first < b.first;
+		});
+    auto out = pl_changes.begin();
+    for (auto i = pl_changes.begin(); i != pl_changes.end(); ++i) {
+	auto next = i + 1;
+	if (next != pl_changes.end() && next->first == i->first)
+	    continue;
+	*out++ = *i;
+    }
+    pl_changes.erase(out, pl_changes.end());
+    sorted = true;
+}
+
 void
 Inverter::flush_post_list(GlassPostListTable & table, const string & term)
 {
-    map<string, PostingChanges>::iterator i;
-    i = postlist_changes.find(term);
+    auto i = postlist_changes.find(term);
     if (i == postlist_changes.end()) return;
 
     // Flush buffered changes for just this term's postlist.
+    postlist_mem -= postlist_memory(term, i->second);
+    i->second.finalise();
     table.merge_changes(term, i->second);
     postlist_changes.erase(i);
 }
@@ -170,11 +255,12 @@ Inverter::flush_post_list(GlassPostListTable & table, const string & term)
 void
 Inverter::flush_all_post_lists(GlassPostListTable & table)
 {
-    map<string, PostingChanges>::const_iterator i;
-    for (i = postlist_changes.begin(); i != postlist_changes.end(); ++i) {
-	table.merge_changes(i->first, i->second);
+    for (auto& i : postlist_changes) {
+	i.second.finalise();
+	table.merge_changes(i.first, i.second);
     }
     postlist_changes.clear();
+    postlist_mem = 0;
 }
 
 void
@@ -200,6 +286,8 @@ Inverter::flush_post_lists(GlassPostListTable & table, const string & pfx)
     }
 
     for (i = begin; i != end; ++i) {
+	postlist_mem -= postlist_memory(i->first, i->second);
+	i->second.finalise();
 	table.merge_changes(i->first, i->second);
     }
 
@@ -231,4 +319,5 @@ Inverter::flush_pos_lists(GlassPositionListTable & table)
 	}
     }
     pos_changes.clear();
+    pos_mem = 0;
 }
@@ -27,6 +27,7 @@
 
 #include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "omassert.h"
@@ -43,6 +44,13 @@ class TermIterator;
 /** Magic wdf value used for a deleted posting. */
 const Xapian::termcount DELETED_POSTING = Xapian::termcount(-1);
 
+/** Approximate overhead of a std::map node beyond the value it holds.
+ *
+ *  Typical implementations use a red-black tree with three pointers and a
+ *  colour flag per node, plus allocator bookkeeping.
+ */
+const size_t MAP_NODE_OVERHEAD = 4 * sizeof(void*);
+
 /** Class which "inverts the file". */
 class Inverter {
     friend class GlassPostListTable;
@@ -51,28 +59,50 @@ class Inverter {
     class PostingChanges {
 	friend class GlassPostListTable;
 
+      public:
+	/// A buffered change: the docid and new wdf (or DELETED_POSTING).
+	typedef std::pair<Xapian::docid, Xapian::termcount> change;
+
+      private:
 	/// Change in term frequency,
 	Xapian::termcount_diff tf_delta;
 
 	/// Change in collection frequency.
 	Xapian::termcount_diff cf_delta;
 
-	/// Changes to this term's postlist.
-	std::map<Xapian::docid, Xapian::termcount> pl_changes;
+	/** Changes to this term's postlist.
+	 *
+	 *  These are appended as they're made, which avoids a heap allocation
+	 *  per posting.  Normally documents are added in ascending docid
+	 *  order so this is already sorted, but if not (or if there's more
+	 *  than one change for a docid) we sort (and keep only the last
+	 *  change for each docid) in finalise() just before flushing.
+	 */
+	std::vector<change> pl_changes;
+
+	/// Are pl_changes in strictly ascending docid order?
+	bool sorted = true;
+
+	/// Append a change.
+	void append(Xapian::docid did, Xapian::termcount wdf) {
+	    if (!pl_changes.empty() && did <= pl_changes.back().first)
+		sorted = false;
+	    pl_changes.emplace_back(did, wdf);
+	}
 
       public:
 	/// Constructor for an added posting.
 	PostingChanges(Xapian::docid did, Xapian::termcount wdf)
 	    : tf_delta(1), cf_delta(Xapian::termcount_diff(wdf))
 	{
-	    pl_changes.insert(std::make_pair(did, wdf));
+	    pl_changes.emplace_back(did, wdf);
 	}
 
 	/// Constructor for a removed posting.
 	PostingChanges(Xapian::docid did, Xapian::termcount wdf, bool)
 	    : tf_delta(-1), cf_delta(-Xapian::termcount_diff(wdf))
 	{
-	    pl_changes.insert(std::make_pair(did, DELETED_POSTING));
+	    pl_changes.emplace_back(did, DELETED_POSTING);
 	}
 
 	/// Constructor for an updated posting.
@@ -80,7 +110,7 @@ class Inverter {
 		       Xapian::termcount new_wdf)
 	    : tf_delta(0), cf_delta(Xapian::termcount_diff(new_wdf - old_wdf))
 	{
-	    pl_changes.insert(std::make_pair(did, new_wdf));
+	    pl_changes.emplace_back(did, new_wdf);
 	}
 
 	/// Add a posting.
@@ -88,7 +118,7 @@ class Inverter {
 	    ++tf_delta;
 	    cf_delta += wdf;
 	    // Add did to term's postlist
-	    pl_changes[did] = wdf;
+	    append(did, wdf);
 	}
 
 	/// Remove a posting.
@@ -96,24 +126,82 @@ class Inverter {
 	    --tf_delta;
 	    cf_delta -= wdf;
 	    // Remove did from term's postlist.
-	    pl_changes[did] = DELETED_POSTING;
+	    append(did, DELETED_POSTING);
 	}
 
 	/// Update a posting.
 	void update_posting(Xapian::docid did, Xapian::termcount old_wdf,
 			    Xapian::termcount new_wdf) {
 	    cf_delta += new_wdf - old_wdf;
-	    pl_changes[did] = new_wdf;
+	    append(did, new_wdf);
+	}
+
+	/** Append the changes from @a o.
+	 *
+	 *  The changes in @a o are treated as having been made after those
+	 *  already here.
+	 */
+	void merge(PostingChanges&& o) {
+	    tf_delta += o.tf_delta;
+	    cf_delta += o.cf_delta;
+	    if (pl_changes.empty()) {
+		std::swap(pl_changes, o.pl_changes);
+		sorted = o.sorted;
+		return;
+	    }
+	    if (!o.sorted || o.pl_changes.front().first <= pl_changes.back().first)
+		sorted = false;
+	    pl_changes.insert(pl_changes.end(),
+			      o.pl_changes.begin(), o.pl_changes.end());
 	}
 
+	/** Put the changes into ascending docid order.
+	 *
+	 *  Where there's more than one change for a docid, only the most
+	 *  recent is kept.
+	 */
+	void finalise();
+
 	/// Get the term frequency delta.
 	Xapian::termcount_diff get_tfdelta() const { return tf_delta; }
 
 	/// Get the collection frequency delta.
 	Xapian::termcount_diff get_cfdelta() const { return cf_delta; }
+
+	/// Get the number of changes which space has been allocated for.
+	size_t capacity() const { return pl_changes.capacity(); }
     };
 
-    /// Buffered changes to postlists.
+    /// Approximate memory used by an entry in a std::map<K, V>.
+    template<typename K, typename V>
+    static constexpr size_t map_entry_size() {
+	return MAP_NODE_OVERHEAD + sizeof(std::pair<const K, V>);
+    }
+
+    /// Approximate memory used by the buffered changes for @a term.
+    static size_t postlist_memory(const std::string & term,
+				  const PostingChanges & changes) {
+	return map_entry_size<std::string, PostingChanges>() +
+	    term.size() +
+	    changes.capacity() * sizeof(PostingChanges::change);
+    }
+
+    /** Approximate memory used by postlist_changes.
+     *
+     *  Document length changes are accounted for separately as their size
+     *  can be calculated directly from doclen_changes.size().
+     */
+    size_t postlist_mem = 0;
+
+    /// Approximate memory used by pos_changes.
+    size_t pos_mem = 0;
+
+    /** Buffered changes to postlists.
+     *
+     *  This is kept in term order, which is the order the postlists are
+     *  stored in the table, and allows flushing just the terms with a given
+     *  prefix efficiently.
+     */
     std::map<std::string, PostingChanges> postlist_changes;
 
     /// Buffered changes to positional data.
@@ -136,38 +224,47 @@ class Inverter {
   public:
     void add_posting(Xapian::docid did, const std::string & term,
 		     Xapian::doccount wdf) {
-	std::map<std::string, PostingChanges>::iterator i;
-	i = postlist_changes.find(term);
+	auto i = postlist_changes.find(term);
 	if (i == postlist_changes.end()) {
-	    postlist_changes.insert(
-		std::make_pair(term, PostingChanges(did, wdf)));
+	    i = postlist_changes.insert(
+		std::make_pair(term, PostingChanges(did, wdf))).first;
+	    postlist_mem += postlist_memory(term, i->second);
 	} else {
+	    size_t old_capacity = i->second.capacity();
 	    i->second.add_posting(did, wdf);
+	    postlist_mem += (i->second.capacity() - old_capacity) *
+		sizeof(PostingChanges::change);
 	}
     }
 
     void remove_posting(Xapian::docid did, const std::string & term,
 			Xapian::doccount wdf) {
-	std::map<std::string, PostingChanges>::iterator i;
-	i = postlist_changes.find(term);
+	auto i = postlist_changes.find(term);
 	if (i == postlist_changes.end()) {
-	    postlist_changes.insert(
-		std::make_pair(term, PostingChanges(did, wdf, false)));
+	    i = postlist_changes.insert(
+		std::make_pair(term, PostingChanges(did, wdf, false))).first;
+	    postlist_mem += postlist_memory(term, i->second);
 	} else {
+	    size_t old_capacity = i->second.capacity();
 	    i->second.remove_posting(did, wdf);
+	    postlist_mem += (i->second.capacity() - old_capacity) *
+		sizeof(PostingChanges::change);
 	}
     }
 
     void update_posting(Xapian::docid did, const std::string & term,
 			Xapian::termcount old_wdf,
 			Xapian::termcount new_wdf) {
-	std::map<std::string, PostingChanges>::iterator i;
-	i = postlist_changes.find(term);
+	auto i = postlist_changes.find(term);
 	if (i == postlist_changes.end()) {
-	    postlist_changes.insert(
-		std::make_pair(term, PostingChanges(did, old_wdf, new_wdf)));
+	    i = postlist_changes.insert(
+		std::make_pair(term, PostingChanges(did, old_wdf, new_wdf))).first;
+	    postlist_mem += postlist_memory(term, i->second);
 	} else {
+	    size_t old_capacity = i->second.capacity();
 	    i->second.update_posting(did, old_wdf, new_wdf);
+	    postlist_mem += (i->second.capacity() - old_capacity) *
+		sizeof(PostingChanges::change);
 	}
     }
 
@@ -190,6 +287,32 @@ class Inverter {
 	doclen_changes.clear();
 	postlist_changes.clear();
 	pos_changes.clear();
+	postlist_mem = 0;
+	pos_mem = 0;
+    }
+
+    /** Merge in the changes buffered in @a o.
+     *
+     *  The changes in @a o are treated as having been made after those
+     *  already buffered here.  This is used to combine the changes from
+     *  documents inverted in parallel, so it's most efficient if the docids
+     *  in @a o are all greater than those already here.
+     *
+     *  @a o is left empty.
+     */
+    void merge(Inverter&& o);
+
+    /** Return an estimate of the memory used by the buffered changes.
+     *
+     *  This counts the postlist, position and document length changes held
+     *  (including an allowance for the overhead of the containers holding
+     *  them) and is used to decide when to flush if XAPIAN_FLUSH_MEMORY is
+     *  set.
+     */
+    size_t get_memory_used() const {
+	return postlist_mem + pos_mem +
+	    doclen_changes.size() *
+		map_entry_size<Xapian::docid, Xapian::termcount>();
     }
 
     void set_doclength(Xapian::docid did, Xapian::termcount doclen, bool add) {
@@ -236,8 +359,7 @@ class Inverter {
     bool get_deltas(const std::string & term,
 		    Xapian::termcount_diff & tf_delta,
 		    Xapian::termcount_diff & cf_delta) const {
-	std::map<std::string, PostingChanges>::const_iterator i;
-	i = postlist_changes.find(term);
+	auto i = postlist_changes.find(term);
 	if (i == postlist_changes.end()) {
 	    return false;
 	}
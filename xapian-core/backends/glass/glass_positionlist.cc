@@ -28,6 +28,7 @@
 #include "bitstream.h"
 #include "debuglog.h"
 #include "pack.h"
+#include "packedpositions.h"
 
 #include <string>
 
@@ -40,6 +41,11 @@ GlassPositionListTable::pack(string & s,
     LOGCALL_VOID(DB, "GlassPositionListTable::pack", s | vec);
     Assert(!vec.empty());
 
+    if (packed_positions && vec.size() > 2) {
+	encode_packed_positions(s, vec);
+	return;
+    }
+
     pack_uint(s, vec.back());
 
     if (vec.size() > 1) {
@@ -60,6 +66,9 @@ GlassPositionListTable::positionlist_count(const string& data) const
 
     const char * pos = data.data();
     const char * end = pos + data.size();
+    if (is_packed_positions(pos, end)) {
+	RETURN(packed_positions_count(pos, end));
+    }
     Xapian::termpos pos_last;
     if (!unpack_uint(&pos, end, &pos_last)) {
 	throw Xapian::DatabaseCorruptError("Position list data corrupt");
@@ -109,6 +118,14 @@ GlassBasePositionList::set_data(const string& data)
 
     const char* pos = data.data();
     const char* end = pos + data.size();
+    packed = is_packed_positions(pos, end);
+    if (packed) {
+	Xapian::termpos pos_first;
+	size = prd.init(pos, end, pos_first, last);
+	current_pos = pos_first;
+	return;
+    }
+
     Xapian::termpos pos_last;
     if (!unpack_uint(&pos, end, &pos_last)) {
 	throw Xapian::DatabaseCorruptError("Position list data corrupt");
@@ -163,7 +180,7 @@ GlassBasePositionList::next()
     if (current_pos == last) {
 	return false;
     }
-    current_pos = rd.decode_interpolative_next();
+    current_pos = decode_next();
     return true;
 }
 
@@ -183,7 +200,7 @@ GlassBasePositionList::skip_to(Xapian::termpos termpos)
 	if (current_pos == last) {
 	    return false;
 	}
-	current_pos = rd.decode_interpolative_next();
+	current_pos = decode_next();
     }
     return true;
 }
@@ -28,6 +28,7 @@
 #include "glass_cursor.h"
 #include "glass_lazytable.h"
 #include "pack.h"
+#include "packedpositions.h"
 #include "backends/positionlist.h"
 
 #include <string>
@@ -56,6 +57,10 @@ class GlassPositionListTable : public GlassLazyTable {
 	: GlassLazyTable("position", fd, offset_, readonly_) { }
 
     /** Pack a position list into a string.
+     *
+     *  If the table was created with Xapian::DB_PACKED_POSITIONS, lists with
+     *  more than two entries are bit-packed, otherwise interpolative coding
+     *  is used.
      *
      *  @param s The string to append the position list data to.
      */
@@ -93,6 +98,12 @@ class GlassBasePositionList : public PositionList {
     /// Interpolative decoder.
     BitReader rd;
 
+    /// Bit-packed decoder.
+    PackedPositionReader prd;
+
+    /// Is the current data bit-packed?
+    bool packed = false;
+
     /// Current entry.
     Xapian::termpos current_pos;
 
@@ -112,6 +123,11 @@ class GlassBasePositionList : public PositionList {
      */
     void set_data(const std::string& data);
 
+    /// Decode the entry after the current one.
+    Xapian::termpos decode_next() {
+	return packed ? prd.decode_next() : rd.decode_interpolative_next();
+    }
+
   public:
     /// Default constructor.
     GlassBasePositionList() {}
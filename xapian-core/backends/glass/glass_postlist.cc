@@ -27,6 +27,7 @@
 
 #include "glass_cursor.h"
 #include "glass_database.h"
+#include "glass_doclencache.h"
 #include "debuglog.h"
 #include "pack.h"
 #include "str.h"
@@ -125,19 +126,30 @@ read_wdf(const char ** posptr, const char * end, Xapian::termcount * wdf_ptr)
     if (!unpack_uint(posptr, end, wdf_ptr)) report_read_error(*posptr);
 }
 
-/// Read the start of a chunk.
+/** Read the start of a chunk.
+ *
+ *  If the chunk has skip data, *posptr is left pointing after it, and if
+ *  @a skips_ptr is non-NULL then *skips_ptr is set to point to the start of
+ *  it (or to NULL if there isn't any).
+ */
 static Xapian::docid
 read_start_of_chunk(const char ** posptr,
 		    const char * end,
 		    Xapian::docid first_did_in_chunk,
-		    bool * is_last_chunk_ptr)
+		    bool * is_last_chunk_ptr,
+		    const char ** skips_ptr = NULL)
 {
-    LOGCALL_STATIC(DB, Xapian::docid, "read_start_of_chunk", reinterpret_cast<const void*>(posptr) | reinterpret_cast<const void*>(end) | first_did_in_chunk | reinterpret_cast<const void*>(is_last_chunk_ptr));
+    LOGCALL_STATIC(DB, Xapian::docid, "read_start_of_chunk", reinterpret_cast<const void*>(posptr) | reinterpret_cast<const void*>(end) | first_did_in_chunk | reinterpret_cast<const void*>(is_last_chunk_ptr) | reinterpret_cast<const void*>(skips_ptr));
     Assert(is_last_chunk_ptr);
 
-    // Read whether this is the last chunk
-    if (!unpack_bool(posptr, end, is_last_chunk_ptr))
-	report_read_error(*posptr);
+    // Read whether this is the last chunk, and whether there's skip data.
+    // The flags byte is '0' or '1' if there's no skip data, which is the
+    // same encoding pack_bool() uses.
+    unsigned flags;
+    if (*posptr == end || ((flags = unsigned(**posptr - '0')) & ~3u))
+	report_read_error(NULL);
+    ++*posptr;
+    *is_last_chunk_ptr = (flags & 1);
     LOGVALUE(DB, *is_last_chunk_ptr);
 
     // Read what the final document ID in this chunk is.
@@ -146,6 +158,18 @@ read_start_of_chunk(const char ** posptr,
 	report_read_error(*posptr);
     Xapian::docid last_did_in_chunk = first_did_in_chunk + increase_to_last;
     LOGVALUE(DB, last_did_in_chunk);
+
+    const char * skips = NULL;
+    if (flags & 2) {
+	size_t skips_len;
+	if (!unpack_uint(posptr, end, &skips_len))
+	    report_read_error(*posptr);
+	if (skips_len > size_t(end - *posptr))
+	    report_read_error(NULL);
+	skips = *posptr;
+	*posptr += skips_len;
+    }
+    if (skips_ptr) *skips_ptr = skips;
     RETURN(last_did_in_chunk);
 }
 
@@ -206,6 +230,76 @@ GlassPostListTable::get_doclength(Xapian::docid did,
     return doclen_pl->get_wdf();
 }
 
+bool
+GlassPostListTable::load_doclengths(GlassDoclenCache& cache) const
+{
+    LOGCALL(DB, bool, "GlassPostListTable::load_doclengths", Literal("cache"));
+    unique_ptr<GlassCursor> cursor(cursor_get());
+    if (!cursor.get() || !cursor->find_entry(make_key(string())))
+	RETURN(true);
+
+    cursor->read_tag();
+    const char* pos = cursor->current_tag.data();
+    const char* end = pos + cursor->current_tag.size();
+    // The number of entries isn't maintained for the document length list.
+    Xapian::docid did = read_start_of_first_chunk(&pos, end, NULL, NULL);
+
+    while (true) {
+	bool is_last_chunk;
+	Xapian::docid last_did_in_chunk =
+	    read_start_of_chunk(&pos, end, did, &is_last_chunk);
+	if (pos == end) {
+	    // The placeholder first chunk for an empty list.
+	    RETURN(true);
+	}
+	if (rare(last_did_in_chunk > cache.get_last_docid())) {
+	    throw Xapian::DatabaseCorruptError("Document ID in document length "
+					       "list is greater than last "
+					       "document ID");
+	}
+	Xapian::termcount doclen;
+	read_wdf(&pos, end, &doclen);
+	if (!cache.set(did, doclen)) RETURN(false);
+	while (pos != end) {
+	    read_did_increase(&pos, end, &did);
+	    if (rare(did > last_did_in_chunk)) {
+		throw Xapian::DatabaseCorruptError("Document ID in document "
+						   "length list chunk is "
+						   "greater than last");
+	    }
+	    read_wdf(&pos, end, &doclen);
+	    if (!cache.set(did, doclen)) RETURN(false);
+	}
+	if (is_last_chunk) RETURN(true);
+
+	cursor->next();
+	if (cursor->after_end()) {
+	    throw Xapian::DatabaseCorruptError("Unexpected end of document "
+					       "length list");
+	}
+	const char* keypos = cursor->current_key.data();
+	const char* keyend = keypos + cursor->current_key.size();
+	if (!check_tname_in_key_lite(&keypos, keyend, string())) {
+	    throw Xapian::DatabaseCorruptError("Unexpected end of document "
+					       "length list");
+	}
+	Xapian::docid newdid;
+	if (!unpack_uint_preserving_sort(&keypos, keyend, &newdid)) {
+	    report_read_error(keypos);
+	}
+	if (newdid <= did) {
+	    throw Xapian::DatabaseCorruptError("Document ID in new chunk of "
+					       "document length list is not "
+					       "greater than final document "
+					       "ID in previous chunk");
+	}
+	did = newdid;
+	cursor->read_tag();
+	pos = cursor->current_tag.data();
+	end = pos + cursor->current_tag.size();
+    }
+}
+
 bool
 GlassPostListTable::document_exists(Xapian::docid did,
 				    intrusive_ptr<const GlassDatabase> db) const
@@ -225,6 +319,81 @@ GlassPostListTable::document_exists(Xapian::docid did,
 // Or indexing speed.  Or something...
 const unsigned int CHUNKSIZE = 2000;
 
+/** The largest chunk size to aim for with adaptive chunk sizes.
+ *
+ *  A tag which is bigger than the maximum item size gets split into several
+ *  items, and all of these have to be read to use any of the entries, so
+ *  making chunks bigger has diminishing returns.
+ */
+const unsigned int MAX_ADAPTIVE_CHUNKSIZE = 8 * CHUNKSIZE;
+
+/// How many bytes of entries there are between points in the skip data.
+const unsigned int CHUNK_SKIP_INTERVAL = 256;
+
+/** Return the chunk size to aim for with adaptive chunk sizes.
+ *
+ *  @param termfreq	The number of entries in the posting list.
+ */
+static unsigned
+adaptive_chunk_size(Xapian::doccount termfreq)
+{
+    // Posting lists which only need a handful of standard sized chunks use
+    // that size, then we double the chunk size each time the termfreq goes
+    // up by a factor of 4.
+    unsigned chunk_size = CHUNKSIZE;
+    termfreq >>= 14;
+    while (termfreq && chunk_size < MAX_ADAPTIVE_CHUNKSIZE) {
+	chunk_size *= 2;
+	termfreq >>= 2;
+    }
+    return chunk_size;
+}
+
+/** Make the skip data for a chunk.
+ *
+ *  The skip data is the length of the rest of the skip data, then for
+ *  entries roughly every CHUNK_SKIP_INTERVAL bytes through the chunk the
+ *  increase in docid and in the offset of the entry's wdf from the start of
+ *  the entries (each relative to the previous such entry, or to the first
+ *  entry in the chunk).
+ *
+ *  @param first_did	The first docid in the chunk.
+ *  @param chunk	The entries in the chunk.
+ *
+ *  @return The skip data, or an empty string if the chunk is small enough
+ *	    not to need any.
+ */
+static string
+make_chunk_skips(Xapian::docid first_did, const string & chunk)
+{
+    string skips;
+    if (chunk.size() <= CHUNKSIZE) return skips;
+
+    const char * start = chunk.data();
+    const char * p = start;
+    const char * end = p + chunk.size();
+    read_wdf(&p, end, NULL);
+    Xapian::docid did = first_did;
+    Xapian::docid prev_did = first_did;
+    size_t prev_offset = 0;
+    while (p != end) {
+	read_did_increase(&p, end, &did);
+	size_t offset = p - start;
+	if (offset - prev_offset >= CHUNK_SKIP_INTERVAL) {
+	    pack_uint(skips, did - prev_did);
+	    pack_uint(skips, offset - prev_offset);
+	    prev_did = did;
+	    prev_offset = offset;
+	}
+	read_wdf(&p, end, NULL);
+    }
+
+    string result;
+    pack_uint(result, skips.size());
+    result += skips;
+    return result;
+}
+
 /** PostlistChunkWriter is a wrapper which acts roughly as an
  *  output iterator on a postlist chunk, taking care of the
  *  messy details.  It's intended to be used with deletion and
@@ -236,7 +405,9 @@ class Glass::PostlistChunkWriter {
     PostlistChunkWriter(const string &orig_key_,
 			bool is_first_chunk_,
 			const string &tname_,
-			bool is_last_chunk_);
+			bool is_last_chunk_,
+			unsigned chunk_size_,
+			bool skips_);
 
     /// Append an entry to this chunk.
     void append(GlassTable * table, Xapian::docid did,
@@ -267,6 +438,12 @@ class Glass::PostlistChunkWriter {
     bool is_last_chunk;
     bool started;
 
+    /// Start a new chunk once this many bytes of entries are in this one.
+    unsigned chunk_size;
+
+    /// Should large chunks have skip data?
+    bool skips;
+
     Xapian::docid first_did;
     Xapian::docid current_did;
 
@@ -334,13 +511,17 @@ PostlistChunkReader::next()
 PostlistChunkWriter::PostlistChunkWriter(const string &orig_key_,
 					 bool is_first_chunk_,
 					 const string &tname_,
-					 bool is_last_chunk_)
+					 bool is_last_chunk_,
+					 unsigned chunk_size_,
+					 bool skips_)
 	: orig_key(orig_key_),
 	  tname(tname_), is_first_chunk(is_first_chunk_),
 	  is_last_chunk(is_last_chunk_),
-	  started(false)
+	  started(false),
+	  chunk_size(chunk_size_),
+	  skips(skips_)
 {
-    LOGCALL_CTOR(DB, "PostlistChunkWriter", orig_key_ | is_first_chunk_ | tname_ | is_last_chunk_);
+    LOGCALL_CTOR(DB, "PostlistChunkWriter", orig_key_ | is_first_chunk_ | tname_ | is_last_chunk_ | chunk_size_ | skips_);
 }
 
 void
@@ -353,7 +534,7 @@ PostlistChunkWriter::append(GlassTable * table, Xapian::docid did,
     } else {
 	Assert(did > current_did);
 	// Start a new chunk if this one has grown to the threshold.
-	if (chunk.size() >= CHUNKSIZE) {
+	if (chunk.size() >= chunk_size) {
 	    bool save_is_last_chunk = is_last_chunk;
 	    is_last_chunk = false;
 	    flush(table);
@@ -385,35 +566,27 @@ make_start_of_first_chunk(Xapian::doccount entries,
 }
 
 /** Make the data to go at the start of a standard chunk.
+ *
+ *  @param skips	Skip data from make_chunk_skips() (may be empty).
  */
 static inline string
 make_start_of_chunk(bool new_is_last_chunk,
 		    Xapian::docid new_first_did,
-		    Xapian::docid new_final_did)
+		    Xapian::docid new_final_did,
+		    const string & skips = string())
 {
     Assert(new_final_did >= new_first_did);
     string chunk;
-    pack_bool(chunk, new_is_last_chunk);
+    if (skips.empty()) {
+	pack_bool(chunk, new_is_last_chunk);
+    } else {
+	chunk += char('2' | static_cast<char>(new_is_last_chunk));
+    }
     pack_uint(chunk, new_final_did - new_first_did);
+    chunk += skips;
     return chunk;
 }
 
-static void
-write_start_of_chunk(string & chunk,
-		     unsigned int start_of_chunk_header,
-		     unsigned int end_of_chunk_header,
-		     bool is_last_chunk,
-		     Xapian::docid first_did_in_chunk,
-		     Xapian::docid last_did_in_chunk)
-{
-    Assert(size_t(end_of_chunk_header - start_of_chunk_header) <= chunk.size());
-
-    chunk.replace(start_of_chunk_header,
-		  end_of_chunk_header - start_of_chunk_header,
-		  make_start_of_chunk(is_last_chunk, first_did_in_chunk,
-				      last_did_in_chunk));
-}
-
 void
 PostlistChunkWriter::flush(GlassTable *table)
 {
@@ -497,27 +670,16 @@ PostlistChunkWriter::flush(GlassTable *table)
 	    }
 
 	    cursor->read_tag();
-	    const char *tagpos = cursor->current_tag.data();
-	    const char *tagend = tagpos + cursor->current_tag.size();
-
-	    // Read the chunk header
-	    bool new_is_last_chunk;
-	    Xapian::docid new_last_did_in_chunk =
-		read_start_of_chunk(&tagpos, tagend, new_first_did,
-				    &new_is_last_chunk);
-
-	    string chunk_data(tagpos, tagend);
 
 	    // First remove the renamed tag
 	    table->del(cursor->current_key);
 
-	    // And now write it as the first chunk
+	    // And now write it as the first chunk.  The standard chunk header
+	    // (and any skip data) is unchanged, so we just copy it over with
+	    // the entries.
 	    string tag;
 	    tag = make_start_of_first_chunk(num_ent, coll_freq, new_first_did);
-	    tag += make_start_of_chunk(new_is_last_chunk,
-					      new_first_did,
-					      new_last_did_in_chunk);
-	    tag += chunk_data;
+	    tag += cursor->current_tag;
 	    table->add(orig_key, tag);
 	    return;
 	}
@@ -565,18 +727,12 @@ PostlistChunkWriter::flush(GlassTable *table)
 	    }
 	    bool wrong_is_last_chunk;
 	    string::size_type start_of_chunk_header = tagpos - tag.data();
-	    Xapian::docid last_did_in_chunk =
-		read_start_of_chunk(&tagpos, tagend, first_did_in_chunk,
-				    &wrong_is_last_chunk);
-	    string::size_type end_of_chunk_header = tagpos - tag.data();
-
-	    // write new is_last flag
-	    write_start_of_chunk(tag,
-				 start_of_chunk_header,
-				 end_of_chunk_header,
-				 true, // is_last_chunk
-				 first_did_in_chunk,
-				 last_did_in_chunk);
+	    (void)read_start_of_chunk(&tagpos, tagend, first_did_in_chunk,
+				      &wrong_is_last_chunk);
+
+	    // Write new is_last flag, which is the bottom bit of the first
+	    // byte of the chunk header.
+	    tag[start_of_chunk_header] |= 1;
 	    table->add(cursor->current_key, tag);
 	}
     } else {
@@ -614,7 +770,9 @@ PostlistChunkWriter::flush(GlassTable *table)
 
 	    tag = make_start_of_first_chunk(num_ent, coll_freq, first_did);
 
-	    tag += make_start_of_chunk(is_last_chunk, first_did, current_did);
+	    tag += make_start_of_chunk(is_last_chunk, first_did, current_did,
+				       skips ? make_chunk_skips(first_did, chunk) :
+					       string());
 	    tag += chunk;
 	    table->add(key, tag);
 	    return;
@@ -654,7 +812,9 @@ PostlistChunkWriter::flush(GlassTable *table)
 	}
 
 	// ...and write the start of this chunk.
-	tag = make_start_of_chunk(is_last_chunk, first_did, current_did);
+	tag = make_start_of_chunk(is_last_chunk, first_did, current_did,
+				  skips ? make_chunk_skips(first_did, chunk) :
+					  string());
 
 	tag += chunk;
 	table->add(new_key, tag);
@@ -685,11 +845,16 @@ void GlassPostList::read_number_of_entries(const char ** posptr,
  *
  *  A chunk (except for the first chunk) contains:
  *
- *  1)  bool - true if this is the last chunk.
+ *  1)  flags byte - '0' + 1 if this is the last chunk, + 2 if there's skip
+ *	data (so without skip data this is the same as a packed bool).
  *  2)  difference between final docid in chunk and first docid.
- *  3)  wdf for the first item.
- *  4)  increment in docid to next item, followed by wdf for the item.
- *  5)  (4) repeatedly.
+ *  3)  skip data (if the flag says there is - see make_chunk_skips()).
+ *  4)  wdf for the first item.
+ *  5)  increment in docid to next item, followed by wdf for the item.
+ *  6)  (5) repeatedly.
+ *
+ *  Skip data is only written if the postlist table was created with
+ *  Xapian::DB_ADAPTIVE_CHUNKS.
  *
  *  The first chunk begins with the number of entries, the collection
  *  frequency, then the docid of the first document, then has the header of a
@@ -742,9 +907,7 @@ GlassPostList::init()
 
     did = read_start_of_first_chunk(&pos, end, &number_of_entries, NULL);
     first_did_in_chunk = did;
-    last_did_in_chunk = read_start_of_chunk(&pos, end, first_did_in_chunk,
-					    &is_last_chunk);
-    read_wdf(&pos, end, &wdf);
+    read_chunk_header();
     LOGLINE(DB, "Initial docid " << did);
 }
 
@@ -825,8 +988,18 @@ GlassPostList::next_chunk()
     end = pos + cursor->current_tag.size();
 
     first_did_in_chunk = did;
+    read_chunk_header();
+}
+
+void
+GlassPostList::read_chunk_header()
+{
+    LOGCALL_VOID(DB, "GlassPostList::read_chunk_header", NO_ARGS);
     last_did_in_chunk = read_start_of_chunk(&pos, end, first_did_in_chunk,
-					    &is_last_chunk);
+					    &is_last_chunk, &skip_pos);
+    skip_end = pos;
+    skip_did = first_did_in_chunk;
+    skip_offset = 0;
     read_wdf(&pos, end, &wdf);
 }
 
@@ -923,9 +1096,7 @@ GlassPostList::move_to_chunk_containing(Xapian::docid desired_did)
     }
 
     first_did_in_chunk = did;
-    last_did_in_chunk = read_start_of_chunk(&pos, end, first_did_in_chunk,
-					    &is_last_chunk);
-    read_wdf(&pos, end, &wdf);
+    read_chunk_header();
 
     // Possible, since desired_did might be after end of this chunk and before
     // the next.
@@ -940,6 +1111,31 @@ GlassPostList::move_forward_in_chunk_to_at_least(Xapian::docid desired_did)
 	RETURN(true);
 
     if (desired_did <= last_did_in_chunk) {
+	if (skip_pos) {
+	    // Use the skip data to find the last entry it points to which is
+	    // before desired_did.
+	    while (skip_pos != skip_end) {
+		const char * p = skip_pos;
+		Xapian::docid did_increase;
+		size_t offset_increase;
+		if (!unpack_uint(&p, skip_end, &did_increase) ||
+		    !unpack_uint(&p, skip_end, &offset_increase)) {
+		    report_read_error(p);
+		}
+		if (skip_did + did_increase >= desired_did) break;
+		skip_did += did_increase;
+		skip_offset += offset_increase;
+		skip_pos = p;
+	    }
+	    if (skip_did > did) {
+		if (skip_offset > size_t(end - skip_end))
+		    report_read_error(NULL);
+		did = skip_did;
+		pos = skip_end + skip_offset;
+		// We know this entry is before desired_did, so skip its wdf.
+		read_wdf(&pos, end, NULL);
+	    }
+	}
 	while (pos != end) {
 	    read_did_increase(&pos, end, &did);
 	    if (did >= desired_did) {
@@ -1037,9 +1233,13 @@ Xapian::docid
 GlassPostListTable::get_chunk(const string &tname,
 			      Xapian::docid did, bool adding,
 			      PostlistChunkReader ** from,
-			      PostlistChunkWriter **to)
+			      PostlistChunkWriter **to,
+			      Xapian::doccount termfreq)
 {
-    LOGCALL(DB, Xapian::docid, "GlassPostListTable::get_chunk", tname | did | adding | from | to);
+    LOGCALL(DB, Xapian::docid, "GlassPostListTable::get_chunk", tname | did | adding | from | to | termfreq);
+    unsigned chunk_size = CHUNKSIZE;
+    if (adaptive_chunks) chunk_size = adaptive_chunk_size(termfreq);
+
     // Get chunk containing entry
     string key = make_key(tname, did);
 
@@ -1061,7 +1261,8 @@ GlassPostListTable::get_chunk(const string &tname,
 	    throw Xapian::DatabaseCorruptError("Attempted to delete or modify an entry in a non-existent posting list for " + tname);
 
 	*from = NULL;
-	*to = new PostlistChunkWriter(string(), true, tname, true);
+	*to = new PostlistChunkWriter(string(), true, tname, true,
+				      chunk_size, adaptive_chunks);
 	RETURN(Xapian::docid(-1));
     }
 
@@ -1086,7 +1287,7 @@ GlassPostListTable::get_chunk(const string &tname,
     Xapian::docid last_did_in_chunk;
     last_did_in_chunk = read_start_of_chunk(&pos, end, first_did_in_chunk, &is_last_chunk);
     *to = new PostlistChunkWriter(cursor->current_key, is_first_chunk, tname,
-				  is_last_chunk);
+				  is_last_chunk, chunk_size, adaptive_chunks);
     if (did > last_did_in_chunk) {
 	// This is the shortcut.  Not very pretty, but I'll leave refactoring
 	// until I've a clearer picture of everything which needs to be done.
@@ -1142,10 +1343,14 @@ GlassPostListTable::merge_doclen_changes(const map<Xapian::docid, Xapian::termco
     j = doclens.begin();
     Assert(j != doclens.end()); // This case is caught above.
 
+    // We don't keep a count of entries for the document length list, but the
+    // highest docid we're updating is a reasonable estimate.
+    Xapian::doccount termfreq = doclens.rbegin()->first;
+
     Xapian::docid max_did;
     PostlistChunkReader *from;
     PostlistChunkWriter *to;
-    max_did = get_chunk(string(), j->first, true, &from, &to);
+    max_did = get_chunk(string(), j->first, true, &from, &to, termfreq);
     LOGVALUE(DB, max_did);
     for ( ; j != doclens.end(); ++j) {
 	Xapian::docid did = j->first;
@@ -1165,7 +1370,7 @@ next_doclen_chunk:
 	    delete from;
 	    to->flush(this);
 	    delete to;
-	    max_did = get_chunk(string(), did, false, &from, &to);
+	    max_did = get_chunk(string(), did, false, &from, &to, termfreq);
 	    goto next_doclen_chunk;
 	}
 
@@ -1190,6 +1395,7 @@ void
 GlassPostListTable::merge_changes(const string &term,
 				  const Inverter::PostingChanges & changes)
 {
+    Xapian::doccount termfreq;
     {
 	// Rewrite the first chunk of this posting list with the updated
 	// termfreq and collfreq.
@@ -1200,7 +1406,7 @@ GlassPostListTable::merge_changes(const string &term,
 	// Read start of first chunk to get termfreq and collfreq.
 	const char *pos = tag.data();
 	const char *end = pos + tag.size();
-	Xapian::doccount termfreq;
+	const char *end_of_first_chunk_header = pos;
 	Xapian::termcount collfreq;
 	Xapian::docid firstdid, lastdid;
 	bool islast;
@@ -1213,6 +1419,7 @@ GlassPostListTable::merge_changes(const string &term,
 	} else {
 	    firstdid = read_start_of_first_chunk(&pos, end,
 						 &termfreq, &collfreq);
+	    end_of_first_chunk_header = pos;
 	    // Handle the generic start of chunk header.
 	    lastdid = read_start_of_chunk(&pos, end, firstdid, &islast);
 	}
@@ -1241,23 +1448,25 @@ GlassPostListTable::merge_changes(const string &term,
 
 	// Rewrite start of first chunk to update termfreq and collfreq.
 	string newhdr = make_start_of_first_chunk(termfreq, collfreq, firstdid);
-	newhdr += make_start_of_chunk(islast, firstdid, lastdid);
 	if (pos == end) {
+	    newhdr += make_start_of_chunk(islast, firstdid, lastdid);
 	    add(current_key, newhdr);
 	} else {
-	    Assert(size_t(pos - tag.data()) <= tag.size());
-	    tag.replace(0, pos - tag.data(), newhdr);
+	    // The standard chunk header (including any skip data) is
+	    // unchanged.
+	    tag.replace(0, end_of_first_chunk_header - tag.data(), newhdr);
 	    add(current_key, tag);
 	}
     }
-    map<Xapian::docid, Xapian::termcount>::const_iterator j;
-    j = changes.pl_changes.begin();
+    // Inverter::PostingChanges::finalise() should have been called.
+    Assert(changes.sorted);
+    auto j = changes.pl_changes.begin();
     Assert(j != changes.pl_changes.end()); // This case is caught above.
 
     Xapian::docid max_did;
     PostlistChunkReader *from;
     PostlistChunkWriter *to;
-    max_did = get_chunk(term, j->first, false, &from, &to);
+    max_did = get_chunk(term, j->first, false, &from, &to, termfreq);
     for ( ; j != changes.pl_changes.end(); ++j) {
 	Xapian::docid did = j->first;
 
@@ -1278,7 +1487,7 @@ next_chunk:
 	    delete from;
 	    to->flush(this);
 	    delete to;
-	    max_did = get_chunk(term, did, false, &from, &to);
+	    max_did = get_chunk(term, did, false, &from, &to, termfreq);
 	    goto next_chunk;
 	}
 
@@ -1299,6 +1508,74 @@ next_chunk:
     delete to;
 }
 
+void
+GlassPostListTable::rechunk(vector<pair<Xapian::docid, string>> & tags,
+			    Xapian::doccount termfreq, bool adaptive)
+{
+    LOGCALL_STATIC_VOID(DB, "GlassPostListTable::rechunk", tags.size() | termfreq | adaptive);
+    if (tags.empty()) return;
+
+    unsigned chunk_size = CHUNKSIZE;
+    if (adaptive) {
+	if (termfreq == 0) {
+	    // Estimate the number of entries from the last docid.
+	    const string & last_tag = tags.back().second;
+	    const char * p = last_tag.data();
+	    const char * e = p + last_tag.size();
+	    bool is_last;
+	    termfreq = read_start_of_chunk(&p, e, tags.back().first, &is_last);
+	}
+	chunk_size = adaptive_chunk_size(termfreq);
+    }
+
+    vector<pair<Xapian::docid, string>> new_tags;
+    string chunk;
+    Xapian::docid first_did = 0, last_did = 0;
+    for (auto& i : tags) {
+	const char * p = i.second.data();
+	const char * e = p + i.second.size();
+	bool is_last;
+	(void)read_start_of_chunk(&p, e, i.first, &is_last);
+	Xapian::docid did = i.first;
+	if (did <= last_did) {
+	    throw Xapian::DatabaseCorruptError("Document ID in new chunk of "
+					       "postlist is not greater than "
+					       "final document ID in previous "
+					       "chunk");
+	}
+	while (true) {
+	    Xapian::termcount wdf;
+	    read_wdf(&p, e, &wdf);
+	    if (chunk.size() >= chunk_size) {
+		string tag = make_start_of_chunk(false, first_did, last_did,
+						 adaptive ?
+						 make_chunk_skips(first_did,
+								  chunk) :
+						 string());
+		tag += chunk;
+		new_tags.emplace_back(first_did, std::move(tag));
+		chunk.resize(0);
+	    }
+	    if (chunk.empty()) {
+		first_did = did;
+	    } else {
+		pack_uint(chunk, did - last_did - 1);
+	    }
+	    pack_uint(chunk, wdf);
+	    last_did = did;
+	    if (p == e) break;
+	    read_did_increase(&p, e, &did);
+	}
+    }
+    string tag = make_start_of_chunk(true, first_did, last_did,
+				     adaptive ?
+				     make_chunk_skips(first_did, chunk) :
+				     string());
+    tag += chunk;
+    new_tags.emplace_back(first_did, std::move(tag));
+    swap(tags, new_tags);
+}
+
 void
 GlassPostListTable::get_used_docid_range(Xapian::docid & first,
 					 Xapian::docid & last) const
@@ -36,9 +36,12 @@
 #include <memory>
 #include <map>
 #include <string>
+#include <utility>
+#include <vector>
 
 class GlassCursor;
 class GlassDatabase;
+class GlassDoclenCache;
 
 namespace Glass {
     class PostlistChunkReader;
@@ -91,10 +94,33 @@ class GlassPostListTable : public GlassTable {
     void merge_doclen_changes(const std::map<Xapian::docid,
 					Xapian::termcount>& doclens);
 
+    /** Get the chunk of the posting list for @a tname which contains @a did.
+     *
+     *  @param termfreq	The number of entries in the posting list, which
+     *			is used to pick the chunk size if adaptive chunk
+     *			sizes are enabled.
+     */
     Xapian::docid get_chunk(const std::string& tname,
 			    Xapian::docid did, bool adding,
 			    Glass::PostlistChunkReader** from,
-			    Glass::PostlistChunkWriter** to);
+			    Glass::PostlistChunkWriter** to,
+			    Xapian::doccount termfreq);
+
+    /** Split a posting list into chunks again.
+     *
+     *  Used by compaction to resize chunks when the input and output
+     *  databases use different chunk sizes.
+     *
+     *  @param tags	The chunks of the posting list, as pairs of the first
+     *			docid in the chunk and the chunk data in the format
+     *			used for chunks other than the first.  Replaced by
+     *			the new chunks.
+     *  @param termfreq	The number of entries in the posting list, or 0 if
+     *			not known (as for the document length list).
+     *  @param adaptive	Use adaptive chunk sizes and skip data?
+     */
+    static void rechunk(std::vector<std::pair<Xapian::docid, std::string>>& tags,
+			Xapian::doccount termfreq, bool adaptive);
 
     /// Compose a key from a termname and docid.
     static std::string make_key(const std::string& term, Xapian::docid did) {
@@ -130,6 +156,12 @@ class GlassPostListTable : public GlassTable {
     Xapian::termcount get_doclength(Xapian::docid did,
 				    Xapian::Internal::intrusive_ptr<const GlassDatabase> db) const;
 
+    /** Read all the document lengths into @a cache.
+     *
+     *  @return	false if a document length was too large for @a cache.
+     */
+    bool load_doclengths(GlassDoclenCache& cache) const;
+
     /** Check if document @a did exists. */
     bool document_exists(Xapian::docid did,
 			 Xapian::Internal::intrusive_ptr<const GlassDatabase> db) const;
@@ -171,6 +203,21 @@ class GlassPostList : public LeafPostList {
     /// Position of iteration through current chunk.
     const char * pos;
 
+    /** Position of iteration through the skip data for the current chunk.
+     *
+     *  NULL if the current chunk has no skip data.
+     */
+    const char * skip_pos = NULL;
+
+    /// End of the skip data, which is also the start of the entries.
+    const char * skip_end = NULL;
+
+    /// The docid of the entry the skip data last pointed to.
+    Xapian::docid skip_did = 0;
+
+    /// The offset of that entry's wdf from skip_end.
+    size_t skip_offset = 0;
+
     /// Pointer to byte after end of current chunk.
     const char * end;
 
@@ -234,6 +281,13 @@ class GlassPostList : public LeafPostList {
      */
     bool move_forward_in_chunk_to_at_least(Xapian::docid desired_did);
 
+    /** Read the header of the current chunk and the first wdf.
+     *
+     *  pos and end must point to the chunk data after any first chunk
+     *  header, and first_did_in_chunk must be set.
+     */
+    void read_chunk_header();
+
     GlassPostList(Xapian::Internal::intrusive_ptr<const GlassDatabase> this_db_,
 		  const std::string& term,
 		  GlassCursor * cursor_);
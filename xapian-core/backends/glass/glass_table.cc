@@ -45,6 +45,7 @@
 #include "glass_defs.h"
 #include "glass_version.h"
 
+#include "crc32c.h"
 #include "debuglog.h"
 #include "filetests.h"
 #include "io_utils.h"
@@ -52,6 +53,7 @@
 #include "wordaccess.h"
 
 #include <algorithm>  // for std::min()
+#include <memory>
 #include <string>
 
 #include "xapian/constants.h"
@@ -167,9 +169,30 @@ GlassTable::read_block(uint4 n, uint8_t * p) const
 
     io_read_block(handle, reinterpret_cast<char *>(p), block_size, n, offset);
 
+    if (checksums) {
+	unsigned e = block_end();
+	if (rare(crc32c(p, e) != aligned_read4(p + e))) {
+	    // A reader can see a block which a writer is part way through
+	    // overwriting, since the writer may reuse blocks which the
+	    // revision we're reading has freed.  If the header shows the block
+	    // has been reused then this is the same situation as
+	    // block_to_cursor() finding a block from a newer revision.  For a
+	    // writer (or xapian-check, which opens tables as writable) this is
+	    // always corruption.
+	    if (!writable &&
+		(REVISION(p) > revision_number ||
+		 GET_LEVEL(p) == LEVEL_FREELIST)) {
+		set_overwritten();
+	    }
+	    string msg("checksum mismatch in block ");
+	    msg += str(n);
+	    throw Xapian::DatabaseCorruptError(msg);
+	}
+    }
+
     if (GET_LEVEL(p) != LEVEL_FREELIST) {
 	int dir_end = DIR_END(p);
-	if (rare(dir_end < DIR_START || unsigned(dir_end) > block_size)) {
+	if (rare(dir_end < DIR_START || unsigned(dir_end) > block_end())) {
 	    string msg("dir_end invalid in block ");
 	    msg += str(n);
 	    throw Xapian::DatabaseCorruptError(msg);
@@ -178,6 +201,9 @@ GlassTable::read_block(uint4 n, uint8_t * p) const
 }
 
 /** write_block(n, p, appending) writes block n in the DB file from address p.
+ *
+ *  If the table uses checksums, the checksum at the end of the block at p is
+ *  updated before it is written.
  *
  *  If appending is true (not specified it defaults to false), then this
  *  indicates that we've added data to a block in space which was previously
@@ -188,7 +214,7 @@ GlassTable::read_block(uint4 n, uint8_t * p) const
  *  invalidating any existing revisions, which may be useful information.
  */
 void
-GlassTable::write_block(uint4 n, const uint8_t * p, bool appending) const
+GlassTable::write_block(uint4 n, uint8_t * p, bool appending) const
 {
     LOGCALL_VOID(DB, "GlassTable::write_block", n | p | appending);
     Assert(writable);
@@ -217,6 +243,11 @@ GlassTable::write_block(uint4 n, const uint8_t * p, bool appending) const
 	// read lock and try to take an exclusive lock here?
     }
 
+    if (checksums) {
+	unsigned e = block_end();
+	aligned_write4(p + e, crc32c(p, e));
+    }
+
     const char * p_char = reinterpret_cast<const char *>(p);
     io_write_block(handle, p_char, block_size, n, offset);
 
@@ -314,7 +345,7 @@ GlassTable::block_to_cursor(Glass::Cursor * C_, int j, uint4 n) const
 
     if (writable && C_[j].rewrite) {
 	Assert(C == C_);
-	write_block(C_[j].get_n(), C_[j].get_p());
+	write_block(C_[j].get_n(), C_[j].get_modifiable_p(block_size));
 	C_[j].rewrite = false;
     }
 
@@ -565,7 +596,7 @@ GlassTable::compact(uint8_t * p)
     LOGCALL_VOID(DB, "GlassTable::compact", (void*)p);
     Assert(p != buffer);
     Assert(writable);
-    int e = block_size;
+    int e = block_end();
     uint8_t * b = buffer;
     int dir_end = DIR_END(p);
     if (GET_LEVEL(p) == 0) {
@@ -587,7 +618,7 @@ GlassTable::compact(uint8_t * p)
 	    BItem_wr::setD(p, c, e);  /* reform in b */
 	}
     }
-    memcpy(p + e, b + e, block_size - e);  /* copy back */
+    memcpy(p + e, b + e, block_end() - e);  /* copy back */
     e -= dir_end;
     SET_TOTAL_FREE(p, e);
     SET_MAX_FREE(p, e);
@@ -734,7 +765,7 @@ GlassTable::mid_point(uint8_t * p) const
     LOGCALL(DB, int, "GlassTable::mid_point", (void*)p);
     int n = 0;
     int dir_end = DIR_END(p);
-    int size = block_size - TOTAL_FREE(p) - dir_end;
+    int size = block_end() - TOTAL_FREE(p) - dir_end;
     for (int c = DIR_START; c < dir_end; c += D2) {
 	int l;
 	if (GET_LEVEL(p) == 0) {
@@ -1284,12 +1315,27 @@ GlassTable::add(const string &key, string tag, bool already_compressed)
 	    GlassTable::throw_database_closed();
 	}
 	RootInfo root_info;
-	root_info.init(block_size, compress_min);
+	root_info.init(block_size, compress_min, comp_stream.get_codec(),
+		       checksums, packed_positions, adaptive_chunks);
 	do_open_to_write(&root_info);
     }
 
     form_key(key);
 
+    if (already_compressed && comp_stream.get_codec() != COMPRESSION_ZLIB) {
+	// Tags passed through compressed (e.g. when compacting) are always
+	// zlib-compressed, so we need to inflate the tag and compress it with
+	// the codec this table uses.
+	recompress_stream.decompress_start();
+	string uncompressed;
+	if (!recompress_stream.decompress_chunk(tag.data(), tag.size(),
+						uncompressed)) {
+	    throw Xapian::DatabaseCorruptError("Truncated compressed tag");
+	}
+	swap(tag, uncompressed);
+	already_compressed = false;
+    }
+
     const char* tag_data = tag.data();
     size_t tag_size = tag.size();
 
@@ -1355,7 +1401,7 @@ GlassTable::add(const string &key, string tag, bool already_compressed)
     for (i = 1; i <= m; ++i) {
 	size_t l = (i == m ? residue : (i == 1 ? first_L : L));
 	size_t this_cd = (i == 1 ? cd - X2 : cd);
-	Assert(this_cd + l <= block_size);
+	Assert(this_cd + l <= block_end());
 	Assert(o + l <= tag_size);
 	kt.set_tag(this_cd, tag_data + o, l, compressed, i, m);
 
@@ -1467,6 +1513,47 @@ GlassTable::readahead_key(const string &key) const
     RETURN(true);
 }
 
+void
+GlassTable::readahead_leaves(const vector<string>& keys) const
+{
+    LOGCALL_VOID(DB, "GlassTable::readahead_leaves", keys.size());
+    // See readahead_key() for what the handle values mean.
+    if (handle < 0)
+	return;
+
+    // If the table only has one level, there are no branch blocks to preread.
+    if (level == 0)
+	return;
+
+    uint4 last_n = C[0].get_n();
+    for (const string& key : keys) {
+	// An overlong key cannot be found.
+	if (key.size() > GLASS_BTREE_MAX_KEY_LEN)
+	    continue;
+
+	form_key(key);
+
+	// Descend to level 1 just as find() would, so any branch blocks we
+	// read are left in the cursor for the lookups which follow.
+	const uint8_t * p;
+	int c;
+	for (int j = level; j > 1; --j) {
+	    p = C[j].get_p();
+	    c = find_in_branch(p, kt, C[j].c);
+	    C[j].c = c;
+	    block_to_cursor(C, j - 1, BItem(p, c).block_given_by());
+	}
+	p = C[1].get_p();
+	c = find_in_branch(p, kt, C[1].c);
+	uint4 n = BItem(p, c).block_given_by();
+	if (n != last_n) {
+	    last_n = n;
+	    if (!io_readahead_block(handle, block_size, n, offset))
+		return;
+	}
+    }
+}
+
 bool
 GlassTable::get_exact_entry(const string &key, string & tag) const
 {
@@ -1510,6 +1597,10 @@ GlassTable::read_tag(Glass::Cursor * C_, string *tag, bool keep_compressed) cons
 
     tag->resize(0);
 
+    // Only zlib-compressed tags can be passed through compressed, since
+    // that's what GlassTable::add() and HoneyTable::add() expect.
+    if (comp_stream.get_codec() != COMPRESSION_ZLIB) keep_compressed = false;
+
     bool first = true;
     bool compressed = false;
     bool decompress = false;
@@ -1557,6 +1648,51 @@ GlassTable::set_full_compaction(bool parity)
     full_compaction = parity;
 }
 
+void
+GlassTable::get_split_keys(size_t n, vector<string>& keys) const
+{
+    LOGCALL_VOID(DB, "GlassTable::get_split_keys", n | Literal("keys"));
+    keys.clear();
+    if (handle < 0) {
+	if (handle == -2) {
+	    GlassTable::throw_database_closed();
+	}
+	return;
+    }
+    if (level == 0 || faked_root_block) return;
+
+    unique_ptr<uint8_t[]> p(new uint8_t[block_size]);
+    // The blocks at the current level, in key order.
+    vector<uint4> blocks(1, root);
+    for (int j = level; j > 0; --j) {
+	// The keys at this level, in key order.  Those from the level above
+	// separate the blocks at this level.
+	vector<string> level_keys;
+	vector<uint4> children;
+	for (size_t i = 0; i != blocks.size(); ++i) {
+	    if (i) level_keys.push_back(keys[i - 1]);
+	    read_block(blocks[i], p.get());
+	    int dir_end = DIR_END(p.get());
+	    for (int c = DIR_START; c < dir_end; c += D2) {
+		BItem item(p.get(), c);
+		children.push_back(item.block_given_by());
+		// The first key in a branch block is usually null.
+		if (item.key().length() == 0) continue;
+		string key;
+		item.key().read(&key);
+		level_keys.push_back(std::move(key));
+	    }
+	}
+	swap(keys, level_keys);
+	if (keys.size() >= n) break;
+	swap(blocks, children);
+    }
+    // The keys should already be in order, but make sure in case an
+    // unexpected non-null first key in a block has put any out of place.
+    sort(keys.begin(), keys.end());
+    keys.erase(unique(keys.begin(), keys.end()), keys.end());
+}
+
 GlassCursor * GlassTable::cursor_get() const {
     LOGCALL(DB, GlassCursor *, "GlassTable::cursor_get", NO_ARGS);
     if (handle < 0) {
@@ -1590,6 +1726,10 @@ GlassTable::basic_open(const RootInfo * root_info, glass_revision_number_t rev)
     }
 
     compress_min = root_info->get_compress_min();
+    comp_stream.set_codec(root_info->get_compress_codec());
+    checksums = root_info->get_checksums();
+    packed_positions = root_info->get_packed_positions();
+    adaptive_chunks = root_info->get_adaptive_chunks();
 
     /* kt holds constructed items as well as keys */
     kt = LeafItem_wr(zeroed_new(block_size));
@@ -1622,7 +1762,7 @@ GlassTable::read_root()
 	 * the same database. */
 	memset(p, 0, block_size);
 
-	int o = block_size - I2 - K1;
+	int o = block_end() - I2 - K1;
 	LeafItem_wr(p + o).fake_root_item();
 
 	LeafItem_wr::setD(p, DIR_START, o);         // its directory entry
@@ -1672,6 +1812,13 @@ GlassTable::do_open_to_write(const RootInfo * root_info,
 	    // directory doesn't exist.
 	    if (lazy && rev && errno == ENOENT) {
 		revision_number = rev;
+		// Remember the settings so the table is created with them if
+		// it gets written to.
+		compress_min = root_info->get_compress_min();
+		comp_stream.set_codec(root_info->get_compress_codec());
+		checksums = root_info->get_checksums();
+		packed_positions = root_info->get_packed_positions();
+		adaptive_chunks = root_info->get_adaptive_chunks();
 		return;
 	    }
 	    string message((rev == 0) ? "Couldn't create " : "Couldn't open ");
@@ -1699,6 +1846,9 @@ GlassTable::GlassTable(const char * tablename_, const string & path_,
 	  revision_number(0),
 	  item_count(0),
 	  block_size(0),
+	  checksums(false),
+	  packed_positions(false),
+	  adaptive_chunks(false),
 	  faked_root_block(true),
 	  sequential(true),
 	  handle(-1),
@@ -1734,6 +1884,9 @@ GlassTable::GlassTable(const char * tablename_, int fd, off_t offset_,
 	  revision_number(0),
 	  item_count(0),
 	  block_size(0),
+	  checksums(false),
+	  packed_positions(false),
+	  adaptive_chunks(false),
 	  faked_root_block(true),
 	  sequential(true),
 	  handle(-3 - fd),
@@ -1793,6 +1946,10 @@ GlassTable::create_and_open(int flags_, const RootInfo & root_info)
 	close();
 	(void)io_unlink(name + GLASS_TABLE_EXTENSION);
 	compress_min = root_info.get_compress_min();
+	comp_stream.set_codec(root_info.get_compress_codec());
+	checksums = root_info.get_checksums();
+	packed_positions = root_info.get_packed_positions();
+	adaptive_chunks = root_info.get_adaptive_chunks();
     } else {
 	// FIXME: it would be good to arrange that this works such that there's
 	// always a valid table in place if you run create_and_open() on an
@@ -1853,7 +2010,7 @@ GlassTable::flush_db()
 
     for (int j = level; j >= 0; --j) {
 	if (C[j].rewrite) {
-	    write_block(C[j].get_n(), C[j].get_p());
+	    write_block(C[j].get_n(), C[j].get_modifiable_p(block_size));
 	}
     }
 
@@ -1861,9 +2018,10 @@ GlassTable::flush_db()
 }
 
 void
-GlassTable::commit(glass_revision_number_t revision, RootInfo * root_info)
+GlassTable::commit(glass_revision_number_t revision, RootInfo * root_info,
+		   unsigned retain)
 {
-    LOGCALL_VOID(DB, "GlassTable::commit", revision|root_info);
+    LOGCALL_VOID(DB, "GlassTable::commit", revision|root_info|retain);
     Assert(writable);
 
     if (revision <= revision_number) {
@@ -1901,12 +2059,12 @@ GlassTable::commit(glass_revision_number_t revision, RootInfo * root_info)
 	}
 
 	free_list.set_revision(revision);
-	free_list.commit(this, block_size);
+	free_list.commit(this, block_size, retain);
 
 	// Save the freelist details into the root_info.
 	string serialised;
 	free_list.pack(serialised);
-	root_info->set_free_list(serialised);
+	root_info->set_free_list(serialised, free_list.has_retained());
 
 	revision_number = revision;
 
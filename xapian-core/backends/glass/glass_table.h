@@ -41,6 +41,7 @@
 
 #include <algorithm>
 #include <string>
+#include <vector>
 
 namespace Glass {
 
@@ -485,6 +486,19 @@ class GlassTable {
 
     bool readahead_key(const string &key) const;
 
+    /** Preread the leaf blocks which a list of keys would be in.
+     *
+     *  Unlike readahead_key(), this descends the B-tree with the built-in
+     *  cursor (reading any branch blocks which aren't already in it) so that
+     *  it can issue a readahead for each different leaf block the keys would
+     *  be in, allowing the reads of those blocks to proceed in parallel.
+     *  Walking the keys in order means each branch block is read at most
+     *  once.
+     *
+     *  @param keys	The keys, in ascending order.
+     */
+    void readahead_leaves(const std::vector<std::string>& keys) const;
+
     /** Determine whether the btree exists on disk.
      */
     bool exists() const;
@@ -512,6 +526,9 @@ class GlassTable {
     /** Return true if this table is writable. */
     bool is_writable() const { return writable; }
 
+    /** Return true if posting list chunks are sized by term frequency. */
+    bool get_adaptive_chunks() const { return adaptive_chunks; }
+
     /** Flush any outstanding changes to the DB file of the table.
      *
      *  This must be called before commit, to ensure that the DB file is
@@ -533,8 +550,13 @@ class GlassTable {
      *          needs to be greater than any previously used revision.
      *
      *  @param root_info  Information about the root is returned in this.
+     *
+     *  @param retain  The number of revisions before @a new_revision to keep
+     *		blocks for so that readers of them can continue (default: 0,
+     *		so only blocks of the latest committed revision are kept).
      */
-    void commit(glass_revision_number_t revision, RootInfo * root_info);
+    void commit(glass_revision_number_t revision, RootInfo * root_info,
+		unsigned retain = 0);
 
     bool sync() {
 	return (flags & Xapian::DB_NO_SYNC) ||
@@ -581,9 +603,10 @@ class GlassTable {
     /** Read the tag value for the key pointed to by cursor C_.
      *
      *  @param keep_compressed  Don't uncompress the tag - e.g. useful
-     *			    if it's just being opaquely copied.
+     *			    if it's just being opaquely copied.  This is
+     *			    ignored unless the table uses zlib.
      *
-     *  @return	true if current_tag holds compressed data (always
+     *  @return	true if current_tag holds zlib-compressed data (always
      *		false if keep_compressed was false).
      */
     bool read_tag(Glass::Cursor* C_,
@@ -602,9 +625,10 @@ class GlassTable {
      *
      *  @param key   The key to store in the table.
      *  @param tag   The tag to store in the table.
-     *  @param already_compressed	true if tag is already compressed,
-     *		for example because it is being opaquely copied
-     *		(default: false).
+     *  @param already_compressed	true if tag is already compressed with
+     *		zlib, for example because it is being opaquely copied
+     *		(default: false).  If the table uses a different codec the
+     *		tag is recompressed.
      */
     void add(const std::string& key,
 	     std::string tag,
@@ -688,6 +712,20 @@ class GlassTable {
 	return (item_count == 0);
     }
 
+    /** Get keys which divide the table into similarly sized ranges.
+     *
+     *  The keys come from the branch blocks of the B-tree, so they split the
+     *  table into runs of leaf blocks.  We use the highest level with enough
+     *  keys (or the level above the leaves if no level has enough).  Keys in
+     *  branch blocks are truncated to the shortest prefix which separates
+     *  adjacent leaf blocks, so may not be present in the table.
+     *
+     *  @param n	The number of keys wanted.
+     *  @param keys	The keys in ascending order.  This will be empty if
+     *			the table is only a single leaf block.
+     */
+    void get_split_keys(size_t n, std::vector<std::string>& keys) const;
+
     /** Get a cursor for reading from the table.
      *
      *  The cursor is owned by the caller - it is the caller's
@@ -713,7 +751,7 @@ class GlassTable {
 	using Glass::DIR_START;
 	using Glass::D2;
 	max_item_size =
-	    (block_size - DIR_START - block_capacity * D2) / block_capacity;
+	    (block_end() - DIR_START - block_capacity * D2) / block_capacity;
 	// Make sure we don't exceed the limit imposed by the format.
 	if (max_item_size > Glass::MAX_ITEM_SIZE)
 	    max_item_size = Glass::MAX_ITEM_SIZE;
@@ -740,7 +778,7 @@ class GlassTable {
     bool find(Glass::Cursor *) const;
     int delete_kt();
     void read_block(uint4 n, uint8_t *p) const;
-    void write_block(uint4 n, const uint8_t *p,
+    void write_block(uint4 n, uint8_t *p,
 		     bool appending = false) const;
     [[noreturn]]
     void set_overwritten() const;
@@ -774,6 +812,31 @@ class GlassTable {
     /** block size of the B tree in bytes */
     unsigned int block_size;
 
+    /** true if the last 4 bytes of each block hold a CRC32C checksum of the
+     *  rest of the block.
+     */
+    bool checksums;
+
+    /** true if position lists are stored bit-packed.
+     *
+     *  Only used for the position table.
+     */
+    bool packed_positions;
+
+    /** true if posting list chunks are sized by term frequency.
+     *
+     *  Only used for the postlist table.
+     */
+    bool adaptive_chunks;
+
+    /** The offset of the end of the space usable for items in a block.
+     *
+     *  This is block_size, less the space for the checksum if there is one.
+     */
+    unsigned block_end() const {
+	return checksums ? block_size - 4 : block_size;
+    }
+
     /** Flags like DB_NO_SYNC and DB_DANGEROUS. */
     int flags;
 
@@ -903,6 +966,14 @@ class GlassTable {
 
     mutable CompressionStream comp_stream;
 
+    /** Used to inflate zlib-compressed tags passed to add().
+     *
+     *  Only needed if this table uses a different codec, in which case we
+     *  reuse this stream for every such tag rather than setting up a new
+     *  zlib stream each time.
+     */
+    CompressionStream recompress_stream;
+
     /// If true, don't create the table until it's needed.
     bool lazy;
 
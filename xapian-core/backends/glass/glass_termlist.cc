@@ -190,6 +190,10 @@ TermList *
 GlassTermList::skip_to(const string & term)
 {
     LOGCALL(API, TermList *, "GlassTermList::skip_to", term);
+    // Each term is stored as a suffix of the previous one, so we have to
+    // decode the terms in turn.  The constructor has already read the whole
+    // entry, which costs more than decoding it, so a skip index in the entry
+    // wouldn't save much.
     while (pos != NULL && current_term < term) {
 	(void)GlassTermList::next();
     }
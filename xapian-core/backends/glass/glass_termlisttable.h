@@ -67,6 +67,30 @@ class GlassTermListTable : public GlassTable {
     void set_termlist(Xapian::docid did, const Xapian::Document & doc,
 		      Xapian::termcount doclen);
 
+    /** Set the termlist data for document @a did.
+     *
+     *  Any existing data is replaced.
+     *
+     *  @param did	The docid to set the termlist data for.
+     *  @param tag	The termlist data, as produced by encode_termlist().
+     */
+    void set_termlist(Xapian::docid did, const std::string & tag) {
+	add(make_key(did), tag);
+    }
+
+    /** Encode the termlist data for a document.
+     *
+     *  This doesn't access the table, so can be called for different
+     *  documents in parallel.
+     *
+     *  @param tag	String to append the encoded termlist data to.
+     *  @param doc	The Xapian::Document object to read term data from.
+     *  @param doclen	The document length.
+     */
+    static void encode_termlist(std::string & tag,
+				const Xapian::Document & doc,
+				Xapian::termcount doclen);
+
     /** Delete the termlist data for document @a did.
      *
      *  @param did  The docid to delete the termlist data for.
@@ -23,6 +23,7 @@
 
 #include "glass_version.h"
 
+#include "compression_stream.h"
 #include "debuglog.h"
 #include "fd.h"
 #include "glass_defs.h"
@@ -51,6 +52,18 @@ using namespace std;
 
 /// Glass format version (date of change):
 #define GLASS_FORMAT_VERSION DATE_TO_VERSION(2016,03,14)
+/** Glass format version used if any table uses a codec other than zlib, block
+ *  checksums, keeps blocks for readers of older revisions, bit-packed
+ *  position lists, or adaptive posting list chunks.
+ *
+ *  We only write this version when it's needed so that databases which don't
+ *  use these features can still be read by older releases.
+ */
+#define GLASS_FORMAT_VERSION_EXTENDED DATE_TO_VERSION(2026,10,19)
+// 2026,10,19 1.5.0 per-table compression codec, block checksums flag,
+//		    retained revisions in freelist, bit-packed position
+//		    lists and adaptive posting list chunks flags in the
+//		    version file
 // 2016,03,14 1.3.5 compress_min in version file; partly eliminate component_of
 // 2015,12,24 1.3.4 2 bytes "components_of" per item eliminated, and much more
 // 2014,11,21 1.3.2 Brass renamed to Glass
@@ -133,7 +146,8 @@ GlassVersion::read()
     version = static_cast<unsigned char>(buf[GLASS_VERSION_MAGIC_LEN]);
     version <<= 8;
     version |= static_cast<unsigned char>(buf[GLASS_VERSION_MAGIC_LEN + 1]);
-    if (version != GLASS_FORMAT_VERSION) {
+    if (version != GLASS_FORMAT_VERSION &&
+	version != GLASS_FORMAT_VERSION_EXTENDED) {
 	string msg;
 	if (!single_file()) {
 	    msg = db_dir;
@@ -144,9 +158,9 @@ GlassVersion::read()
 		   VERSION_TO_MONTH(version) * 100 +
 		   VERSION_TO_DAY(version));
 	msg += " but I only understand ";
-	msg += str(VERSION_TO_YEAR(GLASS_FORMAT_VERSION) * 10000 +
-		   VERSION_TO_MONTH(GLASS_FORMAT_VERSION) * 100 +
-		   VERSION_TO_DAY(GLASS_FORMAT_VERSION));
+	msg += str(VERSION_TO_YEAR(GLASS_FORMAT_VERSION_EXTENDED) * 10000 +
+		   VERSION_TO_MONTH(GLASS_FORMAT_VERSION_EXTENDED) * 100 +
+		   VERSION_TO_DAY(GLASS_FORMAT_VERSION_EXTENDED));
 	throw Xapian::DatabaseVersionError(msg);
     }
 
@@ -161,6 +175,33 @@ GlassVersion::read()
 	if (!root[table_no].unserialise(&p, end)) {
 	    throw Xapian::DatabaseCorruptError("Rev file root_info missing");
 	}
+	if (version != GLASS_FORMAT_VERSION_EXTENDED) {
+	    if (root[table_no].get_compress_codec() != COMPRESSION_ZLIB) {
+		throw Xapian::DatabaseCorruptError("Rev file compression "
+						   "codec not valid for "
+						   "format version");
+	    }
+	    if (root[table_no].get_checksums()) {
+		throw Xapian::DatabaseCorruptError("Rev file block checksums "
+						   "not valid for format "
+						   "version");
+	    }
+	    if (root[table_no].get_free_list_retains()) {
+		throw Xapian::DatabaseCorruptError("Rev file retained "
+						   "revisions not valid for "
+						   "format version");
+	    }
+	    if (root[table_no].get_packed_positions()) {
+		throw Xapian::DatabaseCorruptError("Rev file packed "
+						   "positions not valid for "
+						   "format version");
+	    }
+	    if (root[table_no].get_adaptive_chunks()) {
+		throw Xapian::DatabaseCorruptError("Rev file adaptive "
+						   "chunks not valid for "
+						   "format version");
+	    }
+	}
 	old_root[table_no] = root[table_no];
     }
 
@@ -274,6 +315,22 @@ GlassVersion::write(glass_revision_number_t new_rev, int flags)
     LOGCALL(DB, const string, "GlassVersion::write", new_rev|flags);
 
     string s(GLASS_VERSION_MAGIC, GLASS_VERSION_MAGIC_AND_VERSION_LEN);
+    for (unsigned table_no = 0; table_no < Glass::MAX_; ++table_no) {
+	if (root[table_no].get_compress_codec() != COMPRESSION_ZLIB ||
+	    root[table_no].get_checksums() ||
+	    root[table_no].get_free_list_retains() ||
+	    root[table_no].get_packed_positions() ||
+	    root[table_no].get_adaptive_chunks()) {
+	    // Older releases can't read tables using other codecs, with block
+	    // checksums, with retained revisions in the freelist, with
+	    // bit-packed position lists, or with adaptive posting list chunks.
+	    s[GLASS_VERSION_MAGIC_LEN] =
+		char((GLASS_FORMAT_VERSION_EXTENDED >> 8) & 0xff);
+	    s[GLASS_VERSION_MAGIC_LEN + 1] =
+		char(GLASS_FORMAT_VERSION_EXTENDED & 0xff);
+	    break;
+	}
+    }
     s.append(uuid.data(), uuid.BINARY_SIZE);
 
     pack_uint(s, new_rev);
@@ -414,19 +471,49 @@ static const uint4 compress_min_tab[] = {
 };
 
 void
-GlassVersion::create(unsigned blocksize)
+GlassVersion::create(unsigned blocksize, int flags)
 {
     AssertRel(blocksize,>=,GLASS_MIN_BLOCKSIZE);
+    unsigned codec = COMPRESSION_ZLIB;
+    switch (flags & Xapian::DB_COMPRESS_MASK_) {
+	case 0:
+	    break;
+	case Xapian::DB_COMPRESS_ZSTD:
+	    codec = COMPRESSION_ZSTD;
+	    break;
+	case Xapian::DB_COMPRESS_LZ4:
+	    codec = COMPRESSION_LZ4;
+	    break;
+	default:
+	    throw Xapian::InvalidArgumentError("DB_COMPRESS_ZSTD and "
+					       "DB_COMPRESS_LZ4 can't both be "
+					       "specified");
+    }
+    if (!CompressionStream::codec_available(codec)) {
+	throw Xapian::FeatureUnavailableError(codec == COMPRESSION_ZSTD ?
+	    "zstd compression support not compiled in" :
+	    "LZ4 compression support not compiled in");
+    }
+    bool checksums = (flags & Xapian::DB_BLOCK_CHECKSUMS);
+    bool packed_positions = (flags & Xapian::DB_PACKED_POSITIONS);
+    bool adaptive_chunks = (flags & Xapian::DB_ADAPTIVE_CHUNKS);
     uuid.generate();
     for (unsigned table_no = 0; table_no < Glass::MAX_; ++table_no) {
-	root[table_no].init(blocksize, compress_min_tab[table_no]);
+	uint4 compress_min = compress_min_tab[table_no];
+	// Only record a codec for tables which are compressed.
+	root[table_no].init(blocksize, compress_min, compress_min ? codec : 0,
+			    checksums,
+			    packed_positions && table_no == Glass::POSITION,
+			    adaptive_chunks && table_no == Glass::POSTLIST);
     }
 }
 
 namespace Glass {
 
 void
-RootInfo::init(unsigned blocksize_, uint4 compress_min_)
+RootInfo::init(unsigned blocksize_, uint4 compress_min_,
+	       unsigned compress_codec_, bool checksums_,
+	       bool packed_positions_, bool adaptive_chunks_)
 {
     AssertRel(blocksize_,>=,GLASS_MIN_BLOCKSIZE);
     root = 0;
@@ -436,6 +523,11 @@ RootInfo::init(unsigned blocksize_, uint4 compress_min_)
     sequential = true;
     blocksize = blocksize_;
     compress_min = compress_min_;
+    compress_codec = compress_codec_;
+    checksums = checksums_;
+    fl_retains = false;
+    packed_positions = packed_positions_;
+    adaptive_chunks = adaptive_chunks_;
     fl_serialised.resize(0);
 }
 
@@ -449,7 +541,15 @@ RootInfo::serialise(string &s) const
     pack_uint(s, val);
     pack_uint(s, num_entries);
     pack_uint(s, blocksize >> 11);
-    pack_uint(s, compress_min);
+    // The codec and the checksums, retained revisions, packed positions and
+    // adaptive chunks flags are stored in the top bits of compress_min, which
+    // means the encoding is unchanged when none of these features are used.
+    uint4 val_compress = compress_min | (compress_codec << 24);
+    if (checksums) val_compress |= 0x10000000;
+    if (fl_retains) val_compress |= 0x20000000;
+    if (packed_positions) val_compress |= 0x40000000;
+    if (adaptive_chunks) val_compress |= 0x80000000;
+    pack_uint(s, val_compress);
     pack_string(s, fl_serialised);
 }
 
@@ -468,6 +568,13 @@ RootInfo::unserialise(const char ** p, const char * end)
     root_is_fake = val & 0x01;
     blocksize <<= 11;
     AssertRel(blocksize,>=,GLASS_MIN_BLOCKSIZE);
+    checksums = (compress_min & 0x10000000);
+    fl_retains = (compress_min & 0x20000000);
+    packed_positions = (compress_min & 0x40000000);
+    adaptive_chunks = (compress_min & 0x80000000);
+    compress_codec = (compress_min >> 24) & 0x0f;
+    compress_min &= 0xffffff;
+    if (compress_codec >= unsigned(COMPRESSION_MAX_)) return false;
     // Map old default to new default.
     if (compress_min == 4) {
 	compress_min = COMPRESS_MIN;
@@ -47,10 +47,23 @@ class RootInfo {
     unsigned blocksize;
     /// Should be >= 4 or 0 for no compression.
     uint4 compress_min;
+    /// Compression codec (one of the COMPRESSION_* constants).
+    unsigned compress_codec;
+    /// Does each block end with a checksum?
+    bool checksums;
+    /// Does the freelist keep blocks for readers of older revisions?
+    bool fl_retains;
+    /// Are position lists stored bit-packed?  (Only for the position table.)
+    bool packed_positions;
+    /// Are chunks sized by term frequency?  (Only for the postlist table.)
+    bool adaptive_chunks;
     std::string fl_serialised;
 
   public:
-    void init(unsigned blocksize_, uint4 compress_min_);
+    void init(unsigned blocksize_, uint4 compress_min_,
+	      unsigned compress_codec_ = 0, bool checksums_ = false,
+	      bool packed_positions_ = false,
+	      bool adaptive_chunks_ = false);
 
     void serialise(std::string &s) const;
 
@@ -67,6 +80,11 @@ class RootInfo {
 	return blocksize;
     }
     uint4 get_compress_min() const { return compress_min; }
+    unsigned get_compress_codec() const { return compress_codec; }
+    bool get_checksums() const { return checksums; }
+    bool get_free_list_retains() const { return fl_retains; }
+    bool get_packed_positions() const { return packed_positions; }
+    bool get_adaptive_chunks() const { return adaptive_chunks; }
     const std::string & get_free_list() const { return fl_serialised; }
 
     void set_level(int level_) { level = unsigned(level_); }
@@ -79,7 +97,10 @@ class RootInfo {
 	AssertRel(b,<=,GLASS_MAX_BLOCKSIZE);
 	blocksize = b;
     }
-    void set_free_list(const std::string & s) { fl_serialised = s; }
+    void set_free_list(const std::string & s, bool retains = false) {
+	fl_serialised = s;
+	fl_retains = retains;
+    }
 };
 
 }
@@ -168,8 +189,18 @@ class GlassVersion {
 
     ~GlassVersion();
 
-    /** Create the version file. */
-    void create(unsigned blocksize);
+    /** Create the version file.
+     *
+     *  @param blocksize	The blocksize to use for the tables.
+     *  @param flags	Xapian::DB_COMPRESS_ZSTD or Xapian::DB_COMPRESS_LZ4
+     *			select the codec to use for the tables which are
+     *			compressed (by default zlib is used).
+     *			Xapian::DB_BLOCK_CHECKSUMS,
+     *			Xapian::DB_PACKED_POSITIONS and
+     *			Xapian::DB_ADAPTIVE_CHUNKS are also recorded.
+     *			Other bits are ignored.
+     */
+    void create(unsigned blocksize, int flags = 0);
 
     void set_changes(GlassChanges * changes_) { changes = changes_; }
 
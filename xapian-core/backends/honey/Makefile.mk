@@ -5,6 +5,7 @@ if BUILD_BACKEND_HONEY
 noinst_HEADERS +=\
 	backends/honey/honey_alldocspostlist.h\
 	backends/honey/honey_alltermslist.h\
+	backends/honey/honey_bloomfilter.h\
 	backends/honey/honey_check.h\
 	backends/honey/honey_cursor.h\
 	backends/honey/honey_database.h\
@@ -16,6 +17,9 @@ noinst_HEADERS +=\
 	backends/honey/honey_inverter.h\
 	backends/honey/honey_lazytable.h\
 	backends/honey/honey_metadata.h\
+	backends/honey/honey_overlay.h\
+	backends/honey/honey_overlaylists.h\
+	backends/honey/honey_packedpostings.h\
 	backends/honey/honey_positionlist.h\
 	backends/honey/honey_postlist.h\
 	backends/honey/honey_postlist_encodings.h\
@@ -33,6 +37,7 @@ noinst_HEADERS +=\
 lib_src +=\
 	backends/honey/honey_alldocspostlist.cc\
 	backends/honey/honey_alltermslist.cc\
+	backends/honey/honey_bloomfilter.cc\
 	backends/honey/honey_check.cc\
 	backends/honey/honey_compact.cc\
 	backends/honey/honey_cursor.cc\
@@ -42,6 +47,9 @@ lib_src +=\
 	backends/honey/honey_freelist.cc\
 	backends/honey/honey_inverter.cc\
 	backends/honey/honey_metadata.cc\
+	backends/honey/honey_overlay.cc\
+	backends/honey/honey_overlaylists.cc\
+	backends/honey/honey_packedpostings.cc\
 	backends/honey/honey_positionlist.cc\
 	backends/honey/honey_postlist.cc\
 	backends/honey/honey_postlisttable.cc\
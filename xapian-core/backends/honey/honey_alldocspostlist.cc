@@ -228,13 +228,12 @@ DocLenChunkReader::update(HoneyCursor* cursor)
     Xapian::docid last_did = docid_from_key(cursor->current_key);
     if (!last_did) return false;
 
-    cursor->read_tag();
-
-    size_t len = cursor->current_tag.size();
+    size_t len;
+    const char* tag = cursor->read_tag_view(len);
     if (rare(len == 0))
 	throw Xapian::DatabaseCorruptError("Doclen data chunk is empty");
 
-    p = reinterpret_cast<const unsigned char*>(cursor->current_tag.data());
+    p = reinterpret_cast<const unsigned char*>(tag);
     end = p + len;
     width = *p++;
     if (((width - 8) &~ 0x18) != 0) {
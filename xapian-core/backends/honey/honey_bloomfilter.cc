@@ -0,0 +1,124 @@
+/** @file
+ * @brief Blocked Bloom filter over the keys in a honey table.
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "honey_bloomfilter.h"
+
+#include "xapian/error.h"
+
+#include "wordaccess.h"
+
+using namespace std;
+
+/** Bits per key to size the filter for.
+ *
+ *  With 16 bits per key, about 0.1% of keys which aren't present pass the
+ *  filter.
+ */
+static const unsigned BITS_PER_KEY = 16;
+
+/// Odd constants used to pick the bit set in each word of a block.
+static const uint32_t salt[8] = {
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+    0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U
+};
+
+/** Hash a key.
+ *
+ *  This is stored on disk (in effect), so must not change.  We use 64-bit
+ *  FNV-1a followed by the finaliser from MurmurHash3 to mix the bits well.
+ */
+static uint64_t
+hash_key(const string& key)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (unsigned char ch : key) {
+	h ^= ch;
+	h *= 0x100000001b3ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/// Which block a hash maps to.
+static inline uint32_t
+block_for_hash(uint64_t h, uint32_t n_blocks)
+{
+    return uint32_t(((h >> 32) * n_blocks) >> 32);
+}
+
+namespace Honey {
+
+void
+BloomFilterBuilder::add(const string& key)
+{
+    hashes.push_back(hash_key(key));
+}
+
+void
+BloomFilterBuilder::encode(string& out) const
+{
+    uint64_t n = (uint64_t(hashes.size()) * BITS_PER_KEY + 255) / 256;
+    if (n == 0) n = 1;
+    if (n > 0xffffffff)
+	throw Xapian::DatabaseError("Too many keys for Bloom filter");
+    uint32_t n_blocks = uint32_t(n);
+    vector<uint32_t> words(size_t(n_blocks) * 8);
+    for (uint64_t h : hashes) {
+	uint32_t* block = &words[size_t(block_for_hash(h, n_blocks)) * 8];
+	uint32_t k = uint32_t(h);
+	for (int i = 0; i != 8; ++i) {
+	    block[i] |= uint32_t(1) << ((k * salt[i]) >> 27);
+	}
+    }
+
+    size_t o = out.size();
+    out.resize(o + 4 + BloomFilter::encoded_size(n_blocks));
+    auto p = reinterpret_cast<unsigned char*>(&out[o]);
+    unaligned_write4(p, n_blocks);
+    p += 4;
+    for (uint32_t word : words) {
+	unaligned_write4(p, word);
+	p += 4;
+    }
+}
+
+bool
+BloomFilter::may_contain(const string& key) const
+{
+    if (n_blocks == 0) return true;
+    uint64_t h = hash_key(key);
+    const unsigned char* block =
+	blocks + size_t(block_for_hash(h, n_blocks)) * 32;
+    uint32_t k = uint32_t(h);
+    uint32_t missing = 0;
+    for (int i = 0; i != 8; ++i) {
+	uint32_t bit = uint32_t(1) << ((k * salt[i]) >> 27);
+	missing |= ~unaligned_read4(block + i * 4) & bit;
+    }
+    return missing == 0;
+}
+
+}
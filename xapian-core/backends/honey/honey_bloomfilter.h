@@ -0,0 +1,118 @@
+/** @file
+ * @brief Blocked Bloom filter over the keys in a honey table.
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_HONEY_BLOOMFILTER_H
+#define XAPIAN_INCLUDED_HONEY_BLOOMFILTER_H
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+/* A table built with Xapian::DB_BLOOM_FILTERS has a filter over all its keys
+ * stored after the index, which lets lookups of most keys which aren't
+ * present return without reading the table.
+ *
+ * The filter is a "split block" Bloom filter: the bits are divided into
+ * blocks of 256 bits (so a block fits well within a cache line), and each key
+ * sets one bit in each of the eight 32-bit words of a single block chosen by
+ * a hash of the key.  So checking a key touches one block, and the bits to
+ * test can be computed without data-dependent branches.
+ *
+ * The encoded filter is:
+ *
+ *   - The number of blocks as a 4 byte big-endian value.
+ *   - The blocks, each as eight 4 byte big-endian words.
+ */
+
+namespace Honey {
+
+/// Build a Bloom filter over a set of keys.
+class BloomFilterBuilder {
+    /// Hashes of the keys added.
+    std::vector<uint64_t> hashes;
+
+  public:
+    /// Add a key to the filter.
+    void add(const std::string& key);
+
+    /** Encode the filter.
+     *
+     *  @param out	String to append the encoded filter to.
+     */
+    void encode(std::string& out) const;
+};
+
+/// Check keys against a Bloom filter.
+class BloomFilter {
+    /// The encoded blocks.
+    const unsigned char* blocks = nullptr;
+
+    /// The number of blocks.
+    uint32_t n_blocks = 0;
+
+    /// Storage for the encoded filter if it isn't read from a mapped file.
+    std::string storage;
+
+  public:
+    /// Is there a filter to check?
+    bool empty() const { return n_blocks == 0; }
+
+    /// Return the number of bytes of memory used to hold a copy of the filter.
+    size_t get_memory_used() const { return storage.size(); }
+
+    /** Set the filter to use.
+     *
+     *  @param data	The encoded blocks (without the leading block count).
+     *			The data must remain valid while this object is in
+     *			use.
+     *  @param n	The number of blocks.
+     */
+    void init(const char* data, uint32_t n) {
+	blocks = reinterpret_cast<const unsigned char*>(data);
+	n_blocks = n;
+    }
+
+    /** Set the filter to use from a copy of its encoded blocks.
+     *
+     *  @param data	The encoded blocks (without the leading block count).
+     *  @param n	The number of blocks.
+     */
+    void init(std::string&& data, uint32_t n) {
+	storage = std::move(data);
+	init(storage.data(), n);
+    }
+
+    /** Might @a key be present?
+     *
+     *  If there isn't a filter, this always returns true.
+     */
+    bool may_contain(const std::string& key) const;
+
+    /** The size of an encoded filter with @a n blocks.
+     *
+     *  This doesn't include the leading block count.
+     */
+    static size_t encoded_size(uint32_t n) { return size_t(n) * 32; }
+};
+
+}
+
+#endif // XAPIAN_INCLUDED_HONEY_BLOOMFILTER_H
@@ -27,25 +27,39 @@
 #include "xapian/types.h"
 
 #include <algorithm>
+#include <exception>
+#include <functional>
 #include <memory>
 #include <queue>
+#include <system_error>
+#ifdef HAVE_STD_THREAD
+# include <thread>
+#endif
 #include <type_traits>
 
 #include <cerrno>
 #include <cstdio>
 
+#include "backends/databasehelpers.h"
 #include "backends/flint_lock.h"
 #include "compression_stream.h"
 #include "honey_cursor.h"
 #include "honey_database.h"
 #include "honey_defs.h"
+#include "honey_overlay.h"
+#include "honey_packedpostings.h"
+#include "honey_positionlist.h"
+#include "honey_postlist.h"
 #include "honey_postlist_encodings.h"
 #include "honey_table.h"
 #include "honey_values.h"
 #include "honey_version.h"
 #include "filetests.h"
+#include "fileutils.h"
 #include "internaltypes.h"
 #include "pack.h"
+#include "safesysstat.h"
+#include "safeunistd.h"
 #include "backends/valuestats.h"
 #include "wordaccess.h"
 
@@ -75,6 +89,142 @@ throw_database_corrupt(const char* item, const char* pos)
     throw Xapian::DatabaseCorruptError(message);
 }
 
+/** Document lengths, used to generate the skip data in posting chunks.
+ *
+ *  We keep the doclen chunks we've written rather than an array indexed by
+ *  docid, so the memory needed doesn't depend on how sparse the docids are.
+ */
+class DocLens {
+    /// The first docid in each chunk, and the chunk's tag.
+    vector<pair<Xapian::docid, string>> chunks;
+
+  public:
+    /** Add a doclen chunk.
+     *
+     *  Chunks must be added in ascending docid order.
+     */
+    void add_chunk(Xapian::docid lastdid, string&& tag) {
+	size_t n = (tag.size() - 1) / (tag[0] / 8);
+	chunks.emplace_back(lastdid - n + 1, std::move(tag));
+    }
+
+    /** Look up a document length.
+     *
+     *  @param did	The docid to look up.
+     *  @param hint	Index of the chunk to start looking in, which is
+     *			updated to the chunk @a did is in.  Successive lookups
+     *			with the same @a hint in ascending docid order only
+     *			need to search forwards.
+     *
+     *  @return The document length, or 0 if it's not known.
+     */
+    Xapian::termcount get(Xapian::docid did, size_t& hint) const {
+	if (hint >= chunks.size() || chunks[hint].first > did) {
+	    hint = 0;
+	}
+	if (hint + 1 < chunks.size() && chunks[hint + 1].first <= did) {
+	    auto i = upper_bound(chunks.begin() + hint + 1, chunks.end(), did,
+				 [](Xapian::docid d,
+				    const pair<Xapian::docid, string>& c) {
+				     return d < c.first;
+				 });
+	    hint = (i - chunks.begin()) - 1;
+	}
+	if (hint >= chunks.size() || chunks[hint].first > did) return 0;
+
+	const string& tag = chunks[hint].second;
+	size_t byte_width = tag[0] / 8;
+	size_t offset = 1 + size_t(did - chunks[hint].first) * byte_width;
+	if (offset >= tag.size()) return 0;
+	const unsigned char* d =
+	    reinterpret_cast<const unsigned char*>(tag.data()) + offset;
+	Xapian::termcount doclen = 0;
+	for (size_t w = 0; w != byte_width; ++w) {
+	    doclen = (doclen << 8) | *d++;
+	}
+	return doclen;
+    }
+};
+
+/** Add skip data to the posting data after the chunk header in @a tag.
+ *
+ *  The posting data is split into blocks of Honey::PACKED_POSTINGS_BLOCK
+ *  entries, and the skip data has an entry for each block giving the last
+ *  docid in the block (as a delta from the previous block's last docid, or
+ *  from the chunk's first docid for the first block), the size of the
+ *  block's posting data in bytes, the maximum wdf in the block (only if wdfs
+ *  are explicitly stored) and the minimum document length in the block, each
+ *  packed with pack_uint().  The skip data is preceded by its size in bytes,
+ *  also packed with pack_uint().
+ *
+ *  This allows a reader to skip over whole blocks without decoding them,
+ *  either because they end before the docid being skipped to or because they
+ *  can't contain a document with a high enough weight.
+ *
+ *  @param tag		The chunk, which will be updated in place.
+ *  @param header_len	The size of the chunk header.
+ *  @param did		The first docid in the chunk.
+ *  @param have_wdfs	Are wdfs explicitly stored?
+ *  @param packed	Should the posting data be converted to the packed
+ *			encoding too?
+ *  @param doclens	Document lengths.
+ */
+static void
+add_skip_data(string& tag, size_t header_len, Xapian::docid did,
+	      bool have_wdfs, bool packed, const DocLens& doclens)
+{
+    if (tag.size() == header_len) return;
+    string data(tag, header_len);
+    tag.resize(header_len);
+    const char* start = data.data();
+    const char* end = start + data.size();
+
+    vector<size_t> block_sizes;
+    string packed_data;
+    if (packed) {
+	Honey::pack_postings(start, end, have_wdfs, packed_data, &block_sizes);
+    }
+
+    string skip;
+    const char* p = start;
+    Xapian::docid prev_last = did;
+    size_t block = 0;
+    size_t doclen_hint = 0;
+    while (p != end) {
+	const char* block_start = p;
+	Xapian::termcount wdf_max = 0;
+	Xapian::termcount doclen_min = Xapian::termcount(-1);
+	unsigned n = 0;
+	do {
+	    Xapian::docid delta;
+	    Xapian::termcount wdf;
+	    if (!unpack_uint(&p, end, &delta) ||
+		(have_wdfs && !unpack_uint(&p, end, &wdf))) {
+		throw Xapian::DatabaseCorruptError("Bad postlist chunk data");
+	    }
+	    did += delta + 1;
+	    if (have_wdfs) wdf_max = max(wdf_max, wdf);
+	    // Zero is a safe lower bound if the length is somehow missing.
+	    Xapian::termcount doclen = doclens.get(did, doclen_hint);
+	    doclen_min = min(doclen_min, doclen);
+	} while (++n != Honey::PACKED_POSTINGS_BLOCK && p != end);
+
+	pack_uint(skip, did - prev_last - 1);
+	pack_uint(skip, packed ? block_sizes[block++] : size_t(p - block_start));
+	if (have_wdfs) pack_uint(skip, wdf_max);
+	pack_uint(skip, doclen_min);
+	prev_last = did;
+    }
+
+    pack_uint(tag, skip.size());
+    tag += skip;
+    if (packed) {
+	tag += packed_data;
+    } else {
+	tag += data;
+    }
+}
+
 #ifdef XAPIAN_HAS_GLASS_BACKEND
 namespace GlassCompact {
 
@@ -102,6 +252,22 @@ is_doclenchunk_key(const string& key)
     return key.size() > 1 && key[0] == '\0' && key[1] == '\xe0';
 }
 
+/** Skip any skip data in the header of a glass posting list chunk.
+ *
+ *  @param flags	The first byte of the chunk header.
+ */
+static void
+skip_chunk_skips(const char** p, const char* end, char flags)
+{
+    if (flags & 2) {
+	size_t len;
+	if (!unpack_uint(p, end, &len) || len > size_t(end - *p))
+	    throw Xapian::DatabaseCorruptError("Bad skip data in glass "
+					       "posting chunk");
+	*p += len;
+    }
+}
+
 }
 
 static inline bool
@@ -170,6 +336,14 @@ class PostlistCursor<const GlassTable&> : private GlassCursor {
 	rewind();
     }
 
+    /** Start from the first entry with key >= @a start.
+     *
+     *  Call next() to move to that entry.
+     */
+    void start_at(const string& start) {
+	find_entry_lt(start);
+    }
+
     bool next() {
 	if (!GlassCursor::next()) return false;
 	// We put all chunks into the non-initial chunk form here, then fix up
@@ -277,11 +451,12 @@ class PostlistCursor<const GlassTable&> : private GlassCursor {
 	    if (d == e)
 		throw Xapian::DatabaseCorruptError("No last chunk flag in "
 						   "glass docdata chunk");
-	    ++d;
+	    char flags = *d++;
 	    Xapian::docid increase_to_last;
 	    if (!unpack_uint(&d, e, &increase_to_last))
 		throw Xapian::DatabaseCorruptError("Decoding last docid delta "
 						   "in glass docdata chunk");
+	    GlassCompact::skip_chunk_skips(&d, e, flags);
 
 	    Xapian::termcount doclen_max = 0;
 	    while (true) {
@@ -385,11 +560,12 @@ class PostlistCursor<const GlassTable&> : private GlassCursor {
 	if (d == e)
 	    throw Xapian::DatabaseCorruptError("No last chunk flag in glass "
 					       "posting chunk");
-	++d;
+	char flags = *d++;
 	Xapian::docid increase_to_last;
 	if (!unpack_uint(&d, e, &increase_to_last))
 	    throw Xapian::DatabaseCorruptError("Decoding last docid delta in "
 					       "glass posting chunk");
+	GlassCompact::skip_chunk_skips(&d, e, flags);
 	chunk_lastdid = firstdid + increase_to_last;
 	if (!unpack_uint(&d, e, &first_wdf))
 	    throw Xapian::DatabaseCorruptError("Decoding first wdf in glass "
@@ -444,6 +620,30 @@ template<>
 class PostlistCursor<const HoneyTable&> : private HoneyCursor {
     Xapian::docid offset;
 
+    /// Is the posting data in the input packed?
+    bool packed;
+
+    /** Convert the posting data in tag to the usual encoding.
+     *
+     *  The skip data is removed, and packed posting data is unpacked.
+     */
+    void unpack_tag() {
+	if (tag.empty()) return;
+	const char* p = tag.data();
+	const char* end = p + tag.size();
+	size_t skip_len;
+	if (!unpack_uint(&p, end, &skip_len) || skip_len > size_t(end - p))
+	    throw Xapian::DatabaseCorruptError("Bad postlist skip data");
+	p += skip_len;
+	if (!packed) {
+	    tag.erase(0, p - tag.data());
+	    return;
+	}
+	string data;
+	Honey::unpack_postings(p, end, have_wdfs, data);
+	swap(data, tag);
+    }
+
   public:
     string key, tag;
     Xapian::docid firstdid;
@@ -454,7 +654,8 @@ class PostlistCursor<const HoneyTable&> : private HoneyCursor {
     bool have_wdfs;
 
     PostlistCursor(const HoneyTable* in, Xapian::docid offset_)
-	: HoneyCursor(in), offset(offset_), firstdid(0)
+	: HoneyCursor(in), offset(offset_),
+	  packed(in->get_packed_postings()), firstdid(0)
     {
 	rewind();
     }
@@ -590,6 +791,7 @@ class PostlistCursor<const HoneyTable&> : private HoneyCursor {
 	    }
 	    tag.erase(0, d - tag.data());
 	}
+	unpack_tag();
 	firstdid += offset;
 	chunk_lastdid += offset;
 	return true;
@@ -603,6 +805,440 @@ class PostlistCursor<HoneyTable&> : public PostlistCursor<const HoneyTable&> {
 	: PostlistCursor<const HoneyTable&>(in, offset_) {}
 };
 
+/// The postlist tables to merge for a honey database with an overlay.
+struct HoneyOverlayPostlists {
+    /// The postlist table of the honey database.
+    const HoneyTable* base;
+
+    /// The postlist table of the delta, converted to honey.
+    const HoneyTable* delta;
+
+    /// The overlay, which tells us which docids in @a base are masked.
+    const HoneyOverlayDatabase* overlay;
+};
+
+/// Return the slot from a value stats key.
+static Xapian::valueno
+valuestats_slot(const string& key)
+{
+    unsigned char code = key[1];
+    if (code < Honey::KEY_VALUE_STATS_HI || key.size() == 2) {
+	return code - Honey::KEY_VALUE_STATS;
+    }
+    const char* p = key.data() + 2;
+    const char* end = key.data() + key.size();
+    Xapian::valueno slot;
+    if (!unpack_uint_preserving_sort(&p, end, &slot) || p != end)
+	throw Xapian::DatabaseCorruptError("Bad value stats key");
+    return slot;
+}
+
+/// Return the slot from a value chunk key.
+static Xapian::valueno
+valuechunk_slot(const string& key)
+{
+    unsigned char code = key[1];
+    if (code != Honey::KEY_VALUE_CHUNK_HI) {
+	return code - Honey::KEY_VALUE_CHUNK;
+    }
+    const char* p = key.data() + 2;
+    const char* end = key.data() + key.size();
+    Xapian::valueno slot;
+    if (!unpack_uint_preserving_sort(&p, end, &slot))
+	throw Xapian::DatabaseCorruptError("Bad value key");
+    return slot;
+}
+
+/** Merge the postlist table of a honey database with its overlay's delta.
+ *
+ *  The docids of the two interleave and the masked documents need dropping
+ *  from the honey database, so we can't just pass chunks through as we do
+ *  when merging databases with disjoint docid ranges.  Instead we merge the
+ *  entries for each value slot, the document lengths, and the postings for
+ *  each term into new chunks, which we return in the same form as
+ *  PostlistCursor<const HoneyTable&> so merge_postlists() can write them out
+ *  as usual.
+ *
+ *  The value statistics come from the overlay, since the bounds can't be
+ *  adjusted for the masked documents.
+ */
+template<>
+class PostlistCursor<const HoneyOverlayPostlists&> {
+    /// One of the two inputs, with the entries from its current chunk.
+    struct Input {
+	/// Cursor on the input, or NULL once it's exhausted.
+	unique_ptr<PostlistCursor<const HoneyTable&>> cursor;
+
+	/// The overlay to drop masked docids for, or NULL for the delta.
+	const HoneyOverlayDatabase* overlay;
+
+	/// The document lengths or postings from the chunk last read.
+	vector<pair<Xapian::docid, Xapian::termcount>> counts;
+
+	/// The values from the chunk last read.
+	vector<pair<Xapian::docid, string>> values;
+
+	/** Index of the next unused entry in counts or values.
+	 *
+	 *  Both are emptied once the entries for the slot, the document
+	 *  lengths or the term run out, so this applies to whichever is in use.
+	 */
+	size_t pos = 0;
+
+	/// The wdf of postings for the current term which isn't stored.
+	Xapian::termcount implicit_wdf = 0;
+
+	/// The key of the chunk the buffered entries came from.
+	string chunk_key;
+
+	Input(const HoneyTable* table, const HoneyOverlayDatabase* overlay_)
+	    : cursor(new PostlistCursor<const HoneyTable&>(table, 0)),
+	      overlay(overlay_)
+	{
+	    if (!cursor->next()) cursor.reset();
+	}
+
+	/// Are there entries from an earlier chunk still to use?
+	bool buffered() const {
+	    return pos < counts.size() || pos < values.size();
+	}
+
+	/// The Honey::KEY_* type of the current entry (or -1 at the end).
+	int type() const {
+	    if (buffered()) return key_type(chunk_key);
+	    return cursor ? key_type(cursor->key) : -1;
+	}
+
+	/// The current key.
+	const string& key() const {
+	    return buffered() ? chunk_key : cursor->key;
+	}
+
+	void advance() {
+	    if (!cursor->next()) cursor.reset();
+	}
+
+	bool masked(Xapian::docid did) const {
+	    return overlay && !overlay->in_base(did);
+	}
+
+	/// Ensure there's a value for @a slot buffered, if there are any more.
+	bool fill_values(Xapian::valueno slot) {
+	    while (pos == values.size()) {
+		if (type() != Honey::KEY_VALUE_CHUNK ||
+		    valuechunk_slot(key()) != slot) {
+		    values.clear();
+		    pos = 0;
+		    return false;
+		}
+		values.clear();
+		pos = 0;
+		const string& tag = cursor->tag;
+		Xapian::docid last_did = Honey::docid_from_key(slot, key());
+		Honey::ValueChunkReader reader(tag.data(), tag.size(),
+					       last_did);
+		for ( ; !reader.at_end(); reader.next()) {
+		    Xapian::docid did = reader.get_docid();
+		    if (!masked(did)) {
+			values.emplace_back(did, reader.get_value());
+		    }
+		}
+		chunk_key = cursor->key;
+		advance();
+	    }
+	    return true;
+	}
+
+	/// Ensure there's a document length buffered, if there are any more.
+	bool fill_doclens() {
+	    while (pos == counts.size()) {
+		if (type() != Honey::KEY_DOCLEN_CHUNK) {
+		    counts.clear();
+		    pos = 0;
+		    return false;
+		}
+		counts.clear();
+		pos = 0;
+		const string& tag = cursor->tag;
+		size_t byte_width = tag[0] / 8;
+		Xapian::docid did = cursor->firstdid;
+		for (size_t i = 1; i + byte_width <= tag.size();
+		     i += byte_width, ++did) {
+		    Xapian::termcount doclen = 0;
+		    bool missing = true;
+		    for (size_t w = 0; w != byte_width; ++w) {
+			unsigned char ch = tag[i + w];
+			if (ch != 0xff) missing = false;
+			doclen = (doclen << 8) | ch;
+		    }
+		    if (!missing && !masked(did)) {
+			counts.emplace_back(did, doclen);
+		    }
+		}
+		chunk_key = cursor->key;
+		advance();
+	    }
+	    return true;
+	}
+
+	/// Ensure there's a posting for @a term buffered, if there are any more.
+	bool fill_postings(const string& term_key) {
+	    while (pos == counts.size()) {
+		if (type() != Honey::KEY_POSTING_CHUNK || key() != term_key) {
+		    counts.clear();
+		    pos = 0;
+		    return false;
+		}
+		counts.clear();
+		pos = 0;
+		const auto& c = *cursor;
+		Xapian::docid did = c.firstdid;
+		Xapian::termcount wdf;
+		if (c.tf) {
+		    // The initial chunk for the term.
+		    if (c.tf > 1)
+			implicit_wdf = (c.cf - c.first_wdf) / (c.tf - 1);
+		    wdf = c.first_wdf;
+		} else {
+		    wdf = c.have_wdfs ? c.first_wdf : implicit_wdf;
+		}
+		if (!masked(did)) counts.emplace_back(did, wdf);
+		if (c.tf == 2) {
+		    // The second posting isn't explicitly stored.
+		    did = c.chunk_lastdid;
+		    if (!masked(did)) counts.emplace_back(did, implicit_wdf);
+		}
+		const char* p = c.tag.data();
+		const char* end = p + c.tag.size();
+		while (p != end) {
+		    Xapian::docid delta;
+		    if (!unpack_uint(&p, end, &delta) ||
+			(c.have_wdfs && !unpack_uint(&p, end, &wdf))) {
+			throw Xapian::DatabaseCorruptError("Bad postlist "
+							   "chunk data");
+		    }
+		    if (!c.have_wdfs) wdf = implicit_wdf;
+		    did += delta + 1;
+		    if (!masked(did)) counts.emplace_back(did, wdf);
+		}
+		chunk_key = cursor->key;
+		advance();
+	    }
+	    return true;
+	}
+    };
+
+    Input base, delta;
+
+    Xapian::docid offset;
+
+    const HoneyOverlayDatabase* overlay;
+
+    /** Return the input whose next entry of type @a type has the lower key.
+     *
+     *  Returns @a delta if the keys are the same.
+     */
+    Input& lower_key(int type) {
+	if (base.type() != type) return delta;
+	if (delta.type() != type) return base;
+	return base.key() < delta.key() ? base : delta;
+    }
+
+    /// Return the input with the lower buffered docid, given which have one.
+    template<typename V>
+    Input& lower_docid(bool in_base, bool in_delta, V Input::* entries) {
+	if (!in_delta) return base;
+	if (!in_base) return delta;
+	const auto& b = (base.*entries)[base.pos];
+	const auto& d = (delta.*entries)[delta.pos];
+	return b.first < d.first ? base : delta;
+    }
+
+    bool next_metadata() {
+	Input& in = lower_key(Honey::KEY_USER_METADATA);
+	key = in.key();
+	tag = in.cursor->tag;
+	if (&in == &delta && base.type() == Honey::KEY_USER_METADATA &&
+	    base.key() == key) {
+	    // The delta's entry overrides the honey database's.
+	    base.advance();
+	}
+	in.advance();
+	// Drop the entries which record masked docids.
+	return &in == &base ||
+	       !HoneyOverlayDatabase::is_mask_key(key.substr(2));
+    }
+
+    bool next_valuestats() {
+	key = lower_key(Honey::KEY_VALUE_STATS).key();
+	for (Input* in : { &base, &delta }) {
+	    if (in->type() == Honey::KEY_VALUE_STATS && in->key() == key)
+		in->advance();
+	}
+	Xapian::valueno slot = valuestats_slot(key);
+	Xapian::doccount freq = overlay->get_value_freq(slot);
+	if (freq == 0) return false;
+	tag = encode_valuestats(freq,
+				overlay->get_value_lower_bound(slot),
+				overlay->get_value_upper_bound(slot));
+	return true;
+    }
+
+    bool next_values() {
+	Xapian::valueno slot =
+	    valuechunk_slot(lower_key(Honey::KEY_VALUE_CHUNK).key());
+	string data;
+	Xapian::docid first_did = 0, last_did = 0;
+	while (data.size() < HONEY_POSTLIST_CHUNK_MAX) {
+	    bool in_base = base.fill_values(slot);
+	    bool in_delta = delta.fill_values(slot);
+	    if (!in_base && !in_delta) break;
+	    Input& in = lower_docid(in_base, in_delta, &Input::values);
+	    const auto& entry = in.values[in.pos++];
+	    if (first_did == 0) {
+		first_did = entry.first;
+	    } else {
+		pack_uint(data, entry.first - last_did - 1);
+	    }
+	    last_did = entry.first;
+	    pack_string(data, entry.second);
+	}
+	// Every value in the slot might have been in a masked document.
+	if (first_did == 0) return false;
+	key = Honey::make_valuechunk_key(slot, last_did + offset);
+	tag.resize(0);
+	pack_uint(tag, last_did - first_did);
+	tag += data;
+	return true;
+    }
+
+    bool next_doclens() {
+	vector<Xapian::termcount> doclens;
+	Xapian::docid first_did = 0;
+	while (doclens.size() < (HONEY_DOCLEN_CHUNK_MAX - 1) / 4) {
+	    bool in_base = base.fill_doclens();
+	    bool in_delta = delta.fill_doclens();
+	    if (!in_base && !in_delta) break;
+	    Input& in = lower_docid(in_base, in_delta, &Input::counts);
+	    Xapian::docid did = in.counts[in.pos].first;
+	    // merge_postlists() joins chunks with gaps between them, so we
+	    // just return runs of consecutive docids.
+	    if (first_did && did != first_did + doclens.size()) break;
+	    if (first_did == 0) first_did = did;
+	    doclens.push_back(in.counts[in.pos++].second);
+	}
+	if (doclens.empty()) return false;
+
+	Xapian::termcount doclen_max = *max_element(doclens.begin(),
+						    doclens.end());
+	if (doclen_max >= 0xffffffff) {
+	    const char* m = "Document length values >= 0xffffffff not "
+			    "currently handled";
+	    throw Xapian::FeatureUnavailableError(m);
+	}
+	// All bytes 0xff is used for a missing document.
+	unsigned byte_width = 1;
+	while (byte_width < 4 &&
+	       doclen_max >= (Xapian::termcount(1) << (byte_width * 8)) - 1) {
+	    ++byte_width;
+	}
+	tag.assign(1, char(byte_width * 8));
+	for (Xapian::termcount doclen : doclens) {
+	    for (unsigned w = byte_width; w != 0; --w) {
+		tag += char(doclen >> ((w - 1) * 8));
+	    }
+	}
+	key.assign(KEY_DOCLEN_PREFIX, 2);
+	firstdid = first_did + offset;
+	chunk_lastdid = firstdid + (doclens.size() - 1);
+	return true;
+    }
+
+    bool next_postings() {
+	string term_key = lower_key(Honey::KEY_POSTING_CHUNK).key();
+	string data;
+	Xapian::docid first_did = 0, last_did = 0;
+	Xapian::doccount n = 0;
+	Xapian::termcount sum = 0;
+	wdf_max = 0;
+	while (data.size() < HONEY_POSTLIST_CHUNK_MAX) {
+	    bool in_base = base.fill_postings(term_key);
+	    bool in_delta = delta.fill_postings(term_key);
+	    if (!in_base && !in_delta) break;
+	    Input& in = lower_docid(in_base, in_delta, &Input::counts);
+	    const auto& entry = in.counts[in.pos++];
+	    Xapian::termcount wdf = entry.second;
+	    if (n == 0) {
+		first_did = entry.first;
+		first_wdf = wdf;
+	    } else {
+		pack_uint(data, entry.first - last_did - 1);
+		pack_uint(data, wdf);
+	    }
+	    last_did = entry.first;
+	    ++n;
+	    sum += wdf;
+	    wdf_max = max(wdf_max, wdf);
+	}
+	// Every posting for the term might have been in a masked document.
+	if (n == 0) return false;
+	key = std::move(term_key);
+	swap(tag, data);
+	firstdid = first_did + offset;
+	chunk_lastdid = last_did + offset;
+	// Each chunk contributes its postings to the totals for the term.
+	tf = n;
+	cf = sum;
+	have_wdfs = true;
+	return true;
+    }
+
+  public:
+    string key, tag;
+    Xapian::docid firstdid;
+    Xapian::docid chunk_lastdid;
+    Xapian::termcount tf, cf;
+    Xapian::termcount first_wdf;
+    Xapian::termcount wdf_max;
+    bool have_wdfs;
+
+    PostlistCursor(const HoneyOverlayPostlists* in, Xapian::docid offset_)
+	: base(in->base, in->overlay), delta(in->delta, NULL),
+	  offset(offset_), overlay(in->overlay), firstdid(0) { }
+
+    bool next() {
+	while (true) {
+	    tf = cf = 0;
+	    int type = min(base.type(), delta.type());
+	    if (type < 0) type = max(base.type(), delta.type());
+	    bool found;
+	    switch (type) {
+		case -1:
+		    return false;
+		case Honey::KEY_USER_METADATA:
+		    found = next_metadata();
+		    break;
+		case Honey::KEY_VALUE_STATS:
+		    found = next_valuestats();
+		    break;
+		case Honey::KEY_VALUE_CHUNK:
+		    found = next_values();
+		    break;
+		case Honey::KEY_DOCLEN_CHUNK:
+		    found = next_doclens();
+		    break;
+		case Honey::KEY_POSTING_CHUNK:
+		    found = next_postings();
+		    break;
+		default:
+		    throw Xapian::DatabaseCorruptError("Bad postlist table "
+						       "key type");
+	    }
+	    if (found) return true;
+	}
+    }
+};
+
 template<typename T>
 class PostlistCursorGt {
   public:
@@ -615,33 +1251,27 @@ class PostlistCursorGt {
     }
 };
 
-// U : vector<HoneyTable*>::const_iterator
-template<typename T, typename U> void
-merge_postlists(Xapian::Compactor* compactor,
-		T* out, vector<Xapian::docid>::const_iterator offset,
-		U b, U e)
+/** Merge the postlist table entries which come before the posting chunks.
+ *
+ *  These are the user metadata, value statistics, value chunks and document
+ *  length chunks.
+ *
+ *  @param pq	The cursors to merge, which are left positioned on the
+ *		first posting chunk (or removed if there aren't any).
+ *  @param doclens	The merged document lengths are added to this.
+ */
+template<typename T, typename Q> void
+merge_postlist_leading_keys(Xapian::Compactor* compactor, T* out, Q& pq,
+			    DocLens& doclens)
 {
-    typedef decltype(**b) table_type; // E.g. HoneyTable
-    typedef PostlistCursor<table_type> cursor_type;
-    typedef PostlistCursorGt<cursor_type> gt_type;
-    priority_queue<cursor_type*, vector<cursor_type*>, gt_type> pq;
-    for ( ; b != e; ++b, ++offset) {
-	auto in = *b;
-	auto cursor = new cursor_type(in, *offset);
-	if (cursor->next()) {
-	    pq.push(cursor);
-	} else {
-	    // Skip empty tables.
-	    delete cursor;
-	}
-    }
+    typedef typename Q::value_type cursor_ptr;
 
     string last_key;
     {
 	// Merge user metadata.
 	vector<string> tags;
 	while (!pq.empty()) {
-	    cursor_type* cur = pq.top();
+	    cursor_ptr cur = pq.top();
 	    const string& key = cur->key;
 	    if (key_type(key) != Honey::KEY_USER_METADATA) break;
 
@@ -697,7 +1327,7 @@ merge_postlists(Xapian::Compactor* compactor,
 	string lbound, ubound;
 
 	while (!pq.empty()) {
-	    cursor_type* cur = pq.top();
+	    cursor_ptr cur = pq.top();
 	    const string& key = cur->key;
 	    if (key_type(key) != Honey::KEY_VALUE_STATS) break;
 	    if (key != last_key) {
@@ -763,7 +1393,7 @@ merge_postlists(Xapian::Compactor* compactor,
 
     // Merge valuestream chunks.
     while (!pq.empty()) {
-	cursor_type* cur = pq.top();
+	cursor_ptr cur = pq.top();
 	const string& key = cur->key;
 	if (key_type(key) != Honey::KEY_VALUE_CHUNK) break;
 	out->add(key, cur->tag);
@@ -777,7 +1407,7 @@ merge_postlists(Xapian::Compactor* compactor,
 
     // Merge doclen chunks.
     while (!pq.empty()) {
-	cursor_type* cur = pq.top();
+	cursor_ptr cur = pq.top();
 	if (key_type(cur->key) != Honey::KEY_DOCLEN_CHUNK) break;
 	string tag = std::move(cur->tag);
 	auto chunk_lastdid = cur->chunk_lastdid;
@@ -824,11 +1454,18 @@ merge_postlists(Xapian::Compactor* compactor,
 		// Partial copy.
 		auto copy_size = new_size - tag.size();
 		tag.append(cur->tag, 1, copy_size);
-		cur->tag.erase(1, copy_size);
-		copy_size /= byte_width;
-		cur->firstdid += copy_size;
 		chunk_lastdid += gap_size;
-		chunk_lastdid += copy_size;
+		chunk_lastdid += copy_size / byte_width;
+		// The rest of the chunk mustn't start with a gap, so also drop
+		// any entries for missing documents which follow what we copied.
+		const string missing(byte_width, '\xff');
+		while (1 + copy_size + byte_width < cur->tag.size() &&
+		       cur->tag.compare(1 + copy_size, byte_width,
+					missing) == 0) {
+		    copy_size += byte_width;
+		}
+		cur->tag.erase(1, copy_size);
+		cur->firstdid += copy_size / byte_width;
 		break;
 	    }
 
@@ -843,7 +1480,27 @@ merge_postlists(Xapian::Compactor* compactor,
 	    }
 	}
 	out->add(Honey::make_doclenchunk_key(chunk_lastdid), tag);
+
+	// Record the document lengths for the skip data in posting chunks.
+	doclens.add_chunk(chunk_lastdid, std::move(tag));
     }
+}
+
+/** Merge the posting chunks for terms before @a end_key.
+ *
+ *  Any cursors left in @a pq at the end are deleted.
+ *
+ *  @param pq	The cursors to merge, positioned on posting chunks.
+ *  @param doclens	Document lengths for generating skip data.
+ *  @param packed	Should we write posting data in the packed encoding?
+ *  @param end_key	Stop at the first term whose key is >= this, or merge
+ *			all the remaining posting chunks if it's empty.
+ */
+template<typename T, typename Q> void
+merge_postings(T* out, Q& pq, const DocLens& doclens, bool packed,
+	       const string& end_key)
+{
+    typedef typename Q::value_type cursor_ptr;
 
     struct HoneyPostListChunk {
 	Xapian::docid first, last;
@@ -957,11 +1614,12 @@ merge_postlists(Xapian::Compactor* compactor,
     };
     vector<HoneyPostListChunk> tags;
 
+    string last_key;
     Xapian::termcount tf = 0, cf = 0; // Initialise to avoid warnings.
 
     while (true) {
-	cursor_type* cur = NULL;
-	if (!pq.empty()) {
+	cursor_ptr cur = NULL;
+	if (!pq.empty() && (end_key.empty() || pq.top()->key < end_key)) {
 	    cur = pq.top();
 	    pq.pop();
 	}
@@ -1034,11 +1692,14 @@ merge_postlists(Xapian::Compactor* compactor,
 
 		if (tf > 2) {
 		    // If tf <= 2 there's no explicit posting data.
+		    size_t header_len = first_tag.size();
 		    tags[0].append_postings_to(first_tag, have_wdfs);
 		    for (size_t chunk = 1; chunk != j; ++chunk) {
 			tags[chunk].append_postings_to(first_tag, have_wdfs,
 						       tags[chunk - 1].last);
 		    }
+		    add_skip_data(first_tag, header_len, tags[0].first,
+				  have_wdfs, packed, doclens);
 		}
 		out->add(last_key, first_tag);
 
@@ -1075,11 +1736,15 @@ merge_postlists(Xapian::Compactor* compactor,
 							     tag);
 			}
 
+			size_t header_len = tag.size();
+			Xapian::docid first_did = tags[i].first;
 			tags[i].append_postings_to(tag, have_wdfs);
 			while (++i != j) {
 			    tags[i].append_postings_to(tag, have_wdfs,
 						       tags[i - 1].last);
 			}
+			add_skip_data(tag, header_len, first_did, have_wdfs,
+				      packed, doclens);
 
 			out->add(pack_honey_postlist_key(term, last_did), tag);
 		    }
@@ -1115,6 +1780,38 @@ merge_postlists(Xapian::Compactor* compactor,
 	    delete cur;
 	}
     }
+
+    while (!pq.empty()) {
+	delete pq.top();
+	pq.pop();
+    }
+}
+
+// U : vector<HoneyTable*>::const_iterator
+template<typename T, typename U> void
+merge_postlists(Xapian::Compactor* compactor,
+		T* out, vector<Xapian::docid>::const_iterator offset,
+		U b, U e)
+{
+    typedef decltype(**b) table_type; // E.g. HoneyTable
+    typedef PostlistCursor<table_type> cursor_type;
+    typedef PostlistCursorGt<cursor_type> gt_type;
+    priority_queue<cursor_type*, vector<cursor_type*>, gt_type> pq;
+    for ( ; b != e; ++b, ++offset) {
+	auto in = *b;
+	auto cursor = new cursor_type(in, *offset);
+	if (cursor->next()) {
+	    pq.push(cursor);
+	} else {
+	    // Skip empty tables.
+	    delete cursor;
+	}
+    }
+
+    // Document lengths, used to generate the skip data in posting chunks.
+    DocLens doclens;
+    merge_postlist_leading_keys(compactor, out, pq, doclens);
+    merge_postings(out, pq, doclens, out->get_packed_postings(), string());
 }
 
 template<typename T> struct MergeCursor;
@@ -1157,6 +1854,11 @@ merge_spellings(HoneyTable* out,
     priority_queue<cursor_type*, vector<cursor_type*>, gt_type> pq;
     for ( ; b != e; ++b) {
 	auto in = *b;
+	if (in->empty()) {
+	    // Skip empty tables (a lazy table which doesn't exist is empty).
+	    continue;
+	}
+
 	auto cursor = new cursor_type(in);
 	if (cursor->next()) {
 	    pq.push(cursor);
@@ -1359,6 +2061,11 @@ merge_spellings(HoneyTable* out,
     priority_queue<cursor_type*, vector<cursor_type*>, gt_type> pq;
     for ( ; b != e; ++b) {
 	auto in = *b;
+	if (in->empty()) {
+	    // Skip empty tables (a lazy table which doesn't exist is empty).
+	    continue;
+	}
+
 	auto cursor = new cursor_type(in);
 	if (cursor->next()) {
 	    pq.push(cursor);
@@ -1474,6 +2181,11 @@ merge_synonyms(T* out, U b, U e)
     priority_queue<cursor_type*, vector<cursor_type*>, gt_type> pq;
     for ( ; b != e; ++b) {
 	auto in = *b;
+	if (in->empty()) {
+	    // Skip empty tables (a lazy table which doesn't exist is empty).
+	    continue;
+	}
+
 	auto cursor = new cursor_type(in);
 	if (cursor->next()) {
 	    pq.push(cursor);
@@ -1646,6 +2358,213 @@ multimerge_postlists(Xapian::Compactor* compactor,
     }
 }
 
+#if defined XAPIAN_HAS_GLASS_BACKEND && defined HAVE_STD_THREAD && \
+    !defined XAPIAN_DEBUG_LOG
+/// What we need to open another copy of an input glass postlist table.
+struct GlassPostlistSource {
+    /// The path of the table, without the extension.
+    string path;
+    Glass::RootInfo root_info;
+    glass_revision_number_t revision;
+};
+
+/// A range of terms whose posting chunks are merged in another thread.
+struct PostingRange {
+    /// Key for the first term in the range.
+    string start_key;
+    /// Key for the first term after the range, or empty for the last range.
+    string end_key;
+    /// The temporary table the range is merged into.
+    HoneyTable* tmptab = NULL;
+    Honey::RootInfo root_info;
+    /// Exception thrown while merging, if any.
+    exception_ptr error;
+};
+
+/// Merge the posting chunks in @a range into its temporary table.
+static void
+merge_posting_range(PostingRange& range,
+		    const vector<GlassPostlistSource>& sources,
+		    const vector<Xapian::docid>& offset,
+		    const DocLens& doclens, bool packed)
+{
+    try {
+	typedef PostlistCursor<const GlassTable&> cursor_type;
+	typedef PostlistCursorGt<cursor_type> gt_type;
+	// A GlassTable can't be read from more than one thread at once, so
+	// open our own copy of each input table at the same revision.
+	vector<unique_ptr<GlassTable>> tables;
+	priority_queue<cursor_type*, vector<cursor_type*>, gt_type> pq;
+	for (size_t i = 0; i != sources.size(); ++i) {
+	    const GlassPostlistSource& source = sources[i];
+	    tables.emplace_back(new GlassTable("postlist", source.path, true));
+	    tables.back()->open(0, source.root_info, source.revision);
+	    auto cursor = new cursor_type(tables.back().get(), offset[i]);
+	    cursor->start_at(range.start_key);
+	    if (cursor->next()) {
+		pq.push(cursor);
+	    } else {
+		delete cursor;
+	    }
+	}
+	merge_postings(range.tmptab, pq, doclens, packed, range.end_key);
+	range.tmptab->flush_db();
+	range.tmptab->commit(1, &range.root_info);
+    } catch (...) {
+	range.error = current_exception();
+    }
+}
+
+/** Merge glass postlist tables, merging ranges of terms in parallel.
+ *
+ *  The entries before the posting chunks are merged as usual first, since
+ *  we need the merged document lengths to generate the skip data.  Then the
+ *  terms are split into up to @a n_ranges ranges at keys from the branch
+ *  blocks of the largest input.  The calling thread merges the first range
+ *  straight into @a out, while each other range is merged into a temporary
+ *  table in a thread of its own, and these are then copied to @a out in
+ *  order.  Copying an entry is much cheaper than converting it, and @a out
+ *  gets exactly the same entries as merge_postlists() would give it.
+ */
+static void
+merge_postlists_in_ranges(Xapian::Compactor* compactor,
+			  HoneyTable* out, const char* tmpdir,
+			  const vector<const GlassTable*>& inputs,
+			  const vector<GlassPostlistSource>& sources,
+			  const vector<Xapian::docid>& offset,
+			  unsigned n_ranges)
+{
+    typedef PostlistCursor<const GlassTable&> cursor_type;
+    typedef PostlistCursorGt<cursor_type> gt_type;
+    priority_queue<cursor_type*, vector<cursor_type*>, gt_type> pq;
+    for (size_t i = 0; i != inputs.size(); ++i) {
+	auto cursor = new cursor_type(inputs[i], offset[i]);
+	if (cursor->next()) {
+	    pq.push(cursor);
+	} else {
+	    // Skip empty tables.
+	    delete cursor;
+	}
+    }
+
+    // Document lengths, used to generate the skip data in posting chunks.
+    DocLens doclens;
+    merge_postlist_leading_keys(compactor, out, pq, doclens);
+    if (pq.empty()) return;
+
+    bool packed = out->get_packed_postings();
+
+    // Find where terms start near the keys which split the largest input
+    // into runs of leaf blocks.  Ask for more keys than we need, as some
+    // will be for the entries before the posting chunks.
+    vector<string> starts;
+    {
+	auto largest = *max_element(inputs.begin(), inputs.end(),
+				    [](const GlassTable* a,
+				       const GlassTable* b) {
+					return a->get_entry_count() <
+					       b->get_entry_count();
+				    });
+	vector<string> split_keys;
+	largest->get_split_keys(n_ranges * 4, split_keys);
+	GlassCursor cursor(largest);
+	for (const string& split_key : split_keys) {
+	    if (!cursor.find_entry_ge(split_key) && cursor.after_end())
+		break;
+	    const string& key = cursor.current_key;
+	    if (GlassCompact::is_user_metadata_key(key) ||
+		GlassCompact::is_valuestats_key(key) ||
+		GlassCompact::is_valuechunk_key(key) ||
+		GlassCompact::is_doclenchunk_key(key)) {
+		continue;
+	    }
+	    const char* p = key.data();
+	    const char* end = p + key.size();
+	    string term;
+	    if (!unpack_string_preserving_sort(&p, end, term))
+		throw Xapian::DatabaseCorruptError("Bad postlist key");
+	    string start = pack_glass_postlist_key(term);
+	    if (start <= pq.top()->key) continue;
+	    if (!starts.empty() && start <= starts.back()) continue;
+	    starts.push_back(std::move(start));
+	}
+    }
+    if (starts.size() >= n_ranges) {
+	// Use evenly spaced keys to get n_ranges ranges.
+	vector<string> chosen;
+	size_t m = starts.size() + 1;
+	for (unsigned i = 1; i != n_ranges; ++i) {
+	    chosen.push_back(std::move(starts[i * m / n_ranges - 1]));
+	}
+	swap(starts, chosen);
+    }
+
+    vector<PostingRange> ranges(starts.size());
+    vector<thread> workers;
+    workers.reserve(ranges.size());
+    for (size_t r = 0; r != ranges.size(); ++r) {
+	PostingRange& range = ranges[r];
+	range.start_key = starts[r];
+	if (r + 1 != starts.size()) range.end_key = starts[r + 1];
+
+	string dest = tmpdir;
+	dest += "/tmprange";
+	dest += str(r);
+	dest += '.';
+	range.tmptab = new HoneyTable("postlist", dest, false);
+	// Don't compress entries in temporary tables, so that copying them
+	// to the output compresses them exactly as merging directly would.
+	range.root_info.init(0);
+	const int flags = Xapian::DB_DANGEROUS|Xapian::DB_NO_SYNC;
+	range.tmptab->create_and_open(flags, range.root_info);
+
+	try {
+	    workers.emplace_back(merge_posting_range, ref(range),
+				 cref(sources), cref(offset), cref(doclens),
+				 packed);
+	} catch (const system_error&) {
+	    // We couldn't start a thread, so do the work in this one.
+	    merge_posting_range(range, sources, offset, doclens, packed);
+	    workers.emplace_back();
+	}
+    }
+
+    // We must join all the threads before returning or throwing, so note
+    // the first exception and rethrow it at the end.
+    exception_ptr error;
+    try {
+	merge_postings(out, pq, doclens, packed,
+		       starts.empty() ? string() : starts[0]);
+    } catch (...) {
+	error = current_exception();
+    }
+
+    for (size_t r = 0; r != ranges.size(); ++r) {
+	PostingRange& range = ranges[r];
+	if (workers[r].joinable()) workers[r].join();
+	if (!error) error = range.error;
+	if (!error) {
+	    try {
+		HoneyCursor cursor(range.tmptab);
+		while (cursor.next()) {
+		    bool compressed = cursor.read_tag(true);
+		    out->add(cursor.current_key, cursor.current_tag,
+			     compressed);
+		}
+	    } catch (...) {
+		error = current_exception();
+	    }
+	}
+	string path = range.tmptab->get_path();
+	delete range.tmptab;
+	range.tmptab = NULL;
+	unlink(path.c_str());
+    }
+
+    if (error) rethrow_exception(error);
+}
+#endif
+
 template<typename T> class PositionCursor;
 
 #ifdef XAPIAN_HAS_GLASS_BACKEND
@@ -1657,7 +2576,8 @@ class PositionCursor<const GlassTable&> : private GlassCursor {
     string key;
     Xapian::docid firstdid;
 
-    PositionCursor(const GlassTable* in, Xapian::docid offset_)
+    PositionCursor(const GlassTable* in, Xapian::docid offset_,
+		   const GlassTable*)
 	: GlassCursor(in), offset(offset_), firstdid(0) {
 	rewind();
     }
@@ -1691,16 +2611,78 @@ template<>
 class PositionCursor<const HoneyTable&> : private HoneyCursor {
     Xapian::docid offset;
 
+    /** The docids in the current posting list chunk.
+     *
+     *  NULL unless the input's positional data is aligned with the postlist,
+     *  in which case we split each entry into one per posting.
+     */
+    unique_ptr<Honey::PostingChunkDocids> chunks;
+
+    /// The aligned positional data in current_tag.
+    HoneyAlignedPositions aligned;
+
+    /// The term of the aligned positional data in current_tag.
+    string chunk_term;
+
+    /// The index of the next posting in the aligned positional data.
+    Xapian::doccount index = 0;
+
+    /// The positional data for the current posting, if aligned.
+    string tag;
+
+    /// Move to the next posting with aligned positional data.
+    bool next_aligned() {
+	while (true) {
+	    while (index < aligned.size()) {
+		const char* p;
+		size_t len;
+		aligned.get(index, p, len);
+		Xapian::docid did = chunks->get_docids()[index++];
+		if (len == 0) continue;
+		tag.assign(p, len);
+		key.resize(0);
+		pack_string_preserving_sort(key, chunk_term);
+		pack_uint_preserving_sort(key, did + offset);
+		return true;
+	    }
+
+	    if (!HoneyCursor::next()) return false;
+	    read_tag();
+	    const char* d = current_key.data();
+	    const char* e = d + current_key.size();
+	    Xapian::docid chunk_last;
+	    if (!unpack_string_preserving_sort(&d, e, chunk_term) ||
+		!unpack_uint_preserving_sort(&d, e, &chunk_last) ||
+		d != e) {
+		throw Xapian::DatabaseCorruptError("Bad position key");
+	    }
+	    aligned.init(current_tag.data(), current_tag.size());
+	    if (!chunks->find(chunk_term, chunk_last) ||
+		chunks->get_docids().back() != chunk_last ||
+		chunks->get_docids().size() != aligned.size()) {
+		throw Xapian::DatabaseCorruptError("Aligned position data "
+						   "doesn't match postlist");
+	    }
+	    index = 0;
+	}
+    }
+
   public:
     string key;
     Xapian::docid firstdid;
 
-    PositionCursor(const HoneyTable* in, Xapian::docid offset_)
+    PositionCursor(const HoneyTable* in, Xapian::docid offset_,
+		   const HoneyTable* postlist)
 	: HoneyCursor(in), offset(offset_), firstdid(0) {
+	if (in->get_aligned_positions()) {
+	    Assert(postlist);
+	    chunks.reset(new Honey::PostingChunkDocids(postlist));
+	}
 	rewind();
     }
 
     bool next() {
+	if (chunks) return next_aligned();
 	if (!HoneyCursor::next()) return false;
 	read_tag();
 	const char* d = current_key.data();
@@ -1720,7 +2702,7 @@ class PositionCursor<const HoneyTable&> : private HoneyCursor {
     }
 
     const string& get_tag() const {
-	return current_tag;
+	return chunks ? tag : current_tag;
     }
 };
 
@@ -1734,19 +2716,39 @@ class PositionCursorGt {
     }
 };
 
+/** Merge the positional data from @a inputs.
+ *
+ *  @param postlists	The postlist table for each input, which is needed to
+ *			read input positional data which is aligned with the
+ *			postlist (or NULL if no inputs are honey databases).
+ *  @param overlay	If non-NULL, the first input is the honey database
+ *			under this overlay and the second its delta, and the
+ *			entries for masked docids in the first are dropped.
+ */
 template<typename T, typename U> void
 merge_positions(T* out, const vector<U*>& inputs,
-		const vector<Xapian::docid>& offset)
+		const vector<Xapian::docid>& offset,
+		const vector<U*>* postlists = NULL,
+		const HoneyOverlayDatabase* overlay = NULL)
 {
     typedef decltype(*inputs[0]) table_type; // E.g. HoneyTable
     typedef PositionCursor<table_type> cursor_type;
     typedef PositionCursorGt<cursor_type> gt_type;
     priority_queue<cursor_type*, vector<cursor_type*>, gt_type> pq;
+    // The cursor for the input to drop masked docids from (if any).
+    cursor_type* masked_input = NULL;
     for (size_t i = 0; i < inputs.size(); ++i) {
 	auto in = inputs[i];
-	auto cursor = new cursor_type(in, offset[i]);
+	if (in->empty()) {
+	    // Skip empty tables (a lazy table which doesn't exist is empty).
+	    continue;
+	}
+
+	auto cursor = new cursor_type(in, offset[i],
+				      postlists ? (*postlists)[i] : NULL);
 	if (cursor->next()) {
 	    pq.push(cursor);
+	    if (overlay && i == 0) masked_input = cursor;
 	} else {
 	    // Skip empty tables.
 	    delete cursor;
@@ -1756,15 +2758,137 @@ merge_positions(T* out, const vector<U*>& inputs,
     while (!pq.empty()) {
 	cursor_type* cur = pq.top();
 	pq.pop();
-	out->add(cur->key, cur->get_tag());
+	if (cur == masked_input) {
+	    const char* d = cur->key.data();
+	    const char* e = d + cur->key.size();
+	    string term;
+	    Xapian::docid did;
+	    if (!unpack_string_preserving_sort(&d, e, term) ||
+		!unpack_uint_preserving_sort(&d, e, &did)) {
+		throw Xapian::DatabaseCorruptError("Bad position key");
+	    }
+	    if (overlay->in_base(did - offset[0])) {
+		out->add(cur->key, cur->get_tag());
+	    }
+	} else {
+	    out->add(cur->key, cur->get_tag());
+	}
 	if (cur->next()) {
 	    pq.push(cur);
 	} else {
+	    if (cur == masked_input) masked_input = NULL;
 	    delete cur;
 	}
     }
 }
 
+/** Write positional data aligned with the postlist.
+ *
+ *  Takes the positional data for each posting in order of term and then
+ *  docid (as merge_positions() produces it) and writes an entry for each
+ *  posting list chunk in the already written postlist table (in the format
+ *  described for HoneyAlignedPositions).
+ */
+class AlignedPositionWriter {
+    /// The position table to write to.
+    HoneyTable* out;
+
+    /// The docids in the current posting list chunk.
+    Honey::PostingChunkDocids chunks;
+
+    /// Are we building an entry?
+    bool have_chunk = false;
+
+    /// The term of the entry we're building.
+    string term;
+
+    /// The end offset of the data for each posting in the entry so far.
+    vector<size_t> ends;
+
+    /// The data for the postings in the entry so far.
+    string data;
+
+    /// Write out the entry we're building (if any).
+    void write_chunk() {
+	if (!have_chunk) return;
+	have_chunk = false;
+	const vector<Xapian::docid>& docids = chunks.get_docids();
+	// Postings after the last with positional data have none.
+	ends.resize(docids.size(), data.size());
+	unsigned width = 1;
+	while (width < sizeof(size_t) && (data.size() >> (width * 8))) {
+	    ++width;
+	}
+	string tag;
+	pack_uint(tag, docids.size());
+	tag += char(width);
+	for (size_t end : ends) {
+	    for (unsigned w = width; w != 0; --w) {
+		tag += char(end >> ((w - 1) * 8));
+	    }
+	}
+	tag += data;
+	out->add(HoneyPositionTable::make_key(docids.back(), term), tag);
+	ends.clear();
+	data.resize(0);
+    }
+
+  public:
+    /** Constructor.
+     *
+     *  @param out_	The position table to write to.
+     *  @param postlist	The postlist table written for the same database.
+     */
+    AlignedPositionWriter(HoneyTable* out_, const HoneyTable* postlist)
+	: out(out_), chunks(postlist) {}
+
+    /// Add the positional data for a posting.
+    void add(const string& key, const string& tag) {
+	const char* d = key.data();
+	const char* e = d + key.size();
+	string key_term;
+	Xapian::docid did;
+	if (!unpack_string_preserving_sort(&d, e, key_term) ||
+	    !unpack_uint_preserving_sort(&d, e, &did) ||
+	    d != e) {
+	    throw Xapian::DatabaseCorruptError("Bad position key");
+	}
+
+	if (have_chunk &&
+	    (key_term != term || did > chunks.get_docids().back())) {
+	    write_chunk();
+	}
+	if (!have_chunk) {
+	    if (!chunks.find(key_term, did)) {
+		throw Xapian::DatabaseCorruptError("Positional data for term "
+						   "not in postlist");
+	    }
+	    term = std::move(key_term);
+	    have_chunk = true;
+	}
+
+	// Postings before this one which we haven't seen positional data for
+	// have none.
+	const vector<Xapian::docid>& docids = chunks.get_docids();
+	size_t i = ends.size();
+	while (i != docids.size() && docids[i] < did) {
+	    ends.push_back(data.size());
+	    ++i;
+	}
+	if (i == docids.size() || docids[i] != did) {
+	    throw Xapian::DatabaseCorruptError("Positional data for document "
+					       "not in postlist");
+	}
+	data += tag;
+	ends.push_back(data.size());
+    }
+
+    /// Write out any pending data.
+    void flush() {
+	write_chunk();
+    }
+};
+
 template<typename T, typename U> void
 merge_docid_keyed(T* out, const vector<U*>& inputs,
 		  const vector<Xapian::docid>& offset,
@@ -1806,6 +2930,53 @@ merge_docid_keyed(T* out, const vector<U*>& inputs,
     }
 }
 
+/** Merge a docid-keyed table of a honey database with its overlay's delta.
+ *
+ *  The docids of the two interleave, so we merge the keys in order, dropping
+ *  the entries for masked docids in @a base.
+ */
+static void
+merge_docid_keyed(HoneyTable* out, const HoneyTable* base,
+		  const HoneyTable* delta, Xapian::docid offset,
+		  const HoneyOverlayDatabase* overlay)
+{
+    HoneyCursor base_cur(base), delta_cur(delta);
+    base_cur.rewind();
+    delta_cur.rewind();
+    bool in_base = base_cur.next();
+    bool in_delta = delta_cur.next();
+
+    string key;
+    while (in_base || in_delta) {
+	bool from_base = !in_delta ||
+			 (in_base &&
+			  base_cur.current_key < delta_cur.current_key);
+	HoneyCursor& cur = from_base ? base_cur : delta_cur;
+	Xapian::docid did;
+	const char* d = cur.current_key.data();
+	const char* e = d + cur.current_key.size();
+	if (!unpack_uint_preserving_sort(&d, e, &did)) {
+	    string msg = "Bad key in ";
+	    msg += (from_base ? base : delta)->get_path();
+	    throw Xapian::DatabaseCorruptError(msg);
+	}
+	if (!from_base || overlay->in_base(did)) {
+	    key.resize(0);
+	    pack_uint_preserving_sort(key, did + offset);
+	    // Copy over anything extra in the key (e.g. the zero byte at the
+	    // end of "used value slots" in the termlist table).
+	    key.append(d, e - d);
+	    bool compressed = cur.read_tag(true);
+	    out->add(key, cur.current_tag, compressed);
+	}
+	if (from_base) {
+	    in_base = base_cur.next();
+	} else {
+	    in_delta = delta_cur.next();
+	}
+    }
+}
+
 #ifdef XAPIAN_HAS_GLASS_BACKEND
 template<typename T> void
 merge_docid_keyed(T* out, const vector<const GlassTable*>& inputs,
@@ -2016,7 +3187,8 @@ HoneyDatabase::compact(Xapian::Compactor* compactor,
 		       const vector<Xapian::docid>& offset,
 		       Xapian::Compactor::compaction_level compaction,
 		       unsigned flags,
-		       Xapian::docid last_docid)
+		       Xapian::docid last_docid,
+		       const HoneyOverlayDatabase* overlay)
 {
     // Currently unused for honey.
     (void)compaction;
@@ -2028,21 +3200,26 @@ HoneyDatabase::compact(Xapian::Compactor* compactor,
 	Honey::table_type type;
 	// Create tables after position lazily.
 	bool lazy;
+	// Build a Bloom filter if requested?  Only worthwhile for tables where
+	// lookups for keys which aren't present are common.
+	bool filter;
     };
 
     static const table_list tables[] = {
-	// name		type			lazy
-	{ "postlist",	Honey::POSTLIST,	false },
-	{ "docdata",	Honey::DOCDATA,		true },
-	{ "termlist",	Honey::TERMLIST,	false },
-	{ "position",	Honey::POSITION,	true },
-	{ "spelling",	Honey::SPELLING,	true },
-	{ "synonym",	Honey::SYNONYM,		true }
+	// name		type			lazy	filter
+	{ "postlist",	Honey::POSTLIST,	false,	true },
+	{ "docdata",	Honey::DOCDATA,		true,	false },
+	{ "termlist",	Honey::TERMLIST,	false,	false },
+	{ "position",	Honey::POSITION,	true,	true },
+	{ "spelling",	Honey::SPELLING,	true,	true },
+	{ "synonym",	Honey::SYNONYM,		true,	true }
     };
     const table_list* tables_end = tables +
 	(sizeof(tables) / sizeof(tables[0]));
 
-    const int FLAGS = Xapian::DB_DANGEROUS;
+    // The choice of index layout is made per table as it is written.
+    const int FLAGS = Xapian::DB_DANGEROUS |
+		      (flags & Xapian::DB_EYTZINGER_INDEX);
 
     bool single_file = (flags & Xapian::DBCOMPACT_SINGLE_FILE);
     bool multipass = (flags & Xapian::DBCOMPACT_MULTIPASS);
@@ -2104,7 +3281,7 @@ HoneyDatabase::compact(Xapian::Compactor* compactor,
     bool bad_totals = false;
     off_t in_total = 0, out_total = 0;
 
-    version_file_out->create();
+    version_file_out->create(flags);
     for (size_t i = 0; i != sources.size(); ++i) {
 	bool source_single_file = false;
 	if (source_backend == Xapian::DB_BACKEND_GLASS) {
@@ -2130,7 +3307,7 @@ HoneyDatabase::compact(Xapian::Compactor* compactor,
 #endif
 	} else {
 	    auto db = static_cast<const HoneyDatabase*>(sources[i]);
-	    version_file_out->merge_stats(db->version_file);
+	    if (!overlay) version_file_out->merge_stats(db->version_file);
 	    source_single_file = db->single_file();
 	}
 	if (source_single_file) {
@@ -2148,6 +3325,23 @@ HoneyDatabase::compact(Xapian::Compactor* compactor,
 	}
     }
 
+    if (overlay) {
+	// The overlay adjusts the statistics for the masked documents.
+	auto& v_base = static_cast<const HoneyDatabase*>(sources[0])->version_file;
+	auto& v_delta =
+	    static_cast<const HoneyDatabase*>(sources[1])->version_file;
+	version_file_out->merge_stats(
+	    overlay->get_doccount(),
+	    overlay->get_doclength_lower_bound(),
+	    overlay->get_doclength_upper_bound(),
+	    max(v_base.get_wdf_upper_bound(), v_delta.get_wdf_upper_bound()),
+	    overlay->get_total_length(),
+	    v_base.get_spelling_wordfreq_upper_bound() +
+		v_delta.get_spelling_wordfreq_upper_bound(),
+	    overlay->get_unique_terms_lower_bound(),
+	    overlay->get_unique_terms_upper_bound());
+    }
+
     string fl_serialised;
 #if 0
     if (single_file) {
@@ -2162,7 +3356,10 @@ if (source_backend == Xapian::DB_BACKEND_GLASS) {
 #ifndef XAPIAN_HAS_GLASS_BACKEND
     throw Xapian::FeatureUnavailableError("Glass backend disabled");
 #else
-    vector<HoneyTable*> tabs;
+    // Owning the tables here means they get closed if an exception is thrown.
+    vector<unique_ptr<HoneyTable>> tabs;
+    // The output postlist table, which aligned positional data needs.
+    const HoneyTable* postlist_out = NULL;
     tabs.reserve(tables_end - tables);
     off_t prev_size = 0;
     for (const table_list* t = tables; t < tables_end; ++t) {
@@ -2292,16 +3489,18 @@ if (source_backend == Xapian::DB_BACKEND_GLASS) {
 	} else {
 	    out = new HoneyTable(t->name, dest, false, t->lazy);
 	}
-	tabs.push_back(out);
+	tabs.emplace_back(out);
 	Honey::RootInfo* root_info = version_file_out->root_to_set(t->type);
+	int table_flags = FLAGS;
+	if (t->filter) table_flags |= (flags & Xapian::DB_BLOOM_FILTERS);
 	if (single_file) {
 	    root_info->set_free_list(fl_serialised);
 	    root_info->set_offset(table_start_offset);
-	    out->open(FLAGS,
+	    out->open(table_flags,
 		      version_file_out->get_root(t->type),
 		      version_file_out->get_revision());
 	} else {
-	    out->create_and_open(FLAGS, *root_info);
+	    out->create_and_open(table_flags, *root_info);
 	}
 
 	switch (t->type) {
@@ -2309,10 +3508,42 @@ if (source_backend == Xapian::DB_BACKEND_GLASS) {
 		if (multipass && inputs.size() > 3) {
 		    multimerge_postlists(compactor, out, destdir,
 					 inputs, offset);
-		} else {
-		    merge_postlists(compactor, out, offset.begin(),
-				    inputs.begin(), inputs.end());
+		    postlist_out = out;
+		    break;
+		}
+#if defined HAVE_STD_THREAD && !defined XAPIAN_DEBUG_LOG
+		// Converting the posting chunks is the bulk of the work, so
+		// merge ranges of terms in parallel if we can.  We need
+		// somewhere to put temporary tables, and to be able to open
+		// another copy of each input table at the revision we're
+		// compacting.  The debug log isn't thread-safe, so we don't
+		// use threads if it's enabled.
+		unsigned n_ranges = get_compact_threads();
+		bool use_ranges = (n_ranges > 1 && !single_file && !multipass);
+		vector<GlassPostlistSource> range_sources;
+		for (auto src : sources) {
+		    if (!use_ranges) break;
+		    auto db = static_cast<const GlassDatabase*>(src);
+		    if (db->single_file() || db->has_uncommitted_changes()) {
+			use_ranges = false;
+			break;
+		    }
+		    range_sources.push_back({db->db_dir + "/postlist.",
+					     db->version_file.get_root(
+						 Glass::POSTLIST),
+					     db->version_file.get_revision()});
 		}
+		if (use_ranges) {
+		    merge_postlists_in_ranges(compactor, out, destdir,
+					      inputs, range_sources, offset,
+					      n_ranges);
+		    postlist_out = out;
+		    break;
+		}
+#endif
+		merge_postlists(compactor, out, offset.begin(),
+				inputs.begin(), inputs.end());
+		postlist_out = out;
 		break;
 	    }
 	    case Honey::SPELLING:
@@ -2322,7 +3553,13 @@ if (source_backend == Xapian::DB_BACKEND_GLASS) {
 		merge_synonyms(out, inputs.begin(), inputs.end());
 		break;
 	    case Honey::POSITION:
-		merge_positions(out, inputs, offset);
+		if (out->get_aligned_positions()) {
+		    AlignedPositionWriter writer(out, postlist_out);
+		    merge_positions(&writer, inputs, offset);
+		    writer.flush();
+		} else {
+		    merge_positions(out, inputs, offset);
+		}
 		break;
 	    default: {
 		// DocData, Termlist
@@ -2428,10 +3665,13 @@ if (source_backend == Xapian::DB_BACKEND_GLASS) {
     version_file_out->set_last_docid(last_docid);
     string tmpfile = version_file_out->write(1, FLAGS);
     if (single_file) {
-	off_t version_file_size = lseek(fd, 0, SEEK_CUR);
-	if (version_file_size < 0) {
+	off_t version_file_end = lseek(fd, 0, SEEK_CUR);
+	if (version_file_end < 0) {
 	    throw Xapian::DatabaseError("lseek() failed", errno);
 	}
+	// The version file starts at the offset we're writing at.
+	off_t version_file_size =
+	    version_file_end - version_file_out->get_offset();
 	if (version_file_size > HONEY_VERSION_MAX_SIZE) {
 	    throw Xapian::DatabaseError("Didn't allow enough space for "
 					"version file data");
@@ -2442,12 +3682,12 @@ if (source_backend == Xapian::DB_BACKEND_GLASS) {
     }
     // Commit with revision 1.
     version_file_out->sync(tmpfile, 1, FLAGS);
-    for (unsigned j = 0; j != tabs.size(); ++j) {
-	delete tabs[j];
-    }
 #endif
 } else {
-    vector<HoneyTable*> tabs;
+    // Owning the tables here means they get closed if an exception is thrown.
+    vector<unique_ptr<HoneyTable>> tabs;
+    // The output postlist table, which aligned positional data needs.
+    const HoneyTable* postlist_out = NULL;
     tabs.reserve(tables_end - tables);
     off_t prev_size = HONEY_MIN_DB_SIZE;
     for (const table_list* t = tables; t < tables_end; ++t) {
@@ -2577,27 +3817,37 @@ if (source_backend == Xapian::DB_BACKEND_GLASS) {
 	} else {
 	    out = new HoneyTable(t->name, dest, false, t->lazy);
 	}
-	tabs.push_back(out);
+	tabs.emplace_back(out);
 	Honey::RootInfo* root_info = version_file_out->root_to_set(t->type);
+	int table_flags = FLAGS;
+	if (t->filter) table_flags |= (flags & Xapian::DB_BLOOM_FILTERS);
 	if (single_file) {
 	    root_info->set_free_list(fl_serialised);
 	    root_info->set_offset(table_start_offset);
-	    out->open(FLAGS,
+	    out->open(table_flags,
 		      version_file_out->get_root(t->type),
 		      version_file_out->get_revision());
 	} else {
-	    out->create_and_open(FLAGS, *root_info);
+	    out->create_and_open(table_flags, *root_info);
 	}
 
 	switch (t->type) {
 	    case Honey::POSTLIST: {
-		if (multipass && inputs.size() > 3) {
+		if (overlay) {
+		    HoneyOverlayPostlists postlists = {
+			inputs[0], inputs[1], overlay
+		    };
+		    vector<const HoneyOverlayPostlists*> in = { &postlists };
+		    merge_postlists(compactor, out, offset.begin(),
+				    in.begin(), in.end());
+		} else if (multipass && inputs.size() > 3) {
 		    multimerge_postlists(compactor, out, destdir,
 					 inputs, offset);
 		} else {
 		    merge_postlists(compactor, out, offset.begin(),
 				    inputs.begin(), inputs.end());
 		}
+		postlist_out = out;
 		break;
 	    }
 	    case Honey::SPELLING:
@@ -2606,12 +3856,32 @@ if (source_backend == Xapian::DB_BACKEND_GLASS) {
 	    case Honey::SYNONYM:
 		merge_synonyms(out, inputs.begin(), inputs.end());
 		break;
-	    case Honey::POSITION:
-		merge_positions(out, inputs, offset);
+	    case Honey::POSITION: {
+		// Positional data in the inputs may be aligned with their
+		// postlists.
+		vector<const HoneyTable*> postlists;
+		for (auto src : sources) {
+		    auto db = static_cast<const HoneyDatabase*>(src);
+		    postlists.push_back(&db->postlist_table);
+		}
+		if (out->get_aligned_positions()) {
+		    AlignedPositionWriter writer(out, postlist_out);
+		    merge_positions(&writer, inputs, offset, &postlists,
+				    overlay);
+		    writer.flush();
+		} else {
+		    merge_positions(out, inputs, offset, &postlists, overlay);
+		}
 		break;
+	    }
 	    default:
 		// DocData, Termlist
-		merge_docid_keyed(out, inputs, offset);
+		if (overlay) {
+		    merge_docid_keyed(out, inputs[0], inputs[1], offset[0],
+				      overlay);
+		} else {
+		    merge_docid_keyed(out, inputs, offset);
+		}
 		break;
 	}
 
@@ -2711,9 +3981,6 @@ if (source_backend == Xapian::DB_BACKEND_GLASS) {
     }
     // Commit with revision 1.
     version_file_out->sync(tmpfile, 1, FLAGS);
-    for (unsigned j = 0; j != tabs.size(); ++j) {
-	delete tabs[j];
-    }
 }
 
     if (!single_file) lock.release();
@@ -2747,3 +4014,59 @@ if (source_backend == Xapian::DB_BACKEND_GLASS) {
 	compactor->set_status("Total", status);
     }
 }
+
+void
+HoneyDatabase::compact_overlay(Xapian::Compactor* compactor,
+			       const char* destdir,
+			       const HoneyOverlayDatabase* overlay,
+			       Xapian::docid offset,
+			       Xapian::Compactor::compaction_level compaction,
+			       unsigned flags,
+			       Xapian::docid last_docid)
+{
+#ifndef XAPIAN_HAS_GLASS_BACKEND
+    (void)compactor;
+    (void)destdir;
+    (void)overlay;
+    (void)offset;
+    (void)compaction;
+    (void)flags;
+    (void)last_docid;
+    throw Xapian::FeatureUnavailableError("Glass backend disabled");
+#else
+    auto delta = static_cast<const GlassDatabase*>(overlay->delta.get());
+    if (delta->has_uncommitted_changes()) {
+	// The masks we'd use include the uncommitted changes, but we'd read
+	// the committed delta.
+	const char* m =
+	    "Can't compact from a WritableDatabase with uncommitted "
+	    "changes - either call commit() first, or create a new "
+	    "Database object from the filename on disk";
+	throw Xapian::InvalidOperationError(m);
+    }
+
+    string tmpdir = destdir;
+    tmpdir += ".merge";
+    if (mkdir(tmpdir.c_str(), 0755) < 0) {
+	string msg = tmpdir;
+	msg += ": cannot create directory";
+	throw Xapian::DatabaseError(msg, errno);
+    }
+    try {
+	compact(NULL, tmpdir.c_str(), -1, Xapian::DB_BACKEND_GLASS,
+		{ delta }, { 0 }, compaction, 0, delta->get_lastdocid());
+	HoneyDatabase delta_honey(tmpdir);
+	compact(compactor, destdir, -1, Xapian::DB_BACKEND_HONEY,
+		{ overlay->base.get(), &delta_honey }, { offset, offset },
+		compaction, flags, last_docid, overlay);
+    } catch (...) {
+	// Report the original error rather than any from cleaning up.
+	try {
+	    removedir(tmpdir);
+	} catch (...) {
+	}
+	throw;
+    }
+    removedir(tmpdir);
+#endif
+}
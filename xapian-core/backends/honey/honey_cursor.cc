@@ -113,6 +113,7 @@ HoneyCursor::next_from_index()
     if (p != end) abort();
     current_compressed = val_size & 1;
     val_size >>= 1;
+    tag_view = nullptr;
 
     // FIXME: Always resize to 0?  Not doing so avoids always having to clear
     // all the data before reading it.
@@ -126,6 +127,11 @@ HoneyCursor::next_from_index()
 bool
 HoneyCursor::read_tag(bool keep_compressed)
 {
+    if (tag_view) {
+	// read_tag_view() returned this tag without copying it.
+	current_tag.assign(tag_view, tag_view_len);
+	tag_view = nullptr;
+    }
     if (val_size) {
 	if (store.was_forced_closed()) {
 	    HoneyTable::throw_database_closed();
@@ -166,6 +172,31 @@ HoneyCursor::read_tag(bool keep_compressed)
     return current_compressed;
 }
 
+const char*
+HoneyCursor::read_tag_view(size_t& len)
+{
+    if (tag_view) {
+	len = tag_view_len;
+	return tag_view;
+    }
+    if (val_size && !current_compressed) {
+	if (store.was_forced_closed()) {
+	    HoneyTable::throw_database_closed();
+	}
+
+	const char* p = store.read_mapped(val_size);
+	if (p) {
+	    tag_view = p;
+	    len = tag_view_len = val_size;
+	    val_size = 0;
+	    return p;
+	}
+    }
+    read_tag();
+    len = current_tag.size();
+    return current_tag.data();
+}
+
 bool
 HoneyCursor::do_find(const string& key, bool greater_than)
 {
@@ -267,6 +298,20 @@ HoneyCursor::do_find(const string& key, bool greater_than)
 		last_key.assign(kkey, jump == 0 ? 0 : kkey_len);
 		break;
 	    }
+	    case SSTIndex::EYTZINGER:
+	    case SSTIndex::EYTZINGER_WIDE: {
+		unsigned ptr_size = (index_type == SSTIndex::EYTZINGER ? 4 : 8);
+		off_t jump = SSTIndex::eytzinger_find(store, key, last_key,
+						      ptr_size);
+		if (jump < 0) {
+		    // The key is before every index entry, so search from the
+		    // start of the table.
+		    jump = offset;
+		    last_key = string();
+		}
+		store.rewind(jump);
+		break;
+	    }
 	    case 0x02: {
 		// FIXME: If "close" just seek forwards?  Or consider seeking
 		// from current index pos?
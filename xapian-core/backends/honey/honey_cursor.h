@@ -39,6 +39,19 @@ class HoneyCursor {
 
     BufferedFile store;
 
+    /** The current tag in the table's memory mapping.
+     *
+     *  Set by read_tag_view() when it avoids copying the tag, in which case
+     *  current_tag hasn't been updated.  NULL otherwise.
+     */
+    const char* tag_view = nullptr;
+
+    /// Length of the tag tag_view points to.
+    size_t tag_view_len = 0;
+
+    /// Bloom filter over the keys in the table.
+    const Honey::BloomFilter* filter;
+
   public:
     std::string current_key, current_tag;
     mutable size_t val_size = 0;
@@ -56,6 +69,7 @@ class HoneyCursor {
     // Forward to next constructor form.
     explicit HoneyCursor(const HoneyTable* table)
 	: store(table->store),
+	  filter(&table->filter),
 	  comp_stream(Z_DEFAULT_STRATEGY),
 	  root(table->get_root()),
 	  offset(table->get_offset())
@@ -65,6 +79,9 @@ class HoneyCursor {
 
     HoneyCursor(const HoneyCursor& o)
 	: store(o.store),
+	  tag_view(o.tag_view),
+	  tag_view_len(o.tag_view_len),
+	  filter(o.filter),
 	  current_key(o.current_key),
 	  current_tag(o.current_tag), // FIXME really copy?
 	  val_size(o.val_size),
@@ -87,6 +104,7 @@ class HoneyCursor {
 	current_key = last_key = std::string();
 	is_at_end = false;
 	val_size = 0;
+	tag_view = nullptr;
     }
 
     void to_end() { is_at_end = true; }
@@ -103,7 +121,29 @@ class HoneyCursor {
 
     bool read_tag(bool keep_compressed = false);
 
+    /** Read the tag, avoiding copying it if possible.
+     *
+     *  If the table is memory mapped and the tag isn't compressed, this
+     *  returns a pointer to the tag in the mapping, which remains valid
+     *  for as long as this cursor exists.  Otherwise the tag is read into
+     *  current_tag as read_tag() would.  Either way current_tag should not
+     *  be used to access the tag.
+     *
+     *  @param len	Set to the length of the tag.
+     *
+     *  @return Pointer to the start of the tag.
+     */
+    const char* read_tag_view(size_t& len);
+
     bool find_exact(const std::string& key) {
+	if (!key.empty() && !filter->may_contain(key)) {
+	    // The Bloom filter says the key isn't present, so we don't need
+	    // to search the table.
+	    if (store.was_forced_closed()) {
+		HoneyTable::throw_database_closed();
+	    }
+	    return false;
+	}
 	return do_find(key, false);
     }
 
@@ -25,14 +25,18 @@
 #include "honey_alltermslist.h"
 #include "honey_document.h"
 #include "honey_metadata.h"
+#include "honey_overlay.h"
 #include "honey_termlist.h"
 #include "honey_spellingwordslist.h"
 #include "honey_valuelist.h"
 
 #include "backends/backends.h"
 #include "backends/leafpostlist.h"
+#include "filetests.h"
 #include "xapian/error.h"
 
+#include <memory>
+
 using namespace std;
 
 void
@@ -102,6 +106,26 @@ HoneyDatabase::~HoneyDatabase()
     delete doclen_cursor;
 }
 
+void
+HoneyDatabase::load_into_memory()
+{
+    HoneyTable* tables[] = {
+	&docdata_table, &postlist_table, &position_table,
+	&spelling_table, &synonym_table, &termlist_table
+    };
+    // The tables of a single file database are all in the same file, so
+    // share one copy of it.
+    bool one_file = path.empty();
+    shared_ptr<const HoneyLoadedFile> file;
+    for (HoneyTable* table : tables) {
+	auto table_file = table->load_into_memory(one_file ? file : nullptr);
+	if (table_file && table_file != file) {
+	    loaded_size += table_file->get_size();
+	    file = std::move(table_file);
+	}
+    }
+}
+
 void
 HoneyDatabase::readahead_for_query(const Xapian::Query& query) const
 {
@@ -323,6 +347,16 @@ HoneyDatabase::open_allterms(const string& prefix) const
 PositionList*
 HoneyDatabase::open_position_list(Xapian::docid did, const string& term) const
 {
+    if (position_table.get_aligned_positions()) {
+	// The positional data is indexed by the posting's position in the
+	// posting list, so we need to find that first.
+	unique_ptr<LeafPostList> pl(postlist_table.open_post_list(this, term,
+								  false));
+	pl->skip_to(did, 0.0);
+	if (pl->at_end() || pl->get_docid() != did)
+	    return new HoneyPositionList(string());
+	return pl->open_position_list();
+    }
     return new HoneyPositionList(position_table, did, term);
 }
 
@@ -447,6 +481,20 @@ HoneyDatabase::reopen()
     return false;
 }
 
+Xapian::Database::Internal*
+HoneyDatabase::open_replacement() const
+{
+    // A single file database (which has an empty path) can't have an
+    // overlay.
+    if (path.empty() ||
+	!file_exists(path + "/" HONEY_OVERLAY_DIR "/iamglass")) {
+	return NULL;
+    }
+    unique_ptr<HoneyOverlayDatabase> overlay(new HoneyOverlayDatabase(path));
+    if (loaded_size) overlay->load_into_memory();
+    return overlay.release();
+}
+
 void
 HoneyDatabase::close()
 {
@@ -471,6 +519,18 @@ HoneyDatabase::get_revision() const
     return version_file.get_revision();
 }
 
+size_t
+HoneyDatabase::get_memory_footprint() const
+{
+    return loaded_size +
+	   docdata_table.get_memory_footprint() +
+	   postlist_table.get_memory_footprint() +
+	   position_table.get_memory_footprint() +
+	   spelling_table.get_memory_footprint() +
+	   synonym_table.get_memory_footprint() +
+	   termlist_table.get_memory_footprint();
+}
+
 string
 HoneyDatabase::get_uuid() const
 {
@@ -37,6 +37,7 @@
 
 class HoneyAllTermsList;
 class HoneyCursor;
+class HoneyOverlayDatabase;
 class HoneyPostList;
 class HoneySynonymTermList;
 class HoneySpellingWordsList;
@@ -81,6 +82,9 @@ class HoneyDatabase : public Xapian::Database::Internal {
 
     mutable HoneyCursor* doclen_cursor = NULL;
 
+    /// The number of bytes of the database's files loaded into memory.
+    size_t loaded_size = 0;
+
     [[noreturn]]
     void throw_termlist_table_close_exception() const;
 
@@ -93,6 +97,12 @@ class HoneyDatabase : public Xapian::Database::Internal {
 
     ~HoneyDatabase();
 
+    /** Load the tables into memory.
+     *
+     *  Used to implement Xapian::DB_LOAD_INTO_MEMORY.
+     */
+    void load_into_memory();
+
     void readahead_for_query(const Xapian::Query& query) const;
 
     Xapian::doccount get_doccount() const;
@@ -326,6 +336,13 @@ class HoneyDatabase : public Xapian::Database::Internal {
      */
     bool reopen();
 
+    /** Open an overlay if one has been created since we were opened.
+     *
+     *  Updates to a honey database are stored in an overlay, which gets
+     *  created the first time the database is opened for writing.
+     */
+    Xapian::Database::Internal* open_replacement() const;
+
     /** Close the database */
     void close();
 
@@ -349,6 +366,8 @@ class HoneyDatabase : public Xapian::Database::Internal {
     /// Get the current revision of the database.
     Xapian::rev get_revision() const;
 
+    size_t get_memory_footprint() const;
+
     /** Get a UUID for the database.
      *
      *  The UUID will persist for the lifetime of the database.
@@ -379,6 +398,13 @@ class HoneyDatabase : public Xapian::Database::Internal {
      */
     void get_used_docid_range(Xapian::docid& first, Xapian::docid& last) const;
 
+    /** Compact databases.
+     *
+     *  @param overlay	If non-NULL, @a sources are the honey database under
+     *			this overlay and its delta converted to honey, whose
+     *			docids interleave.  Documents masked by the overlay
+     *			are dropped from the first.
+     */
     static
     void compact(Xapian::Compactor* compactor,
 		 const char* destdir,
@@ -388,7 +414,23 @@ class HoneyDatabase : public Xapian::Database::Internal {
 		 const std::vector<Xapian::docid>& offset,
 		 Xapian::Compactor::compaction_level compaction,
 		 unsigned flags,
-		 Xapian::docid last_docid);
+		 Xapian::docid last_docid,
+		 const HoneyOverlayDatabase* overlay = NULL);
+
+    /** Compact a honey database with an overlay, merging in the updates.
+     *
+     *  The delta is converted to a temporary honey database, which is then
+     *  merged with the honey database, so the cost of that conversion only
+     *  depends on the size of the updates.
+     */
+    static
+    void compact_overlay(Xapian::Compactor* compactor,
+			 const char* destdir,
+			 const HoneyOverlayDatabase* overlay,
+			 Xapian::docid offset,
+			 Xapian::Compactor::compaction_level compaction,
+			 unsigned flags,
+			 Xapian::docid last_docid);
 
     bool has_uncommitted_changes() const {
 	return false;
@@ -38,6 +38,12 @@
 /// Maximum key length.
 #define HONEY_MAX_KEY_LENGTH 255
 
+/** Subdirectory of a honey database which holds updates to it.
+ *
+ *  This is a glass database - see HoneyOverlayDatabase for details.
+ */
+#define HONEY_OVERLAY_DIR "overlay"
+
 /** Maximum size of a postlist chunk in bytes.
  *
  *  This isn't a hard maximum, but we won't exceed it by much.
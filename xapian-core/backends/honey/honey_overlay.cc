@@ -0,0 +1,787 @@
+/** @file
+ * @brief Writable overlay over a honey database
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "honey_overlay.h"
+
+#include "xapian/constants.h"
+#include "xapian/database.h"
+#include "xapian/document.h"
+#include "xapian/error.h"
+
+#include "backends/backends.h"
+#include "backends/multi/multi_termlist.h"
+#include "expand/ortermlist.h"
+#include "expand/termlistmerger.h"
+#include "honey_database.h"
+#include "honey_defs.h"
+#include "honey_overlaylists.h"
+#include "pack.h"
+#include "stringutils.h"
+
+#include <algorithm>
+#include <memory>
+
+using namespace std;
+
+/** Prefix for the user metadata keys in the delta which record masked docids.
+ *
+ *  The docid follows, encoded with pack_uint_preserving_sort().
+ */
+#define MASK_KEY_PREFIX "\xff\xffmasked:"
+
+/// The user metadata key which records that @a did is masked.
+static string
+mask_key(Xapian::docid did)
+{
+    string key(MASK_KEY_PREFIX);
+    pack_uint_preserving_sort(key, did);
+    return key;
+}
+
+/** Open the termlist for document @a did.
+ *
+ *  @return The termlist, or NULL if document @a did doesn't exist.
+ */
+static TermList*
+open_term_list_if_exists(const Xapian::Database::Internal* db,
+			 Xapian::docid did)
+{
+    try {
+	return db->open_term_list(did);
+    } catch (const Xapian::DocNotFoundError&) {
+	return NULL;
+    }
+}
+
+/// Merge termlists from the honey database and the delta, either may be NULL.
+template<class ORTERMLIST = OrTermList>
+static TermList*
+merge_termlists(TermList* base_tl, TermList* delta_tl)
+{
+    vector<TermList*> termlists;
+    if (base_tl) termlists.push_back(base_tl);
+    if (delta_tl) termlists.push_back(delta_tl);
+    return make_termlist_merger<ORTERMLIST>(termlists);
+}
+
+/** Return the lower of two lower bounds.
+ *
+ *  A bound of 0 may just mean there are no documents, so any non-zero bound
+ *  wins over it.
+ */
+static Xapian::termcount
+combine_lower_bounds(Xapian::termcount a, Xapian::termcount b)
+{
+    if (a == 0) return b;
+    if (b == 0) return a;
+    return min(a, b);
+}
+
+HoneyOverlayDatabase::HoneyOverlayDatabase(const string& path_)
+    : Xapian::Database::Internal(TRANSACTION_READONLY),
+      path(path_),
+      base(new HoneyDatabase(path_)),
+      delta(Xapian::Database(path_ + "/" HONEY_OVERLAY_DIR,
+			     Xapian::DB_BACKEND_GLASS).internal.get()),
+      base_lastdocid(base->get_lastdocid())
+{
+    load_masks();
+}
+
+HoneyOverlayDatabase::HoneyOverlayDatabase(const string& path_,
+					   int flags,
+					   int block_size)
+    : Xapian::Database::Internal(TRANSACTION_NONE),
+      path(path_),
+      base(new HoneyDatabase(path_)),
+      delta(Xapian::WritableDatabase(path_ + "/" HONEY_OVERLAY_DIR,
+				     (flags & ~(Xapian::DB_ACTION_MASK_ |
+						Xapian::DB_BACKEND_MASK_)) |
+				     Xapian::DB_CREATE_OR_OPEN |
+				     Xapian::DB_BACKEND_GLASS,
+				     block_size).internal.get()),
+      base_lastdocid(base->get_lastdocid())
+{
+    load_masks();
+}
+
+bool
+HoneyOverlayDatabase::is_mask_key(const string& key)
+{
+    return startswith(key, MASK_KEY_PREFIX);
+}
+
+void
+HoneyOverlayDatabase::load_into_memory()
+{
+    static_cast<HoneyDatabase*>(base.get())->load_into_memory();
+}
+
+void
+HoneyOverlayDatabase::mask(Xapian::docid did, TermList* termlist)
+{
+    unique_ptr<TermList> tl(termlist);
+    masked[did] = true;
+    ++masked_docids;
+    if (!tl) return;
+
+    ++masked_doccount;
+    for (tl->next(); !tl->at_end(); tl->next()) {
+	Xapian::termcount wdf = tl->get_wdf();
+	auto& freqs = masked_freqs[tl->get_termname()];
+	++freqs.first;
+	freqs.second += wdf;
+	masked_length += wdf;
+    }
+
+    Xapian::Document doc(base->open_document(did, false));
+    for (auto v = doc.values_begin(); v != doc.values_end(); ++v) {
+	++masked_value_freqs[v.get_valueno()];
+    }
+}
+
+void
+HoneyOverlayDatabase::mask_and_record(Xapian::docid did, TermList* termlist)
+{
+    unique_ptr<TermList> tl(termlist);
+    // Record the mask first, as that fails if the overlay isn't writable.
+    // The value is unused, but an empty value would delete the entry.
+    delta->set_metadata(mask_key(did), "1");
+    mask(did, tl.release());
+}
+
+void
+HoneyOverlayDatabase::load_masks(bool incremental)
+{
+    vector<Xapian::docid> dids;
+    Xapian::doccount already_masked = 0;
+    unique_ptr<TermList> keys(delta->open_metadata_keylist(MASK_KEY_PREFIX));
+    if (keys) {
+	for (keys->next(); !keys->at_end(); keys->next()) {
+	    const string& key = keys->get_termname();
+	    const char* p = key.data() + CONST_STRLEN(MASK_KEY_PREFIX);
+	    const char* end = key.data() + key.size();
+	    Xapian::docid did;
+	    if (!unpack_uint_preserving_sort(&p, end, &did) || p != end ||
+		did == 0 || did > base_lastdocid) {
+		throw Xapian::DatabaseCorruptError("Bad masked docid in honey "
+						   "overlay");
+	    }
+	    if (incremental && masked[did]) ++already_masked;
+	    dids.push_back(did);
+	}
+    }
+
+    if (!incremental || already_masked != masked_docids) {
+	masked.assign(base_lastdocid + 1, false);
+	masked_docids = 0;
+	masked_doccount = 0;
+	masked_length = 0;
+	masked_freqs.clear();
+	masked_value_freqs.clear();
+    }
+
+    for (Xapian::docid did : dids) {
+	if (!masked[did]) {
+	    mask(did, open_term_list_if_exists(base.get(), did));
+	}
+    }
+}
+
+void
+HoneyOverlayDatabase::cancel_after_error()
+{
+    try {
+	cancel();
+    } catch (...) {
+	// Report the original error rather than any from cancelling.
+    }
+}
+
+void
+HoneyOverlayDatabase::readahead_for_query(const Xapian::Query& query) const
+{
+    base->readahead_for_query(query);
+}
+
+Xapian::doccount
+HoneyOverlayDatabase::get_doccount() const
+{
+    return base->get_doccount() - masked_doccount + delta->get_doccount();
+}
+
+Xapian::docid
+HoneyOverlayDatabase::get_lastdocid() const
+{
+    return max(base_lastdocid, delta->get_lastdocid());
+}
+
+Xapian::totallength
+HoneyOverlayDatabase::get_total_length() const
+{
+    return base->get_total_length() - masked_length +
+	   delta->get_total_length();
+}
+
+Xapian::termcount
+HoneyOverlayDatabase::get_doclength(Xapian::docid did) const
+{
+    return shard_for(did)->get_doclength(did);
+}
+
+Xapian::termcount
+HoneyOverlayDatabase::get_unique_terms(Xapian::docid did) const
+{
+    return shard_for(did)->get_unique_terms(did);
+}
+
+Xapian::termcount
+HoneyOverlayDatabase::get_wdfdocmax(Xapian::docid did) const
+{
+    return shard_for(did)->get_wdfdocmax(did);
+}
+
+void
+HoneyOverlayDatabase::get_freqs(const string& term,
+				Xapian::doccount* termfreq_ptr,
+				Xapian::termcount* collfreq_ptr) const
+{
+    Assert(!term.empty());
+
+    Xapian::doccount base_tf, delta_tf;
+    Xapian::termcount base_cf, delta_cf;
+    base->get_freqs(term,
+		    termfreq_ptr ? &base_tf : NULL,
+		    collfreq_ptr ? &base_cf : NULL);
+    delta->get_freqs(term,
+		     termfreq_ptr ? &delta_tf : NULL,
+		     collfreq_ptr ? &delta_cf : NULL);
+    auto i = masked_freqs.find(term);
+    if (termfreq_ptr) {
+	*termfreq_ptr = base_tf + delta_tf;
+	if (i != masked_freqs.end()) *termfreq_ptr -= i->second.first;
+    }
+    if (collfreq_ptr) {
+	*collfreq_ptr = base_cf + delta_cf;
+	if (i != masked_freqs.end()) *collfreq_ptr -= i->second.second;
+    }
+}
+
+Xapian::doccount
+HoneyOverlayDatabase::get_value_freq(Xapian::valueno slot) const
+{
+    Xapian::doccount result = base->get_value_freq(slot) +
+			      delta->get_value_freq(slot);
+    auto i = masked_value_freqs.find(slot);
+    if (i != masked_value_freqs.end()) result -= i->second;
+    return result;
+}
+
+string
+HoneyOverlayDatabase::get_value_lower_bound(Xapian::valueno slot) const
+{
+    string result = base->get_value_lower_bound(slot);
+    string delta_result = delta->get_value_lower_bound(slot);
+    if (result.empty() || (!delta_result.empty() && delta_result < result))
+	result = std::move(delta_result);
+    return result;
+}
+
+string
+HoneyOverlayDatabase::get_value_upper_bound(Xapian::valueno slot) const
+{
+    return max(base->get_value_upper_bound(slot),
+	       delta->get_value_upper_bound(slot));
+}
+
+Xapian::termcount
+HoneyOverlayDatabase::get_doclength_lower_bound() const
+{
+    return combine_lower_bounds(base->get_doclength_lower_bound(),
+				delta->get_doclength_lower_bound());
+}
+
+Xapian::termcount
+HoneyOverlayDatabase::get_doclength_upper_bound() const
+{
+    return max(base->get_doclength_upper_bound(),
+	       delta->get_doclength_upper_bound());
+}
+
+Xapian::termcount
+HoneyOverlayDatabase::get_wdf_upper_bound(const string& term) const
+{
+    return max(base->get_wdf_upper_bound(term),
+	       delta->get_wdf_upper_bound(term));
+}
+
+Xapian::termcount
+HoneyOverlayDatabase::get_unique_terms_lower_bound() const
+{
+    return combine_lower_bounds(base->get_unique_terms_lower_bound(),
+				delta->get_unique_terms_lower_bound());
+}
+
+Xapian::termcount
+HoneyOverlayDatabase::get_unique_terms_upper_bound() const
+{
+    return max(base->get_unique_terms_upper_bound(),
+	       delta->get_unique_terms_upper_bound());
+}
+
+bool
+HoneyOverlayDatabase::term_exists(const string& term) const
+{
+    if (term.empty()) {
+	return get_doccount() != 0;
+    }
+    Xapian::doccount tf;
+    get_freqs(term, &tf, NULL);
+    return tf != 0;
+}
+
+bool
+HoneyOverlayDatabase::has_positions() const
+{
+    return base->has_positions() || delta->has_positions();
+}
+
+PostList*
+HoneyOverlayDatabase::open_post_list(const string& term) const
+{
+    return HoneyOverlayDatabase::open_leaf_post_list(term, false);
+}
+
+LeafPostList*
+HoneyOverlayDatabase::open_leaf_post_list(const string& term,
+					  bool need_read_pos) const
+{
+    bool base_masked;
+    Xapian::doccount delta_tf;
+    if (term.empty()) {
+	base_masked = (masked_doccount != 0);
+	delta_tf = delta->get_doccount();
+    } else {
+	base_masked = (masked_freqs.find(term) != masked_freqs.end());
+	delta->get_freqs(term, &delta_tf, NULL);
+    }
+    if (!base_masked && delta_tf == 0) {
+	// The honey database's postlist is all we need.
+	return base->open_leaf_post_list(term, need_read_pos);
+    }
+
+    Xapian::doccount termfreq;
+    if (term.empty()) {
+	termfreq = get_doccount();
+    } else {
+	get_freqs(term, &termfreq, NULL);
+    }
+    unique_ptr<LeafPostList> base_pl(base->open_leaf_post_list(term,
+							       need_read_pos));
+    unique_ptr<LeafPostList> delta_pl(delta->open_leaf_post_list(term,
+								 need_read_pos));
+    return new HoneyOverlayPostList(this, term,
+				    base_pl.release(), delta_pl.release(),
+				    termfreq);
+}
+
+ValueList*
+HoneyOverlayDatabase::open_value_list(Xapian::valueno slot) const
+{
+    if (masked_value_freqs.find(slot) == masked_value_freqs.end() &&
+	delta->get_value_freq(slot) == 0) {
+	return base->open_value_list(slot);
+    }
+    unique_ptr<ValueList> base_vl(base->open_value_list(slot));
+    unique_ptr<ValueList> delta_vl(delta->open_value_list(slot));
+    return new HoneyOverlayValueList(this, base_vl.release(),
+				     delta_vl.release());
+}
+
+TermList*
+HoneyOverlayDatabase::open_term_list(Xapian::docid did) const
+{
+    // Wrap the termlist so that it reports the termfreqs for the overlay.
+    return new MultiTermList(this, open_term_list_direct(did));
+}
+
+TermList*
+HoneyOverlayDatabase::open_term_list_direct(Xapian::docid did) const
+{
+    return shard_for(did)->open_term_list_direct(did);
+}
+
+TermList*
+HoneyOverlayDatabase::open_allterms(const string& prefix) const
+{
+    if (masked_freqs.empty() && delta->get_doccount() == 0) {
+	return base->open_allterms(prefix);
+    }
+    unique_ptr<TermList> base_tl(base->open_allterms(prefix));
+    unique_ptr<TermList> delta_tl(delta->open_allterms(prefix));
+    return new HoneyOverlayAllTermsList(this, base_tl.release(),
+					delta_tl.release());
+}
+
+PositionList*
+HoneyOverlayDatabase::open_position_list(Xapian::docid did,
+					 const string& term) const
+{
+    return shard_for(did)->open_position_list(did, term);
+}
+
+Xapian::Document::Internal*
+HoneyOverlayDatabase::open_document(Xapian::docid did, bool lazy) const
+{
+    return shard_for(did)->open_document(did, lazy);
+}
+
+TermList*
+HoneyOverlayDatabase::open_spelling_termlist(const string& word) const
+{
+    unique_ptr<TermList> base_tl(base->open_spelling_termlist(word));
+    TermList* delta_tl = delta->open_spelling_termlist(word);
+    return merge_termlists(base_tl.release(), delta_tl);
+}
+
+TermList*
+HoneyOverlayDatabase::open_spelling_wordlist() const
+{
+    unique_ptr<TermList> base_tl(base->open_spelling_wordlist());
+    TermList* delta_tl = delta->open_spelling_wordlist();
+    return merge_termlists<FreqAdderOrTermList>(base_tl.release(), delta_tl);
+}
+
+Xapian::doccount
+HoneyOverlayDatabase::get_spelling_frequency(const string& word) const
+{
+    return base->get_spelling_frequency(word) +
+	   delta->get_spelling_frequency(word);
+}
+
+void
+HoneyOverlayDatabase::add_spelling(const string& word,
+				   Xapian::termcount freqinc) const
+{
+    delta->add_spelling(word, freqinc);
+}
+
+Xapian::termcount
+HoneyOverlayDatabase::remove_spelling(const string& word,
+				      Xapian::termcount freqdec) const
+{
+    // Any frequency from the honey database can't be removed, which we report
+    // in the same way as removing more than the frequency.
+    return delta->remove_spelling(word, freqdec);
+}
+
+TermList*
+HoneyOverlayDatabase::open_synonym_termlist(const string& term) const
+{
+    unique_ptr<TermList> base_tl(base->open_synonym_termlist(term));
+    TermList* delta_tl = delta->open_synonym_termlist(term);
+    return merge_termlists(base_tl.release(), delta_tl);
+}
+
+TermList*
+HoneyOverlayDatabase::open_synonym_keylist(const string& prefix) const
+{
+    unique_ptr<TermList> base_tl(base->open_synonym_keylist(prefix));
+    TermList* delta_tl = delta->open_synonym_keylist(prefix);
+    return merge_termlists(base_tl.release(), delta_tl);
+}
+
+void
+HoneyOverlayDatabase::add_synonym(const string& term,
+				  const string& synonym) const
+{
+    delta->add_synonym(term, synonym);
+}
+
+void
+HoneyOverlayDatabase::remove_synonym(const string& term,
+				     const string& synonym) const
+{
+    unique_ptr<TermList> base_tl(base->open_synonym_termlist(term));
+    if (base_tl) {
+	base_tl->skip_to(synonym);
+	if (!base_tl->at_end() && base_tl->get_termname() == synonym) {
+	    throw Xapian::UnimplementedError("Can't remove synonyms from a "
+					     "honey database");
+	}
+    }
+    delta->remove_synonym(term, synonym);
+}
+
+void
+HoneyOverlayDatabase::clear_synonyms(const string& term) const
+{
+    unique_ptr<TermList> base_tl(base->open_synonym_termlist(term));
+    if (base_tl) {
+	base_tl->next();
+	if (!base_tl->at_end()) {
+	    throw Xapian::UnimplementedError("Can't remove synonyms from a "
+					     "honey database");
+	}
+    }
+    delta->clear_synonyms(term);
+}
+
+string
+HoneyOverlayDatabase::get_metadata(const string& key) const
+{
+    if (startswith(key, MASK_KEY_PREFIX)) {
+	return string();
+    }
+    string value = delta->get_metadata(key);
+    if (value.empty()) {
+	value = base->get_metadata(key);
+    }
+    return value;
+}
+
+TermList*
+HoneyOverlayDatabase::open_metadata_keylist(const string& prefix) const
+{
+    unique_ptr<TermList> base_tl(base->open_metadata_keylist(prefix));
+    TermList* delta_tl = delta->open_metadata_keylist(prefix);
+    if (delta_tl) {
+	delta_tl = new HoneyOverlayMetadataKeyList(delta_tl, MASK_KEY_PREFIX);
+    }
+    return merge_termlists(base_tl.release(), delta_tl);
+}
+
+void
+HoneyOverlayDatabase::set_metadata(const string& key, const string& value)
+{
+    if (startswith(key, MASK_KEY_PREFIX)) {
+	throw Xapian::InvalidArgumentError("User metadata keys starting "
+					   "\"\\xff\\xffmasked:\" are used "
+					   "internally by honey overlays");
+    }
+    if (value.empty() && !base->get_metadata(key).empty()) {
+	throw Xapian::UnimplementedError("Can't remove user metadata from a "
+					 "honey database");
+    }
+    delta->set_metadata(key, value);
+}
+
+bool
+HoneyOverlayDatabase::reopen()
+{
+    if (!delta->reopen()) {
+	return false;
+    }
+    load_masks(true);
+    return true;
+}
+
+void
+HoneyOverlayDatabase::close()
+{
+    base->close();
+    delta->close();
+}
+
+void
+HoneyOverlayDatabase::commit()
+{
+    try {
+	delta->commit();
+    } catch (...) {
+	cancel_after_error();
+	throw;
+    }
+}
+
+void
+HoneyOverlayDatabase::cancel()
+{
+    delta->cancel();
+    load_masks();
+}
+
+void
+HoneyOverlayDatabase::begin_transaction(bool flushed)
+{
+    delta->begin_transaction(flushed);
+}
+
+void
+HoneyOverlayDatabase::end_transaction(bool do_commit)
+{
+    try {
+	delta->end_transaction(do_commit);
+    } catch (...) {
+	cancel_after_error();
+	throw;
+    }
+    if (!do_commit) {
+	load_masks();
+    }
+}
+
+Xapian::docid
+HoneyOverlayDatabase::add_document(const Xapian::Document& document)
+{
+    Xapian::docid did = get_lastdocid() + 1;
+    if (rare(did == 0)) {
+	throw Xapian::DatabaseError("Run out of docids - you'll have to use "
+				    "copydatabase to eliminate any gaps "
+				    "before you can add more documents");
+    }
+    try {
+	delta->replace_document(did, document);
+    } catch (...) {
+	cancel_after_error();
+	throw;
+    }
+    return did;
+}
+
+void
+HoneyOverlayDatabase::delete_document(Xapian::docid did)
+{
+    if (in_base(did)) {
+	// This throws DocNotFoundError if did isn't in the honey database,
+	// which happens before anything has been changed.
+	unique_ptr<TermList> tl(base->open_term_list(did));
+	try {
+	    mask_and_record(did, tl.release());
+	} catch (...) {
+	    cancel_after_error();
+	    throw;
+	}
+	return;
+    }
+    try {
+	delta->delete_document(did);
+    } catch (const Xapian::DocNotFoundError&) {
+	// Glass reports this before changing anything.
+	throw;
+    } catch (...) {
+	cancel_after_error();
+	throw;
+    }
+}
+
+void
+HoneyOverlayDatabase::replace_document(Xapian::docid did,
+				       const Xapian::Document& document)
+{
+    try {
+	if (in_base(did)) {
+	    // We need to mask did even if it's an unused docid in the honey
+	    // database so that we read the new document from the delta.
+	    mask_and_record(did, open_term_list_if_exists(base.get(), did));
+	}
+	delta->replace_document(did, document);
+    } catch (...) {
+	cancel_after_error();
+	throw;
+    }
+}
+
+void
+HoneyOverlayDatabase::request_document(Xapian::docid did) const
+{
+    shard_for(did)->request_document(did);
+}
+
+Xapian::rev
+HoneyOverlayDatabase::get_revision() const
+{
+    return delta->get_revision();
+}
+
+size_t
+HoneyOverlayDatabase::get_buffered_memory() const
+{
+    return delta->get_buffered_memory();
+}
+
+size_t
+HoneyOverlayDatabase::get_memory_footprint() const
+{
+    return base->get_memory_footprint() + delta->get_memory_footprint();
+}
+
+int
+HoneyOverlayDatabase::get_backend_info(string* path_ptr) const
+{
+    if (path_ptr)
+	*path_ptr = path;
+    return BACKEND_HONEY_OVERLAY;
+}
+
+bool
+HoneyOverlayDatabase::locked() const
+{
+    return delta->locked();
+}
+
+void
+HoneyOverlayDatabase::get_used_docid_range(Xapian::docid& first,
+					   Xapian::docid& last) const
+{
+    first = last = 0;
+    if (delta->get_doccount() != 0) {
+	delta->get_used_docid_range(first, last);
+    }
+    if (base->get_doccount() == masked_doccount) {
+	return;
+    }
+
+    // Find the first and last documents in the honey database which aren't
+    // masked.  We only need to step over masked docids and any gaps.
+    Xapian::docid base_first, base_last;
+    base->get_used_docid_range(base_first, base_last);
+    auto exists = [this](Xapian::docid did) {
+	if (!in_base(did)) return false;
+	unique_ptr<TermList> tl(open_term_list_if_exists(base.get(), did));
+	return bool(tl);
+    };
+    while (!exists(base_first)) ++base_first;
+    while (!exists(base_last)) --base_last;
+    if (first == 0 || base_first < first) first = base_first;
+    if (base_last > last) last = base_last;
+}
+
+string
+HoneyOverlayDatabase::reconstruct_text(Xapian::docid did,
+				       size_t length,
+				       const string& prefix,
+				       Xapian::termpos start_pos,
+				       Xapian::termpos end_pos) const
+{
+    return shard_for(did)->reconstruct_text(did, length, prefix,
+					    start_pos, end_pos);
+}
+
+string
+HoneyOverlayDatabase::get_description() const
+{
+    string desc = "HoneyOverlay(";
+    desc += path;
+    desc += ')';
+    return desc;
+}
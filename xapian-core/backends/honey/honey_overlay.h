@@ -0,0 +1,305 @@
+/** @file
+ * @brief Writable overlay over a honey database
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_HONEY_OVERLAY_H
+#define XAPIAN_INCLUDED_HONEY_OVERLAY_H
+
+#include "backends/databaseinternal.h"
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+/** A honey database with updates layered over it.
+ *
+ *  Honey databases can't be modified, so updates are stored in a glass
+ *  database (the "delta") in the HONEY_OVERLAY_DIR subdirectory of the honey
+ *  database, and the two are presented as a single database with the same
+ *  document ids:
+ *
+ *   - New documents are added to the delta.
+ *
+ *   - Deleting or replacing a document from the honey database "masks" it,
+ *     which hides it in the honey database (and a replacement document is
+ *     added to the delta with the same docid).  The masked docids are stored
+ *     as user metadata entries in the delta so they're committed atomically
+ *     with the rest of the changes.  The keys of these entries are hidden
+ *     from the user metadata API.
+ *
+ *  The statistics for the honey database are adjusted for the masked
+ *  documents, which we work out from their termlists when the overlay is
+ *  opened, so the cost of opening grows with the number of documents
+ *  deleted or replaced.  Committed masks are never removed, so reopen() only
+ *  needs to read the termlists of documents masked since.
+ *
+ *  Spelling and synonym data and user metadata in the honey database can be
+ *  added to, but not removed.
+ *
+ *  Compacting an overlay merges the updates to produce a new database.
+ */
+class HoneyOverlayDatabase : public Xapian::Database::Internal {
+    /// Compaction reads the honey database and the delta directly.
+    friend class HoneyDatabase;
+
+    /// Don't allow assignment.
+    HoneyOverlayDatabase& operator=(const HoneyOverlayDatabase&) = delete;
+
+    /// Don't allow copying.
+    HoneyOverlayDatabase(const HoneyOverlayDatabase&) = delete;
+
+    /// Path of the honey database.
+    std::string path;
+
+    /// The honey database.
+    Xapian::Internal::intrusive_ptr_nonnull<Xapian::Database::Internal> base;
+
+    /// The glass database holding the updates.
+    Xapian::Internal::intrusive_ptr_nonnull<Xapian::Database::Internal> delta;
+
+    /// The last docid in the honey database.
+    Xapian::docid base_lastdocid;
+
+    /** Which docids in the honey database are masked.
+     *
+     *  Indexed by docid, so this has (base_lastdocid + 1) entries.
+     */
+    std::vector<bool> masked;
+
+    /// The number of masked docids (including any not in the honey database).
+    Xapian::doccount masked_docids = 0;
+
+    /// The number of masked documents which exist in the honey database.
+    Xapian::doccount masked_doccount = 0;
+
+    /// The total length of the masked documents.
+    Xapian::totallength masked_length = 0;
+
+    /// The termfreq and collection freq of each term in the masked documents.
+    std::map<std::string, std::pair<Xapian::doccount, Xapian::termcount>>
+	masked_freqs;
+
+    /// The number of masked documents with a value in each slot.
+    std::map<Xapian::valueno, Xapian::doccount> masked_value_freqs;
+
+    /** Mask a docid in the honey database and update the statistics.
+     *
+     *  @param did		The docid to mask.
+     *  @param termlist	Termlist for document @a did in the honey
+     *			database, or NULL if it doesn't exist there.  Takes
+     *			ownership of this object.
+     */
+    void mask(Xapian::docid did, TermList* termlist);
+
+    /// Mask @a did and record that in the delta.
+    void mask_and_record(Xapian::docid did, TermList* termlist);
+
+    /** Read the masked docids from the delta.
+     *
+     *  @param incremental	Only read the termlists of documents which
+     *				aren't already masked.  If any docid we have
+     *				masked is no longer masked in the delta (e.g.
+     *				uncommitted changes were discarded) we reload
+     *				all the masks anyway.
+     */
+    void load_masks(bool incremental = false);
+
+    /** Discard uncommitted changes after an update to the delta failed.
+     *
+     *  Glass discards all uncommitted changes if an update fails, so we do
+     *  the same, which also puts the masks back in step with the delta.
+     */
+    void cancel_after_error();
+
+    /// Return the database to read document @a did from.
+    Xapian::Database::Internal* shard_for(Xapian::docid did) const {
+	return in_base(did) ? base.get() : delta.get();
+    }
+
+  public:
+    /// Open the overlay on the honey database at @a path_ read-only.
+    explicit HoneyOverlayDatabase(const std::string& path_);
+
+    /** Open the overlay on the honey database at @a path_ for writing.
+     *
+     *  The delta is created if it doesn't exist yet.
+     *
+     *  @param flags	Flags to open the delta with (the action and backend
+     *			are ignored).
+     *  @param block_size	Block size to create the delta with.
+     */
+    HoneyOverlayDatabase(const std::string& path_, int flags, int block_size);
+
+    /** Load the honey database into memory.
+     *
+     *  Used to implement Xapian::DB_LOAD_INTO_MEMORY.
+     */
+    void load_into_memory();
+
+    /// Is @a did a document in the honey database which hasn't been masked?
+    bool in_base(Xapian::docid did) const {
+	return did <= base_lastdocid && !masked[did];
+    }
+
+    /// Is @a key a user metadata key in the delta which records a mask?
+    static bool is_mask_key(const std::string& key);
+
+    /// Return the number of masked documents which contain @a term.
+    Xapian::doccount get_masked_termfreq(const std::string& term) const {
+	auto i = masked_freqs.find(term);
+	return i == masked_freqs.end() ? 0 : i->second.first;
+    }
+
+    void readahead_for_query(const Xapian::Query& query) const;
+
+    Xapian::doccount get_doccount() const;
+
+    Xapian::docid get_lastdocid() const;
+
+    Xapian::totallength get_total_length() const;
+
+    Xapian::termcount get_doclength(Xapian::docid did) const;
+
+    Xapian::termcount get_unique_terms(Xapian::docid did) const;
+
+    Xapian::termcount get_wdfdocmax(Xapian::docid did) const;
+
+    void get_freqs(const std::string& term,
+		   Xapian::doccount* termfreq_ptr,
+		   Xapian::termcount* collfreq_ptr) const;
+
+    Xapian::doccount get_value_freq(Xapian::valueno slot) const;
+
+    std::string get_value_lower_bound(Xapian::valueno slot) const;
+
+    std::string get_value_upper_bound(Xapian::valueno slot) const;
+
+    Xapian::termcount get_doclength_lower_bound() const;
+
+    Xapian::termcount get_doclength_upper_bound() const;
+
+    Xapian::termcount get_wdf_upper_bound(const std::string& term) const;
+
+    Xapian::termcount get_unique_terms_lower_bound() const;
+
+    Xapian::termcount get_unique_terms_upper_bound() const;
+
+    bool term_exists(const std::string& term) const;
+
+    bool has_positions() const;
+
+    PostList* open_post_list(const std::string& term) const;
+
+    LeafPostList* open_leaf_post_list(const std::string& term,
+				      bool need_read_pos) const;
+
+    ValueList* open_value_list(Xapian::valueno slot) const;
+
+    TermList* open_term_list(Xapian::docid did) const;
+
+    TermList* open_term_list_direct(Xapian::docid did) const;
+
+    TermList* open_allterms(const std::string& prefix) const;
+
+    PositionList* open_position_list(Xapian::docid did,
+				     const std::string& term) const;
+
+    Xapian::Document::Internal* open_document(Xapian::docid did,
+					      bool lazy) const;
+
+    TermList* open_spelling_termlist(const std::string& word) const;
+
+    TermList* open_spelling_wordlist() const;
+
+    Xapian::doccount get_spelling_frequency(const std::string& word) const;
+
+    void add_spelling(const std::string& word,
+		      Xapian::termcount freqinc) const;
+
+    Xapian::termcount remove_spelling(const std::string& word,
+				      Xapian::termcount freqdec) const;
+
+    TermList* open_synonym_termlist(const std::string& term) const;
+
+    TermList* open_synonym_keylist(const std::string& prefix) const;
+
+    void add_synonym(const std::string& term,
+		     const std::string& synonym) const;
+
+    void remove_synonym(const std::string& term,
+			const std::string& synonym) const;
+
+    void clear_synonyms(const std::string& term) const;
+
+    std::string get_metadata(const std::string& key) const;
+
+    TermList* open_metadata_keylist(const std::string& prefix) const;
+
+    void set_metadata(const std::string& key, const std::string& value);
+
+    bool reopen();
+
+    void close();
+
+    void commit();
+
+    void cancel();
+
+    void begin_transaction(bool flushed);
+
+    void end_transaction(bool do_commit);
+
+    Xapian::docid add_document(const Xapian::Document& document);
+
+    // Stop the default implementation of delete_document(term) and
+    // replace_document(term) from being hidden.
+    using Xapian::Database::Internal::delete_document;
+    using Xapian::Database::Internal::replace_document;
+
+    void delete_document(Xapian::docid did);
+
+    void replace_document(Xapian::docid did,
+			  const Xapian::Document& document);
+
+    void request_document(Xapian::docid did) const;
+
+    Xapian::rev get_revision() const;
+
+    size_t get_buffered_memory() const;
+
+    size_t get_memory_footprint() const;
+
+    int get_backend_info(std::string* path_ptr) const;
+
+    bool locked() const;
+
+    void get_used_docid_range(Xapian::docid& first,
+			      Xapian::docid& last) const;
+
+    std::string reconstruct_text(Xapian::docid did,
+				 size_t length,
+				 const std::string& prefix,
+				 Xapian::termpos start_pos,
+				 Xapian::termpos end_pos) const;
+
+    std::string get_description() const;
+};
+
+#endif // XAPIAN_INCLUDED_HONEY_OVERLAY_H
@@ -0,0 +1,405 @@
+/** @file
+ * @brief Lists which merge a honey database with its overlay
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "honey_overlaylists.h"
+
+#include "omassert.h"
+#include "stringutils.h"
+
+using namespace std;
+
+/// Advance a termlist, handling it being pruned.
+static void
+next_term(unique_ptr<TermList>& tl)
+{
+    TermList* p = tl->next();
+    if (p) tl.reset(p);
+}
+
+/// Skip a termlist to @a term, handling it being pruned.
+static void
+skip_to_term(unique_ptr<TermList>& tl, const string& term)
+{
+    TermList* p = tl->skip_to(term);
+    if (p) tl.reset(p);
+}
+
+Xapian::doccount
+HoneyOverlayPostList::get_termfreq() const
+{
+    return termfreq;
+}
+
+Xapian::docid
+HoneyOverlayPostList::get_docid() const
+{
+    Assert(current);
+    return current->get_docid();
+}
+
+Xapian::termcount
+HoneyOverlayPostList::get_wdf() const
+{
+    Assert(current);
+    return current->get_wdf();
+}
+
+PositionList*
+HoneyOverlayPostList::read_position_list()
+{
+    Assert(current);
+    return current->read_position_list();
+}
+
+PositionList*
+HoneyOverlayPostList::open_position_list() const
+{
+    Assert(current);
+    return current->open_position_list();
+}
+
+void
+HoneyOverlayPostList::skip_masked()
+{
+    while (!base_pl->at_end() && !db->in_base(base_pl->get_docid())) {
+	base_pl->next(0.0);
+    }
+}
+
+void
+HoneyOverlayPostList::update_current()
+{
+    if (base_pl->at_end()) {
+	current = delta_pl->at_end() ? nullptr : delta_pl.get();
+    } else if (delta_pl->at_end() ||
+	       base_pl->get_docid() < delta_pl->get_docid()) {
+	current = base_pl.get();
+    } else {
+	current = delta_pl.get();
+    }
+}
+
+PostList*
+HoneyOverlayPostList::next(double)
+{
+    if (!started) {
+	started = true;
+	base_pl->next(0.0);
+	skip_masked();
+	delta_pl->next(0.0);
+    } else if (current == base_pl.get()) {
+	base_pl->next(0.0);
+	skip_masked();
+    } else {
+	Assert(current);
+	delta_pl->next(0.0);
+    }
+    update_current();
+    return NULL;
+}
+
+PostList*
+HoneyOverlayPostList::skip_to(Xapian::docid did, double)
+{
+    if (!started) {
+	started = true;
+	base_pl->skip_to(did, 0.0);
+	skip_masked();
+	delta_pl->skip_to(did, 0.0);
+    } else {
+	if (!base_pl->at_end() && base_pl->get_docid() < did) {
+	    base_pl->skip_to(did, 0.0);
+	    skip_masked();
+	}
+	if (!delta_pl->at_end() && delta_pl->get_docid() < did) {
+	    delta_pl->skip_to(did, 0.0);
+	}
+    }
+    update_current();
+    return NULL;
+}
+
+bool
+HoneyOverlayPostList::at_end() const
+{
+    return started && !current;
+}
+
+string
+HoneyOverlayPostList::get_description() const
+{
+    string desc = "HoneyOverlayPostList(";
+    desc += base_pl->get_description();
+    desc += ", ";
+    desc += delta_pl->get_description();
+    desc += ')';
+    return desc;
+}
+
+Xapian::docid
+HoneyOverlayValueList::get_docid() const
+{
+    Assert(current);
+    return current->get_docid();
+}
+
+string
+HoneyOverlayValueList::get_value() const
+{
+    Assert(current);
+    return current->get_value();
+}
+
+Xapian::valueno
+HoneyOverlayValueList::get_valueno() const
+{
+    return base_vl->get_valueno();
+}
+
+bool
+HoneyOverlayValueList::at_end() const
+{
+    return started && !current;
+}
+
+void
+HoneyOverlayValueList::skip_masked()
+{
+    while (!base_vl->at_end() && !db->in_base(base_vl->get_docid())) {
+	base_vl->next();
+    }
+}
+
+void
+HoneyOverlayValueList::update_current()
+{
+    if (base_vl->at_end()) {
+	current = delta_vl->at_end() ? nullptr : delta_vl.get();
+    } else if (delta_vl->at_end() ||
+	       base_vl->get_docid() < delta_vl->get_docid()) {
+	current = base_vl.get();
+    } else {
+	current = delta_vl.get();
+    }
+}
+
+void
+HoneyOverlayValueList::next()
+{
+    if (!started) {
+	started = true;
+	base_vl->next();
+	skip_masked();
+	delta_vl->next();
+    } else if (current == base_vl.get()) {
+	base_vl->next();
+	skip_masked();
+    } else {
+	Assert(current);
+	delta_vl->next();
+    }
+    update_current();
+}
+
+void
+HoneyOverlayValueList::skip_to(Xapian::docid did)
+{
+    if (!started) {
+	started = true;
+	base_vl->skip_to(did);
+	skip_masked();
+	delta_vl->skip_to(did);
+    } else {
+	if (!base_vl->at_end() && base_vl->get_docid() < did) {
+	    base_vl->skip_to(did);
+	    skip_masked();
+	}
+	if (!delta_vl->at_end() && delta_vl->get_docid() < did) {
+	    delta_vl->skip_to(did);
+	}
+    }
+    update_current();
+}
+
+string
+HoneyOverlayValueList::get_description() const
+{
+    string desc = "HoneyOverlayValueList(";
+    desc += base_vl->get_description();
+    desc += ", ";
+    desc += delta_vl->get_description();
+    desc += ')';
+    return desc;
+}
+
+void
+HoneyOverlayAllTermsList::settle(bool advance)
+{
+    while (true) {
+	if (advance) {
+	    if (!base_tl->at_end() && base_tl->get_termname() == current_term)
+		next_term(base_tl);
+	    if (!delta_tl->at_end() &&
+		delta_tl->get_termname() == current_term)
+		next_term(delta_tl);
+	}
+	advance = true;
+
+	bool base_end = base_tl->at_end();
+	bool delta_end = delta_tl->at_end();
+	if (base_end && delta_end) {
+	    current_term.resize(0);
+	    current_termfreq = 0;
+	    return;
+	}
+
+	Xapian::doccount tf = 0;
+	if (base_end) {
+	    current_term = delta_tl->get_termname();
+	} else {
+	    current_term = base_tl->get_termname();
+	    if (!delta_end) {
+		string delta_term = delta_tl->get_termname();
+		if (delta_term < current_term) {
+		    current_term = std::move(delta_term);
+		}
+	    }
+	}
+	if (!base_end && base_tl->get_termname() == current_term) {
+	    tf = base_tl->get_termfreq() - db->get_masked_termfreq(current_term);
+	}
+	if (!delta_end && delta_tl->get_termname() == current_term) {
+	    tf += delta_tl->get_termfreq();
+	}
+	if (tf) {
+	    current_termfreq = tf;
+	    return;
+	}
+	// The term only occurs in masked documents.
+    }
+}
+
+Xapian::termcount
+HoneyOverlayAllTermsList::get_approx_size() const
+{
+    return base_tl->get_approx_size() + delta_tl->get_approx_size();
+}
+
+string
+HoneyOverlayAllTermsList::get_termname() const
+{
+    return current_term;
+}
+
+Xapian::doccount
+HoneyOverlayAllTermsList::get_termfreq() const
+{
+    return current_termfreq;
+}
+
+TermList*
+HoneyOverlayAllTermsList::next()
+{
+    if (!started) {
+	started = true;
+	next_term(base_tl);
+	next_term(delta_tl);
+	settle(false);
+    } else {
+	settle(true);
+    }
+    return NULL;
+}
+
+TermList*
+HoneyOverlayAllTermsList::skip_to(const string& term)
+{
+    if (!started || (!at_end() && current_term < term)) {
+	started = true;
+	skip_to_term(base_tl, term);
+	skip_to_term(delta_tl, term);
+	settle(false);
+    }
+    return NULL;
+}
+
+bool
+HoneyOverlayAllTermsList::at_end() const
+{
+    return started && current_termfreq == 0;
+}
+
+void
+HoneyOverlayMetadataKeyList::skip_hidden()
+{
+    if (!keys->at_end() && startswith(keys->get_termname(), hidden_prefix)) {
+	// The hidden keys all sort together, so skip to the first key after
+	// them.  The prefix can't be all 0xff bytes, as then no key would sort
+	// after it.
+	string after = hidden_prefix;
+	while (static_cast<unsigned char>(after.back()) == 0xff) {
+	    after.pop_back();
+	}
+	++after.back();
+	skip_to_term(keys, after);
+    }
+}
+
+Xapian::termcount
+HoneyOverlayMetadataKeyList::get_approx_size() const
+{
+    return keys->get_approx_size();
+}
+
+string
+HoneyOverlayMetadataKeyList::get_termname() const
+{
+    return keys->get_termname();
+}
+
+Xapian::doccount
+HoneyOverlayMetadataKeyList::get_termfreq() const
+{
+    return keys->get_termfreq();
+}
+
+TermList*
+HoneyOverlayMetadataKeyList::next()
+{
+    next_term(keys);
+    skip_hidden();
+    return NULL;
+}
+
+TermList*
+HoneyOverlayMetadataKeyList::skip_to(const string& key)
+{
+    skip_to_term(keys, key);
+    skip_hidden();
+    return NULL;
+}
+
+bool
+HoneyOverlayMetadataKeyList::at_end() const
+{
+    return keys->at_end();
+}
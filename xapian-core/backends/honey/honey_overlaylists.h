@@ -0,0 +1,252 @@
+/** @file
+ * @brief Lists which merge a honey database with its overlay
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_HONEY_OVERLAYLISTS_H
+#define XAPIAN_INCLUDED_HONEY_OVERLAYLISTS_H
+
+#include "backends/alltermslist.h"
+#include "backends/leafpostlist.h"
+#include "backends/valuelist.h"
+#include "honey_overlay.h"
+
+#include <memory>
+#include <string>
+
+/** Postlist for a term in a honey database with an overlay.
+ *
+ *  Merges the postlist from the honey database (skipping masked documents)
+ *  with the postlist from the delta.  These never contain the same docid.
+ */
+class HoneyOverlayPostList : public LeafPostList {
+    /// Don't allow assignment.
+    HoneyOverlayPostList& operator=(const HoneyOverlayPostList&) = delete;
+
+    /// Don't allow copying.
+    HoneyOverlayPostList(const HoneyOverlayPostList&) = delete;
+
+    /// The overlay database.
+    Xapian::Internal::intrusive_ptr<const HoneyOverlayDatabase> db;
+
+    /// The postlist from the honey database.
+    std::unique_ptr<LeafPostList> base_pl;
+
+    /// The postlist from the delta.
+    std::unique_ptr<LeafPostList> delta_pl;
+
+    /** The postlist positioned on the current docid.
+     *
+     *  NULL before we start and once we reach the end.
+     */
+    LeafPostList* current = nullptr;
+
+    /// Have we started iterating yet?
+    bool started = false;
+
+    /// The termfreq of the term in the overlay.
+    Xapian::doccount termfreq;
+
+    /// Advance @a base_pl past any masked documents.
+    void skip_masked();
+
+    /// Set @a current to the postlist with the lower docid.
+    void update_current();
+
+  public:
+    HoneyOverlayPostList(const HoneyOverlayDatabase* db_,
+			 const std::string& term_,
+			 LeafPostList* base_pl_,
+			 LeafPostList* delta_pl_,
+			 Xapian::doccount termfreq_)
+	: LeafPostList(term_), db(db_), base_pl(base_pl_),
+	  delta_pl(delta_pl_), termfreq(termfreq_) {}
+
+    Xapian::doccount get_termfreq() const;
+
+    Xapian::docid get_docid() const;
+
+    Xapian::termcount get_wdf() const;
+
+    PositionList* read_position_list();
+
+    PositionList* open_position_list() const;
+
+    PostList* next(double w_min);
+
+    PostList* skip_to(Xapian::docid did, double w_min);
+
+    bool at_end() const;
+
+    std::string get_description() const;
+};
+
+/** Value stream for a slot in a honey database with an overlay.
+ *
+ *  Merges the values from the honey database (skipping masked documents)
+ *  with the values from the delta.
+ */
+class HoneyOverlayValueList : public ValueList {
+    /// Don't allow assignment.
+    HoneyOverlayValueList& operator=(const HoneyOverlayValueList&) = delete;
+
+    /// Don't allow copying.
+    HoneyOverlayValueList(const HoneyOverlayValueList&) = delete;
+
+    /// The overlay database.
+    Xapian::Internal::intrusive_ptr<const HoneyOverlayDatabase> db;
+
+    /// The value stream from the honey database.
+    std::unique_ptr<ValueList> base_vl;
+
+    /// The value stream from the delta.
+    std::unique_ptr<ValueList> delta_vl;
+
+    /** The value stream positioned on the current docid.
+     *
+     *  NULL before we start and once we reach the end.
+     */
+    ValueList* current = nullptr;
+
+    /// Have we started iterating yet?
+    bool started = false;
+
+    /// Advance @a base_vl past any masked documents.
+    void skip_masked();
+
+    /// Set @a current to the value stream with the lower docid.
+    void update_current();
+
+  public:
+    HoneyOverlayValueList(const HoneyOverlayDatabase* db_,
+			  ValueList* base_vl_,
+			  ValueList* delta_vl_)
+	: db(db_), base_vl(base_vl_), delta_vl(delta_vl_) {}
+
+    Xapian::docid get_docid() const;
+
+    std::string get_value() const;
+
+    Xapian::valueno get_valueno() const;
+
+    bool at_end() const;
+
+    void next();
+
+    void skip_to(Xapian::docid did);
+
+    std::string get_description() const;
+};
+
+/** All the terms in a honey database with an overlay.
+ *
+ *  Merges the terms from the honey database and the delta, and adjusts the
+ *  termfreqs for masked documents.  Terms which only occur in masked
+ *  documents are skipped.
+ */
+class HoneyOverlayAllTermsList : public AllTermsList {
+    /// Don't allow assignment.
+    HoneyOverlayAllTermsList& operator=(const HoneyOverlayAllTermsList&) =
+	delete;
+
+    /// Don't allow copying.
+    HoneyOverlayAllTermsList(const HoneyOverlayAllTermsList&) = delete;
+
+    /// The overlay database.
+    Xapian::Internal::intrusive_ptr<const HoneyOverlayDatabase> db;
+
+    /// The terms in the honey database.
+    std::unique_ptr<TermList> base_tl;
+
+    /// The terms in the delta.
+    std::unique_ptr<TermList> delta_tl;
+
+    /// The current term (empty before we start and once we reach the end).
+    std::string current_term;
+
+    /// The termfreq of the current term (0 once we reach the end).
+    Xapian::doccount current_termfreq = 0;
+
+    /// Have we started iterating yet?
+    bool started = false;
+
+    /** Find the first term with a non-zero termfreq.
+     *
+     *  @param advance	Advance the lists past the current term first?
+     */
+    void settle(bool advance);
+
+  public:
+    HoneyOverlayAllTermsList(const HoneyOverlayDatabase* db_,
+			     TermList* base_tl_,
+			     TermList* delta_tl_)
+	: db(db_), base_tl(base_tl_), delta_tl(delta_tl_) {}
+
+    Xapian::termcount get_approx_size() const;
+
+    std::string get_termname() const;
+
+    Xapian::doccount get_termfreq() const;
+
+    TermList* next();
+
+    TermList* skip_to(const std::string& term);
+
+    bool at_end() const;
+};
+
+/** The user metadata keys in the delta of an overlay.
+ *
+ *  Skips the keys which the overlay uses to store masked docids.
+ */
+class HoneyOverlayMetadataKeyList : public AllTermsList {
+    /// Don't allow assignment.
+    HoneyOverlayMetadataKeyList& operator=(const HoneyOverlayMetadataKeyList&) =
+	delete;
+
+    /// Don't allow copying.
+    HoneyOverlayMetadataKeyList(const HoneyOverlayMetadataKeyList&) = delete;
+
+    /// The metadata keys from the delta.
+    std::unique_ptr<TermList> keys;
+
+    /// The prefix of keys to skip.
+    std::string hidden_prefix;
+
+    /// Advance past any keys with @a hidden_prefix.
+    void skip_hidden();
+
+  public:
+    HoneyOverlayMetadataKeyList(TermList* keys_,
+				const std::string& hidden_prefix_)
+	: keys(keys_), hidden_prefix(hidden_prefix_) {}
+
+    Xapian::termcount get_approx_size() const;
+
+    std::string get_termname() const;
+
+    Xapian::doccount get_termfreq() const;
+
+    TermList* next();
+
+    TermList* skip_to(const std::string& key);
+
+    bool at_end() const;
+};
+
+#endif // XAPIAN_INCLUDED_HONEY_OVERLAYLISTS_H
@@ -0,0 +1,319 @@
+/** @file
+ * @brief Encode/decode honey posting data as blocks of bit-packed values.
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "honey_packedpostings.h"
+
+#include "bitunpack.h"
+#include "omassert.h"
+#include "pack.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+
+#ifdef __SSE2__
+# include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace Honey {
+
+/// Throw DatabaseCorruptError for bad posting list data.
+[[noreturn]]
+static void
+throw_corrupt()
+{
+    throw_packed_data_corrupt("Posting list");
+}
+
+/// The number of bits needed to represent @a v.
+static inline unsigned
+bit_length(uint64_t v)
+{
+    unsigned len = 0;
+    while (v) {
+	++len;
+	v >>= 1;
+    }
+    return len;
+}
+
+/// Append @a n values from @a v to @a out.
+template<typename T>
+static void
+encode_values(const T* v, unsigned n, string& out)
+{
+    AssertRel(n, <=, PACKED_POSTINGS_BLOCK);
+    // Count how many values need each number of bits, which is enough to
+    // work out the encoded size for each possible width.
+    unsigned counts[65] = { 0 };
+    for (unsigned i = 0; i != n; ++i) {
+	++counts[bit_length(v[i])];
+    }
+
+    unsigned width = 0;
+    size_t best = size_t(-1);
+    for (unsigned w = 0; w <= 32; ++w) {
+	size_t size = (size_t(n) * w + 7) / 8;
+	for (unsigned len = w + 1; len <= 64; ++len) {
+	    // Index byte and the top len - w bits packed with pack_uint().
+	    size += counts[len] * (1 + (len - w + 6) / 7);
+	}
+	if (size < best) {
+	    best = size;
+	    width = w;
+	}
+    }
+
+    unsigned exceptions = 0;
+    for (unsigned len = width + 1; len <= 64; ++len) {
+	exceptions += counts[len];
+    }
+    out += char(width);
+    out += char(exceptions);
+
+    if (width) {
+	const uint64_t mask = (uint64_t(1) << width) - 1;
+	uint64_t acc = 0;
+	unsigned bits = 0;
+	for (unsigned i = 0; i != n; ++i) {
+	    acc |= (uint64_t(v[i]) & mask) << bits;
+	    bits += width;
+	    while (bits >= 8) {
+		out += char(acc & 0xff);
+		acc >>= 8;
+		bits -= 8;
+	    }
+	}
+	if (bits) out += char(acc);
+    }
+
+    if (exceptions) {
+	for (unsigned i = 0; i != n; ++i) {
+	    uint64_t high = uint64_t(v[i]) >> width;
+	    if (high) {
+		out += char(i);
+		pack_uint(out, high);
+	    }
+	}
+    }
+}
+
+/** Decode @a n values from @a p to @a out.
+ *
+ *  @a out must have space for PACKED_POSTINGS_BLOCK entries.
+ *
+ *  @return	Pointer to just after the encoded values.
+ */
+template<typename T>
+static const unsigned char*
+decode_values(const unsigned char* p, const unsigned char* end,
+	      unsigned n, T* out)
+{
+    if (end - p < 2) throw_corrupt();
+    unsigned width = p[0];
+    unsigned exceptions = p[1];
+    p += 2;
+    if (exceptions > n ||
+	!unpack_bit_block<PACKED_POSTINGS_BLOCK>(p, end, width, n, out)) {
+	throw_corrupt();
+    }
+
+    const unsigned type_bits = sizeof(T) * CHAR_BIT;
+    while (exceptions--) {
+	if (p == end) throw_corrupt();
+	unsigned i = *p++;
+	const char* q = reinterpret_cast<const char*>(p);
+	T high;
+	if (i >= n ||
+	    !unpack_uint(&q, reinterpret_cast<const char*>(end), &high) ||
+	    high == 0) {
+	    throw_corrupt();
+	}
+	if (width && (width >= type_bits || (high >> (type_bits - width))))
+	    throw_corrupt();
+	out[i] |= high << width;
+	p = reinterpret_cast<const unsigned char*>(q);
+    }
+    return p;
+}
+
+/** Skip @a n encoded values.
+ *
+ *  @return	Pointer to just after the encoded values.
+ */
+template<typename T>
+static const unsigned char*
+skip_values(const unsigned char* p, const unsigned char* end, unsigned n)
+{
+    if (end - p < 2) throw_corrupt();
+    unsigned width = p[0];
+    unsigned exceptions = p[1];
+    p += 2;
+    if (width > 32 || exceptions > n) throw_corrupt();
+    size_t bytes = (size_t(n) * width + 7) / 8;
+    if (size_t(end - p) < bytes) throw_corrupt();
+    p += bytes;
+    while (exceptions--) {
+	if (p == end) throw_corrupt();
+	const char* q = reinterpret_cast<const char*>(++p);
+	if (!unpack_uint(&q, reinterpret_cast<const char*>(end),
+			 static_cast<T*>(NULL))) {
+	    throw_corrupt();
+	}
+	p = reinterpret_cast<const unsigned char*>(q);
+    }
+    return p;
+}
+
+void
+pack_postings(const char* p, const char* end, bool have_wdfs, string& out,
+	      vector<size_t>* block_sizes)
+{
+    Xapian::doccount count = 0;
+    for (const char* q = p; q != end; ++count) {
+	if (!unpack_uint(&q, end, static_cast<Xapian::docid*>(NULL)) ||
+	    (have_wdfs &&
+	     !unpack_uint(&q, end, static_cast<Xapian::termcount*>(NULL)))) {
+	    throw_corrupt();
+	}
+    }
+    if (count == 0) return;
+    pack_uint(out, count);
+
+    Xapian::docid deltas[PACKED_POSTINGS_BLOCK];
+    Xapian::termcount wdfs[PACKED_POSTINGS_BLOCK];
+    while (p != end) {
+	unsigned n = 0;
+	do {
+	    // The data was checked above.
+	    (void)unpack_uint(&p, end, &deltas[n]);
+	    if (have_wdfs) (void)unpack_uint(&p, end, &wdfs[n]);
+	} while (++n != PACKED_POSTINGS_BLOCK && p != end);
+	size_t start = out.size();
+	encode_values(deltas, n, out);
+	if (have_wdfs) encode_values(wdfs, n, out);
+	if (block_sizes) block_sizes->push_back(out.size() - start);
+    }
+}
+
+void
+unpack_postings(const char* p_, const char* end_, bool have_wdfs,
+		string& out)
+{
+    if (p_ == end_) return;
+    Xapian::doccount remaining;
+    if (!unpack_uint(&p_, end_, &remaining) || remaining == 0)
+	throw_corrupt();
+    auto p = reinterpret_cast<const unsigned char*>(p_);
+    auto end = reinterpret_cast<const unsigned char*>(end_);
+
+    Xapian::docid deltas[PACKED_POSTINGS_BLOCK];
+    Xapian::termcount wdfs[PACKED_POSTINGS_BLOCK];
+    while (remaining) {
+	unsigned n = PACKED_POSTINGS_BLOCK;
+	if (remaining < n) n = unsigned(remaining);
+	p = decode_values(p, end, n, deltas);
+	if (have_wdfs) p = decode_values(p, end, n, wdfs);
+	for (unsigned i = 0; i != n; ++i) {
+	    pack_uint(out, deltas[i]);
+	    if (have_wdfs) pack_uint(out, wdfs[i]);
+	}
+	remaining -= n;
+    }
+    if (p != end) throw_corrupt();
+}
+
+void
+PackedPostingsDecoder::init(const char* data, const char* data_end)
+{
+    remaining = 0;
+    if (data != data_end) {
+	if (!unpack_uint(&data, data_end, &remaining) || remaining == 0)
+	    throw_corrupt();
+    }
+    p = reinterpret_cast<const unsigned char*>(data);
+    end = reinterpret_cast<const unsigned char*>(data_end);
+}
+
+unsigned
+PackedPostingsDecoder::unpack_docids(Xapian::docid prev, Xapian::docid* dids,
+				     bool have_wdfs)
+{
+    Assert(!at_end());
+    unsigned n = PACKED_POSTINGS_BLOCK;
+    if (remaining < n) n = unsigned(remaining);
+    p = decode_values(p, end, n, dids);
+
+    // Convert the deltas to docids.  This is a serial dependency which
+    // compilers won't vectorise for us, so use SSE2 where we can to sum four
+    // at a time.
+    unsigned i = 0;
+#ifdef __SSE2__
+    if (sizeof(Xapian::docid) == 4) {
+	const __m128i ones = _mm_set1_epi32(1);
+	__m128i run = _mm_set1_epi32(int(prev));
+	for ( ; i + 4 <= n; i += 4) {
+	    __m128i* ptr = reinterpret_cast<__m128i*>(dids + i);
+	    __m128i x = _mm_add_epi32(_mm_loadu_si128(ptr), ones);
+	    x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+	    x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+	    x = _mm_add_epi32(x, run);
+	    _mm_storeu_si128(ptr, x);
+	    run = _mm_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 3, 3));
+	}
+	if (i) prev = dids[i - 1];
+    }
+#endif
+    for ( ; i != n; ++i) {
+	prev += dids[i] + 1;
+	dids[i] = prev;
+    }
+
+    if (have_wdfs) {
+	wdf_data = p;
+	p = skip_values<Xapian::termcount>(p, end, n);
+    }
+    remaining -= n;
+    if (remaining == 0 && p != end) throw_corrupt();
+    return n;
+}
+
+void
+PackedPostingsDecoder::skip_block(size_t size)
+{
+    Assert(!at_end());
+    if (size > size_t(end - p)) throw_corrupt();
+    p += size;
+    remaining -= min(remaining, Xapian::doccount(PACKED_POSTINGS_BLOCK));
+    if (remaining == 0 && p != end) throw_corrupt();
+}
+
+void
+PackedPostingsDecoder::unpack_wdfs(unsigned n, Xapian::termcount* wdfs) const
+{
+    Assert(wdf_data);
+    (void)decode_values(wdf_data, end, n, wdfs);
+}
+
+}
@@ -0,0 +1,143 @@
+/** @file
+ * @brief Encode/decode honey posting data as blocks of bit-packed values.
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_HONEY_PACKEDPOSTINGS_H
+#define XAPIAN_INCLUDED_HONEY_PACKEDPOSTINGS_H
+
+#include <xapian/types.h>
+
+#include <string>
+#include <vector>
+
+/* This is an alternative encoding for the posting data which follows the
+ * chunk header (the "body" of a chunk), used if the postlist table was
+ * created with Xapian::DB_PACKED_POSTINGS.
+ *
+ * The usual body is a docid delta (minus one) for each entry after the first,
+ * each followed by the wdf if wdfs are explicitly stored, all packed with
+ * pack_uint().  The packed body holds the same values as:
+ *
+ *   - The number of entries in the body, packed with pack_uint() (an empty
+ *     body is left empty).
+ *   - Blocks of up to PACKED_POSTINGS_BLOCK entries, each of which is the
+ *     docid deltas and then (if wdfs are explicitly stored) the wdfs.
+ *
+ * A sequence of values in a block is:
+ *
+ *   - A byte giving the number of bits per value, W (at most 32).
+ *   - A byte giving the number of exceptions.
+ *   - The bottom W bits of each value, bit-packed least significant bit
+ *     first.
+ *   - For each exception, a byte giving its index in the block and then the
+ *     value shifted right by W, packed with pack_uint().
+ *
+ * The encoder picks W to minimise the encoded size, so a few outliers in a
+ * block don't force all the other values to be stored with more bits.
+ *
+ * Every value in a block uses the same number of bits, so unpacking is a
+ * fixed sequence of loads, shifts and masks without any data-dependent
+ * branches, which compilers can unroll and vectorise.
+ */
+
+namespace Honey {
+
+/// The maximum number of entries in each block.
+const unsigned PACKED_POSTINGS_BLOCK = 128;
+
+/** Convert a posting chunk body to the packed encoding.
+ *
+ *  @param p	Start of the body in the usual encoding.
+ *  @param end	End of the body in the usual encoding.
+ *  @param have_wdfs	Are wdfs explicitly stored?
+ *  @param out	String to append the packed body to.
+ *  @param block_sizes	If non-NULL, the encoded size in bytes of each block
+ *			is appended to this vector.
+ */
+void pack_postings(const char* p, const char* end, bool have_wdfs,
+		   std::string& out,
+		   std::vector<size_t>* block_sizes = NULL);
+
+/** Convert a packed posting chunk body back to the usual encoding.
+ *
+ *  @param p	Start of the packed body.
+ *  @param end	End of the packed body.
+ *  @param have_wdfs	Are wdfs explicitly stored?
+ *  @param out	String to append the body in the usual encoding to.
+ */
+void unpack_postings(const char* p, const char* end, bool have_wdfs,
+		     std::string& out);
+
+/// Decoder for a packed posting chunk body.
+class PackedPostingsDecoder {
+    /// Current position in the encoded data.
+    const unsigned char* p = nullptr;
+
+    /// End of the encoded data.
+    const unsigned char* end = nullptr;
+
+    /// Number of entries still to unpack.
+    Xapian::doccount remaining = 0;
+
+    /// The encoded wdfs for the most recently unpacked block.
+    const unsigned char* wdf_data = nullptr;
+
+  public:
+    /** Start decoding a packed body.
+     *
+     *  The data must remain valid while this object is in use.
+     */
+    void init(const char* data, const char* data_end);
+
+    /// Are there more blocks to unpack?
+    bool at_end() const { return remaining == 0; }
+
+    /** Unpack the docids from the next block.
+     *
+     *  If wdfs are explicitly stored, they are skipped over and can be
+     *  unpacked with unpack_wdfs() before the next call to this method.
+     *
+     *  @param prev	The docid before the first in this block.
+     *  @param dids	Set to the docids in the block.  Must have space for
+     *			PACKED_POSTINGS_BLOCK entries.
+     *  @param have_wdfs	Are wdfs explicitly stored?
+     *
+     *  @return	The number of entries in the block.
+     */
+    unsigned unpack_docids(Xapian::docid prev, Xapian::docid* dids,
+			   bool have_wdfs);
+
+    /** Skip the next block without unpacking it.
+     *
+     *  @param size	The size of the encoded block in bytes.
+     */
+    void skip_block(size_t size);
+
+    /** Unpack the wdfs for the block most recently unpacked.
+     *
+     *  @param n	The number of entries in the block.
+     *  @param wdfs	Set to the wdfs in the block.  Must have space for
+     *			PACKED_POSTINGS_BLOCK entries.
+     */
+    void unpack_wdfs(unsigned n, Xapian::termcount* wdfs) const;
+};
+
+}
+
+#endif // XAPIAN_INCLUDED_HONEY_PACKEDPOSTINGS_H
@@ -29,6 +29,7 @@
 #include "debuglog.h"
 #include "honey_cursor.h"
 #include "pack.h"
+#include "packedpositions.h"
 
 #include <string>
 
@@ -65,6 +66,10 @@ HoneyPositionTable::positionlist_count(Xapian::docid did,
 
     const char* pos = data.data();
     const char* end = pos + data.size();
+    if (is_packed_positions(pos, end)) {
+	// Bit-packed data from a glass database we were compacted from.
+	RETURN(packed_positions_count(pos, end));
+    }
     Xapian::termpos pos_last;
     if (!unpack_uint(&pos, end, &pos_last)) {
 	throw Xapian::DatabaseCorruptError("Position list data corrupt");
@@ -84,13 +89,39 @@ HoneyPositionTable::positionlist_count(Xapian::docid did,
 ///////////////////////////////////////////////////////////////////////////
 
 void
-HoneyBasePositionList::set_data(const string& data)
+HoneyAlignedPositions::init(const char* p, size_t len)
+{
+    if (!p) {
+	count = 0;
+	return;
+    }
+
+    const char* end = p + len;
+    if (!unpack_uint(&p, end, &count) || count == 0 || p == end) {
+	throw Xapian::DatabaseCorruptError("Bad aligned position data");
+    }
+    width = static_cast<unsigned char>(*p++);
+    if (width == 0 || width > sizeof(size_t) ||
+	size_t(end - p) / width < count) {
+	throw Xapian::DatabaseCorruptError("Bad aligned position data");
+    }
+    offsets = p;
+    data = p + count * width;
+    if (end_offset(count - 1) != size_t(end - data)) {
+	throw Xapian::DatabaseCorruptError("Bad aligned position data");
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////
+
+void
+HoneyBasePositionList::set_data(const char* pos, size_t len)
 {
-    LOGCALL_VOID(DB, "HoneyBasePositionList::set_data", data);
+    LOGCALL_VOID(DB, "HoneyBasePositionList::set_data", (const void*)pos | len);
 
     have_started = false;
 
-    if (data.empty()) {
+    if (len == 0) {
 	// There's no positional information for this term.
 	size = 0;
 	last = 0;
@@ -98,8 +129,16 @@ HoneyBasePositionList::set_data(const string& data)
 	return;
     }
 
-    const char* pos = data.data();
-    const char* end = pos + data.size();
+    const char* end = pos + len;
+    packed = is_packed_positions(pos, end);
+    if (packed) {
+	// Bit-packed data from a glass database we were compacted from.
+	Xapian::termpos pos_first;
+	size = prd.init(pos, end, pos_first, last);
+	current_pos = pos_first;
+	return;
+    }
+
     Xapian::termpos pos_last;
     if (!unpack_uint(&pos, end, &pos_last)) {
 	throw Xapian::DatabaseCorruptError("Position list data corrupt");
@@ -154,7 +193,7 @@ HoneyBasePositionList::next()
     if (current_pos == last) {
 	return false;
     }
-    current_pos = rd.decode_interpolative_next();
+    current_pos = decode_next();
     return true;
 }
 
@@ -174,7 +213,7 @@ HoneyBasePositionList::skip_to(Xapian::termpos termpos)
 	if (current_pos == last) {
 	    return false;
 	}
-	current_pos = rd.decode_interpolative_next();
+	current_pos = decode_next();
     }
     return true;
 }
@@ -211,6 +250,7 @@ HoneyRePositionList::assign_data(string&& data)
     // current_tag member as somewhere to store it.
     cursor.to_end();
     cursor.current_tag = std::move(data);
+    aligned_chunk_last = 0;
 
     set_data(cursor.current_tag);
 }
@@ -226,6 +266,33 @@ HoneyRePositionList::read_data(Xapian::docid did,
     } else {
 	cursor.read_tag();
     }
+    aligned_chunk_last = 0;
 
     set_data(cursor.current_tag);
 }
+
+void
+HoneyRePositionList::read_aligned(Xapian::docid chunk_last,
+				  const string& term,
+				  Xapian::doccount index)
+{
+    LOGCALL_VOID(DB, "HoneyRePositionList::read_aligned", chunk_last | term | index);
+
+    if (chunk_last != aligned_chunk_last) {
+	aligned_chunk_last = chunk_last;
+	if (!cursor.find_exact(HoneyPositionTable::make_key(chunk_last,
+							    term))) {
+	    cursor.current_tag.clear();
+	    aligned.init(NULL, 0);
+	} else {
+	    cursor.read_tag();
+	    aligned.init(cursor.current_tag.data(),
+			 cursor.current_tag.size());
+	}
+    }
+
+    const char* p;
+    size_t len;
+    aligned.get(index, p, len);
+    set_data(p, len);
+}
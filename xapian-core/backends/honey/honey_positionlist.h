@@ -29,6 +29,7 @@
 #include "honey_cursor.h"
 #include "honey_lazytable.h"
 #include "pack.h"
+#include "packedpositions.h"
 
 #include <string>
 
@@ -78,6 +79,81 @@ class HoneyPositionTable : public HoneyLazyTable {
 					 const std::string& term) const;
 };
 
+/** Positional data aligned with a posting list chunk.
+ *
+ *  With Xapian::DB_ALIGNED_POSITIONS, the position table has an entry for
+ *  each posting list chunk which has any positional data, with the key
+ *  HoneyPositionTable::make_key(last_did, term) where last_did is the last
+ *  docid in the chunk.  The entry starts with the number of postings in the
+ *  chunk (packed with pack_uint()) followed by a byte giving a width in
+ *  bytes, then the offset of the end of the data for each posting (as a big
+ *  endian integer of that width) and finally the encoded position list for
+ *  each posting in turn (empty if the posting has no positional data).
+ *
+ *  This allows the positional data for a posting to be found from its index
+ *  in the posting list chunk without decoding the data for other postings.
+ */
+class HoneyAlignedPositions {
+    /// Start of the array of end offsets.
+    const char* offsets = NULL;
+
+    /// Start of the position lists.
+    const char* data = NULL;
+
+    /// Number of postings.
+    Xapian::doccount count = 0;
+
+    /// Width in bytes of each end offset.
+    unsigned width = 0;
+
+    /// Read the end offset for the posting with index @a i.
+    size_t end_offset(Xapian::doccount i) const {
+	const unsigned char* o =
+	    reinterpret_cast<const unsigned char*>(offsets) + i * width;
+	size_t r = 0;
+	for (unsigned w = 0; w != width; ++w) {
+	    r = (r << 8) | o[w];
+	}
+	return r;
+    }
+
+  public:
+    /** Set the entry to read.
+     *
+     *  @param p	The entry, or NULL for a chunk with no positional data.
+     *			Must stay valid while this object is using it.
+     *  @param len	The size of the entry in bytes.
+     */
+    void init(const char* p, size_t len);
+
+    /** Return the number of postings.
+     *
+     *  Zero for a chunk with no positional data.
+     */
+    Xapian::doccount size() const { return count; }
+
+    /** Find the positional data for a posting.
+     *
+     *  @param i	The index of the posting in its chunk.
+     *  @param p	Set to the start of the encoded position list.
+     *  @param len	Set to the size of the encoded position list in bytes
+     *			(zero if there are no positions).
+     */
+    void get(Xapian::doccount i, const char*& p, size_t& len) const {
+	if (count == 0) {
+	    p = NULL;
+	    len = 0;
+	    return;
+	}
+	if (rare(i >= count))
+	    throw Xapian::DatabaseCorruptError("Aligned position data too "
+					       "short");
+	size_t start = i ? end_offset(i - 1) : 0;
+	p = data + start;
+	len = end_offset(i) - start;
+    }
+};
+
 /** Base-class for a position list in a honey database. */
 class HoneyBasePositionList : public PositionList {
     /// Copying is not allowed.
@@ -90,6 +166,12 @@ class HoneyBasePositionList : public PositionList {
     /// Interpolative decoder.
     BitReader rd;
 
+    /// Bit-packed decoder.
+    PackedPositionReader prd;
+
+    /// Is the current data bit-packed?
+    bool packed = false;
+
     /// Current entry.
     Xapian::termpos current_pos;
 
@@ -107,7 +189,22 @@ class HoneyBasePositionList : public PositionList {
      *  @param data	The positional data.  Must stay valid
      *			while this object is using it.
      */
-    void set_data(const std::string& data);
+    void set_data(const std::string& data) {
+	set_data(data.data(), data.size());
+    }
+
+    /** Set positional data and start to decode it.
+     *
+     *  @param p	The positional data.  Must stay valid while this object
+     *			is using it.
+     *  @param len	The size of the positional data in bytes.
+     */
+    void set_data(const char* p, size_t len);
+
+    /// Decode the entry after the current one.
+    Xapian::termpos decode_next() {
+	return packed ? prd.decode_next() : rd.decode_interpolative_next();
+    }
 
   public:
     /// Default constructor.
@@ -159,6 +256,14 @@ class HoneyRePositionList : public HoneyBasePositionList {
     /// Cursor for locating multiple entries efficiently.
     HoneyCursor cursor;
 
+    /** Last docid of the posting list chunk whose aligned positional data
+     *  is in cursor.current_tag, or 0 if there isn't one.
+     */
+    Xapian::docid aligned_chunk_last = 0;
+
+    /// The aligned positional data in cursor.current_tag.
+    HoneyAlignedPositions aligned;
+
     /// Copying is not allowed.
     HoneyRePositionList(const HoneyRePositionList&) = delete;
 
@@ -176,6 +281,19 @@ class HoneyRePositionList : public HoneyBasePositionList {
 
     /** Fill list with data, and move the position to the start. */
     void read_data(Xapian::docid did, const std::string& term);
+
+    /** Fill list with aligned data, and move the position to the start.
+     *
+     *  For use with Xapian::DB_ALIGNED_POSITIONS.  The positional data for
+     *  the posting list chunk is only looked up when @a chunk_last differs
+     *  from the previous call.
+     *
+     *  @param chunk_last	The last docid in the posting list chunk.
+     *  @param term		The term.
+     *  @param index	The index of the posting in the chunk.
+     */
+    void read_aligned(Xapian::docid chunk_last, const std::string& term,
+		      Xapian::doccount index);
 };
 
 #endif /* XAPIAN_INCLUDED_HONEY_POSITIONLIST_H */
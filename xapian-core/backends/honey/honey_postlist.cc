@@ -27,8 +27,11 @@
 #include "honey_positionlist.h"
 #include "honey_postlist_encodings.h"
 #include "pack.h"
+#include "xapian/weight.h"
 
+#include <algorithm>
 #include <string>
+#include <typeinfo>
 
 using namespace Honey;
 using namespace std;
@@ -39,9 +42,9 @@ HoneyPostList::update_reader()
     Xapian::docid chunk_last = docid_from_key(term, cursor->current_key);
     if (!chunk_last) return false;
 
-    cursor->read_tag();
-    const string& tag = cursor->current_tag;
-    reader.assign(tag.data(), tag.size(), chunk_last);
+    size_t len;
+    const char* tag = cursor->read_tag_view(len);
+    reader.assign(tag, len, chunk_last);
     return true;
 }
 
@@ -60,54 +63,10 @@ HoneyPostList::HoneyPostList(const HoneyDatabase* db_,
 	return;
     }
 
-    cursor->read_tag();
-    const string& chunk = cursor->current_tag;
-
-    const char* p = chunk.data();
-    const char* pend = p + chunk.size();
-    // FIXME: Make use of [first,last] ranges to calculate better estimates and
-    // potentially to spot subqueries that can't match anything.
-    Xapian::doccount tf;
-    Xapian::termcount cf;
-    Xapian::docid first_did;
-    Xapian::termcount first_wdf;
-    Xapian::docid chunk_last;
-    Xapian::termcount wdf_max;
-    if (!decode_initial_chunk_header(&p, pend, tf, cf,
-				     first_did, last_did,
-				     chunk_last, first_wdf, wdf_max))
-	throw Xapian::DatabaseCorruptError("Postlist initial chunk header");
-
-    Xapian::termcount cf_info = cf;
-    if (cf == 0) {
-	// wdf must always be zero.
-    } else if (tf <= 2) {
-	// No further postlist data stored.
-    } else if (cf == tf - 1 + first_wdf) {
-	// wdf must be 1 for second and subsequent entries.
-	cf_info = 1 | TOP_BIT_SET(decltype(cf_info));
-    } else {
-	cf_info = 1;
-	// If wdf_max can only be zero if cf == 0 (and
-	// decode_initial_chunk_header() should ensure this).
-	Assert(wdf_max != 0);
-	Xapian::termcount remaining_cf_for_flat_wdf = (tf - 1) * wdf_max;
-	// Check this matches and that it isn't a false match due
-	// to overflow of the multiplication above.
-	if (cf - first_wdf == remaining_cf_for_flat_wdf &&
-	    usual(remaining_cf_for_flat_wdf / wdf_max == tf - 1)) {
-	    // Set cl_info to the flat wdf value with the top bit set to
-	    // signify that this is a flat wdf value.
-	    cf_info = wdf_max;
-	    // It shouldn't be possible for the top bit to already be set since
-	    // tf > 2 so cf must be at least 2 * remaining_cf_for_flat_wdf.
-	    Assert((cf_info & TOP_BIT_SET(decltype(cf_info))) == 0);
-	    cf_info |= TOP_BIT_SET(decltype(cf_info));
-	}
-    }
-
-    reader.init(tf, cf_info);
-    reader.assign(p, pend - p, first_did, last_did, first_wdf);
+    size_t len;
+    const char* p = cursor->read_tag_view(len);
+    bool packed = db->postlist_table.get_packed_postings();
+    last_did = reader.init_from_initial_chunk(p, len, packed);
 }
 
 HoneyPostList::~HoneyPostList()
@@ -168,27 +127,52 @@ HoneyPostList::at_end() const
 PositionList*
 HoneyPostList::open_position_list() const
 {
+    if (db->position_table.get_aligned_positions()) {
+	Xapian::docid chunk_last = reader.get_last_did_in_chunk();
+	string key = HoneyPositionTable::make_key(chunk_last, term);
+	string chunk;
+	if (!db->position_table.get_exact_entry(key, chunk)) {
+	    return new HoneyPositionList(string());
+	}
+	HoneyAlignedPositions aligned;
+	aligned.init(chunk.data(), chunk.size());
+	const char* p;
+	size_t len;
+	aligned.get(reader.get_index(), p, len);
+	return new HoneyPositionList(string(p, len));
+    }
     return new HoneyPositionList(db->position_table, get_docid(), term);
 }
 
-PostList*
-HoneyPostList::next(double)
+void
+HoneyPostList::check_bound_weight()
 {
-    if (!started) {
-	started = true;
-	return NULL;
-    }
-
-    Assert(!reader.at_end());
-
-    if (reader.next())
-	return NULL;
+    checked_bound_weight = true;
+    // We can only bound the weight of a block from its maximum wdf and
+    // minimum document length if the weighting scheme's contribution can't
+    // increase as wdf decreases or as document length increases, and doesn't
+    // depend on any other per-document statistics.  We don't have a way to
+    // ask a weighting scheme that, so we enable this just for schemes we know
+    // satisfy these requirements.
+    //
+    // We check the exact type rather than the name or using dynamic_cast<>,
+    // since a subclass may override get_sumpart() (and will inherit
+    // short_name() unless it overrides that too).
+    if (!weight) return;
+    const type_info& type = typeid(*weight);
+    if (type == typeid(Xapian::BM25Weight) ||
+	type == typeid(Xapian::BM25PlusWeight))
+	reader.set_bound_weight(weight);
+}
 
+void
+HoneyPostList::next_chunk()
+{
     if (reader.get_docid() >= last_did) {
 	// We've reached the end.
 	delete cursor;
 	cursor = NULL;
-	return NULL;
+	return;
     }
 
     if (rare(!cursor->next()))
@@ -197,12 +181,29 @@ HoneyPostList::next(double)
 
     if (rare(!update_reader()))
 	throw Xapian::DatabaseCorruptError("Missing postlist chunk");
+}
+
+PostList*
+HoneyPostList::next(double w_min)
+{
+    if (!started) {
+	started = true;
+	return NULL;
+    }
+
+    Assert(!reader.at_end());
+
+    if (w_min > 0.0 && !checked_bound_weight)
+	check_bound_weight();
+
+    if (!reader.next(w_min))
+	next_chunk();
 
     return NULL;
 }
 
 PostList*
-HoneyPostList::skip_to(Xapian::docid did, double)
+HoneyPostList::skip_to(Xapian::docid did, double w_min)
 {
     if (!started) {
 	started = true;
@@ -215,7 +216,10 @@ HoneyPostList::skip_to(Xapian::docid did, double)
 
     Assert(!reader.at_end());
 
-    if (reader.skip_to(did))
+    if (w_min > 0.0 && !checked_bound_weight)
+	check_bound_weight();
+
+    if (reader.skip_to(did, w_min))
 	return NULL;
 
     if (did > last_did) {
@@ -225,8 +229,12 @@ HoneyPostList::skip_to(Xapian::docid did, double)
 	return NULL;
     }
 
-    // At this point we know that skip_to() must succeed since last_did
-    // satisfies the requirements.
+    if (did <= reader.get_last_did_in_chunk()) {
+	// The rest of the current chunk was skipped because it couldn't reach
+	// w_min, so continue from the start of the next chunk.
+	next_chunk();
+	return NULL;
+    }
 
     // find_entry_ge() returns true for an exact match, which isn't interesting
     // here.
@@ -239,9 +247,14 @@ HoneyPostList::skip_to(Xapian::docid did, double)
     if (rare(!update_reader()))
 	throw Xapian::DatabaseCorruptError("Missing postlist chunk");
 
-    if (rare(!reader.skip_to(did)))
-	throw Xapian::DatabaseCorruptError("Postlist chunk doesn't contain "
-					   "its last entry");
+    if (!reader.skip_to(did, w_min)) {
+	// If we didn't skip any blocks, skip_to() must succeed since the last
+	// entry in the chunk satisfies the requirements.
+	if (w_min == 0.0)
+	    throw Xapian::DatabaseCorruptError("Postlist chunk doesn't "
+					       "contain its last entry");
+	next_chunk();
+    }
 
     return NULL;
 }
@@ -259,11 +272,17 @@ HoneyPosPostList::HoneyPosPostList(const HoneyDatabase* db_,
 				   const std::string& term_,
 				   HoneyCursor* cursor_)
     : HoneyPostList(db_, term_, cursor_),
-      position_list(db_->position_table) {}
+      position_list(db_->position_table),
+      aligned(db_->position_table.get_aligned_positions()) {}
 
 PositionList*
 HoneyPosPostList::read_position_list()
 {
+    if (aligned) {
+	position_list.read_aligned(reader.get_last_did_in_chunk(), term,
+				   reader.get_index());
+	return &position_list;
+    }
     position_list.read_data(HoneyPostList::get_docid(), term);
     // FIXME: Consider returning NULL if there's no positional data - callers
     // need fixing up, but this may be a rare case and the costs of checking
@@ -282,10 +301,183 @@ HoneyPosPostList::get_description() const
 
 namespace Honey {
 
+Xapian::docid
+PostingChunkReader::init_from_initial_chunk(const char* p_, size_t len,
+					    bool packed_)
+{
+    const char* pend = p_ + len;
+    // FIXME: Make use of [first,last] ranges to calculate better estimates and
+    // potentially to spot subqueries that can't match anything.
+    Xapian::doccount tf;
+    Xapian::termcount cf;
+    Xapian::docid first_did;
+    Xapian::termcount first_wdf;
+    Xapian::docid last_did_in_term;
+    Xapian::docid chunk_last;
+    Xapian::termcount wdf_max;
+    if (!decode_initial_chunk_header(&p_, pend, tf, cf,
+				     first_did, last_did_in_term,
+				     chunk_last, first_wdf, wdf_max))
+	throw Xapian::DatabaseCorruptError("Postlist initial chunk header");
+
+    Xapian::termcount cf_info = cf;
+    if (cf == 0) {
+	// wdf must always be zero.
+    } else if (tf <= 2) {
+	// No further postlist data stored.
+    } else if (cf == tf - 1 + first_wdf) {
+	// wdf must be 1 for second and subsequent entries.
+	cf_info = 1 | TOP_BIT_SET(decltype(cf_info));
+    } else {
+	cf_info = 1;
+	// If wdf_max can only be zero if cf == 0 (and
+	// decode_initial_chunk_header() should ensure this).
+	Assert(wdf_max != 0);
+	Xapian::termcount remaining_cf_for_flat_wdf = (tf - 1) * wdf_max;
+	// Check this matches and that it isn't a false match due
+	// to overflow of the multiplication above.
+	if (cf - first_wdf == remaining_cf_for_flat_wdf &&
+	    usual(remaining_cf_for_flat_wdf / wdf_max == tf - 1)) {
+	    // Set cl_info to the flat wdf value with the top bit set to
+	    // signify that this is a flat wdf value.
+	    cf_info = wdf_max;
+	    // It shouldn't be possible for the top bit to already be set since
+	    // tf > 2 so cf must be at least 2 * remaining_cf_for_flat_wdf.
+	    Assert((cf_info & TOP_BIT_SET(decltype(cf_info))) == 0);
+	    cf_info |= TOP_BIT_SET(decltype(cf_info));
+	}
+    }
+
+    init(tf, cf_info, packed_);
+    assign(p_, pend - p_, first_did, chunk_last, first_wdf);
+    return last_did_in_term;
+}
+
+void
+PostingChunkReader::start_data()
+{
+    buf_pos = buf_len = 0;
+    index = 0;
+    next_block_index = 1;
+    block_last = did;
+    skip_p = skip_end = p;
+    if (p != end) {
+	size_t skip_len;
+	if (!unpack_uint(&p, end, &skip_len) || skip_len > size_t(end - p))
+	    throw Xapian::DatabaseCorruptError("postlist skip data");
+	skip_p = p;
+	skip_end = p += skip_len;
+	if (packed) {
+	    decoder.init(p, end);
+	    // All the posting data is now read via decoder.
+	    p = end;
+	}
+    }
+    block_end = p;
+}
+
+bool
+PostingChunkReader::next_block(Xapian::docid target, double w_min)
+{
+    AssertEq(did, block_last);
+    while (skip_p != skip_end) {
+	Xapian::docid delta;
+	size_t size;
+	Xapian::termcount wdf_max = wdf;
+	Xapian::termcount doclen_min;
+	if (!unpack_uint(&skip_p, skip_end, &delta) ||
+	    !unpack_uint(&skip_p, skip_end, &size) ||
+	    (collfreq_info && !unpack_uint(&skip_p, skip_end, &wdf_max)) ||
+	    !unpack_uint(&skip_p, skip_end, &doclen_min)) {
+	    throw Xapian::DatabaseCorruptError("postlist skip data");
+	}
+	if (rare(delta >= last_did - block_last))
+	    throw Xapian::DatabaseCorruptError("postlist skip data");
+	block_last += delta + 1;
+	Xapian::doccount block_index = next_block_index;
+	next_block_index += PACKED_POSTINGS_BLOCK;
+
+	bool skip = (block_last < target);
+	if (!skip && bound_weight && w_min > 0.0) {
+	    // The weight can't exceed that for the highest wdf and shortest
+	    // document length in the block.
+	    double w_max = 0.0;
+	    if (wdf_max)
+		w_max = bound_weight->get_sumpart(wdf_max, doclen_min, 0, 0);
+	    skip = (w_max < w_min);
+	}
+
+	if (packed) {
+	    if (skip) {
+		decoder.skip_block(size);
+	    } else {
+		buf_len = decoder.unpack_docids(did, buf_dids, collfreq_info != 0);
+		buf_pos = 0;
+		have_buf_wdfs = false;
+		if (rare(buf_dids[buf_len - 1] != block_last))
+		    throw Xapian::DatabaseCorruptError("postlist skip data");
+	    }
+	} else {
+	    if (rare(size > size_t(end - p)))
+		throw Xapian::DatabaseCorruptError("postlist skip data");
+	    block_end = p + size;
+	    if (skip) p = block_end;
+	}
+
+	if (!skip) {
+	    index = block_index - 1;
+	    return true;
+	}
+	did = block_last;
+    }
+    return false;
+}
+
+void
+PostingChunkReader::read_entry()
+{
+    Assert(!block_done());
+    if (packed) {
+	did = buf_dids[buf_pos];
+	if (collfreq_info) {
+	    if (!have_buf_wdfs) {
+		decoder.unpack_wdfs(buf_len, buf_wdfs);
+		have_buf_wdfs = true;
+	    }
+	    wdf = buf_wdfs[buf_pos];
+	}
+	index = next_block_index - PACKED_POSTINGS_BLOCK + buf_pos;
+	++buf_pos;
+	return;
+    }
+
+    Xapian::docid delta;
+    if (!unpack_uint(&p, block_end, &delta)) {
+	throw Xapian::DatabaseCorruptError("postlist docid delta");
+    }
+    did += delta + 1;
+    ++index;
+    if (collfreq_info) {
+	if (!unpack_uint(&p, block_end, &wdf)) {
+	    throw Xapian::DatabaseCorruptError("postlist wdf");
+	}
+    }
+    if (p == block_end ? did != block_last : did >= block_last)
+	throw Xapian::DatabaseCorruptError("postlist skip data");
+}
+
 void
 PostingChunkReader::assign(const char* p_, size_t len,
 			   Xapian::docid chunk_last)
 {
+    // A continuation chunk can't contain the first entry, so handle the
+    // "constant wdf apart from maybe the first entry" case here, as otherwise
+    // we'd decode the chunk header as if it had an explicit wdf.
+    if (collfreq_info & TOP_BIT_SET(decltype(collfreq_info))) {
+	wdf = collfreq_info &~ TOP_BIT_SET(decltype(collfreq_info));
+	collfreq_info = 0;
+    }
+
     const char* pend = p_ + len;
     if (collfreq_info ?
 	!decode_delta_chunk_header(&p_, pend, chunk_last, did, wdf) :
@@ -295,6 +487,7 @@ PostingChunkReader::assign(const char* p_, size_t len,
     p = p_;
     end = pend;
     last_did = chunk_last;
+    start_data();
 }
 
 void
@@ -307,15 +500,17 @@ PostingChunkReader::assign(const char* p_, size_t len, Xapian::docid did_,
     did = did_;
     last_did = last_did_in_chunk;
     wdf = wdf_;
+    start_data();
 }
 
 bool
-PostingChunkReader::next()
+PostingChunkReader::next(double w_min)
 {
-    if (p == end) {
+    if (data_done()) {
 	if (termfreq == 2 && did != last_did) {
 	    did = last_did;
 	    wdf = collfreq_info - wdf;
+	    index = 1;
 	    return true;
 	}
 	p = NULL;
@@ -328,22 +523,17 @@ PostingChunkReader::next()
 	collfreq_info = 0;
     }
 
-    Xapian::docid delta;
-    if (!unpack_uint(&p, end, &delta)) {
-	throw Xapian::DatabaseCorruptError("postlist docid delta");
-    }
-    did += delta + 1;
-    if (collfreq_info) {
-	if (!unpack_uint(&p, end, &wdf)) {
-	    throw Xapian::DatabaseCorruptError("postlist wdf");
-	}
+    if (block_done() && !next_block(0, w_min)) {
+	p = NULL;
+	return false;
     }
 
+    read_entry();
     return true;
 }
 
 bool
-PostingChunkReader::skip_to(Xapian::docid target)
+PostingChunkReader::skip_to(Xapian::docid target, double w_min)
 {
     if (p == NULL)
 	return false;
@@ -356,13 +546,14 @@ PostingChunkReader::skip_to(Xapian::docid target)
 	return false;
     }
 
-    if (p == end) {
+    if (data_done()) {
 	// Given the checks above, this must be the termfreq == 2 case with the
 	// current position being on the first entry, and so skip_to() must
 	// move to last_did.
 	AssertEq(termfreq, 2);
 	did = last_did;
 	wdf = collfreq_info - wdf;
+	index = 1;
 	return true;
     }
 
@@ -372,35 +563,78 @@ PostingChunkReader::skip_to(Xapian::docid target)
 	collfreq_info = 0;
     }
 
-    if (target == last_did) {
-	if (collfreq_info) {
-	    if (!unpack_uint_backwards(&end, p, &wdf))
-		throw Xapian::DatabaseCorruptError("postlist final wdf");
+    if (!block_done() && block_last < target) {
+	// Skip the rest of the current block.
+	did = block_last;
+	if (packed) {
+	    buf_pos = buf_len;
+	} else {
+	    p = block_end;
 	}
-	did = last_did;
-	p = end;
-	return true;
     }
 
+    if (block_done() && !next_block(target, w_min)) {
+	p = NULL;
+	return false;
+    }
+
+    // The current block must contain target or a later entry.
+    if (packed) {
+	buf_pos = lower_bound(buf_dids + buf_pos, buf_dids + buf_len, target) -
+		  buf_dids;
+	read_entry();
+    } else {
+	do {
+	    read_entry();
+	} while (did < target);
+    }
+
+    return true;
+}
+
+PostingChunkDocids::PostingChunkDocids(const HoneyTable* table)
+    : cursor(new HoneyCursor(table)),
+      packed(table->get_packed_postings()) {}
+
+PostingChunkDocids::~PostingChunkDocids() {}
+
+void
+PostingChunkDocids::read_docids()
+{
+    docids.clear();
     do {
-	if (rare(p == end)) {
-	    // FIXME: Shouldn't happen unless last_did was wrong.
-	    p = NULL;
-	    return false;
-	}
+	docids.push_back(reader.get_docid());
+    } while (reader.next());
+}
 
-	Xapian::docid delta;
-	if (!unpack_uint(&p, end, &delta)) {
-	    throw Xapian::DatabaseCorruptError("postlist docid delta");
-	}
-	did += delta + 1;
-	if (collfreq_info) {
-	    if (!unpack_uint(&p, end, &wdf)) {
-		throw Xapian::DatabaseCorruptError("postlist wdf");
-	    }
-	}
-    } while (target > did);
+bool
+PostingChunkDocids::find(const string& term_, Xapian::docid did)
+{
+    size_t len;
+    if (term_ != term || docids.empty()) {
+	term = term_;
+	docids.clear();
+	if (!cursor->find_exact(make_postingchunk_key(term)))
+	    return false;
+	const char* p = cursor->read_tag_view(len);
+	term_last_did = reader.init_from_initial_chunk(p, len, packed);
+	read_docids();
+    }
 
+    AssertRel(did, >=, docids.front());
+    while (docids.back() < did) {
+	if (docids.back() == term_last_did)
+	    return false;
+	if (rare(!cursor->next()))
+	    throw Xapian::DatabaseCorruptError("Hit end of table looking for "
+					       "postlist chunk");
+	Xapian::docid chunk_last = docid_from_key(term, cursor->current_key);
+	if (rare(!chunk_last))
+	    throw Xapian::DatabaseCorruptError("Missing postlist chunk");
+	const char* p = cursor->read_tag_view(len);
+	reader.assign(p, len, chunk_last);
+	read_docids();
+    }
     return true;
 }
 
@@ -23,13 +23,17 @@
 #define XAPIAN_INCLUDED_HONEY_POSTLIST_H
 
 #include "backends/leafpostlist.h"
+#include "honey_packedpostings.h"
 #include "honey_positionlist.h"
 #include "pack.h"
 
+#include <memory>
 #include <string>
+#include <vector>
 
 class HoneyCursor;
 class HoneyDatabase;
+class HoneyTable;
 
 namespace Honey {
 
@@ -110,6 +114,76 @@ class PostingChunkReader {
      */
     Xapian::termcount collfreq_info;
 
+    /// Is the posting data in the packed encoding?
+    bool packed = false;
+
+    /// Have the wdfs in buf_wdfs been unpacked for the current block?
+    bool have_buf_wdfs = false;
+
+    /// Index of the next entry to return from buf_dids.
+    unsigned buf_pos = 0;
+
+    /// Number of entries in buf_dids.
+    unsigned buf_len = 0;
+
+    /// The next unread entry in the skip data.
+    const char* skip_p = NULL;
+
+    /// The end of the skip data.
+    const char* skip_end = NULL;
+
+    /// End of the current block's posting data (if not packed).
+    const char* block_end = NULL;
+
+    /// The last docid in the current block.
+    Xapian::docid block_last;
+
+    /// Index in this chunk of the current entry.
+    Xapian::doccount index;
+
+    /// Index in this chunk of the first entry of the next block.
+    Xapian::doccount next_block_index;
+
+    /** Weighting scheme to use to bound the weight of blocks.
+     *
+     *  NULL if blocks shouldn't be skipped based on their weight.
+     */
+    const Xapian::Weight* bound_weight = NULL;
+
+    /// Decoder for packed posting data.
+    PackedPostingsDecoder decoder;
+
+    /// Docids from the most recently unpacked block.
+    Xapian::docid buf_dids[PACKED_POSTINGS_BLOCK];
+
+    /// Wdfs from the most recently unpacked block.
+    Xapian::termcount buf_wdfs[PACKED_POSTINGS_BLOCK];
+
+    /// Set up to read the skip data and posting data in [p, end).
+    void start_data();
+
+    /// Have we read all the entries in the current block?
+    bool block_done() const {
+	return packed ? buf_pos == buf_len : p == block_end;
+    }
+
+    /// Is there no more posting data in this chunk?
+    bool data_done() const {
+	return block_done() && skip_p == skip_end;
+    }
+
+    /** Move to the next block which might contain a suitable entry.
+     *
+     *  Blocks which end before @a target are skipped, as are blocks which
+     *  can't contain an entry with weight at least @a w_min.
+     *
+     *  @return false if there's no such block in this chunk.
+     */
+    bool next_block(Xapian::docid target, double w_min);
+
+    /// Read the next entry in the current block, which must exist.
+    void read_entry();
+
   public:
     /// Create an uninitialised PostingChunkReader.
     PostingChunkReader() : p(NULL) { }
@@ -120,13 +194,29 @@ class PostingChunkReader {
 	termfreq = 0;
     }
 
-    /// Initialise.
-    void init(Xapian::doccount tf, Xapian::termcount cf_info) {
+    /** Initialise.
+     *
+     *  @param packed_	Is the posting data in the packed encoding (i.e. was
+     *			the postlist table created with
+     *			Xapian::DB_PACKED_POSTINGS)?
+     */
+    void init(Xapian::doccount tf, Xapian::termcount cf_info,
+	      bool packed_ = false) {
 	p = NULL;
 	termfreq = tf;
 	collfreq_info = cf_info;
+	packed = packed_;
     }
 
+    /** Initialise and assign the initial chunk of a posting list.
+     *
+     *  @param packed_	Is the posting data in the packed encoding?
+     *
+     *  @return The last docid in the posting list.
+     */
+    Xapian::docid init_from_initial_chunk(const char* p_, size_t len,
+					  bool packed_);
+
     void assign(const char* p_, size_t len, Xapian::docid did);
 
     void assign(const char* p_, size_t len, Xapian::docid did_,
@@ -141,11 +231,83 @@ class PostingChunkReader {
 
     Xapian::termcount get_wdf() const { return wdf; }
 
-    /// Advance, returning false if we've run out of data.
-    bool next();
+    Xapian::docid get_last_did_in_chunk() const { return last_did; }
+
+    /** Return the index of the current entry in this chunk.
+     *
+     *  The first entry in a chunk has index 0.
+     */
+    Xapian::doccount get_index() const { return index; }
 
-    /// Skip ahead, returning false if we've run out of data.
-    bool skip_to(Xapian::docid target);
+    /** Skip blocks which can't reach the minimum weight.
+     *
+     *  @param weight	Weighting scheme to calculate a bound on the weight of
+     *			each block with.  Its get_sumpart() method must not
+     *			decrease as wdf increases or as document length
+     *			decreases, and must not depend on the number of
+     *			unique terms or the maximum wdf in the document.
+     */
+    void set_bound_weight(const Xapian::Weight* weight) {
+	bound_weight = weight;
+    }
+
+    /** Advance, returning false if we've run out of data.
+     *
+     *  @param w_min	Blocks of entries which can't reach this weight may be
+     *			skipped over.
+     */
+    bool next(double w_min = 0.0);
+
+    /** Skip ahead, returning false if we've run out of data.
+     *
+     *  @param w_min	Blocks of entries which can't reach this weight may be
+     *			skipped over.
+     */
+    bool skip_to(Xapian::docid target, double w_min = 0.0);
+};
+
+/** Read the docids in each chunk of posting lists.
+ *
+ *  Used to work out which posting each entry of positional data aligned with
+ *  the postlist (see Xapian::DB_ALIGNED_POSITIONS) belongs to.
+ */
+class PostingChunkDocids {
+    /// Cursor on the postlist table.
+    std::unique_ptr<HoneyCursor> cursor;
+
+    PostingChunkReader reader;
+
+    /// Is the posting data in the packed encoding?
+    bool packed;
+
+    /// The term whose posting list we're reading.
+    std::string term;
+
+    /// The last docid in the posting list for @a term.
+    Xapian::docid term_last_did = 0;
+
+    /// The docids in the current chunk (empty if there isn't one).
+    std::vector<Xapian::docid> docids;
+
+    /// Read the docids in the chunk @a reader has been assigned.
+    void read_docids();
+
+  public:
+    explicit PostingChunkDocids(const HoneyTable* table);
+
+    ~PostingChunkDocids();
+
+    /** Move to the chunk of @a term_'s posting list which contains @a did.
+     *
+     *  Successive calls for the same term must be in ascending docid order.
+     *
+     *  @return false if @a term_ doesn't index a document with docid @a did
+     *		or higher.
+     */
+    bool find(const std::string& term_, Xapian::docid did);
+
+    /// The docids in the current chunk.
+    const std::vector<Xapian::docid>& get_docids() const { return docids; }
 };
 
 }
@@ -161,8 +323,10 @@ class HoneyPostList : public LeafPostList {
     /// Cursor on the postlist table.
     HoneyCursor* cursor;
 
+  protected:
     Honey::PostingChunkReader reader;
 
+  private:
     /// The highest document id in this posting list.
     Xapian::docid last_did;
 
@@ -175,9 +339,22 @@ class HoneyPostList : public LeafPostList {
      */
     bool started = false;
 
+    /** Have we checked if the weighting scheme allows skipping blocks?
+     *
+     *  We can't check this on construction as the weight object is set after
+     *  that.
+     */
+    bool checked_bound_weight = false;
+
     /// Update @a reader to use the chunk currently pointed to by @a cursor.
     bool update_reader();
 
+    /// Check if @a reader can skip blocks based on their weight.
+    void check_bound_weight();
+
+    /// Move to the first entry of the next chunk, or to the end.
+    void next_chunk();
+
   public:
     /// Create HoneyPostList from already positioned @a cursor_.
     HoneyPostList(const HoneyDatabase* db_,
@@ -219,6 +396,9 @@ class HoneyPosPostList : public HoneyPostList {
      */
     HoneyRePositionList position_list;
 
+    /// Is the positional data aligned with the postlist?
+    bool aligned;
+
   public:
     HoneyPosPostList(const HoneyDatabase* db_,
 		     const std::string& term_,
@@ -26,10 +26,15 @@
 
 #include "honey_cursor.h"
 #include "stringutils.h"
+#include "wordaccess.h"
+#include "xapian/constants.h"
 
 #include "unicode/description_append.h"
 
 #include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <new>
 
 #ifdef DEBUGGING
 # include <iostream>
@@ -39,12 +44,214 @@ using Honey::RootInfo;
 
 using namespace std;
 
+#if defined HAVE_MMAP && defined MAP_ANONYMOUS
+# define HONEY_LOAD_USING_MMAP
+#endif
+
+HoneyLoadedFile::HoneyLoadedFile(int fd, size_t size_)
+    : size(size_)
+{
+#ifdef HONEY_LOAD_USING_MMAP
+    // Use an anonymous mapping rather than new so the copy is page aligned
+    // and we can ask for it to use huge pages, which reduces TLB misses when
+    // probing a large table.
+    void* p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+	throw std::bad_alloc();
+# ifdef MADV_HUGEPAGE
+    (void)madvise(p, size, MADV_HUGEPAGE);
+# endif
+    data = static_cast<char*>(p);
+#else
+    data = new char[size];
+#endif
+    try {
+	io_pread(fd, data, size, 0, size);
+    } catch (...) {
+	release();
+	throw;
+    }
+#ifdef HONEY_LOAD_USING_MMAP
+    // Nothing should modify the copy.
+    (void)mprotect(data, size, PROT_READ);
+#endif
+}
+
+void
+HoneyLoadedFile::release()
+{
+#ifdef HONEY_LOAD_USING_MMAP
+    if (data) munmap(data, size);
+#else
+    delete [] data;
+#endif
+    data = nullptr;
+}
+
+void
+SSTIndex::add_eytzinger_entry(const string& key, off_t ptr)
+{
+    // As for SSTINDEX_BINARY_CHOP, entries are truncated to a fixed width,
+    // with trailing zero bytes indicating keys shorter than that, and point
+    // to the first key with that truncated value.
+    if (eytzinger_last_key.size() == SSTINDEX_EYTZINGER_KEY_SIZE) {
+	if (startswith(key, eytzinger_last_key)) {
+	    return;
+	}
+    }
+
+    // Ensure the truncated key doesn't end in a zero byte.
+    if (key.size() >= SSTINDEX_EYTZINGER_KEY_SIZE) {
+	eytzinger_last_key.assign(key, 0, SSTINDEX_EYTZINGER_KEY_SIZE);
+	if (key[SSTINDEX_EYTZINGER_KEY_SIZE - 1] == '\0')
+	    return;
+    } else {
+	eytzinger_last_key = key;
+	if (key.back() == '\0')
+	    return;
+	// Pad with zero bytes.
+	eytzinger_last_key.resize(SSTINDEX_EYTZINGER_KEY_SIZE);
+    }
+
+    // Thin entries to at most one per INDEXBLOCK sized block.
+    size_t cur_block = ptr / INDEXBLOCK;
+    if (cur_block == eytzinger_block)
+	return;
+
+    auto p = reinterpret_cast<const unsigned char*>(eytzinger_last_key.data());
+    eytzinger_keys.push_back(do_unaligned_read<uint64_t>(p));
+    eytzinger_ptrs.push_back(ptr);
+    eytzinger_block = cur_block;
+}
+
+/** Fill in entries of an Eytzinger layout index.
+ *
+ *  Does an in-order walk of the subtree rooted at @a k, so the entries are
+ *  assigned in ascending order.
+ *
+ *  @param ptr_size	Size of each pointer in bytes (4 or 8).
+ *  @param i	Index in @a keys of the next entry to assign.
+ *  @param k	Node in the tree to start at (counting from 1).
+ *
+ *  @return	Index in @a keys of the next entry to assign after this
+ *		subtree.
+ */
+static size_t
+eytzinger_fill(const vector<uint64_t>& keys, const vector<off_t>& ptrs,
+	       unsigned char* out, unsigned ptr_size, size_t i, size_t k)
+{
+    size_t n = keys.size();
+    if (k <= n) {
+	i = eytzinger_fill(keys, ptrs, out, ptr_size, i, 2 * k);
+	do_unaligned_write<uint64_t, uint64_t>(out + (k - 1) * 8, keys[i]);
+	unsigned char* p = out + n * 8 + (k - 1) * ptr_size;
+	if (ptr_size == 8) {
+	    do_unaligned_write<uint64_t, uint64_t>(p, ptrs[i]);
+	} else {
+	    unaligned_write4(p, ptrs[i]);
+	}
+	++i;
+	i = eytzinger_fill(keys, ptrs, out, ptr_size, i, 2 * k + 1);
+    }
+    return i;
+}
+
+off_t
+SSTIndex::write_eytzinger(BufferedFile& store)
+{
+    off_t root = store.get_pos();
+
+    size_t n = eytzinger_keys.size();
+    if (n > 0xffffffff)
+	throw Xapian::DatabaseError("Too many index entries");
+    // The entries point to increasing positions in the table, so the last
+    // has the largest pointer.
+    unsigned ptr_size = 4;
+    if (sizeof(off_t) > 4 && n && eytzinger_ptrs.back() > off_t(0xffffffff))
+	ptr_size = 8;
+    data.assign(5 + n * (SSTINDEX_EYTZINGER_KEY_SIZE + ptr_size), '\0');
+    data[0] = char(ptr_size == 8 ? EYTZINGER_WIDE : EYTZINGER);
+    unaligned_write4(reinterpret_cast<unsigned char*>(&data[1]), n);
+    eytzinger_fill(eytzinger_keys, eytzinger_ptrs,
+		   reinterpret_cast<unsigned char*>(&data[5]), ptr_size, 0, 1);
+    eytzinger_keys = vector<uint64_t>();
+    eytzinger_ptrs = vector<off_t>();
+
+    store.write(data.data(), data.size());
+    return root;
+}
+
+off_t
+SSTIndex::eytzinger_find(BufferedFile& store, const string& key,
+			 string& prefix, unsigned ptr_size)
+{
+    size_t n = store.read_uint4_be();
+    off_t base = store.get_pos();
+
+    unsigned char buf[SSTINDEX_EYTZINGER_KEY_SIZE] = {};
+    memcpy(buf, key.data(), min(key.size(), sizeof(buf)));
+    uint64_t x = do_unaligned_read<uint64_t>(buf);
+
+    auto keys = reinterpret_cast<const unsigned char*>(
+	    store.read_mapped(n * (SSTINDEX_EYTZINGER_KEY_SIZE + ptr_size)));
+    size_t k = 1;
+    if (keys) {
+	while (k <= n) {
+#ifdef __GNUC__
+	    // Fetch the entries four levels down, which are contiguous.
+	    if (16 * k <= n) __builtin_prefetch(keys + (16 * k - 1) * 8);
+#endif
+	    k = 2 * k + (do_unaligned_read<uint64_t>(keys + (k - 1) * 8) <= x);
+	}
+    } else {
+	while (k <= n) {
+	    store.set_pos(base + (k - 1) * 8);
+	    store.read(reinterpret_cast<char*>(buf), sizeof(buf));
+	    k = 2 * k + (do_unaligned_read<uint64_t>(buf) <= x);
+	}
+    }
+
+    // The bits of k now record the path taken, with a 1 for each step to a
+    // right child.  The entry we want is the last one we stepped right from,
+    // so strip the trailing left steps and then that one right step.
+    while ((k & 1) == 0) k >>= 1;
+    k >>= 1;
+    if (k == 0) return -1;
+
+    if (keys) {
+	memcpy(buf, keys + (k - 1) * 8, sizeof(buf));
+	keys += n * 8 + (k - 1) * ptr_size;
+    } else {
+	store.set_pos(base + (k - 1) * 8);
+	store.read(reinterpret_cast<char*>(buf), sizeof(buf));
+    }
+    size_t len = sizeof(buf);
+    while (len > 0 && buf[len - 1] == '\0') --len;
+    prefix.assign(reinterpret_cast<const char*>(buf), len);
+    if (!keys) {
+	store.set_pos(base + n * 8 + (k - 1) * ptr_size);
+	if (ptr_size == 4) return store.read_uint4_be();
+	store.read(reinterpret_cast<char*>(buf), sizeof(buf));
+	keys = buf;
+    }
+    if (ptr_size == 4) return unaligned_read4(keys);
+    uint64_t ptr = do_unaligned_read<uint64_t>(keys);
+    if (sizeof(off_t) == 4 && ptr > 0x7fffffff)
+	throw Xapian::DatabaseError("Honey table too large for off_t");
+    return off_t(ptr);
+}
+
 void
 HoneyTable::create_and_open(int flags_, const RootInfo& root_info)
 {
     Assert(!single_file());
     flags = flags_;
     compress_min = root_info.get_compress_min();
+    packed_postings = root_info.get_packed_postings();
+    aligned_positions = root_info.get_aligned_positions();
+    if (flags & Xapian::DB_EYTZINGER_INDEX) index.set_eytzinger();
+    build_filter = (flags & Xapian::DB_BLOOM_FILTERS);
     if (read_only) {
 	num_entries = root_info.get_num_entries();
 	root = root_info.get_root();
@@ -59,15 +266,67 @@ HoneyTable::open(int flags_, const RootInfo& root_info, honey_revision_number_t)
 {
     flags = flags_;
     compress_min = root_info.get_compress_min();
+    packed_postings = root_info.get_packed_postings();
+    aligned_positions = root_info.get_aligned_positions();
     num_entries = root_info.get_num_entries();
     offset = root_info.get_offset();
     root = root_info.get_root();
+    if (!read_only) {
+	if (flags & Xapian::DB_EYTZINGER_INDEX) index.set_eytzinger();
+	build_filter = (flags & Xapian::DB_BLOOM_FILTERS);
+    }
     if (!single_file() && !store.open(path, read_only)) {
 	if (!lazy)
 	    throw Xapian::DatabaseOpeningError("Failed to open HoneyTable",
 					       errno);
     }
+    // Honey tables are never modified once written, so we can read them
+    // via a memory mapping (unless XAPIAN_HONEY_NO_MMAP is set).
+    if (read_only) {
+	const char* p = getenv("XAPIAN_HONEY_NO_MMAP");
+	if (!p || !*p) store.map_for_reading();
+    }
+    if (read_only && root_info.get_filter() && store.is_open()) {
+	filter_pos = root_info.get_filter();
+	read_filter(filter_pos);
+    }
+    store.set_pos(offset);
+}
+
+shared_ptr<const HoneyLoadedFile>
+HoneyTable::load_into_memory(shared_ptr<const HoneyLoadedFile> file)
+{
+    if (!read_only || !store.is_open())
+	return file;
+    if (file) {
+	store.use_loaded(file);
+    } else {
+	file = store.load_into_memory();
+    }
+    if (filter_pos) {
+	// The filter may point into the mapping of the file which the copy
+	// has replaced.
+	filter = Honey::BloomFilter();
+	read_filter(filter_pos);
+    }
     store.set_pos(offset);
+    return file;
+}
+
+void
+HoneyTable::read_filter(off_t pos)
+{
+    store.rewind(pos);
+    uint4 n = store.read_uint4_be();
+    size_t len = Honey::BloomFilter::encoded_size(n);
+    const char* p = store.read_mapped(len);
+    if (p) {
+	filter.init(p, n);
+    } else {
+	string data(len, '\0');
+	store.read(&data[0], len);
+	filter.init(std::move(data), n);
+    }
 }
 
 void
@@ -99,30 +358,37 @@ HoneyTable::add(const std::string& key,
 	throw Xapian::InvalidOperationError("New key <= previous key");
     size_t reuse = common_prefix_length(last_key, key);
 
-#ifdef SSTINDEX_ARRAY
-    if (reuse == 0) {
+    if (index.is_eytzinger()) {
+	// As for a binary chop index, the index point is before the key info.
 	index.maybe_add_entry(key, store.get_pos());
-    }
+    } else {
+#ifdef SSTINDEX_ARRAY
+	if (reuse == 0) {
+	    index.maybe_add_entry(key, store.get_pos());
+	}
 #elif defined SSTINDEX_BINARY_CHOP
-    // For a binary chop index, the index point is before the key info - the
-    // index key must have the same N first bytes as the previous key, where
-    // N >= the keep length.
-    index.maybe_add_entry(key, store.get_pos());
+	// For a binary chop index, the index point is before the key info -
+	// the index key must have the same N first bytes as the previous key,
+	// where N >= the keep length.
+	index.maybe_add_entry(key, store.get_pos());
 #elif defined SSTINDEX_SKIPLIST
-    // Handled below.
+	// Handled below.
 #else
 # error SSTINDEX type not specified
 #endif
+    }
 
     store.write(static_cast<unsigned char>(reuse));
     store.write(static_cast<unsigned char>(key.size() - reuse));
     store.write(key.data() + reuse, key.size() - reuse);
     ++num_entries;
+    if (build_filter) filter_builder.add(key);
 
 #ifdef SSTINDEX_SKIPLIST
     // For a skiplist index, the index provides the full key, so the index
     // point is after the key at the level below.
-    index.maybe_add_entry(key, store.get_pos());
+    if (!index.is_eytzinger())
+	index.maybe_add_entry(key, store.get_pos());
 #endif
 
     // Encode "compressed?" flag in bottom bit.
@@ -146,6 +412,7 @@ HoneyTable::commit(honey_revision_number_t, RootInfo* root_info)
     root_info->set_num_entries(num_entries);
     // offset should already be set.
     root_info->set_root(root);
+    root_info->set_filter(filter_pos);
     // Not really meaningful.
     // root_info->set_free_list(std::string());
 
@@ -252,6 +519,8 @@ HoneyTable::get_exact_entry(const std::string& key, std::string* tag) const
 	    throw_database_closed();
 	return false;
     }
+    if (!filter.may_contain(key))
+	return false;
     store.rewind(root);
     if (rare(key.empty()))
 	return false;
@@ -314,6 +583,20 @@ HoneyTable::get_exact_entry(const std::string& key, std::string* tag) const
 	    last_key.assign(kkey, jump == 0 ? 0 : kkey_len);
 	    break;
 	}
+	case SSTIndex::EYTZINGER:
+	case SSTIndex::EYTZINGER_WIDE: {
+	    unsigned ptr_size = (index_type == SSTIndex::EYTZINGER ? 4 : 8);
+	    off_t jump = SSTIndex::eytzinger_find(store, key, last_key,
+						  ptr_size);
+	    if (jump < 0) {
+		// The key is before every index entry, so search from the
+		// start of the table.
+		jump = offset;
+		last_key = string();
+	    }
+	    store.rewind(jump);
+	    break;
+	}
 	case 0x02: {
 	    // FIXME: If "close" just seek forwards?  Or consider seeking from
 	    // current index pos?
@@ -34,6 +34,9 @@
 #define SSTINDEX_BINARY_CHOP_ENTRY_SIZE \
     (SSTINDEX_BINARY_CHOP_KEY_SIZE + SSTINDEX_BINARY_CHOP_PTR_SIZE)
 
+// Key prefix size for SSTIndex::EYTZINGER, which is selected at runtime.
+#define SSTINDEX_EYTZINGER_KEY_SIZE 8
+
 //#include "xapian/constants.h"
 #include "xapian/error.h"
 
@@ -42,18 +45,26 @@
 #include <iostream> // FIXME
 #endif
 
+#include <cerrno>
+#include <cstdint>
 #include <cstdio> // For EOF
 #include <cstdlib> // std::abort()
+#include <memory>
 #include <type_traits>
+#include <vector>
 #ifdef HAVE_SYS_UIO_H
 # include <sys/uio.h>
 #endif
+#ifdef HAVE_MMAP
+# include <sys/mman.h>
+#endif
 
 #include <sys/types.h>
 #include "safesysstat.h"
 #include "safeunistd.h"
 
 #include "compression_stream.h"
+#include "honey_bloomfilter.h"
 #include "honey_defs.h"
 #include "honey_version.h"
 #include "internaltypes.h"
@@ -73,15 +84,72 @@ const uint4 BLK_UNUSED = uint4(-1);
 
 class HoneyFreeListChecker;
 
+/** A copy of a file held in memory.
+ *
+ *  The memory is allocated separately from the OS cache of the file, so the
+ *  data stays in memory however much other file I/O there is.
+ */
+class HoneyLoadedFile {
+    /// The copy of the file.
+    char* data = nullptr;
+
+    /// The size of the file in bytes.
+    size_t size;
+
+    /// Free the memory for data.
+    void release();
+
+  public:
+    /** Read a file into memory.
+     *
+     *  @param fd	The file to read (from the start, regardless of the
+     *			current file offset).
+     *  @param size_	The size of the file in bytes (must be non-zero).
+     */
+    HoneyLoadedFile(int fd, size_t size_);
+
+    ~HoneyLoadedFile() { release(); }
+
+    HoneyLoadedFile(const HoneyLoadedFile&) = delete;
+
+    HoneyLoadedFile& operator=(const HoneyLoadedFile&) = delete;
+
+    const char* get_data() const { return data; }
+
+    size_t get_size() const { return size; }
+};
+
 class BufferedFileCommon {
     friend class BufferedFile;
     int fd = -1;
     unsigned _refs = 0;
     off_t offset = 0;
 
+    /** The file mapped into memory, or NULL if it isn't mapped.
+     *
+     *  The mapping outlives closing fd, so data read from it remains valid
+     *  until the last BufferedFile sharing this object is destroyed.
+     */
+    const char* mapped = nullptr;
+
+    /// Size of the mapping in bytes.
+    size_t mapped_size = 0;
+
+    /** The copy of the file which mapped points to.
+     *
+     *  NULL if mapped is a mapping of the file (or NULL).
+     */
+    std::shared_ptr<const HoneyLoadedFile> loaded;
+
     BufferedFileCommon(int fd_, off_t offset_)
 	: fd(fd_), _refs(1), offset(offset_) {}
 
+    ~BufferedFileCommon() {
+#ifdef HAVE_MMAP
+	if (mapped && !loaded) munmap(const_cast<char*>(mapped), mapped_size);
+#endif
+    }
+
     BufferedFileCommon(const BufferedFileCommon&) = delete;
 
     BufferedFileCommon& operator=(const BufferedFileCommon&) = delete;
@@ -100,6 +168,12 @@ class BufferedFile {
   public:
     BufferedFile() { }
 
+    /// Throw an exception indicating that the file has been closed.
+    [[noreturn]]
+    static void throw_database_closed() {
+	throw Xapian::DatabaseClosedError("Closed!");
+    }
+
     BufferedFile(const BufferedFile& o) : common(o.common) {
 	if (!o.read_only) std::abort();
 	if (common) ++common->_refs;
@@ -160,6 +234,92 @@ class BufferedFile {
 	return true;
     }
 
+    /** Map the file into memory for reading.
+     *
+     *  Subsequent reads are then served directly from the mapping rather
+     *  than by calling pread().  If the file can't be mapped (or mmap()
+     *  isn't supported) reads continue to use pread().
+     *
+     *  This is only safe for a file which won't be modified while open.
+     */
+    void map_for_reading() {
+#ifdef HAVE_MMAP
+	if (!read_only || !common || common->fd < 0 || common->mapped)
+	    return;
+	struct stat sbuf;
+	if (fstat(common->fd, &sbuf) < 0 || sbuf.st_size <= 0)
+	    return;
+	typedef std::make_unsigned<off_t>::type uoff_t;
+	if (uoff_t(sbuf.st_size) > SIZE_MAX)
+	    return;
+	size_t size = size_t(sbuf.st_size);
+	void* p = mmap(NULL, size, PROT_READ, MAP_SHARED, common->fd, 0);
+	if (p == MAP_FAILED)
+	    return;
+	// Discard anything buffered, so the position is just pos.
+	pos -= buf_end;
+	buf_end = 0;
+	common->mapped = static_cast<const char*>(p);
+	common->mapped_size = size;
+#endif
+    }
+
+    /** Read the whole file into memory.
+     *
+     *  Subsequent reads are then served from the copy in memory, as they are
+     *  from the mapping after map_for_reading(), but without depending on the
+     *  OS keeping the file's pages cached.
+     *
+     *  This is only safe for a file which won't be modified while open.
+     *
+     *  @return	The copy of the file, which can be shared by other
+     *		BufferedFile objects reading the same file by passing it to
+     *		use_loaded().  NULL if the file is empty.
+     */
+    std::shared_ptr<const HoneyLoadedFile> load_into_memory() {
+	if (!read_only || !common || common->fd < 0)
+	    return nullptr;
+	if (common->loaded)
+	    return common->loaded;
+	struct stat sbuf;
+	if (fstat(common->fd, &sbuf) < 0) {
+	    throw Xapian::DatabaseError("Couldn't stat honey table", errno);
+	}
+	typedef std::make_unsigned<off_t>::type uoff_t;
+	if (uoff_t(sbuf.st_size) > SIZE_MAX) {
+	    throw Xapian::DatabaseError("Honey table too large to load into "
+					"memory");
+	}
+	if (sbuf.st_size <= 0)
+	    return nullptr;
+	auto file = std::make_shared<const HoneyLoadedFile>(common->fd,
+							    size_t(sbuf.st_size));
+	use_loaded(file);
+	return file;
+    }
+
+    /** Read from a copy of the file which has already been loaded.
+     *
+     *  @param file	The copy, as returned by load_into_memory() (NULL to
+     *			leave things unchanged).
+     */
+    void use_loaded(std::shared_ptr<const HoneyLoadedFile> file) {
+	if (!read_only || !common || !file || common->loaded == file)
+	    return;
+#ifdef HAVE_MMAP
+	if (common->mapped && !common->loaded)
+	    munmap(const_cast<char*>(common->mapped), common->mapped_size);
+#endif
+	// Discard anything buffered, so the position is just pos.
+	pos -= buf_end;
+	buf_end = 0;
+	common->mapped = file->get_data();
+	common->mapped_size = file->get_size();
+	common->loaded = std::move(file);
+    }
+
+    bool is_mapped() const { return common && common->mapped; }
+
     off_t get_pos() const {
 	return read_only ? pos - buf_end : pos + buf_end;
     }
@@ -257,6 +417,15 @@ class BufferedFile {
     }
 
     int read() const {
+	if (common->mapped) {
+	    // Reading via the mapping would still work after a forced close,
+	    // but should fail as reading via the file descriptor would.
+	    if (was_forced_closed()) throw_database_closed();
+	    if (size_t(pos) >= common->mapped_size) {
+		return EOF;
+	    }
+	    return static_cast<unsigned char>(common->mapped[pos++]);
+	}
 	if (buf_end == 0) {
 	    // The buffer is currently empty, so we need to read at least one
 	    // byte.
@@ -282,6 +451,10 @@ class BufferedFile {
     }
 
     void read(char* p, size_t len) const {
+	if (common->mapped) {
+	    memcpy(p, read_mapped(len), len);
+	    return;
+	}
 	if (buf_end != 0) {
 	    if (len <= buf_end) {
 		memcpy(p, buf + sizeof(buf) - buf_end, len);
@@ -300,6 +473,24 @@ class BufferedFile {
 	pos += r;
     }
 
+    /** Read @a len bytes from a mapped file without copying.
+     *
+     *  @return Pointer to the data in the mapping, or NULL if the file isn't
+     *		mapped.
+     */
+    const char* read_mapped(size_t len) const {
+	if (!common->mapped)
+	    return NULL;
+	if (was_forced_closed()) throw_database_closed();
+	if (size_t(pos) > common->mapped_size ||
+	    len > common->mapped_size - size_t(pos)) {
+	    throw Xapian::DatabaseCorruptError("Read past end of honey table");
+	}
+	const char* p = common->mapped + pos;
+	pos += len;
+	return p;
+    }
+
     void flush() {
 	if (!read_only && buf_end) {
 	    io_write(common->fd, buf, buf_end);
@@ -322,6 +513,25 @@ class BufferedFile {
 class HoneyCursor;
 
 class SSTIndex {
+  public:
+    /** Index type byte for an index with the Eytzinger layout.
+     *
+     *  This holds fixed width key prefixes (padded with zero bytes) as 64-bit
+     *  big-endian values, and a 4 byte pointer for each (or an 8 byte
+     *  pointer for EYTZINGER_WIDE, which is used if any pointer needs more
+     *  than 4 bytes).  The prefixes and
+     *  pointers are stored in "Eytzinger order" - the entries of a complete
+     *  binary search tree in breadth-first order, so entry k has children
+     *  2k and 2k+1 (counting from 1).  A search is then a walk down the tree
+     *  with no data-dependent branches, and the entries near the root which
+     *  every search visits are packed together at the start.
+     *
+     *  Unlike the other index types, this one is selected at runtime (by
+     *  calling set_eytzinger() before adding entries).
+     */
+    enum { EYTZINGER = 0x03, EYTZINGER_WIDE = 0x04 };
+
+  private:
     std::string data;
 #if defined SSTINDEX_BINARY_CHOP
     size_t block = size_t(-1);
@@ -341,6 +551,25 @@ class SSTIndex {
     off_t* pointers = NULL;
 #endif
 
+    /// Are we building an Eytzinger index instead of the default type?
+    bool eytzinger = false;
+
+    /// The last key prefix considered for an Eytzinger index.
+    std::string eytzinger_last_key;
+
+    /// Block containing the last Eytzinger index entry added.
+    size_t eytzinger_block = size_t(-1);
+
+    /// Eytzinger index key prefixes added so far, in ascending order.
+    std::vector<uint64_t> eytzinger_keys;
+
+    /// Eytzinger index pointers added so far, in ascending key order.
+    std::vector<off_t> eytzinger_ptrs;
+
+    void add_eytzinger_entry(const std::string& key, off_t ptr);
+
+    off_t write_eytzinger(BufferedFile& store);
+
   public:
     SSTIndex() {
 #ifdef SSTINDEX_ARRAY
@@ -360,7 +589,37 @@ class SSTIndex {
 #endif
     }
 
+    /** Build an index with the Eytzinger layout.
+     *
+     *  Must be called before any entries are added.
+     */
+    void set_eytzinger() { eytzinger = true; }
+
+    bool is_eytzinger() const { return eytzinger; }
+
+    /** Look up @a key in an index with the Eytzinger layout.
+     *
+     *  @param store	The table, positioned just after the index type byte.
+     *			The position is left undefined.
+     *  @param key	The key to look up.
+     *  @param prefix	Set to the prefix of the index entry found (so the
+     *			key at the returned position starts with it).
+     *  @param ptr_size	Size of each pointer in bytes: 4 for EYTZINGER, 8
+     *			for EYTZINGER_WIDE.
+     *
+     *  @return The position of the first key with the greatest index prefix
+     *		<= @a key, or -1 if @a key is before every index entry.
+     */
+    static off_t eytzinger_find(BufferedFile& store,
+				const std::string& key,
+				std::string& prefix,
+				unsigned ptr_size);
+
     void maybe_add_entry(const std::string& key, off_t ptr) {
+	if (eytzinger) {
+	    add_eytzinger_entry(key, ptr);
+	    return;
+	}
 #ifdef SSTINDEX_ARRAY
 	unsigned char initial = key[0];
 	if (!pointers) {
@@ -450,6 +709,8 @@ class SSTIndex {
     }
 
     off_t write(BufferedFile& store) {
+	if (eytzinger) return write_eytzinger(store);
+
 	off_t root = store.get_pos();
 
 #ifdef SSTINDEX_ARRAY
@@ -535,17 +796,30 @@ class MutableHoneyCursor;
 
 class HoneyTable {
     // FIXME cleaner way?
-    friend class HoneyCursor; // Allow access to store.
+    friend class HoneyCursor; // Allow access to store and filter.
     friend class MutableHoneyCursor; // Allow access to store.
 
     std::string path;
     bool read_only;
     int flags;
     uint4 compress_min;
+    /// Is posting data packed?  (Only for the postlist table.)
+    bool packed_postings = false;
+    /// Is positional data aligned with the postlist?  (Only for the position
+    /// table.)
+    bool aligned_positions = false;
     mutable BufferedFile store;
     mutable std::string last_key;
     SSTIndex index;
     off_t root = -1;
+    /// Are we building a Bloom filter over the keys?
+    bool build_filter = false;
+    /// Builder for the Bloom filter over the keys.
+    Honey::BloomFilterBuilder filter_builder;
+    /// Position of the Bloom filter, or 0 if there isn't one.
+    off_t filter_pos = 0;
+    /// Bloom filter over the keys (empty if there isn't one).
+    Honey::BloomFilter filter;
     honey_tablesize_t num_entries = 0;
     bool lazy;
 
@@ -560,6 +834,9 @@ class HoneyTable {
 
     bool get_exact_entry(const std::string& key, std::string* tag) const;
 
+    /// Read the Bloom filter at position @a pos.
+    void read_filter(off_t pos);
+
     bool read_key(std::string& key, size_t& val_size, bool& compressed) const;
 
     void read_val(std::string& val, size_t val_size) const;
@@ -597,6 +874,29 @@ class HoneyTable {
 
     int get_flags() const { return flags; }
 
+    bool get_packed_postings() const { return packed_postings; }
+
+    bool get_aligned_positions() const { return aligned_positions; }
+
+    /** Load the table into memory.
+     *
+     *  Has no effect for a table which isn't open for reading.
+     *
+     *  @param file	A copy of the file the table is stored in which has
+     *			already been loaded into memory (the tables of a
+     *			single file database share one), or NULL to load it.
+     *
+     *  @return	The copy of the file the table is now read from (NULL if
+     *		it isn't read from one).
+     */
+    std::shared_ptr<const HoneyLoadedFile>
+    load_into_memory(std::shared_ptr<const HoneyLoadedFile> file);
+
+    /** Return the number of bytes of memory used for data loaded from the
+     *  table, not counting any copy of the file made by load_into_memory().
+     */
+    size_t get_memory_footprint() const { return filter.get_memory_used(); }
+
     void create_and_open(int flags_, const Honey::RootInfo& root_info);
 
     void open(int flags_, const Honey::RootInfo& root_info,
@@ -625,6 +925,12 @@ class HoneyTable {
 
     void flush_db() {
 	root = index.write(store);
+	if (build_filter) {
+	    filter_pos = store.get_pos();
+	    std::string data;
+	    filter_builder.encode(data);
+	    store.write(data.data(), data.size());
+	}
 	store.flush();
     }
 
@@ -670,7 +976,7 @@ class HoneyTable {
     bool is_open() const { return store.is_open(); }
 
     static void throw_database_closed() {
-	throw Xapian::DatabaseClosedError("Closed!");
+	BufferedFile::throw_database_closed();
     }
 
     honey_tablesize_t get_entry_count() const { return num_entries; }
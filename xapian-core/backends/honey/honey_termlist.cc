@@ -24,6 +24,8 @@
 
 #include "expand/expandweight.h"
 
+#include <memory>
+
 using namespace std;
 
 [[noreturn]]
@@ -194,6 +196,10 @@ HoneyTermList::at_end() const
 Xapian::termcount
 HoneyTermList::positionlist_count() const
 {
+    if (db->position_table.get_aligned_positions()) {
+	unique_ptr<PositionList> pl(db->open_position_list(did, current_term));
+	return pl->get_approx_size();
+    }
     return db->position_table.positionlist_count(did, current_term);
 }
 
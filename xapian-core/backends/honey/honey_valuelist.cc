@@ -36,9 +36,9 @@ HoneyValueList::update_reader()
     Xapian::docid last_did = docid_from_key(slot, cursor->current_key);
     if (!last_did) return false;
 
-    cursor->read_tag();
-    const string& tag = cursor->current_tag;
-    reader.assign(tag.data(), tag.size(), last_did);
+    size_t len;
+    const char* tag = cursor->read_tag_view(len);
+    reader.assign(tag, len, last_did);
     return true;
 }
 
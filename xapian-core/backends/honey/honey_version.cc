@@ -51,8 +51,10 @@
 using namespace std;
 
 /// Honey format version (date of change):
-#define HONEY_FORMAT_VERSION DATE_TO_VERSION(2018,4,3)
-// 2018,4,3   1.5.0 outlaw mixed-wdf terms
+#define HONEY_FORMAT_VERSION DATE_TO_VERSION(2026,10,19)
+// 2026,10,19 1.5.0 packed postings flag in RootInfo; skip data in postlist
+//                  chunks; aligned positions flag in RootInfo
+// 2018,4,3         outlaw mixed-wdf terms
 // 2018,3,28        don't special case first entry in SSTable
 // 2018,3,27        new key format for value stats, value chunks, doclen chunks
 // 2018,3,26        use known suffix from spelling B and T keys
@@ -477,23 +479,31 @@ static const uint4 compress_min_tab[] = {
 };
 
 void
-HoneyVersion::create()
+HoneyVersion::create(int flags)
 {
     uuid.generate();
+    bool packed_postings = (flags & Xapian::DB_PACKED_POSTINGS);
+    bool aligned_positions = (flags & Xapian::DB_ALIGNED_POSITIONS);
     for (unsigned table_no = 0; table_no < Honey::MAX_; ++table_no) {
-	root[table_no].init(compress_min_tab[table_no]);
+	root[table_no].init(compress_min_tab[table_no],
+			    packed_postings && table_no == Honey::POSTLIST,
+			    aligned_positions && table_no == Honey::POSITION);
     }
 }
 
 namespace Honey {
 
 void
-RootInfo::init(uint4 compress_min_)
+RootInfo::init(uint4 compress_min_, bool packed_postings_,
+	       bool aligned_positions_)
 {
     offset = 0;
     root = 0;
     num_entries = 0;
     compress_min = compress_min_;
+    packed_postings = packed_postings_;
+    aligned_positions = aligned_positions_;
+    filter = 0;
     fl_serialised.resize(0);
 }
 
@@ -505,7 +515,13 @@ RootInfo::serialise(string& s) const
     AssertRel(root, >=, offset);
     pack_uint(s, uoffset);
     pack_uint(s, root - uoffset);
-    pack_uint(s, 0u);
+    pack_uint(s, unsigned(packed_postings) | (filter ? 2u : 0u) |
+		 (aligned_positions ? 4u : 0u));
+    if (filter) {
+	// The filter follows the index.
+	AssertRel(filter, >, root);
+	pack_uint(s, std::make_unsigned<off_t>::type(filter - root));
+    }
     pack_uint(s, num_entries);
     pack_uint(s, 2048u >> 11);
     pack_uint(s, compress_min);
@@ -516,20 +532,30 @@ bool
 RootInfo::unserialise(const char** p, const char* end)
 {
     std::make_unsigned<off_t>::type uoffset, uroot;
-    unsigned dummy_val;
+    unsigned table_flags;
     unsigned dummy_blocksize;
     if (!unpack_uint(p, end, &uoffset) ||
 	!unpack_uint(p, end, &uroot) ||
-	!unpack_uint(p, end, &dummy_val) ||
-	!unpack_uint(p, end, &num_entries) ||
+	!unpack_uint(p, end, &table_flags)) return false;
+    // Bit 0 is set for packed postings, bit 1 if there's a filter, and bit 2
+    // for aligned positions.
+    if (table_flags > 7) return false;
+    offset = uoffset;
+    root = uoffset + uroot;
+    packed_postings = (table_flags & 1);
+    aligned_positions = (table_flags & 4);
+    filter = 0;
+    if (table_flags & 2) {
+	std::make_unsigned<off_t>::type ufilter;
+	if (!unpack_uint(p, end, &ufilter)) return false;
+	filter = root + ufilter;
+    }
+    if (!unpack_uint(p, end, &num_entries) ||
 	!unpack_uint(p, end, &dummy_blocksize) ||
 	!unpack_uint(p, end, &compress_min) ||
 	!unpack_string(p, end, fl_serialised)) return false;
-    offset = uoffset;
-    root = uoffset + uroot;
     // Not meaningful, but still there so that existing honey databases
     // continue to work.
-    (void)dummy_val;
     (void)dummy_blocksize;
     // Map old default to new default.
     if (compress_min == 4) {
@@ -43,10 +43,18 @@ class RootInfo {
     honey_tablesize_t num_entries;
     /// Should be >= 4 or 0 for no compression.
     uint4 compress_min;
+    /// Is posting data packed?  (Only for the postlist table.)
+    bool packed_postings;
+    /// Is positional data aligned with the postlist?  (Only for the position
+    /// table.)
+    bool aligned_positions;
+    /// Position of the Bloom filter over the keys, or 0 if there isn't one.
+    off_t filter;
     std::string fl_serialised;
 
   public:
-    void init(uint4 compress_min_);
+    void init(uint4 compress_min_, bool packed_postings_ = false,
+	      bool aligned_positions_ = false);
 
     void serialise(std::string& s) const;
 
@@ -56,11 +64,15 @@ class RootInfo {
     off_t get_root() const { return root; }
     honey_tablesize_t get_num_entries() const { return num_entries; }
     uint4 get_compress_min() const { return compress_min; }
+    bool get_packed_postings() const { return packed_postings; }
+    bool get_aligned_positions() const { return aligned_positions; }
+    off_t get_filter() const { return filter; }
     const std::string& get_free_list() const { return fl_serialised; }
 
     void set_num_entries(honey_tablesize_t n) { num_entries = n; }
     void set_offset(off_t offset_) { offset = offset_; }
     void set_root(off_t root_) { root = root_; }
+    void set_filter(off_t filter_) { filter = filter_; }
     void set_free_list(const std::string& s) { fl_serialised = s; }
 };
 
@@ -160,8 +172,15 @@ class HoneyVersion {
 
     ~HoneyVersion();
 
-    /** Create the version file. */
-    void create();
+    /** Create the version file.
+     *
+     *  @param flags	If Xapian::DB_PACKED_POSTINGS is set, the postlist
+     *			table stores posting data packed.  If
+     *			Xapian::DB_ALIGNED_POSITIONS is set, the position
+     *			table stores positional data aligned with the
+     *			postlist.  Other bits are ignored.
+     */
+    void create(int flags = 0);
 
     /** Read the version file and check it's a version we understand.
      *
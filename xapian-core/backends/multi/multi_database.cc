@@ -43,8 +43,13 @@ bool
 MultiDatabase::reopen()
 {
     bool result = false;
-    for (auto&& shard : shards) {
-	if (shard->reopen()) {
+    for (size_type i = 0; i != shards.size(); ++i) {
+	auto shard = shards[i];
+	Xapian::Database::Internal* replacement = shard->open_replacement();
+	if (replacement) {
+	    shards.replace(i, replacement);
+	    result = true;
+	} else if (shard->reopen()) {
 	    result = true;
 	}
     }
@@ -544,6 +549,26 @@ MultiDatabase::get_revision() const
 					"more than one subdatabase");
 }
 
+size_t
+MultiDatabase::get_buffered_memory() const
+{
+    size_t result = 0;
+    for (auto&& shard : shards) {
+	result += shard->get_buffered_memory();
+    }
+    return result;
+}
+
+size_t
+MultiDatabase::get_memory_footprint() const
+{
+    size_t result = 0;
+    for (auto&& shard : shards) {
+	result += shard->get_memory_footprint();
+    }
+    return result;
+}
+
 void
 MultiDatabase::invalidate_doc_object(Xapian::Document::Internal*) const
 {
@@ -678,6 +703,24 @@ MultiDatabase::request_document(Xapian::docid did) const
     shard->request_document(shard_did);
 }
 
+void
+MultiDatabase::request_documents(const vector<Xapian::docid>& dids) const
+{
+    auto n_shards = shards.size();
+    // Docids in each shard are in ascending order if the unsharded docids
+    // are.
+    vector<vector<Xapian::docid>> shard_dids(n_shards);
+    for (Xapian::docid did : dids) {
+	Assert(did != 0);
+	shard_dids[shard_number(did, n_shards)].push_back(
+	    shard_docid(did, n_shards));
+    }
+    for (size_t i = 0; i != n_shards; ++i) {
+	if (!shard_dids[i].empty())
+	    shards[i]->request_documents(shard_dids[i]);
+    }
+}
+
 void
 MultiDatabase::add_spelling(const string& word,
 			    Xapian::termcount freqinc) const
@@ -62,6 +62,11 @@ class MultiDatabase : public Xapian::Database::Internal {
 	shards.push_back(shard);
     }
 
+    /// Return shard @a i.
+    Xapian::Database::Internal* get_shard(size_type i) const {
+	return shards[i];
+    }
+
     bool reopen();
 
     void close();
@@ -145,6 +150,10 @@ class MultiDatabase : public Xapian::Database::Internal {
 
     Xapian::rev get_revision() const;
 
+    size_t get_buffered_memory() const;
+
+    size_t get_memory_footprint() const;
+
     int get_backend_info(std::string* path) const;
 
     void commit();
@@ -168,6 +177,8 @@ class MultiDatabase : public Xapian::Database::Internal {
 
     void request_document(Xapian::docid did) const;
 
+    void request_documents(const std::vector<Xapian::docid>& dids) const;
+
     void add_spelling(const std::string& word, Xapian::termcount freqinc) const;
 
     Xapian::termcount remove_spelling(const std::string& word,
@@ -11,6 +11,7 @@ noinst_PROGRAMS =
 
 if BUILD_BACKEND_TOOLS
 bin_PROGRAMS +=\
+	bin/xapian-bulkload\
 	bin/xapian-check\
 	bin/xapian-compact
 
@@ -26,6 +27,7 @@ endif
 
 if !MAINTAINER_NO_DOCS
 dist_man_MANS +=\
+	bin/xapian-bulkload.1\
 	bin/xapian-check.1\
 	bin/xapian-compact.1\
 	bin/xapian-delve.1
@@ -48,10 +50,15 @@ dist_man_MANS +=\
 endif
 endif
 
+bin_xapian_bulkload_SOURCES = bin/xapian-bulkload.cc
+bin_xapian_bulkload_LDADD = $(ldflags) libgetopt.la $(libxapian_la)
+
 bin_xapian_check_SOURCES = bin/xapian-check.cc
 bin_xapian_check_LDADD = $(ldflags) $(libxapian_la)
 
-bin_xapian_compact_SOURCES = bin/xapian-compact.cc
+bin_xapian_compact_CPPFLAGS = $(AM_CPPFLAGS)
+bin_xapian_compact_SOURCES = bin/xapian-compact.cc\
+	common/fileutils.cc
 bin_xapian_compact_LDADD = $(ldflags) libgetopt.la $(libxapian_la)
 
 bin_xapian_delve_SOURCES = bin/xapian-delve.cc
@@ -71,6 +78,7 @@ bin_xapian_inspect_SOURCES = bin/xapian-inspect.cc\
 	backends/glass/glass_version.cc\
 	backends/uuids.cc\
 	common/compression_stream.cc\
+	common/crc32c.cc\
 	common/errno_to_string.cc\
 	common/io_utils.cc\
 	common/posixy_wrapper.cc\
@@ -86,6 +94,7 @@ bin_xapian_inspect_honey_CPPFLAGS =\
 bin_xapian_inspect_honey_SOURCES = bin/xapian-inspect-honey.cc\
 	api/constinfo.cc\
 	api/error.cc\
+	backends/honey/honey_bloomfilter.cc\
 	backends/honey/honey_cursor.cc\
 	backends/honey/honey_freelist.cc\
 	backends/honey/honey_table.cc\
@@ -117,6 +126,9 @@ bin_xapian_tcpsrv_SOURCES = bin/xapian-tcpsrv.cc bin/remotetcpserver.cc
 bin_xapian_tcpsrv_LDADD = $(ldflags) libgetopt.la $(libxapian_la)
 
 if DOCUMENTATION_RULES
+bin/xapian-bulkload.1: bin/xapian-bulkload$(EXEEXT) makemanpage
+	./makemanpage bin/xapian-bulkload $(srcdir)/bin/xapian-bulkload.cc bin/xapian-bulkload.1
+
 bin/xapian-check.1: bin/xapian-check$(EXEEXT) makemanpage
 	./makemanpage bin/xapian-check $(srcdir)/bin/xapian-check.cc bin/xapian-check.1
 
@@ -61,3 +61,33 @@ RemoteTcpServer::handle_one_connection(int socket)
 	// ignore other exceptions
     }
 }
+
+void
+RemoteTcpServer::run_threaded(unsigned n_threads)
+{
+    worker_dbs.resize(n_threads);
+    TcpServer::run_threaded(n_threads);
+}
+
+void
+RemoteTcpServer::handle_pooled_connection(int socket, unsigned worker)
+{
+    if (writable) {
+	// Each writer needs its own WritableDatabase.
+	handle_one_connection(socket);
+	return;
+    }
+    try {
+	RemoteServer sserv(dbpaths, worker_dbs[worker], socket, socket,
+			   active_timeout, idle_timeout);
+	sserv.set_registry(reg);
+	sserv.run();
+    } catch (const Xapian::NetworkTimeoutError &e) {
+	if (verbose)
+	    cerr << "Connection timed out: " << e.get_description() << endl;
+    } catch (const Xapian::Error &e) {
+	cerr << "Got exception " << e.get_description() << endl;
+    } catch (...) {
+	// ignore other exceptions
+    }
+}
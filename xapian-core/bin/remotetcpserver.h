@@ -21,6 +21,7 @@
 #ifndef XAPIAN_INCLUDED_REMOTETCPSERVER_H
 #define XAPIAN_INCLUDED_REMOTETCPSERVER_H
 
+#include "net/remoteserver.h"
 #include "net/tcpserver.h"
 
 #include <xapian/database.h>
@@ -58,6 +59,12 @@ class RemoteTcpServer : public TcpServer {
     /** Registry used for (un)serialisation. */
     Xapian::Registry reg;
 
+    /** The databases each worker thread keeps open between connections.
+     *
+     *  Only used by run_threaded(), and indexed by worker number.
+     */
+    std::vector<RemoteServer::SharedDatabase> worker_dbs;
+
     /** Accept a connection and return the file descriptor for it. */
     int accept_connection();
 
@@ -89,6 +96,22 @@ class RemoteTcpServer : public TcpServer {
      *  This method may be called by multiple threads.
      */
     void handle_one_connection(int socket);
+
+    /** Accept connections and service them using a pool of threads.
+     *
+     *  Each worker thread keeps its databases open between the connections it
+     *  serves, and reopens them at the start of each connection to pick up
+     *  any changes.
+     *
+     *  @param n_threads	The number of worker threads to use.
+     */
+    void run_threaded(unsigned n_threads);
+
+    /** Handle a single connection in a worker thread.
+     *
+     *  Called by run_threaded().
+     */
+    void handle_pooled_connection(int socket, unsigned worker);
 };
 
 #endif // XAPIAN_INCLUDED_REMOTETCPSERVER_H
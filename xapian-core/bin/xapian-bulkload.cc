@@ -0,0 +1,247 @@
+/** @file
+ * @brief Build a new database in bulk from the documents in existing ones.
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include <xapian.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "gnu_getopt.h"
+#include "parseint.h"
+
+#include "backends/glass/glass_defs.h"
+
+using namespace std;
+
+#define PROG_NAME "xapian-bulkload"
+#define PROG_DESC "Build a new database in bulk from the documents in existing ones"
+
+#define OPT_HELP 1
+#define OPT_VERSION 2
+
+static void show_usage() {
+    cout << "Usage: " PROG_NAME " [OPTIONS] SOURCE_DATABASE... DESTINATION_DATABASE\n\n"
+"Each document in the source databases is reindexed into the destination\n"
+"database, which is built by writing sorted runs and then merging them.\n"
+"Documents are numbered sequentially in the order they are read.\n\n"
+"Options:\n"
+"  -b, --blocksize=B  Set the blocksize in bytes (e.g. 4096) or K (e.g. 4K)\n"
+"                     (must be between 2K and 64K and a power of 2, default 8K)\n"
+"  -B, --backend=B    Set the output backend.  Supported values are 'glass'\n"
+"                     (the default) and 'honey'.\n"
+"  -M, --memory=M     Set the memory to use for inverting documents in bytes\n"
+"                     or with a K, M or G suffix (default 256M)\n"
+"  -s, --single-file  Produce a single file database\n"
+"  -q, --quiet        Don't report progress\n"
+"  --help             display this help and exit\n"
+"  --version          output version information and exit" << endl;
+}
+
+class MyCompactor : public Xapian::Compactor {
+    bool quiet;
+
+  public:
+    MyCompactor() : quiet(false) { }
+
+    void set_quiet(bool quiet_) { quiet = quiet_; }
+
+    void set_status(const string & table, const string & status);
+};
+
+void
+MyCompactor::set_status(const string & table, const string & status)
+{
+    if (quiet)
+	return;
+    if (!status.empty())
+	cout << '\r' << table << ": " << status << endl;
+    else
+	cout << table << " ..." << flush;
+}
+
+int
+main(int argc, char **argv)
+{
+    const char * opts = "b:B:M:qs";
+    static const struct option long_opts[] = {
+	{"blocksize",	required_argument, 0, 'b'},
+	{"backend",	required_argument, 0, 'B'},
+	{"memory",	required_argument, 0, 'M'},
+	{"single-file", no_argument, 0, 's'},
+	{"quiet",	no_argument, 0, 'q'},
+	{"help",	no_argument, 0, OPT_HELP},
+	{"version",	no_argument, 0, OPT_VERSION},
+	{NULL,		0, 0, 0}
+    };
+
+    MyCompactor compactor;
+    bool quiet = false;
+    int flags = 0;
+    size_t block_size = 0;
+    size_t memory = 0;
+
+    int c;
+    while ((c = gnu_getopt_long(argc, argv, opts, long_opts, 0)) != -1) {
+	switch (c) {
+	    case 'b': {
+		char *p;
+		block_size = strtoul(optarg, &p, 10);
+		if (block_size <= GLASS_MAX_BLOCKSIZE / 1024 &&
+		    (*p == 'K' || *p == 'k')) {
+		    ++p;
+		    block_size *= 1024;
+		}
+		if (*p ||
+		    block_size < GLASS_MIN_BLOCKSIZE ||
+		    block_size > GLASS_MAX_BLOCKSIZE ||
+		    (block_size & (block_size - 1)) != 0) {
+		    cerr << PROG_NAME": Bad value '" << optarg << "' passed "
+			    "for blocksize, must be a power of 2 between "
+			 << (GLASS_MIN_BLOCKSIZE / 1024) << "K and "
+			 << (GLASS_MAX_BLOCKSIZE / 1024) << "K"
+			 << endl;
+		    exit(1);
+		}
+		break;
+	    }
+	    case 'B':
+		if (strcmp(optarg, "honey") == 0) {
+		    flags |= Xapian::DB_BACKEND_HONEY;
+		} else if (strcmp(optarg, "glass") == 0) {
+		    flags |= Xapian::DB_BACKEND_GLASS;
+		} else {
+		    cerr << PROG_NAME": Bad value '" << optarg
+			 << "' passed for backend - must be 'glass' or 'honey'"
+			 << endl;
+		    exit(1);
+		}
+		break;
+	    case 'M': {
+		string arg(optarg);
+		size_t multiplier = 1;
+		if (!arg.empty()) {
+		    switch (arg.back()) {
+			case 'G': case 'g':
+			    multiplier *= 1024;
+			    // FALLTHRU
+			case 'M': case 'm':
+			    multiplier *= 1024;
+			    // FALLTHRU
+			case 'K': case 'k':
+			    multiplier *= 1024;
+			    arg.resize(arg.size() - 1);
+			    break;
+		    }
+		}
+		if (arg.empty() ||
+		    !parse_unsigned(arg.c_str(), memory) ||
+		    memory == 0 ||
+		    memory > size_t(-1) / multiplier) {
+		    cerr << PROG_NAME": Bad value '" << optarg << "' passed "
+			    "for memory" << endl;
+		    exit(1);
+		}
+		memory *= multiplier;
+		break;
+	    }
+	    case 's':
+		flags |= Xapian::DBCOMPACT_SINGLE_FILE;
+		break;
+	    case 'q':
+		quiet = true;
+		compactor.set_quiet(true);
+		break;
+	    case OPT_HELP:
+		cout << PROG_NAME " - " PROG_DESC "\n\n";
+		show_usage();
+		exit(0);
+	    case OPT_VERSION:
+		cout << PROG_NAME " - " PACKAGE_STRING << endl;
+		exit(0);
+	    default:
+		show_usage();
+		exit(1);
+	}
+    }
+
+    if (argc - optind < 2) {
+	show_usage();
+	exit(1);
+    }
+
+    // Path to the database to create.
+    string destdir = argv[argc - 1];
+
+    try {
+	Xapian::BulkLoader loader(destdir, flags, block_size);
+	if (memory) loader.set_memory_limit(memory);
+
+	for (int i = optind; i < argc - 1; ++i) {
+	    Xapian::Database db_in(argv[i]);
+
+	    Xapian::doccount dbsize = db_in.get_doccount();
+	    Xapian::doccount n = 0;
+	    for (Xapian::PostingIterator it = db_in.postlist_begin(string());
+		 it != db_in.postlist_end(string());
+		 ++it) {
+		loader.add_document(db_in.get_document(*it));
+		++n;
+		if (!quiet && (n % 1000 == 0 || n == dbsize)) {
+		    cout << '\r' << argv[i] << ": " << n << '/' << dbsize
+			 << flush;
+		}
+	    }
+	    if (!quiet) cout << endl;
+
+	    for (Xapian::TermIterator t = db_in.spellings_begin();
+		 t != db_in.spellings_end();
+		 ++t) {
+		loader.add_spelling(*t, t.get_termfreq());
+	    }
+
+	    for (Xapian::TermIterator k = db_in.synonym_keys_begin();
+		 k != db_in.synonym_keys_end();
+		 ++k) {
+		const string& key = *k;
+		for (Xapian::TermIterator s = db_in.synonyms_begin(key);
+		     s != db_in.synonyms_end(key);
+		     ++s) {
+		    loader.add_synonym(key, *s);
+		}
+	    }
+
+	    for (Xapian::TermIterator k = db_in.metadata_keys_begin();
+		 k != db_in.metadata_keys_end();
+		 ++k) {
+		const string& key = *k;
+		loader.set_metadata(key, db_in.get_metadata(key));
+	    }
+	}
+
+	loader.finish(compactor);
+    } catch (const Xapian::Error &error) {
+	cerr << argv[0] << ": " << error.get_description() << endl;
+	exit(1);
+    }
+}
@@ -35,15 +35,18 @@ using namespace std;
 #define PROG_DESC "Check the consistency of a database or table"
 
 static void show_usage() {
-    cout << "Usage: " PROG_NAME " DATABASE_DIRECTORY|PATH_TO_BTREE [[F][t][f][b][v][+]]\n\n"
+    cout << "Usage: " PROG_NAME " DATABASE_DIRECTORY|PATH_TO_BTREE [[F][t][f][b][v][p][+]]\n\n"
 "If a whole database is checked, then additional cross-checks between\n"
-"the tables are performed.\n\n"
+"the tables are performed, and the tables are checked in parallel.\n"
+"An interrupted check can't be resumed - checking just the remaining\n"
+"tables individually skips the cross-checks between tables.\n\n"
 "The btree(s) is/are always checked - control the output verbosity with:\n"
 " F = attempt to fix a broken database (implemented for glass currently)\n"
 " t = short tree printing\n"
 " f = full tree printing\n"
 " b = show free blocks\n"
 " v = show stats about B-tree (default)\n"
+" p = report progress through each table\n"
 " + = same as tbv\n"
 " e.g. " PROG_NAME " /var/lib/xapian/data/default\n"
 "      " PROG_NAME " /var/lib/xapian/data/default/postlist fbv" << endl;
@@ -77,6 +80,7 @@ main(int argc, char **argv)
 	    case 'f': opts |= Xapian::DBCHECK_FULL_TREE; break;
 	    case 'b': opts |= Xapian::DBCHECK_SHOW_FREELIST; break;
 	    case 'v': opts |= Xapian::DBCHECK_SHOW_STATS; break;
+	    case 'p': opts |= Xapian::DBCHECK_SHOW_PROGRESS; break;
 	    case '+':
 		opts |= Xapian::DBCHECK_SHORT_TREE;
 		opts |= Xapian::DBCHECK_SHOW_FREELIST;
@@ -87,7 +91,7 @@ main(int argc, char **argv)
 		break;
 	    default:
 		cerr << "option " << opt_string << " unknown\n";
-		cerr << "use t,f,b,v and/or + in the option string\n";
+		cerr << "use F,t,f,b,v,p and/or + in the option string\n";
 		exit(1);
 	}
     }
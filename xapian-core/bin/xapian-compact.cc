@@ -3,6 +3,7 @@
  */
 /* Copyright (C) 2003,2004,2005,2006,2007,2008,2009,2010,2015,2018 Olly Betts
  * Copyright (C) 2008 Lemur Consulting Ltd
+ * Copyright (C) 2026 agent
  *
  * This program is free software; you can redistribute it and/or
  * modify it under the terms of the GNU General Public License as
@@ -24,11 +25,20 @@
 
 #include <xapian.h>
 
+#include <cerrno>
 #include <cstdlib>
 #include <cstring>
+#include <ctime>
+#include <deque>
 #include <iostream>
+#include <string>
+#include <utility>
 
+#include "filetests.h"
+#include "fileutils.h"
 #include "gnu_getopt.h"
+#include "parseint.h"
+#include "safeunistd.h"
 
 #include "backends/glass/glass_defs.h"
 
@@ -40,9 +50,19 @@ using namespace std;
 #define OPT_HELP 1
 #define OPT_VERSION 2
 #define OPT_NO_RENUMBER 3
+#define OPT_MERGE_SHARDS 4
+#define OPT_INTERVAL 5
+#define OPT_CHECKSUMS 6
+#define OPT_PACKED_POSTINGS 7
+#define OPT_REORDER_BY_VALUE 8
+#define OPT_EYTZINGER_INDEX 9
+#define OPT_BLOOM_FILTERS 10
+#define OPT_ALIGNED_POSITIONS 11
+#define OPT_REMOVE_MERGED 12
 
 static void show_usage() {
-    cout << "Usage: " PROG_NAME " [OPTIONS] SOURCE_DATABASE... DESTINATION_DATABASE\n\n"
+    cout << "Usage: " PROG_NAME " [OPTIONS] SOURCE_DATABASE... DESTINATION_DATABASE\n"
+"       " PROG_NAME " [OPTIONS] --merge-shards[=N] STUB_DATABASE\n\n"
 "Options:\n"
 "  -b, --blocksize=B  Set the blocksize in bytes (e.g. 4096) or K (e.g. 4K)\n"
 "                     (must be between 2K and 64K and a power of 2, default 8K)\n"
@@ -62,6 +82,35 @@ static void show_usage() {
 "                     option is only supported when merging databases if they\n"
 "                     have disjoint ranges of used document ids\n"
 "  -s, --single-file  Produce a single file database\n"
+"  -Z, --compression=C  Set the codec used to compress glass tables.\n"
+"                     Supported values are 'zlib' (the default), 'zstd' and\n"
+"                     'lz4' (if Xapian was built with support for them)\n"
+"      --checksums    Store a checksum in each block of glass tables, so that\n"
+"                     corruption is detected when blocks are read\n"
+"      --packed-postings  Store posting lists of honey output as blocks of\n"
+"                     bit-packed values, which are faster to decode\n"
+"      --eytzinger-index  Give tables of honey output an index laid out to\n"
+"                     make key lookups more cache-friendly\n"
+"      --bloom-filters  Store Bloom filters in honey output so that most\n"
+"                     lookups of terms which aren't present don't need to\n"
+"                     read the table\n"
+"      --aligned-positions  Store positional data of honey output in one entry\n"
+"                     per posting list chunk, which makes phrase searches\n"
+"                     faster\n"
+"      --reorder-by-value=SLOT  Renumber documents in order of the value in\n"
+"                     SLOT, so documents with similar values get nearby\n"
+"                     document ids.  Can be given more than once, with later\n"
+"                     slots used to order documents with equal earlier ones\n"
+"      --merge-shards[=N]  Merge shards of STUB_DATABASE in tiers, so that\n"
+"                     there are fewer than N shards (default 4) of each size\n"
+"                     (shards merged are left for you to remove)\n"
+"      --interval=N   With --merge-shards, keep running and check if shards\n"
+"                     need merging every N seconds (shards merged are still\n"
+"                     left for you to remove unless --remove-merged is used)\n"
+"      --remove-merged=N  With --merge-shards and --interval, remove shards\n"
+"                     N seconds after they've been merged (readers which\n"
+"                     still have them open need to reopen the stub database\n"
+"                     before then)\n"
 "  --help             display this help and exit\n"
 "  --version          output version information and exit" << endl;
 }
@@ -74,6 +123,8 @@ class MyCompactor : public Xapian::Compactor {
 
     void set_quiet(bool quiet_) { quiet = quiet_; }
 
+    bool is_quiet() const { return quiet; }
+
     void set_status(const string & table, const string & status);
 
     string
@@ -111,7 +162,7 @@ MyCompactor::resolve_duplicate_metadata(const string & key,
 int
 main(int argc, char **argv)
 {
-    const char * opts = "b:B:nFmqs";
+    const char * opts = "b:B:nFmqsZ:";
     static const struct option long_opts[] = {
 	{"fuller",	no_argument, 0, 'F'},
 	{"no-full",	no_argument, 0, 'n'},
@@ -120,6 +171,16 @@ main(int argc, char **argv)
 	{"backend",	required_argument, 0, 'B'},
 	{"no-renumber", no_argument, 0, OPT_NO_RENUMBER},
 	{"single-file", no_argument, 0, 's'},
+	{"compression", required_argument, 0, 'Z'},
+	{"merge-shards", optional_argument, 0, OPT_MERGE_SHARDS},
+	{"interval",	required_argument, 0, OPT_INTERVAL},
+	{"remove-merged", required_argument, 0, OPT_REMOVE_MERGED},
+	{"checksums",	no_argument, 0, OPT_CHECKSUMS},
+	{"packed-postings", no_argument, 0, OPT_PACKED_POSTINGS},
+	{"reorder-by-value", required_argument, 0, OPT_REORDER_BY_VALUE},
+	{"eytzinger-index", no_argument, 0, OPT_EYTZINGER_INDEX},
+	{"bloom-filters", no_argument, 0, OPT_BLOOM_FILTERS},
+	{"aligned-positions", no_argument, 0, OPT_ALIGNED_POSITIONS},
 	{"quiet",	no_argument, 0, 'q'},
 	{"help",	no_argument, 0, OPT_HELP},
 	{"version",	no_argument, 0, OPT_VERSION},
@@ -131,6 +192,12 @@ main(int argc, char **argv)
     unsigned backend = 0;
     unsigned flags = 0;
     size_t block_size = 0;
+    unsigned merge_factor = 0;
+    unsigned interval = 0;
+    unsigned remove_merged = 0;
+    bool remove_merged_set = false;
+    Xapian::MultiValueKeyMaker sorter;
+    bool reorder = false;
 
     int c;
     while ((c = gnu_getopt_long(argc, argv, opts, long_opts, 0)) != -1) {
@@ -183,9 +250,74 @@ main(int argc, char **argv)
 	    case 's':
 		flags |= Xapian::DBCOMPACT_SINGLE_FILE;
 		break;
+	    case 'Z':
+		flags &= ~(Xapian::DB_COMPRESS_ZSTD|Xapian::DB_COMPRESS_LZ4);
+		if (strcmp(optarg, "zstd") == 0) {
+		    flags |= Xapian::DB_COMPRESS_ZSTD;
+		} else if (strcmp(optarg, "lz4") == 0) {
+		    flags |= Xapian::DB_COMPRESS_LZ4;
+		} else if (strcmp(optarg, "zlib") != 0) {
+		    cerr << PROG_NAME": Bad value '" << optarg
+			 << "' passed for compression - must be 'zlib', "
+			    "'zstd' or 'lz4'" << endl;
+		    exit(1);
+		}
+		break;
+	    case OPT_MERGE_SHARDS:
+		merge_factor = 4;
+		if (optarg &&
+		    (!parse_unsigned(optarg, merge_factor) || merge_factor < 2)) {
+		    cerr << PROG_NAME": Bad value '" << optarg << "' passed "
+			    "for merge-shards, must be an integer >= 2" << endl;
+		    exit(1);
+		}
+		break;
+	    case OPT_INTERVAL:
+		if (!parse_unsigned(optarg, interval) || interval == 0) {
+		    cerr << PROG_NAME": Bad value '" << optarg << "' passed "
+			    "for interval, must be a positive integer" << endl;
+		    exit(1);
+		}
+		break;
+	    case OPT_REMOVE_MERGED:
+		if (!parse_unsigned(optarg, remove_merged)) {
+		    cerr << PROG_NAME": Bad value '" << optarg << "' passed "
+			    "for remove-merged, must be a non-negative integer"
+			 << endl;
+		    exit(1);
+		}
+		remove_merged_set = true;
+		break;
 	    case 'q':
 		compactor.set_quiet(true);
 		break;
+	    case OPT_CHECKSUMS:
+		flags |= Xapian::DB_BLOCK_CHECKSUMS;
+		break;
+	    case OPT_PACKED_POSTINGS:
+		flags |= Xapian::DB_PACKED_POSTINGS;
+		break;
+	    case OPT_EYTZINGER_INDEX:
+		flags |= Xapian::DB_EYTZINGER_INDEX;
+		break;
+	    case OPT_BLOOM_FILTERS:
+		flags |= Xapian::DB_BLOOM_FILTERS;
+		break;
+	    case OPT_ALIGNED_POSITIONS:
+		flags |= Xapian::DB_ALIGNED_POSITIONS;
+		break;
+	    case OPT_REORDER_BY_VALUE: {
+		Xapian::valueno slot;
+		if (!parse_unsigned(optarg, slot)) {
+		    cerr << PROG_NAME": Bad value '" << optarg << "' passed "
+			    "for reorder-by-value, must be a value slot number"
+			 << endl;
+		    exit(1);
+		}
+		sorter.add_value(slot);
+		reorder = true;
+		break;
+	    }
 	    case OPT_HELP:
 		cout << PROG_NAME " - " PROG_DESC "\n\n";
 		show_usage();
@@ -199,7 +331,83 @@ main(int argc, char **argv)
 	}
     }
 
-    if (argc - optind < 2) {
+    flags |= backend | level;
+
+    if (reorder && (merge_factor || (flags & Xapian::DBCOMPACT_NO_RENUMBER))) {
+	cerr << PROG_NAME": --reorder-by-value can't be used with "
+		"--merge-shards or --no-renumber" << endl;
+	exit(1);
+    }
+
+    if (remove_merged_set && !interval) {
+	cerr << PROG_NAME": --remove-merged can only be used with --interval"
+	     << endl;
+	exit(1);
+    }
+
+    if (merge_factor) {
+	if (argc - optind != 1) {
+	    show_usage();
+	    exit(1);
+	}
+	const char* stub = argv[optind];
+	// Shards which have been merged, and when, waiting to be removed.
+	deque<pair<time_t, string>> to_remove;
+	while (true) {
+	    try {
+		while (true) {
+		    auto merged = Xapian::merge_shards(stub, merge_factor,
+						       flags, block_size,
+						       &compactor);
+		    if (merged.empty()) break;
+		    if (!compactor.is_quiet()) {
+			cout << "Merged " << merged.size() << " shards:";
+			for (auto&& path : merged) {
+			    cout << ' ' << path;
+			}
+			cout << endl;
+		    }
+		    if (remove_merged_set) {
+			time_t now = time(NULL);
+			for (auto&& path : merged) {
+			    to_remove.emplace_back(now, path);
+			}
+		    }
+		}
+	    } catch (const Xapian::Error &error) {
+		cerr << argv[0] << ": " << error.get_description() << endl;
+		// Keep going in daemon mode, as the problem may be transient
+		// (e.g. the disk being full).
+		if (!interval) exit(1);
+	    }
+	    if (!interval) break;
+	    time_t now = time(NULL);
+	    while (!to_remove.empty() &&
+		   now - to_remove.front().first >= time_t(remove_merged)) {
+		const string& path = to_remove.front().second;
+		try {
+		    if (file_exists(path)) {
+			if (unlink(path.c_str()) < 0) {
+			    throw Xapian::DatabaseError("Cannot remove file '" +
+							path + "'", errno);
+			}
+		    } else {
+			removedir(path);
+		    }
+		    if (!compactor.is_quiet()) {
+			cout << "Removed merged shard: " << path << endl;
+		    }
+		} catch (const Xapian::Error &error) {
+		    cerr << argv[0] << ": " << error.get_description() << endl;
+		}
+		to_remove.pop_front();
+	    }
+	    sleep(interval);
+	}
+	exit(0);
+    }
+
+    if (argc - optind < 2 || interval) {
 	show_usage();
 	exit(1);
     }
@@ -207,14 +415,17 @@ main(int argc, char **argv)
     // Path to the database to create.
     string destdir = argv[argc - 1];
 
-    flags |= backend | level;
-
     try {
 	Xapian::Database src;
 	for (int i = optind; i < argc - 1; ++i) {
 	    src.add_database(Xapian::Database(argv[i]));
 	}
-	src.compact(destdir, flags, block_size, compactor);
+	if (reorder) {
+	    Xapian::compact_reordered(src, destdir, sorter, flags, block_size,
+				      &compactor);
+	} else {
+	    src.compact(destdir, flags, block_size, compactor);
+	}
     } catch (const Xapian::Error &error) {
 	cerr << argv[0] << ": " << error.get_description() << endl;
 	exit(1);
@@ -55,6 +55,7 @@ const int MSECS_ACTIVE_TIMEOUT_DEFAULT = 15000;
 
 #define OPT_HELP 1
 #define OPT_VERSION 2
+#define OPT_THREADS 3
 
 static const char * opts = "I:p:a:i:t:oqw";
 static const struct option long_opts[] = {
@@ -66,6 +67,7 @@ static const struct option long_opts[] = {
     {"one-shot",	no_argument,		0, 'o'},
     {"quiet",		no_argument,		0, 'q'},
     {"writable",	no_argument,		0, 'w'},
+    {"threads",		required_argument,	0, OPT_THREADS},
     {"help",		no_argument,		0, OPT_HELP},
     {"version",		no_argument,		0, OPT_VERSION},
     {NULL, 0, 0, 0}
@@ -83,6 +85,9 @@ static void show_usage() {
 "  --one-shot              serve a single connection and exit\n"
 "  --quiet                 disable information messages to stdout\n"
 "  --writable              allow updates (only one database directory allowed)\n"
+"  --threads N             serve connections with a pool of N threads which keep\n"
+"                          the databases open between connections (default is\n"
+"                          to fork a process for each connection)\n"
 "  --help                  display this help and exit\n"
 "  --version               output version information and exit" << endl;
 }
@@ -96,6 +101,7 @@ int main(int argc, char **argv) {
     bool one_shot = false;
     bool verbose = true;
     bool writable = false;
+    unsigned threads = 0;
     bool syntax_error = false;
 
     int c;
@@ -155,6 +161,12 @@ int main(int argc, char **argv) {
 	    case 'w':
 		writable = true;
 		break;
+	    case OPT_THREADS:
+		if (!parse_unsigned(optarg, threads) || threads == 0) {
+		    cerr << "Number of threads must be >= 1" << endl;
+		    exit(1);
+		}
+		break;
 	    default:
 		syntax_error = true;
 	}
@@ -209,6 +221,8 @@ int main(int argc, char **argv) {
 
 	if (one_shot) {
 	    server.run_once();
+	} else if (threads) {
+	    server.run_threaded(threads);
 	} else {
 	    server.run();
 	}
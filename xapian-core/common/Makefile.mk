@@ -1,9 +1,11 @@
 noinst_HEADERS +=\
 	common/alignment_cast.h\
 	common/append_filename_arg.h\
+	common/bitunpack.h\
 	common/bitstream.h\
 	common/closefrom.h\
 	common/compression_stream.h\
+	common/crc32c.h\
 	common/debuglog.h\
 	common/errno_to_string.h\
 	common/exp10.h\
@@ -23,6 +25,7 @@ noinst_HEADERS +=\
 	common/output.h\
 	common/overflow.h\
 	common/pack.h\
+	common/packedpositions.h\
 	common/parseint.h\
 	common/popcount.h\
 	common/posixy_wrapper.h\
@@ -55,6 +58,7 @@ EXTRA_DIST +=\
 lib_src +=\
 	common/bitstream.cc\
 	common/closefrom.cc\
+	common/crc32c.cc\
 	common/debuglog.cc\
 	common/errno_to_string.cc\
 	common/fileutils.cc\
@@ -63,6 +67,7 @@ lib_src +=\
 	common/msvc_dirent.cc\
 	common/omassert.cc\
 	common/pack.cc\
+	common/packedpositions.cc\
 	common/posixy_wrapper.cc\
 	common/replicate_utils.cc\
 	common/safe.cc\
@@ -0,0 +1,148 @@
+/** @file
+ * @brief Unpack blocks of fixed-width bit-packed values.
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_BITUNPACK_H
+#define XAPIAN_INCLUDED_BITUNPACK_H
+
+#include "xapian/error.h"
+
+#include "omassert.h"
+#include "wordaccess.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+/* Used for the bit-packed position lists in glass and honey, and the
+ * bit-packed posting data in honey.  A block of n values which are each
+ * W bits is stored in (n * W + 7) / 8 bytes, least significant bit first.
+ *
+ * Every value in a block uses the same number of bits, so unpacking a block
+ * is a fixed sequence of loads, shifts and masks without any data-dependent
+ * branches, which compilers can unroll and vectorise.
+ */
+
+/** Throw DatabaseCorruptError for bad bit-packed data.
+ *
+ *  @param what	What the data is, e.g. "Position list".
+ */
+[[noreturn]]
+inline void
+throw_packed_data_corrupt(const char* what)
+{
+    throw Xapian::DatabaseCorruptError(std::string(what) + " data corrupt");
+}
+
+/// Read 8 bytes in little-endian order.
+inline uint64_t
+read_le64(const unsigned char* p)
+{
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+#ifdef WORDS_BIGENDIAN
+    v = do_bswap(v);
+#endif
+    return v;
+}
+
+/** Unpack values which are W bits each.
+ *
+ *  Groups of 8 values occupy exactly W bytes, so we unpack a whole group at a
+ *  time with constant offsets and shifts.  The caller must ensure that the
+ *  input can be read up to 8 bytes beyond the end of the last group, and
+ *  that @a out has space for @a n rounded up to a multiple of 8.
+ */
+template<unsigned W, typename T>
+void
+unpack_bits(const unsigned char* in, unsigned n, T* out)
+{
+    const uint64_t mask = (uint64_t(1) << W) - 1;
+    for (unsigned i = 0; i < n; i += 8) {
+	const unsigned char* group = in + (i / 8) * W;
+	for (unsigned j = 0; j != 8; ++j) {
+	    const unsigned bit = j * W;
+	    uint64_t v = read_le64(group + bit / 8) >> (bit % 8);
+	    out[i + j] = T(v & mask);
+	}
+    }
+}
+
+/// Table of unpack_bits() for each width from 0 to 32.
+template<typename T>
+struct BitUnpackers {
+    typedef void (*unpacker)(const unsigned char*, unsigned, T*);
+
+    static const unpacker table[33];
+};
+
+template<typename T>
+const typename BitUnpackers<T>::unpacker BitUnpackers<T>::table[33] = {
+    unpack_bits<0, T>, unpack_bits<1, T>, unpack_bits<2, T>,
+    unpack_bits<3, T>, unpack_bits<4, T>, unpack_bits<5, T>,
+    unpack_bits<6, T>, unpack_bits<7, T>, unpack_bits<8, T>,
+    unpack_bits<9, T>, unpack_bits<10, T>, unpack_bits<11, T>,
+    unpack_bits<12, T>, unpack_bits<13, T>, unpack_bits<14, T>,
+    unpack_bits<15, T>, unpack_bits<16, T>, unpack_bits<17, T>,
+    unpack_bits<18, T>, unpack_bits<19, T>, unpack_bits<20, T>,
+    unpack_bits<21, T>, unpack_bits<22, T>, unpack_bits<23, T>,
+    unpack_bits<24, T>, unpack_bits<25, T>, unpack_bits<26, T>,
+    unpack_bits<27, T>, unpack_bits<28, T>, unpack_bits<29, T>,
+    unpack_bits<30, T>, unpack_bits<31, T>, unpack_bits<32, T>
+};
+
+/** Unpack a block of @a n values which are @a width bits each.
+ *
+ *  If there's enough data after the block we unpack it in place, otherwise
+ *  we copy it to a padded buffer first.
+ *
+ *  @param p	Start of the packed values, updated to just after them.
+ *  @param end	End of the data.
+ *  @param width	The number of bits per value.
+ *  @param n	The number of values (at most MAX_N).
+ *  @param out	Where to put the values, which must have space for @a n
+ *		rounded up to a multiple of 8.
+ *
+ *  @return false if @a width is more than 32 or the data is too short.
+ */
+template<unsigned MAX_N, typename T>
+bool
+unpack_bit_block(const unsigned char*& p, const unsigned char* end,
+		 unsigned width, unsigned n, T* out)
+{
+    AssertRel(n, <=, MAX_N);
+    if (width > 32) return false;
+    size_t bytes = (size_t(n) * width + 7) / 8;
+    if (size_t(end - p) < bytes) return false;
+
+    size_t padded = (n + 7) / 8 * width + 8;
+    if (size_t(end - p) >= padded) {
+	BitUnpackers<T>::table[width](p, n, out);
+    } else {
+	unsigned char tmp[MAX_N * 4 + 8];
+	std::memcpy(tmp, p, bytes);
+	std::memset(tmp + bytes, 0, padded - bytes);
+	BitUnpackers<T>::table[width](tmp, n, out);
+    }
+    p += bytes;
+    return true;
+}
+
+#endif // XAPIAN_INCLUDED_BITUNPACK_H
@@ -1,9 +1,10 @@
 /** @file
- * @brief class wrapper around zlib
+ * @brief class wrapper around zlib, zstd and LZ4
  */
 /* Copyright (C) 2007,2009,2012,2013,2014,2016,2019 Olly Betts
  * Copyright (C) 2009 Richard Boulton
  * Copyright (C) 2012 Dan Colish
+ * Copyright (C) 2026 agent
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -23,14 +24,30 @@
 #include <config.h>
 #include "compression_stream.h"
 
+#include <cstring>
+
 #include "omassert.h"
+#include "pack.h"
 #include "str.h"
 #include "stringutils.h"
 
 #include "xapian/error.h"
 
+#ifdef HAVE_LZ4
+# include <lz4.h>
+#endif
+
 using namespace std;
 
+/// zstd compression level to use (zstd's default is 3).
+#define ZSTD_LEVEL 3
+
+/** Space to reserve for the sizes which prefix an LZ4 block.
+ *
+ *  Two pack_uint()-encoded 32-bit values take at most 5 bytes each.
+ */
+#define LZ4_HEADER_MAX 10
+
 CompressionStream::~CompressionStream() {
     if (deflate_zstream) {
 	// Errors which we care about have already been handled, so just ignore
@@ -46,11 +63,56 @@ CompressionStream::~CompressionStream() {
 	delete inflate_zstream;
     }
 
+#ifdef HAVE_ZSTD
+    ZSTD_freeCCtx(zstd_cctx);
+    ZSTD_freeDStream(zstd_dstream);
+#endif
+
     delete [] out;
 }
 
+bool
+CompressionStream::codec_available(int codec_)
+{
+    switch (codec_) {
+	case COMPRESSION_ZLIB:
+	    return true;
+	case COMPRESSION_ZSTD:
+#ifdef HAVE_ZSTD
+	    return true;
+#else
+	    return false;
+#endif
+	case COMPRESSION_LZ4:
+#ifdef HAVE_LZ4
+	    return true;
+#else
+	    return false;
+#endif
+    }
+    return false;
+}
+
+void
+CompressionStream::set_codec(int codec_)
+{
+    if (codec_ < 0 || codec_ >= COMPRESSION_MAX_) {
+	throw Xapian::DatabaseError("Unknown compression codec " + str(codec_));
+    }
+    if (!codec_available(codec_)) {
+	const char* name = (codec_ == COMPRESSION_ZSTD ? "zstd" : "LZ4");
+	string msg = name;
+	msg += " compression support not compiled in";
+	throw Xapian::FeatureUnavailableError(msg);
+    }
+    codec = codec_;
+}
+
 const char*
 CompressionStream::compress(const char* buf, size_t* p_size) {
+    if (codec == COMPRESSION_ZSTD) return compress_zstd(buf, p_size);
+    if (codec == COMPRESSION_LZ4) return compress_lz4(buf, p_size);
+
     lazy_alloc_deflate_zstream();
     size_t size = *p_size;
     if (!out || out_len < size) {
@@ -82,9 +144,182 @@ CompressionStream::compress(const char* buf, size_t* p_size) {
     return out;
 }
 
+const char*
+CompressionStream::compress_zstd(const char* buf, size_t* p_size) {
+#ifdef HAVE_ZSTD
+    size_t size = *p_size;
+    if (!out || out_len < size) {
+	out_len = size;
+	delete [] out;
+	out = NULL;
+	out = new char[size];
+    }
+    if (!zstd_cctx) {
+	zstd_cctx = ZSTD_createCCtx();
+	if (!zstd_cctx) throw std::bad_alloc();
+    }
+    // As for zlib, limit the output to the size of the input so zstd gives
+    // up if the data doesn't compress.
+    size_t result = ZSTD_compressCCtx(zstd_cctx, out, size, buf, size,
+				      ZSTD_LEVEL);
+    if (ZSTD_isError(result) || result >= size) {
+	// Either the data wasn't compressible, or it didn't get smaller.
+	return NULL;
+    }
+    *p_size = result;
+    return out;
+#else
+    (void)buf;
+    (void)p_size;
+    return NULL;
+#endif
+}
+
+const char*
+CompressionStream::compress_lz4(const char* buf, size_t* p_size) {
+#ifdef HAVE_LZ4
+    size_t size = *p_size;
+    if (size <= LZ4_HEADER_MAX || size > size_t(LZ4_MAX_INPUT_SIZE)) {
+	return NULL;
+    }
+    if (!out || out_len < size) {
+	out_len = size;
+	delete [] out;
+	out = NULL;
+	out = new char[size];
+    }
+    // Compress into the buffer after space for the header, and limit the
+    // output so the result is always smaller than the input.
+    int result = LZ4_compress_default(buf, out + LZ4_HEADER_MAX,
+				      int(size), int(size - LZ4_HEADER_MAX));
+    if (result <= 0) {
+	// The data wasn't compressible.
+	return NULL;
+    }
+
+    // Prefix the block with its compressed and uncompressed sizes, since
+    // LZ4's block format doesn't record either.
+    string header;
+    pack_uint(header, unsigned(result));
+    pack_uint(header, size);
+    AssertRel(header.size(),<=,LZ4_HEADER_MAX);
+    char* start = out + LZ4_HEADER_MAX - header.size();
+    memcpy(start, header.data(), header.size());
+    *p_size = header.size() + size_t(result);
+    if (*p_size >= size) {
+	// It didn't get smaller.
+	return NULL;
+    }
+    return start;
+#else
+    (void)buf;
+    (void)p_size;
+    return NULL;
+#endif
+}
+
+void
+CompressionStream::decompress_start()
+{
+    switch (codec) {
+	case COMPRESSION_ZSTD:
+#ifdef HAVE_ZSTD
+	    if (!zstd_dstream) {
+		zstd_dstream = ZSTD_createDStream();
+		if (!zstd_dstream) throw std::bad_alloc();
+	    }
+	    if (rare(ZSTD_isError(ZSTD_initDStream(zstd_dstream)))) {
+		throw Xapian::DatabaseError("ZSTD_initDStream failed");
+	    }
+#endif
+	    break;
+	case COMPRESSION_LZ4:
+	    lz4_input.resize(0);
+	    break;
+	default:
+	    lazy_alloc_inflate_zstream();
+	    break;
+    }
+}
+
+bool
+CompressionStream::decompress_chunk_zstd(const char* p, int len, string& buf)
+{
+#ifdef HAVE_ZSTD
+    char blk[8192];
+
+    ZSTD_inBuffer in = { p, size_t(len), 0 };
+    while (true) {
+	ZSTD_outBuffer zout = { blk, sizeof(blk), 0 };
+	size_t result = ZSTD_decompressStream(zstd_dstream, &zout, &in);
+	if (ZSTD_isError(result)) {
+	    string msg = "zstd decompression failed (";
+	    msg += ZSTD_getErrorName(result);
+	    msg += ')';
+	    throw Xapian::DatabaseError(msg);
+	}
+
+	buf.append(blk, zout.pos);
+	if (result == 0) return true;
+	// If the output buffer was filled, there may be more output pending.
+	if (in.pos == in.size && zout.pos < zout.size) return false;
+    }
+#else
+    (void)p;
+    (void)len;
+    (void)buf;
+    return true;
+#endif
+}
+
+bool
+CompressionStream::decompress_chunk_lz4(const char* p, int len, string& buf)
+{
+#ifdef HAVE_LZ4
+    lz4_input.append(p, len);
+
+    const char* ptr = lz4_input.data();
+    const char* end = ptr + lz4_input.size();
+    unsigned compressed_size, size;
+    if (!unpack_uint(&ptr, end, &compressed_size) ||
+	!unpack_uint(&ptr, end, &size)) {
+	if (ptr == NULL) {
+	    // We don't have the whole header yet.
+	    return false;
+	}
+	throw Xapian::DatabaseError("Bad LZ4 block header");
+    }
+    size_t available = size_t(end - ptr);
+    if (available < compressed_size) return false;
+    if (available > compressed_size ||
+	compressed_size > unsigned(LZ4_MAX_INPUT_SIZE) ||
+	size > unsigned(LZ4_MAX_INPUT_SIZE)) {
+	throw Xapian::DatabaseError("Bad LZ4 block header");
+    }
+
+    size_t old_size = buf.size();
+    buf.resize(old_size + size);
+    int result = LZ4_decompress_safe(ptr, &buf[old_size],
+				     int(compressed_size), int(size));
+    if (result < 0 || unsigned(result) != size) {
+	throw Xapian::DatabaseError("LZ4 decompression failed");
+    }
+    lz4_input.resize(0);
+    return true;
+#else
+    (void)p;
+    (void)len;
+    (void)buf;
+    return true;
+#endif
+}
+
 bool
 CompressionStream::decompress_chunk(const char* p, int len, string& buf)
 {
+    if (codec == COMPRESSION_ZSTD) return decompress_chunk_zstd(p, len, buf);
+    if (codec == COMPRESSION_LZ4) return decompress_chunk_lz4(p, len, buf);
+
     Bytef blk[8192];
 
     inflate_zstream->next_in = reinterpret_cast<const Bytef*>(p);
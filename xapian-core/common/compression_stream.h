@@ -1,8 +1,9 @@
 /** @file
- * @brief class wrapper around zlib
+ * @brief class wrapper around zlib, zstd and LZ4
  */
 /* Copyright (C) 2012 Dan Colish
  * Copyright (C) 2012,2013,2014,2016 Olly Betts
+ * Copyright (C) 2026 agent
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -25,10 +26,31 @@
 #include "internaltypes.h"
 #include <string>
 #include <zlib.h>
+#ifdef HAVE_ZSTD
+# include <zstd.h>
+#endif
+
+/** Codecs which CompressionStream supports.
+ *
+ *  These values are stored on disk, so must not be changed.
+ */
+enum {
+    /// Raw deflate (zlib).
+    COMPRESSION_ZLIB = 0,
+    /// zstd frames.
+    COMPRESSION_ZSTD = 1,
+    /// LZ4 blocks, prefixed by their sizes.
+    COMPRESSION_LZ4 = 2,
+    /// Upper bound on the codec values.
+    COMPRESSION_MAX_ = 3
+};
 
 class CompressionStream {
     int compress_strategy;
 
+    /// The codec to use - one of the COMPRESSION_* constants.
+    int codec;
+
     size_t out_len;
 
     char* out;
@@ -39,6 +61,29 @@ class CompressionStream {
     /// Zlib state object for inflating
     z_stream* inflate_zstream;
 
+#ifdef HAVE_ZSTD
+    /// zstd state object for compressing.
+    ZSTD_CCtx* zstd_cctx;
+
+    /// zstd state object for decompressing.
+    ZSTD_DStream* zstd_dstream;
+#endif
+
+    /** Compressed data seen so far for an LZ4 block.
+     *
+     *  LZ4's block format can't be decoded incrementally, so we accumulate
+     *  the chunks until we have the whole block.
+     */
+    std::string lz4_input;
+
+    const char* compress_zstd(const char* buf, size_t* p_size);
+
+    const char* compress_lz4(const char* buf, size_t* p_size);
+
+    bool decompress_chunk_zstd(const char* p, int len, std::string& buf);
+
+    bool decompress_chunk_lz4(const char* p, int len, std::string& buf);
+
     /// Allocate the zstream for deflating, if not already allocated.
     void lazy_alloc_deflate_zstream();
 
@@ -53,17 +98,43 @@ class CompressionStream {
      */
     explicit CompressionStream(int compress_strategy_ = Z_DEFAULT_STRATEGY)
 	: compress_strategy(compress_strategy_),
+	  codec(COMPRESSION_ZLIB),
 	  out_len(0),
 	  out(NULL),
 	  deflate_zstream(NULL),
 	  inflate_zstream(NULL)
+#ifdef HAVE_ZSTD
+	  , zstd_cctx(NULL),
+	  zstd_dstream(NULL)
+#endif
     { }
 
     ~CompressionStream();
 
+    /** Select the codec to use.
+     *
+     *  @param codec_	One of the COMPRESSION_* constants.
+     *
+     *  @exception Xapian::FeatureUnavailableError if support for @a codec_
+     *		   wasn't compiled in.
+     *  @exception Xapian::DatabaseError if @a codec_ isn't a known codec.
+     */
+    void set_codec(int codec_);
+
+    /// Return the codec in use.
+    int get_codec() const { return codec; }
+
+    /// Return true if support for codec @a codec_ was compiled in.
+    static bool codec_available(int codec_);
+
+    /** Compress a block of data.
+     *
+     *  Returns a pointer to the compressed data (and updates *p_size), or
+     *  NULL if compressing wouldn't make the data smaller.
+     */
     const char* compress(const char* buf, size_t* p_size);
 
-    void decompress_start() { lazy_alloc_inflate_zstream(); }
+    void decompress_start();
 
     /** Returns true if this was the final chunk. */
     bool decompress_chunk(const char* p, int len, std::string& buf);
@@ -0,0 +1,157 @@
+/** @file
+ * @brief Calculate CRC32C checksums
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "crc32c.h"
+
+#include <cstring>
+
+#if defined __GNUC__ && (defined __x86_64__ || defined __i386__)
+// We compile the SSE4.2 version with a target attribute and check at
+// runtime if the CPU supports it, so we don't need to require SSE4.2.
+# define USE_CRC32C_SSE42
+# include <nmmintrin.h>
+#elif defined __ARM_FEATURE_CRC32
+// The compiler has been told the target supports the CRC instructions.
+# define USE_CRC32C_ARM
+# include <arm_acle.h>
+#endif
+
+using namespace std;
+
+/// CRC32C polynomial (0x1EDC6F41) in reversed bit order.
+static const uint32_t CRC32C_POLY = 0x82F63B78;
+
+/** Tables for calculating CRC32C 8 bytes at a time.
+ *
+ *  t[0][b] is the CRC of byte b, and t[k][b] is the CRC of byte b followed
+ *  by k zero bytes.
+ */
+struct CRC32CTables {
+    uint32_t t[8][256];
+
+    CRC32CTables() {
+	for (unsigned b = 0; b != 256; ++b) {
+	    uint32_t crc = b;
+	    for (int i = 0; i != 8; ++i) {
+		crc = (crc >> 1) ^ (CRC32C_POLY & (0 - (crc & 1)));
+	    }
+	    t[0][b] = crc;
+	}
+	for (unsigned b = 0; b != 256; ++b) {
+	    for (int k = 1; k != 8; ++k) {
+		uint32_t crc = t[k - 1][b];
+		t[k][b] = (crc >> 8) ^ t[0][crc & 0xff];
+	    }
+	}
+    }
+};
+
+static inline uint32_t
+read_le32(const unsigned char* p)
+{
+    return uint32_t(p[0]) | uint32_t(p[1]) << 8 |
+	   uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24;
+}
+
+static uint32_t
+crc32c_table(uint32_t crc, const unsigned char* p, size_t len)
+{
+    static const CRC32CTables tables;
+    const auto& t = tables.t;
+    while (len >= 8) {
+	uint32_t lo = crc ^ read_le32(p);
+	uint32_t hi = read_le32(p + 4);
+	crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^
+	      t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^
+	      t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^
+	      t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+	p += 8;
+	len -= 8;
+    }
+    while (len--) {
+	crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xff];
+    }
+    return crc;
+}
+
+#ifdef USE_CRC32C_SSE42
+__attribute__((target("sse4.2")))
+static uint32_t
+crc32c_sse42(uint32_t crc, const unsigned char* p, size_t len)
+{
+# ifdef __x86_64__
+    uint64_t crc64 = crc;
+    while (len >= 8) {
+	uint64_t v;
+	memcpy(&v, p, 8);
+	crc64 = _mm_crc32_u64(crc64, v);
+	p += 8;
+	len -= 8;
+    }
+    crc = uint32_t(crc64);
+# endif
+    while (len >= 4) {
+	uint32_t v;
+	memcpy(&v, p, 4);
+	crc = _mm_crc32_u32(crc, v);
+	p += 4;
+	len -= 4;
+    }
+    while (len--) {
+	crc = _mm_crc32_u8(crc, *p++);
+    }
+    return crc;
+}
+#endif
+
+#ifdef USE_CRC32C_ARM
+static uint32_t
+crc32c_arm(uint32_t crc, const unsigned char* p, size_t len)
+{
+    while (len >= 8) {
+	uint64_t v;
+	memcpy(&v, p, 8);
+	crc = __crc32cd(crc, v);
+	p += 8;
+	len -= 8;
+    }
+    while (len--) {
+	crc = __crc32cb(crc, *p++);
+    }
+    return crc;
+}
+#endif
+
+uint32_t
+crc32c(const void* p, size_t len, uint32_t crc)
+{
+    auto data = static_cast<const unsigned char*>(p);
+    crc = ~crc;
+#if defined USE_CRC32C_SSE42
+    static const bool have_sse42 = __builtin_cpu_supports("sse4.2");
+    if (have_sse42) return ~crc32c_sse42(crc, data, len);
+#elif defined USE_CRC32C_ARM
+    return ~crc32c_arm(crc, data, len);
+#endif
+    return ~crc32c_table(crc, data, len);
+}
@@ -0,0 +1,41 @@
+/** @file
+ * @brief Calculate CRC32C checksums
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_CRC32C_H
+#define XAPIAN_INCLUDED_CRC32C_H
+
+#include <cstddef>
+#include <cstdint>
+
+/** Calculate the CRC32C (Castagnoli) checksum of some data.
+ *
+ *  We use the CPU's CRC instructions if they're available (on x86 with
+ *  SSE4.2, or ARMv8 with the CRC extension), and otherwise a table-driven
+ *  implementation.
+ *
+ *  @param p	The data to checksum.
+ *  @param len	The length of the data in bytes.
+ *  @param crc	CRC of any data preceding @a p (0 if there's none), which
+ *		allows calculating the CRC of data in several pieces.
+ */
+uint32_t crc32c(const void* p, size_t len, uint32_t crc = 0);
+
+#endif // XAPIAN_INCLUDED_CRC32C_H
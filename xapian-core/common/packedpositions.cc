@@ -0,0 +1,147 @@
+/** @file
+ * @brief Encode/decode position lists as blocks of bit-packed gaps.
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "packedpositions.h"
+
+#include "bitunpack.h"
+#include "omassert.h"
+#include "pack.h"
+
+#include <algorithm>
+#include <cstdint>
+
+using namespace std;
+
+/// Throw DatabaseCorruptError for bad position list data.
+[[noreturn]]
+static void
+throw_corrupt()
+{
+    throw_packed_data_corrupt("Position list");
+}
+
+void
+encode_packed_positions(string& s, const Xapian::VecCOW<Xapian::termpos>& vec)
+{
+    AssertRel(vec.size(), >=, 2);
+    size_t n = vec.size();
+    Xapian::termpos prev = vec[0];
+    s += '\0';
+    pack_uint(s, n - 2);
+    pack_uint(s, prev);
+    pack_uint(s, vec.back() - prev);
+
+    // The first and last entries are in the header, so we only need to
+    // encode the gaps to the other entries.
+    size_t i = 1;
+    while (i < n - 1) {
+	size_t block_end = min(n - 1, i + PACKED_POSITIONS_BLOCK);
+
+	Xapian::termpos all_bits = 0;
+	Xapian::termpos p = prev;
+	for (size_t j = i; j != block_end; ++j) {
+	    AssertRel(vec[j], >, p);
+	    all_bits |= vec[j] - p - 1;
+	    p = vec[j];
+	}
+	unsigned width = 0;
+	while (width < 32 && (all_bits >> width)) ++width;
+	s += char(width);
+
+	if (width) {
+	    uint64_t acc = 0;
+	    unsigned bits = 0;
+	    for (size_t j = i; j != block_end; ++j) {
+		acc |= uint64_t(vec[j] - prev - 1) << bits;
+		prev = vec[j];
+		bits += width;
+		while (bits >= 8) {
+		    s += char(acc & 0xff);
+		    acc >>= 8;
+		    bits -= 8;
+		}
+	    }
+	    if (bits) s += char(acc);
+	}
+	prev = p;
+	i = block_end;
+    }
+}
+
+Xapian::termcount
+PackedPositionReader::init(const char* data, const char* data_end,
+			   Xapian::termpos& first, Xapian::termpos& last_)
+{
+    Assert(is_packed_positions(data, data_end));
+    // Skip the zero byte which marks this encoding.
+    ++data;
+    Xapian::termcount size_minus_2;
+    Xapian::termpos range;
+    if (!unpack_uint(&data, data_end, &size_minus_2) ||
+	!unpack_uint(&data, data_end, &first) ||
+	!unpack_uint(&data, data_end, &range) ||
+	size_minus_2 >= range ||
+	first > Xapian::termpos(-1) - range) {
+	throw_corrupt();
+    }
+    p = reinterpret_cast<const unsigned char*>(data);
+    end = reinterpret_cast<const unsigned char*>(data_end);
+    remaining = size_minus_2;
+    prev = first;
+    last = last_ = first + range;
+    buf_pos = buf_len = 0;
+    return size_minus_2 + 2;
+}
+
+void
+PackedPositionReader::unpack_block()
+{
+    unsigned n = PACKED_POSITIONS_BLOCK;
+    if (remaining < n) n = unsigned(remaining);
+    if (p == end) throw_corrupt();
+    unsigned width = *p++;
+    if (!unpack_bit_block<PACKED_POSITIONS_BLOCK>(p, end, width, n, buf))
+	throw_corrupt();
+
+    // Convert the gaps to positions.
+    uint64_t pos = prev;
+    for (unsigned i = 0; i != n; ++i) {
+	pos += uint64_t(buf[i]) + 1;
+	buf[i] = Xapian::termpos(pos);
+    }
+    if (pos >= last) throw_corrupt();
+    prev = Xapian::termpos(pos);
+    remaining -= n;
+    buf_pos = 0;
+    buf_len = n;
+}
+
+Xapian::termcount
+packed_positions_count(const char* p, const char* end)
+{
+    Assert(is_packed_positions(p, end));
+    ++p;
+    Xapian::termcount size_minus_2;
+    if (!unpack_uint(&p, end, &size_minus_2)) throw_corrupt();
+    return size_minus_2 + 2;
+}
@@ -0,0 +1,142 @@
+/** @file
+ * @brief Encode/decode position lists as blocks of bit-packed gaps.
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_PACKEDPOSITIONS_H
+#define XAPIAN_INCLUDED_PACKEDPOSITIONS_H
+
+#include <xapian/types.h>
+
+#include "api/smallvector.h"
+
+#include <string>
+
+/* The encoding is:
+ *
+ *   - A zero byte.
+ *   - The number of entries minus 2, the first entry, and the difference
+ *     between the last and first entries, each packed with pack_uint().
+ *   - The gaps between the other entries (each minus one), in blocks of up
+ *     to PACKED_POSITIONS_BLOCK.  Each block is a byte giving the number of
+ *     bits per gap, followed by the gaps bit-packed least significant bit
+ *     first.
+ *
+ * Interpolative coded position data starts with the last entry, and if that
+ * is 0 the list must only have one entry so there is no more data.  So we
+ * can tell which encoding was used from the data.
+ *
+ * The blocks are unpacked with the helpers in bitunpack.h.
+ */
+
+/// The maximum number of gaps in each block.
+const unsigned PACKED_POSITIONS_BLOCK = 128;
+
+/** Is position list data in the bit-packed encoding?
+ *
+ *  @param p	Start of the data.
+ *  @param end	End of the data.
+ */
+inline bool
+is_packed_positions(const char* p, const char* end)
+{
+    return end - p > 1 && *p == '\0';
+}
+
+/** Encode a position list with the bit-packed encoding.
+ *
+ *  @param s	The string to append the encoded data to.
+ *  @param vec	The positions, which must be in ascending order.  There must
+ *		be at least two.
+ */
+void encode_packed_positions(std::string& s,
+			     const Xapian::VecCOW<Xapian::termpos>& vec);
+
+/// Decoder for bit-packed position list data.
+class PackedPositionReader {
+    /// Current position in the encoded data.
+    const unsigned char* p = nullptr;
+
+    /// End of the encoded data.
+    const unsigned char* end = nullptr;
+
+    /// Number of gaps still to unpack from the encoded data.
+    Xapian::termcount remaining = 0;
+
+    /// The most recently unpacked position.
+    Xapian::termpos prev = 0;
+
+    /// The last entry.
+    Xapian::termpos last = 0;
+
+    /// Index of the next position to return from buf.
+    unsigned buf_pos = 0;
+
+    /// Number of positions in buf.
+    unsigned buf_len = 0;
+
+    /// Positions from the most recently unpacked block.
+    Xapian::termpos buf[PACKED_POSITIONS_BLOCK];
+
+    /// Unpack the next block into buf.
+    void unpack_block();
+
+  public:
+    /** Start decoding data.
+     *
+     *  The data must remain valid while this object is in use.
+     *
+     *  @param data	Start of the data.
+     *  @param data_end	End of the data.
+     *  @param first	Set to the first entry.
+     *  @param last_	Set to the last entry.
+     *
+     *  @return The number of entries.
+     */
+    Xapian::termcount init(const char* data, const char* data_end,
+			   Xapian::termpos& first, Xapian::termpos& last_);
+
+    /** Decode the next entry.
+     *
+     *  Returns the first entry after the previous one returned (or after
+     *  the first entry on the first call).  Must not be called once the last
+     *  entry has been returned.
+     */
+    Xapian::termpos decode_next() {
+	if (buf_pos == buf_len) {
+	    if (remaining == 0) return last;
+	    unpack_block();
+	}
+	return buf[buf_pos++];
+    }
+
+    /// Check all the data has been used.
+    bool check_all_gone() const {
+	return remaining == 0 && p == end;
+    }
+};
+
+/** Return the number of entries in bit-packed position list data.
+ *
+ *  @param p	Start of the data.
+ *  @param end	End of the data.
+ */
+Xapian::termcount packed_positions_count(const char* p, const char* end);
+
+#endif // XAPIAN_INCLUDED_PACKEDPOSITIONS_H
@@ -34,6 +34,7 @@
 #include "omassert.h"
 #include "ortermlist.h"
 #include "str.h"
+#include "stringutils.h"
 #include "api/termlist.h"
 #include "termlistmerger.h"
 #include "unicode/description_append.h"
@@ -105,10 +106,23 @@ ESet::Internal::expand(Xapian::termcount max_esize,
     unique_ptr<TermList> tree(build_termlist_tree(db, rset));
     Assert(tree.get());
 
+    // If all terms which edecider can accept start with a particular prefix,
+    // we can skip straight to the first term which could have it, and stop
+    // at the first term after that which doesn't.
+    string prefix;
+    if (edecider) prefix = edecider->get_required_prefix();
+    bool skip = !prefix.empty();
+
     bool is_heap = false;
     while (true) {
 	// See if the root needs replacing.
-	TermList * new_root = tree->next();
+	TermList * new_root;
+	if (rare(skip)) {
+	    new_root = tree->skip_to(prefix);
+	    skip = false;
+	} else {
+	    new_root = tree->next();
+	}
 	if (new_root) {
 	    LOGLINE(EXPAND, "Replacing the root of the termlist tree");
 	    tree.reset(new_root);
@@ -118,6 +132,10 @@ ESet::Internal::expand(Xapian::termcount max_esize,
 
 	string term = tree->get_termname();
 
+	// Terms are in ascending order, so once one doesn't start with prefix,
+	// none of the rest will.
+	if (!startswith(term, prefix)) break;
+
 	// If there's an ExpandDecider, see if it accepts the term.
 	if (edecider && !(*edecider)(term)) continue;
 
@@ -103,6 +103,9 @@
 // Database compaction and merging
 #include <xapian/compactor.h>
 
+// Building a database in bulk
+#include <xapian/bulkloader.h>
+
 // ELF visibility annotations for GCC.
 #include <xapian/visibility.h>
 
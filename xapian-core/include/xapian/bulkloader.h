@@ -0,0 +1,175 @@
+/** @file
+ * @brief Build a new database from scratch in bulk.
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_BULKLOADER_H
+#define XAPIAN_INCLUDED_BULKLOADER_H
+
+#if !defined XAPIAN_IN_XAPIAN_H && !defined XAPIAN_LIB_BUILD
+# error Never use <xapian/bulkloader.h> directly; include <xapian.h> instead.
+#endif
+
+#include <xapian/intrusive_ptr.h>
+#include <xapian/types.h>
+#include <xapian/visibility.h>
+
+#include <string>
+
+namespace Xapian {
+
+class Compactor;
+class Document;
+
+/** Build a new database from scratch in bulk.
+ *
+ *  Adding documents to a WritableDatabase updates the B-trees in place at
+ *  each flush, which means a lot of random I/O once the database is large.
+ *  When building a whole database from scratch, BulkLoader is usually much
+ *  faster.  It inverts documents in memory and writes them out as a series
+ *  of sorted runs (each one a temporary database written in order), then
+ *  merges all the runs to produce the output database in a single
+ *  compaction pass, so the I/O is almost entirely sequential.
+ *
+ *  The temporary runs are stored in a directory named by appending
+ *  ".bulkload" to the output path, which is removed by finish().
+ *
+ *  The output database isn't visible until finish() has been called.
+ */
+class XAPIAN_VISIBILITY_DEFAULT BulkLoader {
+  public:
+    /// @private @internal Class representing the BulkLoader internals.
+    class Internal;
+    /// @private @internal Reference counted internals.
+    Xapian::Internal::intrusive_ptr_nonnull<Internal> internal;
+
+    /// Copy constructor.
+    BulkLoader(const BulkLoader& o);
+
+    /// Assignment.
+    BulkLoader& operator=(const BulkLoader& o);
+
+    /// Move constructor.
+    BulkLoader(BulkLoader&& o);
+
+    /// Move assignment operator.
+    BulkLoader& operator=(BulkLoader&& o);
+
+    /** Create a BulkLoader.
+     *
+     *  @param path	The path of the database to create.  Nothing must
+     *			already exist at this path.
+     *  @param flags	Flags for the output database - this is a bitwise OR
+     *			of the flags accepted by Database::compact() which
+     *			specify the output database (any of
+     *			Xapian::DB_BACKEND_GLASS, Xapian::DB_BACKEND_HONEY,
+     *			Xapian::DBCOMPACT_SINGLE_FILE and a compaction level
+     *			from Xapian::Compactor::compaction_level).  The
+     *			default is to create a glass database.
+     *  @param block_size   The block size in bytes to use for the output
+     *			    database (0 means use the default).  Ignored when
+     *			    creating a honey database.
+     *
+     *  @exception Xapian::DatabaseCreateError is thrown if @a path already
+     *		   exists.
+     */
+    explicit BulkLoader(const std::string& path,
+			int flags = 0,
+			int block_size = 0);
+
+    /** Destructor.
+     *
+     *  If finish() hasn't been successfully called then all the documents
+     *  added are discarded and the temporary runs are removed.
+     */
+    ~BulkLoader();
+
+    /** Set the memory to use for inverting documents.
+     *
+     *  Once the estimated memory used by buffered changes reaches this many
+     *  bytes, the current run is written out.  Larger runs mean fewer runs
+     *  to merge, so it's best to set this as high as you can afford.
+     *
+     *  The default is 256MB, or the value of the environment variable
+     *  XAPIAN_FLUSH_MEMORY if that is set.
+     */
+    void set_memory_limit(size_t bytes);
+
+    /** Add a document.
+     *
+     *  Documents are numbered sequentially from 1 in the order they are
+     *  added.
+     *
+     *  A document which can't be added (for example because it has a term
+     *  which is too long) is rejected with Xapian::InvalidArgumentError
+     *  before anything is changed, and the BulkLoader can still be used.
+     *
+     *  If any other exception is thrown then documents added since the last
+     *  run was written out may have been discarded, so any further calls to
+     *  methods which add data or to finish() will throw
+     *  Xapian::InvalidOperationError.  The same applies if add_spelling()
+     *  or add_synonym() throw an exception.
+     *
+     *  @return The document ID allocated to the document.
+     *
+     *  @exception Xapian::InvalidArgumentError	if @a doc can't be added.
+     */
+    Xapian::docid add_document(const Xapian::Document& doc);
+
+    /** Add a word to the spelling dictionary.
+     *
+     *  See WritableDatabase::add_spelling() for details.
+     */
+    void add_spelling(const std::string& word,
+		      Xapian::termcount freqinc = 1);
+
+    /** Add a synonym for a term.
+     *
+     *  See WritableDatabase::add_synonym() for details.
+     */
+    void add_synonym(const std::string& term, const std::string& synonym);
+
+    /** Set the user-specified metadata associated with a given key.
+     *
+     *  See WritableDatabase::set_metadata() for details.
+     */
+    void set_metadata(const std::string& key, const std::string& value);
+
+    /// Return the number of documents added so far.
+    Xapian::doccount get_doccount() const;
+
+    /** Merge the runs to produce the output database.
+     *
+     *  Once this method has returned, the BulkLoader can't be used further.
+     */
+    void finish();
+
+    /** Merge the runs to produce the output database.
+     *
+     *  Once this method has returned, the BulkLoader can't be used further.
+     *
+     *  @param compactor  Compactor object which is used to report progress
+     *			  of the merge.
+     */
+    void finish(Xapian::Compactor& compactor);
+};
+
+}
+
+#endif // XAPIAN_INCLUDED_BULKLOADER_H
@@ -30,10 +30,12 @@
 #include <xapian/constants.h>
 #include <xapian/visibility.h>
 #include <string>
+#include <vector>
 
 namespace Xapian {
 
 class Database;
+class KeyMaker;
 
 /** Compact a database, or merge and compact several.
  */
@@ -95,6 +97,92 @@ class XAPIAN_VISIBILITY_DEFAULT Compactor {
 			       size_t num_tags, const std::string tags[]);
 };
 
+/** Merge similarly sized shards of a stub database.
+ *
+ *  This supports keeping a bounded number of shards in a stub database which
+ *  new shards are regularly appended to, without having to repeatedly
+ *  compact the whole database.  Each shard is assigned to a tier by its
+ *  document count - shards with fewer than @a merge_factor documents are in
+ *  tier 0, those with fewer than @a merge_factor squared documents are in
+ *  tier 1, and so on.  If any tier has at least @a merge_factor shards, the
+ *  shards in the lowest such tier are compacted into a new shard which
+ *  replaces them in the stub.  The stub file is updated atomically, so
+ *  readers always see either the old shards or the new one.
+ *
+ *  Only shards listed in the stub with type "auto", "glass" or "honey" are
+ *  considered (and not those which are themselves stub databases).  Lines
+ *  added to the stub while the merge runs are preserved (the stub is checked
+ *  for changes just before it is replaced, though there's no locking so a
+ *  line appended in the brief window after that check would be lost), but
+ *  the stub should not be updated by another process in any other way.
+ *
+ *  The merged shards aren't removed, since readers may still have them open
+ *  - it's up to the caller to remove them once that's no longer the case.
+ *
+ *  Note that the document ids in the stub database change when shards are
+ *  merged, so you'll probably want to use unique terms to identify
+ *  documents.
+ *
+ *  Calling this repeatedly until it returns an empty vector brings the stub
+ *  into a state where no tier needs merging.
+ *
+ *  @param stub		Path to the stub database file, or to a directory
+ *			containing a stub database file called XAPIANDB.
+ *  @param merge_factor	The number of shards in a tier which triggers a
+ *			merge (default 4, must be at least 2).
+ *  @param flags	Flags to pass to Database::compact().
+ *  @param block_size	Block size to pass to Database::compact().
+ *  @param compactor	Compactor to use for progress output and resolving
+ *			duplicate user metadata (or NULL for the default
+ *			behaviour).
+ *
+ *  @return The paths of the shards which were merged (with any relative
+ *	    paths resolved), or an empty vector if no tier needed merging.
+ */
+XAPIAN_VISIBILITY_DEFAULT
+std::vector<std::string>
+merge_shards(const std::string& stub,
+	     unsigned merge_factor = 4,
+	     unsigned flags = 0,
+	     int block_size = 0,
+	     Xapian::Compactor* compactor = NULL);
+
+/** Compact a database, renumbering the documents so they're ordered by key.
+ *
+ *  Documents which are close in the order end up with close document ids,
+ *  so if documents with similar content get similar keys (for example, if
+ *  the key is the URL with the hostname reversed) then the docid deltas in
+ *  posting lists are smaller and so compress better, and documents which
+ *  tend to match the same queries are stored together.
+ *
+ *  Documents with equal keys stay in their existing order.
+ *
+ *  This works by copying the documents in the new order to a temporary
+ *  glass database (along with the user metadata, spelling and synonym data)
+ *  which is then compacted to @a output, so it needs enough free disk space
+ *  for an uncompacted copy of the database.  The temporary database is
+ *  created at @a output with ".reorder" appended, and is removed afterwards.
+ *
+ *  @param db		The database to compact (which may have several
+ *			shards).
+ *  @param output	Path to write the compacted database to.
+ *  @param sorter	Functor to generate the key to order each document by.
+ *  @param flags	Flags to pass to Database::compact().
+ *			Xapian::DBCOMPACT_NO_RENUMBER can't be used here.
+ *  @param block_size	Block size to pass to Database::compact().
+ *  @param compactor	Compactor to use for progress output and resolving
+ *			duplicate user metadata (or NULL for the default
+ *			behaviour).
+ */
+XAPIAN_VISIBILITY_DEFAULT
+void
+compact_reordered(const Xapian::Database& db,
+		  const std::string& output,
+		  const Xapian::KeyMaker& sorter,
+		  unsigned flags = 0,
+		  int block_size = 0,
+		  Xapian::Compactor* compactor = NULL);
+
 }
 
 #endif /* XAPIAN_INCLUDED_COMPACTOR_H */
@@ -201,10 +201,184 @@ const int DB_BACKEND_INMEMORY	 = 0x400;
  */
 const int DB_BACKEND_HONEY	 = 0x500;
 
+/** Compress glass tables with zstd.
+ *
+ *  When creating a new glass database (either by opening a WritableDatabase
+ *  or as the output of Database::compact()), use zstd instead of zlib to
+ *  compress tags in the tables which are compressed (the docdata, termlist,
+ *  spelling and synonym tables).  zstd usually gives smaller tables than
+ *  zlib and decompresses considerably faster.
+ *
+ *  The codec used by each table is recorded in the database, so this flag
+ *  has no effect when opening an existing database.  A database created
+ *  with this flag can't be read by a version of Xapian without zstd support.
+ *
+ *  If Xapian was built without zstd support, Xapian::FeatureUnavailableError
+ *  is thrown.
+ */
+const int DB_COMPRESS_ZSTD	 = 0x1000;
+
+/** Compress glass tables with LZ4.
+ *
+ *  Like DB_COMPRESS_ZSTD, but use LZ4, which compresses less well than zlib
+ *  but decompresses much faster - useful if latency matters more than the
+ *  size of the database.
+ *
+ *  If Xapian was built without LZ4 support, Xapian::FeatureUnavailableError
+ *  is thrown.
+ */
+const int DB_COMPRESS_LZ4	 = 0x2000;
+
+/** Keep a copy of the document lengths in memory.
+ *
+ *  When opening a read-only glass Database, read all the document lengths
+ *  into a compact in-memory array, so looking up a document's length (which
+ *  the matcher does for every candidate document with most weighting
+ *  schemes) doesn't need to search the B-tree.  The array is reloaded when
+ *  the Database is reopened at a newer revision.
+ *
+ *  The array uses (lastdocid + 1) * ceil(log2(max_doclength + 2)) bits of
+ *  memory, and is shared between Database objects open on the same revision
+ *  of the same database in a process.
+ *
+ *  This flag is ignored for other backends, and for WritableDatabase.
+ */
+const int DB_CACHE_DOCLENS	 = 0x4000;
+
+/** Store a checksum in each block of glass tables.
+ *
+ *  When creating a new glass database (either by opening a WritableDatabase
+ *  or as the output of Database::compact()), reserve the last 4 bytes of
+ *  each block for a CRC32C checksum of the rest of the block.  The checksum
+ *  is checked each time a block is read from disk, and a mismatch results in
+ *  Xapian::DatabaseCorruptError being thrown, so corruption caused by
+ *  hardware or filesystem problems is detected rather than possibly
+ *  returning wrong results.
+ *
+ *  The CPU's CRC32C instructions are used where available, so the overhead
+ *  is usually small.
+ *
+ *  Whether checksums are used is recorded in the database, so this flag has
+ *  no effect when opening an existing database.  A database created with
+ *  this flag can't be read by older versions of Xapian.
+ */
+const int DB_BLOCK_CHECKSUMS	 = 0x8000;
+
+/** Store positional information using bit-packed blocks.
+ *
+ *  When creating a new glass database (either by opening a WritableDatabase
+ *  or as the output of Database::compact()), store position lists with more
+ *  than two entries as blocks of fixed-width bit-packed gaps rather than
+ *  using interpolative coding.  This takes somewhat more space, but is much
+ *  faster to decode, which helps phrase-heavy search workloads.
+ *
+ *  Whether this encoding is used is recorded in the database, so this flag
+ *  has no effect when opening an existing database.  Position lists are
+ *  only encoded this way when they are written, so compacting a database
+ *  created without this flag and specifying it will only affect position
+ *  lists added later.  A database created with this flag can't be read by
+ *  older versions of Xapian.
+ */
+const int DB_PACKED_POSITIONS	 = 0x10000;
+
+/** Size posting list chunks according to the term frequency.
+ *
+ *  When creating a new glass database (either by opening a WritableDatabase
+ *  or as the output of Database::compact()), write larger posting list
+ *  chunks for terms which index many documents, and store skip data in
+ *  these larger chunks so that skipping forward within them doesn't need to
+ *  decode every entry.  This means fewer chunks for frequent terms, so less
+ *  overhead when iterating their posting lists or looking up document
+ *  lengths.
+ *
+ *  Whether this is done is recorded in the database, so this flag has no
+ *  effect when opening an existing database.  When compacting to a glass
+ *  database with this flag, the posting lists are rechunked.  A database
+ *  created with this flag can't be read by older versions of Xapian.
+ */
+const int DB_ADAPTIVE_CHUNKS	 = 0x20000;
+
+/** Store honey posting lists as blocks of bit-packed values.
+ *
+ *  When compacting to a honey database, store the docid deltas and wdfs in
+ *  posting lists as blocks of fixed-width bit-packed values (with any
+ *  outlying values stored separately) rather than as a variable-length
+ *  integer for each.  This takes a little more space, but is much faster to
+ *  decode, which helps queries with frequent terms.
+ *
+ *  Whether this encoding is used is recorded in the database, so this flag
+ *  has no effect when opening an existing database.  It is currently ignored
+ *  when creating a glass database.
+ */
+const int DB_PACKED_POSTINGS	 = 0x40000;
+
+/** Index honey tables with a cache-friendly search tree.
+ *
+ *  When compacting to a honey database, index the keys in each table by a
+ *  fixed width prefix stored in a search tree with the "Eytzinger" layout
+ *  rather than by just the first byte of the key.  This makes the index a
+ *  little larger, but means that looking up a term (or any other key) only
+ *  has to scan a few keys, instead of all those with the same first byte.
+ *
+ *  The index type is recorded in each table, so this flag has no effect
+ *  when opening an existing database.  It is currently ignored when
+ *  creating a glass database.
+ */
+const int DB_EYTZINGER_INDEX	 = 0x80000;
+
+/** Store Bloom filters over the keys of honey tables.
+ *
+ *  When compacting to a honey database, store a Bloom filter over the keys in
+ *  the postlist, position, spelling and synonym tables, and load it when the
+ *  database is opened.  Most lookups of keys which aren't present (for
+ *  example, checking if a term is in a shard which doesn't contain it) can
+ *  then return without reading the table, at a cost of two bytes per key.
+ *
+ *  Whether a table has a filter is recorded in the database, so this flag
+ *  has no effect when opening an existing database.  It is currently ignored
+ *  when creating a glass database.
+ */
+const int DB_BLOOM_FILTERS	 = 0x100000;
+
+/** Store honey positional data aligned with the posting lists.
+ *
+ *  When compacting to a honey database, store the positional data for each
+ *  chunk of a posting list as a single entry, with an array of offsets giving
+ *  the position list for each posting in the chunk.  Iterating a posting list
+ *  with positions (as phrase and NEAR queries do) then only needs to look up
+ *  positional data once per chunk rather than once per document, but looking
+ *  up the positions for a particular document and term has to find the
+ *  posting in the posting list first.
+ *
+ *  Whether this layout is used is recorded in the database, so this flag has
+ *  no effect when opening an existing database.  It is currently ignored when
+ *  creating a glass database.
+ */
+const int DB_ALIGNED_POSITIONS	 = 0x200000;
+
+/** Load a honey database into memory when opening it.
+ *
+ *  When opening a read-only honey Database, copy each of its tables into
+ *  memory (asking the OS to use huge pages where supported), and serve all
+ *  reads from this copy.  Searches then don't make any system calls to read
+ *  the database, and their latency doesn't depend on whether the OS has kept
+ *  the database files in its cache.  The data is copied as stored, so
+ *  compressed entries are decompressed when read as usual.
+ *
+ *  This uses as much memory as the size of the database files - the amount
+ *  used can be found with Database::get_memory_footprint().
+ *
+ *  This flag is ignored for other backends, and for WritableDatabase.
+ */
+const int DB_LOAD_INTO_MEMORY	 = 0x400000;
+
 #ifdef XAPIAN_LIB_BUILD
 /** @internal Bit mask for backend codes. */
 const int DB_BACKEND_MASK_	 = 0x700;
 
+/** @internal Bit mask for compression codec flags. */
+const int DB_COMPRESS_MASK_	 = 0x3000;
+
 /** @internal Used internally to signify opening read-only. */
 const int DB_READONLY_		 = -1;
 #endif
@@ -249,6 +423,15 @@ const int DBCHECK_SHOW_STATS = 8;
  */
 const int DBCHECK_FIX = 16;
 
+/** Report progress while checking.
+ *
+ *  For use with Xapian::Database::check().
+ *
+ *  Periodically report what percentage of the entries in each table have
+ *  been checked, which is useful when checking a large database.
+ */
+const int DBCHECK_SHOW_PROGRESS = 32;
+
 
 /** Use the same document ids in the output as in the input(s).
  *
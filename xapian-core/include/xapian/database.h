@@ -628,6 +628,22 @@ class XAPIAN_VISIBILITY_DEFAULT Database {
      */
     Xapian::rev get_revision() const;
 
+    /** Get the amount of memory used to hold data loaded from the database.
+     *
+     *  This is the approximate number of bytes allocated to hold data which
+     *  was loaded from the database when it was opened - for example, the
+     *  tables of a honey database opened with Xapian::DB_LOAD_INTO_MEMORY,
+     *  Bloom filters read from a honey database, or the document lengths
+     *  cached for a glass database opened with Xapian::DB_CACHE_DOCLENS.  It
+     *  doesn't include memory the OS uses to cache the database files, or
+     *  buffers and other small overheads.
+     *
+     *  For a Database with multiple shards, the sum over all the shards is
+     *  returned.  Remote shards contribute 0.  Data which is shared between
+     *  Database objects open on the same database is counted by each.
+     */
+    size_t get_memory_footprint() const;
+
     /** Check the integrity of a database or database table.
      *
      *  @param path	Path to database or table
@@ -930,6 +946,14 @@ class XAPIAN_VISIBILITY_DEFAULT WritableDatabase : public Database {
      */
     void end_transaction_(bool do_commit);
 
+    /** @internal @private Helper method which implements add_documents().
+     *
+     *  @param docs	The documents to add.
+     *  @param threads	The maximum number of threads to use.
+     */
+    Xapian::docid add_documents_(const std::vector<Xapian::Document>& docs,
+				 unsigned threads);
+
   public:
     /** Create a WritableDatabase with no subdatabases.
      *
@@ -1072,11 +1096,34 @@ class XAPIAN_VISIBILITY_DEFAULT WritableDatabase : public Database {
      *  you can improve indexing throughput dramatically by setting
      *  XAPIAN_FLUSH_THRESHOLD in the environment to a larger value.
      *
+     *  If your documents vary a lot in size, a document count isn't a good
+     *  way to bound memory use, so you can instead (or as well) set
+     *  XAPIAN_FLUSH_MEMORY in the environment to a size in bytes, and
+     *  modifications will be automatically committed once the estimate
+     *  reported by get_buffered_memory() reaches this size.  If
+     *  XAPIAN_FLUSH_MEMORY is set but XAPIAN_FLUSH_THRESHOLD isn't, then
+     *  the default document count threshold isn't applied.
+     *
      *  @since This method was new in Xapian 1.1.0 - in earlier versions it
      *	       was called flush().
      */
     void commit();
 
+    /** Get an estimate of the memory used by buffered modifications.
+     *
+     *  This is the approximate number of bytes currently used to hold
+     *  pending postlist, positional and document length changes which will
+     *  be written out at the next flush.  It's intended for monitoring
+     *  indexer memory use, and is what XAPIAN_FLUSH_MEMORY is compared with
+     *  (see commit() for details).
+     *
+     *  For a WritableDatabase with multiple shards, the sum over all the
+     *  shards is returned.  Backends which don't buffer changes in this way
+     *  (or for which this isn't available, such as remote databases)
+     *  contribute 0.
+     */
+    size_t get_buffered_memory() const;
+
     /** Begin a transaction.
      *
      *  A Xapian transaction is a set of consecutive modifications to be
@@ -1175,6 +1222,47 @@ class XAPIAN_VISIBILITY_DEFAULT WritableDatabase : public Database {
      */
     Xapian::docid add_document(const Xapian::Document& doc);
 
+    /** Add several documents to the database.
+     *
+     *  The effect is the same as calling add_document() for each document
+     *  in turn, so the documents are allocated consecutive document IDs in
+     *  the order they're given.
+     *
+     *  For a glass database, the work of inverting the documents (building
+     *  their termlists and encoding their positional data) is split between
+     *  several threads, and the results merged in docid order.  This is
+     *  likely to be faster than add_document() for CPU-bound indexing if
+     *  the batches are reasonably large (a few hundred documents per
+     *  thread or more).  Other backends just add the documents one by one,
+     *  as does glass if Xapian was built without thread support.
+     *
+     *  The documents mustn't be modified (or used in another call to a
+     *  Xapian method) in another thread while this method is running.
+     *
+     *  With glass, if any document fails to be added (e.g. because it
+     *  contains a term which is too long) then all uncommitted changes are
+     *  discarded (including any documents from this batch which were
+     *  already added), as they are if add_document() fails.  This is the
+     *  case whether or not threads are used.  With other backends, the
+     *  documents before it may have been added.
+     *
+     *  @param begin	Begin iterator.  Dereferencing this should return a
+     *			Xapian::Document (or a type which converts to one).
+     *  @param end	End iterator.
+     *  @param threads	The maximum number of threads to use, including the
+     *			calling thread.  The default value of 0 means to use
+     *			one thread per CPU core.
+     *
+     *  @return The document ID allocated to the first document (the others
+     *		are allocated the following document IDs in order), or 0
+     *		if begin == end.
+     */
+    template<typename I>
+    Xapian::docid add_documents(I begin, I end, unsigned threads = 0) {
+	return add_documents_(std::vector<Xapian::Document>(begin, end),
+			      threads);
+    }
+
     /** Delete a document from the database.
      *
      *  This method removes the document with the specified document ID
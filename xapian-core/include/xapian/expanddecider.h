@@ -52,6 +52,19 @@ class XAPIAN_VISIBILITY_DEFAULT ExpandDecider
      */
     virtual bool operator()(const std::string &term) const = 0;
 
+    /** Return a prefix which all terms accepted by this object start with.
+     *
+     *  Terms which don't start with this prefix won't be passed to
+     *  operator(), which allows them to be skipped over when generating an
+     *  ESet rather than each being considered in turn.
+     *
+     *  The default implementation returns an empty string, which means that
+     *  there's no such restriction.
+     *
+     *  @since This method was added in Xapian 1.5.0.
+     */
+    virtual std::string get_required_prefix() const;
+
     /** Virtual destructor, because we have virtual methods. */
     virtual ~ExpandDecider();
 
@@ -109,6 +122,13 @@ class XAPIAN_VISIBILITY_DEFAULT ExpandDeciderAnd : public ExpandDecider {
 	: first(first_), second(second_) { }
 
     virtual bool operator()(const std::string &term) const;
+
+    /** Return a prefix required by @a first and @a second.
+     *
+     *  Accepted terms must start with the required prefixes of both, so we
+     *  return the longer of them.
+     */
+    virtual std::string get_required_prefix() const;
 };
 
 /** ExpandDecider subclass which rejects terms in a specified list.
@@ -151,6 +171,9 @@ class XAPIAN_VISIBILITY_DEFAULT ExpandDeciderFilterPrefix : public ExpandDecider
 	: prefix(prefix_) { }
 
     virtual bool operator() (const std::string &term) const;
+
+    /// Return the prefix specified to the constructor.
+    virtual std::string get_required_prefix() const;
 };
 
 }
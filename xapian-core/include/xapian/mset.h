@@ -45,7 +45,11 @@ class MSetIterator;
 class XAPIAN_VISIBILITY_DEFAULT MSet {
     friend class MSetIterator;
 
-    // Helper function for fetch() methods.
+    /** Helper function for fetch() methods.
+     *
+     *  @a first and @a last are offsets from the end (as MSetIterator
+     *  stores), of the first item and of the item after the last one.
+     */
     void fetch_(Xapian::doccount first, Xapian::doccount last) const;
 
     /** Update the weight corresponding to the document indexed at
@@ -326,41 +330,35 @@ class XAPIAN_VISIBILITY_DEFAULT MSet {
 			const std::string & hi_end = "</b>",
 			const std::string & omit = "...") const;
 
-    /** Prefetch hint a range of items.
+    /** Fetch the documents for a range of items.
+     *
+     *  The document data for all the items in the range is read in one
+     *  batch, in the order the documents are stored in, and kept in the MSet
+     *  so that MSet::get_document() and MSetIterator::get_document() don't
+     *  need to read it again.
      *
-     *  For a remote database, this may start a pipelined fetch of the
-     *  requested documents from the remote server.
+     *  For a disk-based database, prefetch hints for the disk blocks the
+     *  requested documents are stored in are sent to the operating system
+     *  before any of them are read, so the reads can proceed in parallel.
      *
-     *  For a disk-based database, this may send prefetch hints to the
-     *  operating system such that the disk blocks the requested documents
-     *  are stored in are more likely to be in the cache when we come to
-     *  actually read them.
+     *  The range is half-open, so @a end isn't included.
+     *
+     *  Each call to get_document() still returns a separate Document object,
+     *  so changes made to one of those won't be seen via the others.
      */
     void fetch(const MSetIterator &begin, const MSetIterator &end) const;
 
-    /** Prefetch hint a single MSet item.
-     *
-     *  For a remote database, this may start a pipelined fetch of the
-     *  requested documents from the remote server.
+    /** Fetch the document for a single MSet item.
      *
-     *  For a disk-based database, this may send prefetch hints to the
-     *  operating system such that the disk blocks the requested documents
-     *  are stored in are more likely to be in the cache when we come to
-     *  actually read them.
+     *  See fetch(const MSetIterator&, const MSetIterator&) for details.
      */
     void fetch(const MSetIterator &item) const;
 
-    /** Prefetch hint the whole MSet.
-     *
-     *  For a remote database, this may start a pipelined fetch of the
-     *  requested documents from the remote server.
+    /** Fetch the documents for the whole MSet.
      *
-     *  For a disk-based database, this may send prefetch hints to the
-     *  operating system such that the disk blocks the requested documents
-     *  are stored in are more likely to be in the cache when we come to
-     *  actually read them.
+     *  See fetch(const MSetIterator&, const MSetIterator&) for details.
      */
-    void fetch() const { fetch_(0, Xapian::doccount(-1)); }
+    void fetch() const { fetch_(size(), 0); }
 
     /** Return number of items in this MSet object. */
     Xapian::doccount size() const;
@@ -668,7 +666,7 @@ MSet::fetch(const MSetIterator &begin_it, const MSetIterator &end_it) const
 inline void
 MSet::fetch(const MSetIterator &item) const
 {
-    fetch_(item.off_from_end, item.off_from_end);
+    fetch_(item.off_from_end, item.off_from_end - 1);
 }
 
 inline MSetIterator
@@ -42,6 +42,7 @@
 #include "omassert.h"
 #include "pack.h"
 #include "realtime.h"
+#include "safesysstat.h"
 #include "serialise.h"
 #include "serialise-double.h"
 #include "serialise-error.h"
@@ -98,6 +99,104 @@ RemoteServer::RemoteServer(const vector<string>& dbpaths,
 	throw;
     }
 
+    start();
+}
+
+/** Return a string identifying the versions of any stub database files in
+ *  @a dbpaths.
+ *
+ *  We use the inode number, size and modification time, so replacing a stub
+ *  file by renaming a new version over it or updating it in place both change
+ *  the result.  A path which is a regular file might be a single file
+ *  database rather than a stub, in which case the result changes each time it
+ *  is updated, which just means we open it afresh rather than reopening it.
+ */
+static string
+get_stub_state(const vector<string>& dbpaths)
+{
+    string result;
+    for (size_t i = 0; i != dbpaths.size(); ++i) {
+	struct stat statbuf;
+	if (stat(dbpaths[i].c_str(), &statbuf) < 0) continue;
+	if (S_ISDIR(statbuf.st_mode)) {
+	    string stub_file = dbpaths[i];
+	    stub_file += "/XAPIANDB";
+	    if (stat(stub_file.c_str(), &statbuf) < 0) continue;
+	} else if (!S_ISREG(statbuf.st_mode)) {
+	    continue;
+	}
+	pack_uint(result, i);
+	pack_uint(result, static_cast<unsigned long long>(statbuf.st_ino));
+	pack_uint(result, static_cast<unsigned long long>(statbuf.st_size));
+	pack_uint(result, static_cast<unsigned long long>(statbuf.st_mtime));
+    }
+    return result;
+}
+
+RemoteServer::RemoteServer(const vector<string>& dbpaths,
+			   SharedDatabase& shared,
+			   int fdin_, int fdout_,
+			   double active_timeout_, double idle_timeout_)
+    : RemoteConnection(fdin_, fdout_, string()),
+      db(NULL), wdb(NULL), writable(false),
+      active_timeout(active_timeout_), idle_timeout(idle_timeout_)
+{
+    // Catch errors opening the database and propagate them to the client.
+    try {
+	Assert(!dbpaths.empty());
+	// Check the stubs before opening, so a change while we're opening
+	// gets noticed by the next connection.
+	string stub_state = get_stub_state(dbpaths);
+	if (shared.db.size() != 0) {
+	    if (stub_state != shared.stub_state) {
+		shared.db = Xapian::Database();
+	    } else {
+		// The database may have been updated since the last
+		// connection.
+		try {
+		    shared.db.reopen();
+		} catch (const Xapian::Error&) {
+		    // The old handles may no longer be usable, so open the
+		    // databases afresh, which reports the error if the
+		    // problem persists.
+		    shared.db = Xapian::Database();
+		}
+	    }
+	}
+	if (shared.db.size() == 0) {
+	    Xapian::Database new_db(dbpaths[0]);
+	    for (size_t i = 1; i != dbpaths.size(); ++i) {
+		new_db.add_database(Xapian::Database(dbpaths[i]));
+	    }
+	    shared.db = new_db;
+	    shared.stub_state = std::move(stub_state);
+	}
+	db = new Xapian::Database(shared.db);
+    } catch (const Xapian::Error &err) {
+	// Propagate the exception to the client.
+	send_message(REPLY_EXCEPTION, serialise_error(err));
+	// And rethrow it so our caller can log it and close the connection.
+	throw;
+    }
+
+    context = dbpaths[0];
+    for (size_t i = 1; i != dbpaths.size(); ++i) {
+	context += ' ';
+	context += dbpaths[i];
+    }
+
+    start();
+}
+
+RemoteServer::~RemoteServer()
+{
+    delete db;
+    // wdb is either NULL or equal to db, so we shouldn't delete it too!
+}
+
+void
+RemoteServer::start()
+{
 #ifndef __WIN32__
     // It's simplest to just ignore SIGPIPE.  We'll still know if the
     // connection dies because we'll get EPIPE back from write().
@@ -109,12 +208,6 @@ RemoteServer::RemoteServer(const vector<string>& dbpaths,
     msg_update(string());
 }
 
-RemoteServer::~RemoteServer()
-{
-    delete db;
-    // wdb is either NULL or equal to db, so we shouldn't delete it too!
-}
-
 message_type
 RemoteServer::get_message(double timeout, string & result,
 			  message_type required_type)
@@ -31,6 +31,7 @@
 #include "remoteconnection.h"
 
 #include <string>
+#include <vector>
 
 /** Remote backend server base class. */
 class XAPIAN_VISIBILITY_DEFAULT RemoteServer : private RemoteConnection {
@@ -69,6 +70,10 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteServer : private RemoteConnection {
     /// The registry, which allows unserialisation of user subclasses.
     Xapian::Registry reg;
 
+    /// Prepare the connection and send the greeting message.
+    XAPIAN_VISIBILITY_INTERNAL
+    void start();
+
     /// Accept a message from the client.
     XAPIAN_VISIBILITY_INTERNAL
     message_type get_message(double timeout, std::string & result,
@@ -253,6 +258,44 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteServer : private RemoteConnection {
 		 double idle_timeout_,
 		 bool writable = false);
 
+    /// Databases kept open between the connections a thread serves.
+    struct SharedDatabase {
+	/// The databases, or a Database with no shards if not open.
+	Xapian::Database db;
+
+	/** Identifies the versions of any stub database files in the paths.
+	 *
+	 *  Reopening a database doesn't reread a stub database file, so we
+	 *  open the databases afresh if this changes.
+	 */
+	std::string stub_state;
+    };
+
+    /** Construct a read-only RemoteServer using a database kept open between
+     *  connections.
+     *
+     *  @param dbpaths	The paths to the Xapian databases to use.
+     *  @param shared	The databases in @a dbpaths.  If these aren't open
+     *			yet, a stub database among @a dbpaths has changed, or
+     *			reopening them fails, the databases are opened and
+     *			stored in @a shared for use by later connections,
+     *			otherwise they're reopened to make sure we serve the
+     *			latest revision.  This object must not be used by any
+     *			other thread while the RemoteServer exists.
+     *  @param fdin	The file descriptor to read from.
+     *  @param fdout	The file descriptor to write to (fdin and fdout may be
+     *			the same).
+     *  @param active_timeout_	Timeout for actions during a conversation
+     *			(specified in seconds).
+     *  @param idle_timeout_	Timeout while waiting for a new action from
+     *			the client (specified in seconds).
+     */
+    RemoteServer(const std::vector<std::string>& dbpaths,
+		 SharedDatabase& shared,
+		 int fdin, int fdout,
+		 double active_timeout_,
+		 double idle_timeout_);
+
     /// Destructor.
     ~RemoteServer();
 
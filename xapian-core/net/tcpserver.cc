@@ -54,6 +54,14 @@
 #include <cstring>
 #include <cstdlib>
 #include <sys/types.h>
+#ifdef HAVE_STD_THREAD
+# include <condition_variable>
+# include <deque>
+# include <mutex>
+# include <system_error>
+# include <thread>
+# include <vector>
+#endif
 
 using namespace std;
 
@@ -467,6 +475,133 @@ TcpServer::run_once()
     CLOSESOCKET(fd);
 }
 
+void
+TcpServer::handle_pooled_connection(int socket, unsigned)
+{
+    handle_one_connection(socket);
+}
+
+#ifdef HAVE_STD_THREAD
+namespace {
+
+/// State shared between the thread accepting connections and the workers.
+struct ConnectionPool {
+    /// Protects the other members.
+    mutex m;
+
+    /// Signalled when a worker becomes idle.
+    condition_variable idle_cv;
+
+    /// Signalled when a connection is queued or we're stopping.
+    condition_variable queue_cv;
+
+    /// Connections which have been accepted but not yet picked up.
+    deque<int> queue;
+
+    /// The number of workers waiting for a connection.
+    unsigned idle = 0;
+
+    /// Set to tell the workers to exit.
+    bool stopping = false;
+};
+
+}
+
+/// Serve connections from @a pool until it's stopped.
+static void
+run_worker(TcpServer* server, ConnectionPool* pool, unsigned worker,
+	   bool verbose)
+{
+    while (true) {
+	int socket;
+	{
+	    unique_lock<mutex> lock(pool->m);
+	    ++pool->idle;
+	    pool->idle_cv.notify_one();
+	    pool->queue_cv.wait(lock, [pool] {
+		return pool->stopping || !pool->queue.empty();
+	    });
+	    --pool->idle;
+	    if (pool->queue.empty()) return;
+	    socket = pool->queue.front();
+	    pool->queue.pop_front();
+	}
+
+	try {
+	    server->handle_pooled_connection(socket, worker);
+	} catch (...) {
+	    // We don't want to lose a worker, and there's nobody to report
+	    // the problem to, so carry on with the next connection.
+	}
+	CLOSESOCKET(socket);
+
+	if (verbose) cout << "Connection closed." << endl;
+    }
+}
+#endif
+
+void
+TcpServer::run_threaded(unsigned n_threads)
+{
+#ifndef HAVE_STD_THREAD
+    (void)n_threads;
+    throw Xapian::FeatureUnavailableError("Threads aren't supported on this "
+					  "platform");
+#else
+    if (n_threads == 0)
+	throw Xapian::InvalidArgumentError("n_threads must be at least 1");
+
+    ConnectionPool pool;
+    vector<thread> workers;
+    workers.reserve(n_threads);
+    try {
+	for (unsigned worker = 0; worker != n_threads; ++worker) {
+	    workers.emplace_back(run_worker, this, &pool, worker, verbose);
+	}
+    } catch (const system_error& e) {
+	if (workers.empty()) {
+	    throw Xapian::NetworkError("Couldn't start worker thread",
+				       e.code().value());
+	}
+	// Carry on with the workers we managed to start.
+    }
+
+    while (true) {
+	{
+	    // Wait until a worker is free to serve the next connection.
+	    unique_lock<mutex> lock(pool.m);
+	    pool.idle_cv.wait(lock, [&pool] {
+		return pool.idle > pool.queue.size();
+	    });
+	}
+	int connected_socket;
+	try {
+	    connected_socket = accept_connection();
+	} catch (const Xapian::Error &e) {
+	    // FIXME: better error handling.
+	    cerr << "Caught " << e.get_description() << endl;
+	    continue;
+	}
+	if (connected_socket == -1) {
+	    // Shutdown has happened.
+	    break;
+	}
+	lock_guard<mutex> lock(pool.m);
+	pool.queue.push_back(connected_socket);
+	pool.queue_cv.notify_one();
+    }
+
+    {
+	lock_guard<mutex> lock(pool.m);
+	pool.stopping = true;
+	pool.queue_cv.notify_all();
+    }
+    for (auto&& worker : workers) {
+	worker.join();
+    }
+#endif
+}
+
 #ifdef DISABLE_GPL_LIBXAPIAN
 # error GPL source we cannot relicense included in libxapian
 #endif
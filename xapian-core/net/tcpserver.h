@@ -105,8 +105,38 @@ class XAPIAN_VISIBILITY_DEFAULT TcpServer SOCKET_INITIALIZER_MIXIN {
     /** Accept a single connection, service requests on it, then stop.  */
     void run_once();
 
+    /** Accept connections and service them using a pool of threads.
+     *
+     *  Like run(), this runs as a daemon, but connections are served by a
+     *  fixed number of worker threads in this process rather than by forking
+     *  for each.  A connection is only accepted once a worker is free to serve
+     *  it, so at most @a n_threads connections are served at once and others
+     *  wait in the socket's listen queue.
+     *
+     *  Connections are served by calling handle_pooled_connection().
+     *
+     *  @param n_threads	The number of worker threads to use (must be at
+     *				least 1).
+     */
+    void run_threaded(unsigned n_threads);
+
     /// Handle a single connection on an already connected socket.
     virtual void handle_one_connection(int socket) = 0;
+
+    /** Handle a single connection in a worker thread.
+     *
+     *  This is called by run_threaded().  Each worker only serves one
+     *  connection at a time, so @a worker can be used to find state which
+     *  is kept between the connections a worker serves.
+     *
+     *  The default implementation just calls handle_one_connection().
+     *
+     *  @param socket	The connected socket.
+     *  @param worker	The number of the worker thread serving the
+     *			connection (from 0 to one less than the number
+     *			passed to run_threaded()).
+     */
+    virtual void handle_pooled_connection(int socket, unsigned worker);
 };
 
 #endif  // XAPIAN_INCLUDED_TCPSERVER_H
@@ -36,6 +36,7 @@
 #include "testutils.h"
 
 #include "apitest.h"
+#include "backends/documentinternal.h"
 
 #include <list>
 
@@ -689,6 +690,75 @@ DEFINE_TESTCASE(expanddeciderfilterprefix2, backend) {
 		     "Extra items in the filtered eset.");
 }
 
+/// Accepts terms starting with "t" without telling get_eset() the prefix.
+class StartsWithTExpandFunctor : public Xapian::ExpandDecider {
+  public:
+    mutable unsigned calls = 0;
+
+    mutable unsigned accepted = 0;
+
+    bool operator()(const string & tname) const {
+	++calls;
+	if (tname.empty() || tname[0] != 't') return false;
+	++accepted;
+	return true;
+    }
+};
+
+/// Accepts terms starting with "t", and tells get_eset() the prefix.
+class RequirePrefixTExpandFunctor : public Xapian::ExpandDecider {
+  public:
+    mutable unsigned calls = 0;
+
+    bool operator()(const string & tname) const {
+	++calls;
+	// get_eset() shouldn't pass terms without the required prefix.
+	TEST(!tname.empty() && tname[0] == 't');
+	return true;
+    }
+
+    string get_required_prefix() const { return "t"; }
+};
+
+/// Check get_eset() skips terms without the decider's required prefix.
+DEFINE_TESTCASE(expanddeciderfilterprefix3, backend) {
+    Xapian::Enquire enquire(get_database("apitest_simpledata"));
+    enquire.set_query(Xapian::Query("this"));
+
+    Xapian::MSet mymset = enquire.get_mset(0, 10);
+    TEST(mymset.size() >= 3);
+
+    // Use several documents so we skip through a tree of termlists.
+    Xapian::RSet myrset;
+    for (Xapian::MSetIterator i = mymset.begin(); i != mymset.end(); ++i) {
+	myrset.add_document(*i);
+    }
+
+    StartsWithTExpandFunctor plain;
+    Xapian::ESet eset_plain = enquire.get_eset(1000, myrset, &plain);
+    TEST(!eset_plain.empty());
+
+    RequirePrefixTExpandFunctor skipping;
+    Xapian::ESet eset_skipping = enquire.get_eset(1000, myrset, &skipping);
+    TEST_EQUAL(skipping.calls, plain.accepted);
+    TEST_REL(skipping.calls, <, plain.calls);
+
+    Xapian::ExpandDeciderFilterPrefix filter("t");
+    Xapian::ESet eset_filter = enquire.get_eset(1000, myrset, &filter);
+
+    TEST_EQUAL(eset_plain.size(), eset_skipping.size());
+    TEST_EQUAL(eset_plain.size(), eset_filter.size());
+    Xapian::ESetIterator a = eset_plain.begin();
+    Xapian::ESetIterator b = eset_skipping.begin();
+    Xapian::ESetIterator c = eset_filter.begin();
+    for ( ; a != eset_plain.end(); ++a, ++b, ++c) {
+	TEST_EQUAL(*a, *b);
+	TEST_EQUAL(*a, *c);
+	TEST_EQUAL_DOUBLE(a.get_weight(), b.get_weight());
+	TEST_EQUAL_DOUBLE(a.get_weight(), c.get_weight());
+    }
+}
+
 // tests the percent cutoff option
 DEFINE_TESTCASE(pctcutoff1, backend) {
     Xapian::Enquire enquire(get_database("apitest_simpledata"));
@@ -1083,6 +1153,52 @@ DEFINE_TESTCASE(fetchdocs1, backend) {
     TEST_EQUAL(it1, mymset2.end());
 }
 
+// test that fetch() reads the requested range and hands out separate documents
+DEFINE_TESTCASE(fetchdocs2, backend) {
+    Xapian::Database db = get_database("apitest_simpledata");
+    Xapian::Enquire enquire(db);
+    enquire.set_query(query(Xapian::Query::OP_OR, "this", "word"));
+    Xapian::MSet mset = enquire.get_mset(0, 10);
+    TEST_REL(mset.size(), >=, 4);
+
+    // The range is half-open, so this should fetch items 1 and 2.
+    mset.fetch(mset[1], mset[3]);
+
+    // Each call should return a separate Document object, whether or not the
+    // item was fetched, so a change to one shouldn't be seen via another.
+    for (Xapian::doccount i = 0; i != mset.size(); ++i) {
+	Xapian::Document orig = db.get_document(*mset[i]);
+	string data = orig.get_data();
+	TEST_EQUAL(mset[i].get_document().get_data(), data);
+	Xapian::Document doc = mset[i].get_document();
+	// The data of a fetched document shouldn't count as modified (unless
+	// it does for every document, as for a remote database).
+	TEST_EQUAL(doc.internal->data_modified(),
+		   orig.internal->data_modified());
+	doc.set_data("changed");
+	doc.add_term("XCHANGED");
+	TEST_EQUAL(doc.get_data(), "changed");
+	Xapian::Document doc2 = mset[i].get_document();
+	TEST_EQUAL(doc2.get_data(), data);
+	TEST_EQUAL(doc2.termlist_count(), orig.termlist_count());
+    }
+
+    // Fetching a single item, and then everything, should work too.
+    mset.fetch(mset[0]);
+    TEST_EQUAL(mset[0].get_document().get_data(),
+	       db.get_document(*mset[0]).get_data());
+    mset.fetch();
+    Xapian::doccount last = mset.size() - 1;
+    TEST_EQUAL(mset[last].get_document().get_data(),
+	       db.get_document(*mset[last]).get_data());
+
+    // Fetching an empty range or past the end is a no-op.
+    mset.fetch(mset.end());
+    mset.fetch(mset.end(), mset.end());
+    Xapian::MSet empty;
+    empty.fetch();
+}
+
 // test that searching for a term not in the database fails nicely
 DEFINE_TESTCASE(absentterm1, backend) {
     Xapian::Enquire enquire(get_database("apitest_simpledata"));
@@ -40,6 +40,7 @@
 #include "safefcntl.h"
 #include "safesysstat.h"
 #include "safeunistd.h"
+#include "setenv.h"
 #ifdef HAVE_SOCKETPAIR
 # include "safesyssocket.h"
 # include <signal.h>
@@ -49,6 +50,7 @@
 #include <cerrno>
 #include <fstream>
 #include <iterator>
+#include <sstream>
 
 using namespace std;
 
@@ -607,6 +609,64 @@ DEFINE_TESTCASE(databasemodified1, writable && !inmemory && !remote && !multi) {
     }
 }
 
+/// Test XAPIAN_RETAIN_REVISIONS lets readers carry on for longer.
+DEFINE_TESTCASE(retainrevisions1, glass) {
+    struct unset_retain_revisions_helper {
+	~unset_retain_revisions_helper() {
+	    setenv("XAPIAN_RETAIN_REVISIONS", "", 1);
+	}
+    } unset_retain_revisions_afterwards;
+    setenv("XAPIAN_RETAIN_REVISIONS", "2", 1);
+
+    // Same as databasemodified1, but with two more commits which would
+    // throw DatabaseModifiedError without revisions being retained.
+    Xapian::WritableDatabase db =
+	get_named_writable_database("retainrevisions1");
+    string path = get_named_writable_database_path("retainrevisions1");
+    Xapian::Document doc;
+    doc.set_data("cargo");
+    doc.add_term("abc");
+    doc.add_term("def");
+    doc.add_term("ghi");
+    const int N = 500;
+    for (int i = 0; i < N; ++i) {
+	db.add_document(doc);
+    }
+    db.commit();
+
+    Xapian::Database rodb(path);
+    for (int i = 0; i < 3; ++i) {
+	db.add_document(doc);
+	db.commit();
+    }
+    db.add_document(doc);
+
+    TEST_EQUAL(*rodb.termlist_begin(N - 1), "abc");
+    Xapian::Enquire enq(rodb);
+    enq.set_query(Xapian::Query("abc"));
+    Xapian::MSet mset = enq.get_mset(0, 10);
+    TEST_EQUAL(mset.get_matches_estimated(), N);
+    TEST_EQUAL(rodb.get_doccount(), N);
+    db.commit();
+
+    // The retained blocks are in the freelist, so shouldn't be reported as
+    // leaked.
+    TEST_EQUAL(Xapian::Database::check(path), 0);
+
+    // Turning off retention should discard the record of the older
+    // revisions at the next commit.
+    setenv("XAPIAN_RETAIN_REVISIONS", "", 1);
+    db.add_document(doc);
+    db.commit();
+    TEST_EQUAL(Xapian::Database::check(path), 0);
+    TEST(rodb.reopen());
+    TEST_EQUAL(rodb.get_doccount(), N + 5);
+
+    setenv("XAPIAN_RETAIN_REVISIONS", "x", 1);
+    db.add_document(doc);
+    TEST_EXCEPTION(Xapian::InvalidArgumentError, db.commit());
+}
+
 /// Regression test for bug#462 fixed in 1.0.19 and 1.1.5.
 DEFINE_TESTCASE(qpmemoryleak1, writable && !inmemory) {
     // Inmemory never throws DatabaseModifiedError.
@@ -1200,6 +1260,136 @@ DEFINE_TESTCASE(notermlist1, glass) {
     TEST_EXCEPTION(Xapian::FeatureUnavailableError, db.termlist_begin(1));
 }
 
+/// Feature test for Xapian::DB_CACHE_DOCLENS.
+DEFINE_TESTCASE(cachedoclens1, glass) {
+    string db_dir = get_named_writable_database_path("cachedoclens1");
+    Xapian::WritableDatabase wdb = get_named_writable_database("cachedoclens1");
+    // Enough documents that the document lengths span several chunks, with
+    // a range of lengths including zero and one which needs many bits.
+    for (Xapian::docid did = 1; did <= 3000; ++did) {
+	Xapian::Document doc;
+	if (did % 7 != 0) doc.add_term("XYZ", did % 100);
+	doc.add_term(str(did % 10));
+	if (did == 1234) doc.add_term("big", 1000000);
+	wdb.add_document(doc);
+    }
+    wdb.delete_document(5);
+    wdb.delete_document(3000);
+    wdb.commit();
+
+    Xapian::Database db(db_dir);
+    Xapian::Database cdb(db_dir, Xapian::DB_CACHE_DOCLENS);
+    // A second handle on the same revision should share the same cache.
+    Xapian::Database cdb2(db_dir, Xapian::DB_CACHE_DOCLENS);
+    for (Xapian::docid did = 1; did <= 3001; ++did) {
+	if (did == 5 || did >= 3000) {
+	    TEST_EXCEPTION(Xapian::DocNotFoundError, db.get_doclength(did));
+	    TEST_EXCEPTION(Xapian::DocNotFoundError, cdb.get_doclength(did));
+	    continue;
+	}
+	TEST_EQUAL(cdb.get_doclength(did), db.get_doclength(did));
+	TEST_EQUAL(cdb2.get_doclength(did), db.get_doclength(did));
+    }
+
+    Xapian::Enquire enq(db);
+    Xapian::Enquire cenq(cdb);
+    enq.set_query(Xapian::Query("XYZ"));
+    cenq.set_query(Xapian::Query("XYZ"));
+    Xapian::MSet mset = enq.get_mset(0, 10);
+    Xapian::MSet cmset = cenq.get_mset(0, 10);
+    TEST(mset_range_is_same(mset, 0, cmset, 0, mset.size()));
+
+    // Check the cache is updated when reopening at a new revision.
+    Xapian::Document doc;
+    doc.add_term("new", 42);
+    Xapian::docid new_did = wdb.add_document(doc);
+    wdb.commit();
+    TEST_EXCEPTION(Xapian::DocNotFoundError, cdb.get_doclength(new_did));
+    TEST(cdb.reopen());
+    TEST_EQUAL(cdb.get_doclength(new_did), 42);
+    TEST_EQUAL(cdb.get_doclength(1234), db.get_doclength(1234));
+}
+
+/// Check checking the tables of a glass database in parallel.
+DEFINE_TESTCASE(checkparallel1, glass) {
+    string db_dir = get_named_writable_database_path("checkparallel1");
+    {
+	Xapian::WritableDatabase db =
+	    get_named_writable_database("checkparallel1");
+	for (Xapian::docid did = 1; did <= 2000; ++did) {
+	    Xapian::Document doc;
+	    // Leave some documents without terms.
+	    if (did % 13 != 0) {
+		doc.add_posting("word" + str(did % 50), did % 7 + 1);
+		doc.add_term("XID" + str(did), did % 5 + 1);
+	    }
+	    if (did % 3 == 0) doc.set_data("data " + str(did));
+	    if (did % 4 == 0) doc.add_value(1, str(did));
+	    db.add_document(doc);
+	}
+	db.add_spelling("check");
+	db.add_synonym("check", "verify");
+	db.commit();
+    }
+
+    ostringstream out;
+    size_t errors =
+	Xapian::Database::check(db_dir, Xapian::DBCHECK_SHOW_PROGRESS, &out);
+    TEST_EQUAL(errors, 0);
+    string output = out.str();
+    tout << output;
+    TEST(output.find("postlist: 100% of entries checked\n") != string::npos);
+    TEST(output.find("position: 100% of entries checked\n") != string::npos);
+
+    // The reports on each table should be in order.
+    static const char* const tables[] = {
+	"docdata:\n", "termlist:\n", "postlist:\n",
+	"position:\n", "spelling:\n", "synonym:\n"
+    };
+    size_t prev = 0;
+    for (auto table : tables) {
+	size_t i = output.find(table, prev);
+	tout << table;
+	TEST(i != string::npos);
+	prev = i;
+    }
+}
+
+/// Check fetching MSet documents spread over a multi-level glass table.
+DEFINE_TESTCASE(fetchdocs3, glass) {
+    Xapian::WritableDatabase wdb = get_named_writable_database("fetchdocs3");
+    for (Xapian::docid did = 1; did <= 5000; ++did) {
+	Xapian::Document doc;
+	doc.add_term(did % 7 == 0 ? "seven" : "other");
+	doc.set_data(string(100, 'a' + did % 26) + str(did));
+	wdb.add_document(doc);
+    }
+    wdb.commit();
+
+    // Check both committed data and uncommitted modifications.
+    for (int pass = 0; pass != 2; ++pass) {
+	Xapian::Enquire enquire(wdb);
+	enquire.set_query(Xapian::Query("seven"));
+	enquire.set_docid_order(Xapian::Enquire::DESCENDING);
+	Xapian::MSet mset = enquire.get_mset(0, 1000);
+	TEST_EQUAL(mset.size(), 5000 / 7);
+	mset.fetch();
+	for (Xapian::MSetIterator i = mset.begin(); i != mset.end(); ++i) {
+	    Xapian::docid did = *i;
+	    string data = string(100, 'a' + did % 26) + str(did);
+	    if (pass == 1 && did % 2 == 0) data = "new";
+	    TEST_EQUAL(i.get_document().get_data(), data);
+	}
+
+	for (Xapian::docid did = 14; did <= 5000; did += 14) {
+	    Xapian::Document doc;
+	    doc.add_term("seven");
+	    doc.set_data("new");
+	    wdb.replace_document(did, doc);
+	}
+    }
+}
+
 /// Regression test for bug starting a new glass freelist block.
 DEFINE_TESTCASE(newfreelistblock1, writable) {
     Xapian::Document doc;
@@ -30,13 +30,18 @@
 #include "dbcheck.h"
 #include "filetests.h"
 #include "msvcignoreinvalidparam.h"
+#include "setenv.h"
 #include "str.h"
+#include "stringutils.h"
 #include "testsuite.h"
 #include "testutils.h"
 
+#include <algorithm>
 #include <cerrno>
 #include <cstdlib>
 #include <fstream>
+#include <sstream>
+#include <vector>
 
 #include <sys/types.h>
 #include "safesysstat.h"
@@ -727,3 +732,1714 @@ DEFINE_TESTCASE(compact1, compact && writable) {
 
     TEST_EQUAL(Xapian::Database(output).get_doccount(), 3);
 }
+
+/// Test BulkLoader against adding the same documents to a WritableDatabase.
+DEFINE_TESTCASE(bulkload1, glass) {
+    Xapian::Database indb(get_database("apitest_simpledata"));
+
+    const int backends[] = {
+	Xapian::DB_BACKEND_GLASS,
+#ifdef XAPIAN_HAS_HONEY_BACKEND
+	Xapian::DB_BACKEND_HONEY,
+#endif
+    };
+    for (int backend : backends) {
+	string outdbpath = get_compaction_output_path("bulkload1out");
+	rm_rf(outdbpath);
+	rm_rf(outdbpath + ".bulkload");
+
+	{
+	    Xapian::BulkLoader loader(outdbpath, backend);
+	    // Force a run per document so the merge has plenty to do.
+	    loader.set_memory_limit(1);
+	    for (Xapian::docid did = 1; did <= indb.get_lastdocid(); ++did) {
+		TEST_EQUAL(loader.add_document(indb.get_document(did)), did);
+	    }
+	    TEST_EQUAL(loader.get_doccount(), indb.get_doccount());
+	    loader.add_spelling("foo", 2);
+	    loader.add_spelling("foo");
+	    loader.add_synonym("foo", "bar");
+	    loader.set_metadata("key", "old");
+	    loader.set_metadata("key", "new");
+	    loader.finish();
+	    TEST_EXCEPTION(Xapian::InvalidOperationError,
+			   loader.add_document(Xapian::Document()));
+	}
+	// The temporary runs should have been removed.
+	TEST(!path_exists(outdbpath + ".bulkload"));
+
+	Xapian::Database outdb(outdbpath);
+	TEST_EQUAL(outdb.get_doccount(), indb.get_doccount());
+	TEST_EQUAL(outdb.get_lastdocid(), indb.get_lastdocid());
+	TEST_EQUAL(outdb.get_total_length(), indb.get_total_length());
+	dbcheck(outdb, indb.get_doccount(), indb.get_lastdocid());
+	for (auto t = indb.allterms_begin(); t != indb.allterms_end(); ++t) {
+	    TEST_EQUAL(outdb.get_termfreq(*t), t.get_termfreq());
+	    TEST_EQUAL(outdb.get_collection_freq(*t),
+		       indb.get_collection_freq(*t));
+	}
+	for (Xapian::docid did = 1; did <= indb.get_lastdocid(); ++did) {
+	    TEST_EQUAL(outdb.get_document(did).get_data(),
+		       indb.get_document(did).get_data());
+	}
+	auto spell = outdb.spellings_begin();
+	TEST(spell != outdb.spellings_end());
+	TEST_EQUAL(*spell, "foo");
+	TEST_EQUAL(spell.get_termfreq(), 3);
+	TEST_EQUAL(outdb.get_metadata("key"), "new");
+	TEST(outdb.synonyms_begin("foo") != outdb.synonyms_end("foo"));
+	TEST_EQUAL(*outdb.synonyms_begin("foo"), "bar");
+
+	// We shouldn't overwrite an existing path.
+	TEST_EXCEPTION(Xapian::DatabaseCreateError,
+		       Xapian::BulkLoader loader(outdbpath, backend));
+    }
+}
+
+/// Test BulkLoader can't be used after an error adding a document.
+DEFINE_TESTCASE(bulkload2, glass) {
+    string outdbpath = get_compaction_output_path("bulkload2out");
+    rm_rf(outdbpath);
+    rm_rf(outdbpath + ".bulkload");
+
+    {
+	Xapian::BulkLoader loader(outdbpath);
+	Xapian::Document doc;
+	doc.add_term("ok");
+	TEST_EQUAL(loader.add_document(doc), 1);
+
+	// A document which can't be added is rejected without affecting the
+	// current run.
+	Xapian::Document bad_doc;
+	bad_doc.add_term(string(300, 'x'));
+	TEST_EXCEPTION(Xapian::InvalidArgumentError,
+		       loader.add_document(bad_doc));
+	TEST_EQUAL(loader.add_document(doc), 2);
+
+	// Make writing out the current run fail, which loses the documents
+	// buffered for it, so the loader must refuse to carry on.
+	rm_rf(outdbpath + ".bulkload/run0");
+	loader.set_memory_limit(1);
+	TEST_EXCEPTION(Xapian::DatabaseError, loader.add_document(doc));
+	TEST_EXCEPTION(Xapian::InvalidOperationError,
+		       loader.add_document(doc));
+	TEST_EXCEPTION(Xapian::InvalidOperationError,
+		       loader.add_spelling("foo"));
+	TEST_EXCEPTION(Xapian::InvalidOperationError,
+		       loader.set_metadata("key", "value"));
+	TEST_EXCEPTION(Xapian::InvalidOperationError, loader.finish());
+    }
+    TEST(!path_exists(outdbpath));
+    TEST(!path_exists(outdbpath + ".bulkload"));
+}
+
+/// Test creating and compacting glass databases using zstd and LZ4.
+DEFINE_TESTCASE(compresscodec1, glass) {
+    Xapian::Database indb(get_database("apitest_simpledata"));
+
+    TEST_EXCEPTION(Xapian::InvalidArgumentError,
+	Xapian::WritableDatabase(get_named_writable_database_path("codec"),
+				 Xapian::DB_CREATE_OR_OVERWRITE |
+				 Xapian::DB_BACKEND_GLASS |
+				 Xapian::DB_COMPRESS_ZSTD |
+				 Xapian::DB_COMPRESS_LZ4));
+
+    // Document data which compresses, but not so well that it fits in a
+    // single chunk, to test decompressing across chunks.
+    string big_data;
+    unsigned seed = 1;
+    for (int i = 0; i != 100000; ++i) {
+	seed = seed * 1103515245 + 12345;
+	big_data += char('a' + (seed >> 16) % 16);
+    }
+
+    // A zlib-compressed database with several tags big enough to be
+    // compressed, which each need recompressing when compacted to glass with
+    // another codec.
+    string zlib_path = get_named_writable_database_path("codec-zlib");
+    {
+	Xapian::WritableDatabase db(zlib_path,
+				    Xapian::DB_CREATE_OR_OVERWRITE |
+				    Xapian::DB_BACKEND_GLASS);
+	for (Xapian::docid did = 1; did <= indb.get_lastdocid(); ++did) {
+	    db.add_document(indb.get_document(did));
+	}
+	for (int i = 0; i != 3; ++i) {
+	    Xapian::Document big_doc;
+	    big_doc.set_data(big_data.substr(i));
+	    db.add_document(big_doc);
+	}
+	db.commit();
+    }
+
+    const int codecs[] = {
+	Xapian::DB_COMPRESS_ZSTD,
+	Xapian::DB_COMPRESS_LZ4
+    };
+    bool tested = false;
+    for (int codec : codecs) {
+	string path = get_named_writable_database_path("codec");
+	try {
+	    Xapian::WritableDatabase db(path,
+					Xapian::DB_CREATE_OR_OVERWRITE |
+					Xapian::DB_BACKEND_GLASS |
+					codec);
+	    for (Xapian::docid did = 1; did <= indb.get_lastdocid(); ++did) {
+		db.add_document(indb.get_document(did));
+	    }
+	    Xapian::Document big_doc;
+	    big_doc.set_data(big_data);
+	    db.add_document(big_doc);
+	    db.add_spelling("compression");
+	    db.add_synonym("zip", "compress");
+	    db.commit();
+	} catch (const Xapian::FeatureUnavailableError&) {
+	    // Support for this codec wasn't compiled in.
+	    continue;
+	}
+	tested = true;
+
+	TEST_EQUAL(Xapian::Database::check(path, 0, &tout), 0);
+
+	// Compact the database to glass with zlib, to glass with the same
+	// codec and (if enabled) to honey, and also compact a zlib-compressed
+	// database to glass with the codec.
+	struct { bool from_codec_db; int flags; } outputs[] = {
+	    { true, Xapian::DB_BACKEND_GLASS },
+	    { true, Xapian::DB_BACKEND_GLASS | codec },
+#ifdef XAPIAN_HAS_HONEY_BACKEND
+	    { true, Xapian::DB_BACKEND_HONEY },
+#endif
+	    { false, Xapian::DB_BACKEND_GLASS | codec }
+	};
+	for (auto& output : outputs) {
+	    Xapian::Database src(output.from_codec_db ? path : zlib_path);
+	    string outpath = get_compaction_output_path("compresscodec1-out");
+	    rm_rf(outpath);
+	    src.compact(outpath, output.flags);
+	    Xapian::Database outdb(outpath);
+	    for (Xapian::docid did = 1; did <= src.get_lastdocid(); ++did) {
+		Xapian::Document doc = src.get_document(did);
+		Xapian::Document outdoc = outdb.get_document(did);
+		TEST_EQUAL(outdoc.get_data(), doc.get_data());
+		TEST_EQUAL(outdoc.termlist_count(), doc.termlist_count());
+	    }
+	    if (output.from_codec_db) {
+		TEST_EQUAL(outdb.get_document(outdb.get_lastdocid()).get_data(),
+			   big_data);
+		TEST_EQUAL(outdb.get_spelling_suggestion("compresion"),
+			   "compression");
+		TEST(outdb.synonyms_begin("zip") != outdb.synonyms_end("zip"));
+	    }
+	    if (output.flags != Xapian::DB_BACKEND_HONEY) {
+		TEST_EQUAL(Xapian::Database::check(outpath, 0, &tout), 0);
+	    }
+	}
+    }
+    if (!tested) SKIP_TEST("Neither zstd nor LZ4 support compiled in");
+}
+
+/// Test glass databases with block checksums.
+DEFINE_TESTCASE(blockchecksums1, glass) {
+    Xapian::Database indb(get_database("apitest_simpledata"));
+    string path = get_named_writable_database_path("blockchecksums1");
+    {
+	Xapian::WritableDatabase db(path,
+				    Xapian::DB_CREATE_OR_OVERWRITE |
+				    Xapian::DB_BACKEND_GLASS |
+				    Xapian::DB_BLOCK_CHECKSUMS);
+	for (Xapian::docid did = 1; did <= indb.get_lastdocid(); ++did) {
+	    db.add_document(indb.get_document(did));
+	}
+	db.commit();
+	// Modify and commit again so the freelist gets used.
+	db.delete_document(2);
+	db.replace_document(3, indb.get_document(1));
+	db.commit();
+    }
+    TEST_EQUAL(Xapian::Database::check(path, 0, &tout), 0);
+
+    // Compaction should preserve the checksums if asked to, and also be
+    // able to remove them.
+    const int compact_flags[] = {
+	Xapian::DB_BACKEND_GLASS | Xapian::DB_BLOCK_CHECKSUMS,
+	Xapian::DB_BACKEND_GLASS
+    };
+    for (int flags : compact_flags) {
+	string outpath = get_compaction_output_path("blockchecksums1-out");
+	rm_rf(outpath);
+	Xapian::Database(path).compact(outpath, flags);
+	TEST_EQUAL(Xapian::Database::check(outpath, 0, &tout), 0);
+	Xapian::Database outdb(outpath);
+	TEST_EQUAL(outdb.get_doccount(), indb.get_doccount() - 1);
+	TEST_EQUAL(outdb.get_termfreq("this"), indb.get_termfreq("this") - 1);
+    }
+
+    // Change one byte in each block of the postlist table - the checksum
+    // covers the whole block, including any unused space.
+    string table = path + "/postlist.glass";
+    {
+	fstream f(table, ios::in | ios::out | ios::binary);
+	TEST(f.is_open());
+	f.seekg(0, ios::end);
+	off_t size = f.tellg();
+	TEST_REL(size,>,0);
+	for (off_t pos = 100; pos < size; pos += 8192) {
+	    f.seekg(pos);
+	    char ch = char(f.get());
+	    f.seekp(pos);
+	    f.put(char(ch ^ 0x10));
+	}
+	TEST(f.good());
+    }
+    TEST_EXCEPTION(Xapian::DatabaseCorruptError,
+		   Xapian::Database(path).postlist_begin("this"));
+    TEST_EXCEPTION(Xapian::DatabaseCorruptError,
+		   Xapian::Database::check(path, 0, &tout));
+
+    // If the revision in the block is newer, a reader should assume it saw
+    // a block the writer was overwriting, but xapian-check should still
+    // report corruption.
+    {
+	fstream f(table, ios::in | ios::out | ios::binary);
+	TEST(f.is_open());
+	f.seekg(0, ios::end);
+	off_t size = f.tellg();
+	for (off_t pos = 0; pos < size; pos += 8192) {
+	    f.seekp(pos);
+	    f.write("\x7f\xff\xff\xff", 4);
+	}
+	TEST(f.good());
+    }
+    TEST_EXCEPTION(Xapian::DatabaseModifiedError,
+		   Xapian::Database(path).postlist_begin("this"));
+    TEST_EXCEPTION(Xapian::DatabaseCorruptError,
+		   Xapian::Database::check(path, 0, &tout));
+
+    // Regression test - the position table is only created when the first
+    // position list is added, and if that was after the database was
+    // reopened it was created without checksums.
+    path = get_named_writable_database_path("blockchecksums1-lazy");
+    {
+	Xapian::WritableDatabase db(path,
+				    Xapian::DB_CREATE_OR_OVERWRITE |
+				    Xapian::DB_BACKEND_GLASS |
+				    Xapian::DB_BLOCK_CHECKSUMS);
+	Xapian::Document doc;
+	doc.add_term("nopos");
+	db.add_document(doc);
+	db.commit();
+    }
+    {
+	Xapian::WritableDatabase db(path, Xapian::DB_OPEN);
+	for (Xapian::docid did = 1; did <= indb.get_lastdocid(); ++did) {
+	    db.add_document(indb.get_document(did));
+	}
+	db.commit();
+    }
+    TEST(file_exists(path + "/position.glass"));
+    TEST_EQUAL(Xapian::Database::check(path, 0, &tout), 0);
+}
+
+/// Check the position lists in a database built by packedpositions1.
+static void
+check_packed_positions(const Xapian::Database& db,
+		       const vector<vector<Xapian::termpos>>& lists)
+{
+    for (Xapian::docid did = 1; did <= lists.size(); ++did) {
+	const auto& expected = lists[did - 1];
+	Xapian::TermIterator t = db.termlist_begin(did);
+	TEST(t != db.termlist_end(did));
+	TEST_EQUAL(*t, "pos");
+	TEST_EQUAL(t.positionlist_count(), expected.size());
+
+	auto p = db.positionlist_begin(did, "pos");
+	for (Xapian::termpos pos : expected) {
+	    TEST(p != db.positionlist_end(did, "pos"));
+	    TEST_EQUAL(*p, pos);
+	    ++p;
+	}
+	TEST(p == db.positionlist_end(did, "pos"));
+
+	// Skip to just after each entry, which should land on the next one.
+	for (size_t i = 0; i + 1 < expected.size(); i += 7) {
+	    p = db.positionlist_begin(did, "pos");
+	    p.skip_to(expected[i] + 1);
+	    TEST(p != db.positionlist_end(did, "pos"));
+	    TEST_EQUAL(*p, expected[i + 1]);
+	}
+	p = db.positionlist_begin(did, "pos");
+	p.skip_to(expected.back() + 1);
+	TEST(p == db.positionlist_end(did, "pos"));
+    }
+}
+
+/// Test glass databases with bit-packed position lists.
+DEFINE_TESTCASE(packedpositions1, glass) {
+    // Lists of various lengths, including ones which need more than one block
+    // and ones with very large gaps.
+    vector<vector<Xapian::termpos>> lists;
+    for (size_t n : { 1, 2, 3, 200, 1000 }) {
+	vector<Xapian::termpos> positions;
+	Xapian::termpos pos = 1;
+	for (size_t i = 0; i != n; ++i) {
+	    positions.push_back(pos);
+	    pos += 1 + (i * 37) % 11;
+	}
+	lists.push_back(positions);
+    }
+    lists.push_back({ 1, 2, 3, 0x7fffffff, 0x80000000, 0xfffffff0 });
+
+    string path = get_named_writable_database_path("packedpositions1");
+    {
+	Xapian::WritableDatabase db(path,
+				    Xapian::DB_CREATE_OR_OVERWRITE |
+				    Xapian::DB_BACKEND_GLASS |
+				    Xapian::DB_PACKED_POSITIONS);
+	for (const auto& positions : lists) {
+	    Xapian::Document doc;
+	    for (Xapian::termpos pos : positions) {
+		doc.add_posting("pos", pos);
+	    }
+	    db.add_document(doc);
+	}
+	db.commit();
+    }
+    TEST_EQUAL(Xapian::Database::check(path, 0, &tout), 0);
+    check_packed_positions(Xapian::Database(path), lists);
+
+    // Compaction copies the position data, so the output should be readable
+    // and still bit-pack new position lists.
+    const int compact_flags[] = {
+	Xapian::DB_BACKEND_GLASS,
+#ifdef XAPIAN_HAS_HONEY_BACKEND
+	Xapian::DB_BACKEND_HONEY,
+#endif
+    };
+    for (int flags : compact_flags) {
+	string outpath = get_compaction_output_path("packedpositions1-out");
+	rm_rf(outpath);
+	Xapian::Database(path).compact(outpath, flags);
+	check_packed_positions(Xapian::Database(outpath), lists);
+	if (flags != Xapian::DB_BACKEND_GLASS) continue;
+
+	TEST_EQUAL(Xapian::Database::check(outpath, 0, &tout), 0);
+	{
+	    Xapian::WritableDatabase db(outpath);
+	    Xapian::Document doc;
+	    for (Xapian::termpos pos : lists.back()) {
+		doc.add_posting("pos", pos);
+	    }
+	    db.add_document(doc);
+	    db.commit();
+	}
+	TEST_EQUAL(Xapian::Database::check(outpath, 0, &tout), 0);
+	auto out_lists = lists;
+	out_lists.push_back(lists.back());
+	check_packed_positions(Xapian::Database(outpath), out_lists);
+    }
+
+    // The position table is created lazily, and reopening the database
+    // before it is created shouldn't change how the lists get encoded, so
+    // the table should be identical to one built without reopening.
+    string contents[2];
+    for (int reopen = 0; reopen != 2; ++reopen) {
+	path = get_named_writable_database_path("packedpositions1-lazy");
+	Xapian::WritableDatabase db(path,
+				    Xapian::DB_CREATE_OR_OVERWRITE |
+				    Xapian::DB_BACKEND_GLASS |
+				    Xapian::DB_PACKED_POSITIONS);
+	Xapian::Document nopos;
+	nopos.add_term("pos");
+	db.add_document(nopos);
+	db.commit();
+	if (reopen) {
+	    db.close();
+	    db = Xapian::WritableDatabase(path, Xapian::DB_OPEN);
+	}
+	for (const auto& positions : lists) {
+	    Xapian::Document doc;
+	    for (Xapian::termpos pos : positions) {
+		doc.add_posting("pos", pos);
+	    }
+	    db.add_document(doc);
+	}
+	db.commit();
+	db.close();
+	TEST_EQUAL(Xapian::Database::check(path, 0, &tout), 0);
+	ostringstream out;
+	out << ifstream(path + "/position.glass", fstream::binary).rdbuf();
+	contents[reopen] = out.str();
+    }
+    TEST(!contents[0].empty());
+    TEST(contents[0] == contents[1]);
+}
+
+/// Expected wdf of "all" in document @a did for adaptivechunks1.
+static Xapian::termcount
+adaptive_wdf(Xapian::docid did, bool modified)
+{
+    if (modified && did % 777 == 0) return 7;
+    return did % 5 + 1;
+}
+
+/// Check the posting lists in a database built by adaptivechunks1.
+static void
+check_adaptive_chunks(const Xapian::Database& db, Xapian::docid last,
+		      bool modified)
+{
+    auto exists = [&](Xapian::docid did) {
+	return !modified || did % 1000 != 0;
+    };
+
+    Xapian::PostingIterator p = db.postlist_begin("all");
+    for (Xapian::docid did = 1; did <= last; ++did) {
+	if (!exists(did)) continue;
+	TEST(p != db.postlist_end("all"));
+	TEST_EQUAL(*p, did);
+	TEST_EQUAL(p.get_wdf(), adaptive_wdf(did, modified));
+	TEST_EQUAL(p.get_doclength(),
+		   adaptive_wdf(did, modified) + (did % 3 == 0));
+	++p;
+    }
+    TEST(p == db.postlist_end("all"));
+
+    // Skip forwards by a range of distances, both within a chunk and across
+    // chunks.
+    for (Xapian::docid step : { 1, 13, 250, 3001 }) {
+	p = db.postlist_begin("all");
+	Xapian::docid did = 1;
+	while (true) {
+	    p.skip_to(did);
+	    Xapian::docid expected = did;
+	    while (expected <= last && !exists(expected)) ++expected;
+	    if (expected > last) {
+		TEST(p == db.postlist_end("all"));
+		break;
+	    }
+	    TEST(p != db.postlist_end("all"));
+	    TEST_EQUAL(*p, expected);
+	    TEST_EQUAL(p.get_wdf(), adaptive_wdf(expected, modified));
+	    did = expected + step;
+	}
+    }
+
+    p = db.postlist_begin("third");
+    p.skip_to(last - 10);
+    TEST(p != db.postlist_end("third"));
+    TEST_EQUAL(*p, (last - 10 + 2) / 3 * 3);
+}
+
+/// Test glass databases with posting list chunks sized by term frequency.
+DEFINE_TESTCASE(adaptivechunks1, glass) {
+    const Xapian::docid last = 40000;
+    string path = get_named_writable_database_path("adaptivechunks1");
+    {
+	Xapian::WritableDatabase db(path,
+				    Xapian::DB_CREATE_OR_OVERWRITE |
+				    Xapian::DB_BACKEND_GLASS |
+				    Xapian::DB_ADAPTIVE_CHUNKS);
+	for (Xapian::docid did = 1; did <= last; ++did) {
+	    Xapian::Document doc;
+	    doc.add_term("all", adaptive_wdf(did, false));
+	    if (did % 3 == 0) doc.add_term("third");
+	    db.add_document(doc);
+	}
+	db.commit();
+    }
+    TEST_EQUAL(Xapian::Database::check(path, 0, &tout), 0);
+    check_adaptive_chunks(Xapian::Database(path), last, false);
+
+    // Update the existing chunks, which should keep their skip data valid.
+    {
+	Xapian::WritableDatabase db(path);
+	for (Xapian::docid did = 777; did <= last; did += 777) {
+	    Xapian::Document doc;
+	    doc.add_term("all", adaptive_wdf(did, true));
+	    if (did % 3 == 0) doc.add_term("third");
+	    db.replace_document(did, doc);
+	}
+	for (Xapian::docid did = 1000; did <= last; did += 1000) {
+	    db.delete_document(did);
+	}
+	db.commit();
+    }
+    TEST_EQUAL(Xapian::Database::check(path, 0, &tout), 0);
+    check_adaptive_chunks(Xapian::Database(path), last, true);
+
+    // Compaction should rechunk to suit the output database.
+    const int compact_flags[] = {
+	Xapian::DB_BACKEND_GLASS,
+	Xapian::DB_BACKEND_GLASS | Xapian::DB_ADAPTIVE_CHUNKS,
+#ifdef XAPIAN_HAS_HONEY_BACKEND
+	Xapian::DB_BACKEND_HONEY,
+#endif
+    };
+    for (int flags : compact_flags) {
+	string outpath = get_compaction_output_path("adaptivechunks1-out");
+	rm_rf(outpath);
+	Xapian::Database(path).compact(outpath,
+				       flags | Xapian::DBCOMPACT_NO_RENUMBER);
+	check_adaptive_chunks(Xapian::Database(outpath), last, true);
+	if ((flags & Xapian::DB_BACKEND_HONEY) == Xapian::DB_BACKEND_HONEY)
+	    continue;
+	TEST_EQUAL(Xapian::Database::check(outpath, 0, &tout), 0);
+    }
+}
+
+/// Check every posting list in @a db matches that in @a ref.
+static void
+check_same_postlists(const Xapian::Database& db, const Xapian::Database& ref)
+{
+    for (auto t = ref.allterms_begin(); t != ref.allterms_end(); ++t) {
+	const string& term = *t;
+	tout << term << '\n';
+	TEST_EQUAL(db.get_termfreq(term), ref.get_termfreq(term));
+	TEST_EQUAL(db.get_collection_freq(term), ref.get_collection_freq(term));
+	Xapian::PostingIterator p = db.postlist_begin(term);
+	for (auto r = ref.postlist_begin(term); r != ref.postlist_end(term); ++r) {
+	    TEST(p != db.postlist_end(term));
+	    TEST_EQUAL(*p, *r);
+	    TEST_EQUAL(p.get_wdf(), r.get_wdf());
+	    ++p;
+	}
+	TEST(p == db.postlist_end(term));
+
+	// Skip forwards by a range of distances, both within a block and
+	// across blocks.
+	for (Xapian::docid step : { 2, 37, 129, 1000 }) {
+	    p = db.postlist_begin(term);
+	    auto r = ref.postlist_begin(term);
+	    for (Xapian::docid did = 1; r != ref.postlist_end(term);
+		 did += step) {
+		p.skip_to(did);
+		r.skip_to(did);
+		if (r == ref.postlist_end(term)) break;
+		TEST(p != db.postlist_end(term));
+		TEST_EQUAL(*p, *r);
+		TEST_EQUAL(p.get_wdf(), r.get_wdf());
+	    }
+	    TEST(p == db.postlist_end(term));
+	}
+    }
+}
+
+/// Test compacting to honey with bit-packed posting lists.
+DEFINE_TESTCASE(packedpostings1, glass) {
+#ifndef XAPIAN_HAS_HONEY_BACKEND
+    SKIP_TEST("Test requires honey backend");
+#else
+    string path = get_named_writable_database_path("packedpostings1");
+    {
+	Xapian::WritableDatabase db(path,
+				    Xapian::DB_CREATE_OR_OVERWRITE |
+				    Xapian::DB_BACKEND_GLASS);
+	for (Xapian::docid did = 1; did <= 5000; ++did) {
+	    Xapian::Document doc;
+	    // Varying wdfs with an occasional much larger one, which should
+	    // be stored as an exception.
+	    doc.add_term("all", did % 1000 == 0 ? 123456 : did % 7 + 1);
+	    // Flat wdf.
+	    if (did % 3 == 0) doc.add_term("third", 2);
+	    // Mostly small gaps with the occasional large one.
+	    if (did % 100 < 5 || did % 1733 == 0) doc.add_term("gappy", did);
+	    // Zero wdf.
+	    if (did % 11 == 0) doc.add_boolean_term("Bbool");
+	    if (did == 17 || did == 4321) doc.add_term("pair");
+	    if (did == 2500) doc.add_term("single");
+	    db.add_document(doc);
+	}
+	db.commit();
+    }
+    Xapian::Database ref(path);
+
+    string packed = get_compaction_output_path("packedpostings1-packed");
+    rm_rf(packed);
+    ref.compact(packed, Xapian::DB_BACKEND_HONEY | Xapian::DB_PACKED_POSTINGS);
+    check_same_postlists(Xapian::Database(packed), ref);
+
+    // Compacting honey to honey needs to decode the packed posting lists,
+    // whether the output is packed or not.
+    for (int flags : { 0, Xapian::DB_PACKED_POSTINGS }) {
+	string outpath = get_compaction_output_path("packedpostings1-out");
+	rm_rf(outpath);
+	Xapian::Database(packed).compact(outpath,
+					 Xapian::DB_BACKEND_HONEY | flags);
+	check_same_postlists(Xapian::Database(outpath), ref);
+    }
+#endif
+}
+
+/** A BM25Weight subclass whose weight increases with document length.
+ *
+ *  This inherits short_name() from BM25Weight, but honey mustn't assume it
+ *  can bound the weight of a block like it can for BM25Weight.
+ */
+class LongDocWeight : public Xapian::BM25Weight {
+  public:
+    LongDocWeight* clone() const {
+	return new LongDocWeight;
+    }
+
+    double get_sumpart(Xapian::termcount wdf,
+		       Xapian::termcount doclen,
+		       Xapian::termcount,
+		       Xapian::termcount) const {
+	return double(wdf) * doclen;
+    }
+
+    double get_maxpart() const {
+	return double(get_wdf_upper_bound()) * get_doclength_upper_bound();
+    }
+};
+
+/// Check that skipping blocks in honey posting chunks gives the same results.
+DEFINE_TESTCASE(honeyskip1, glass) {
+#ifndef XAPIAN_HAS_HONEY_BACKEND
+    SKIP_TEST("Test requires honey backend");
+#else
+    string path = get_named_writable_database_path("honeyskip1");
+    {
+	Xapian::WritableDatabase db(path,
+				    Xapian::DB_CREATE_OR_OVERWRITE |
+				    Xapian::DB_BACKEND_GLASS);
+	for (Xapian::docid did = 1; did <= 20000; ++did) {
+	    Xapian::Document doc;
+	    // Mostly low wdfs with a few clusters of high ones, so most blocks
+	    // can be skipped once the top documents have been found.
+	    bool hot = (did % 5000 < 40);
+	    doc.add_term("common", hot ? 20 + did % 7 : 1 + did % 2);
+	    if (did % 3 == 0) doc.add_term("third", hot ? 9 : 1);
+	    if (did % 97 == 0) doc.add_term("rare", 1 + did % 5);
+	    // Flat wdf apart from the first entry.
+	    doc.add_term("flat", did == 1 ? 1 : 3);
+	    // Vary the document lengths.
+	    doc.add_term("pad", 1 + (did * 7919) % 50);
+	    db.add_document(doc);
+	}
+	db.commit();
+    }
+    Xapian::Database ref(path);
+
+    static const Xapian::Query::op ops[] = {
+	Xapian::Query::OP_OR,
+	Xapian::Query::OP_AND,
+	Xapian::Query::OP_AND_MAYBE
+    };
+    for (int flags : { 0, Xapian::DB_PACKED_POSTINGS }) {
+	string outpath = get_compaction_output_path("honeyskip1-out");
+	rm_rf(outpath);
+	ref.compact(outpath, Xapian::DB_BACKEND_HONEY | flags);
+	Xapian::Database db(outpath);
+	check_same_postlists(db, ref);
+
+	// Skipping from the first entry straight to a later chunk used to
+	// decode that chunk's header wrongly.
+	Xapian::PostingIterator p = db.postlist_begin("flat");
+	p.skip_to(19990);
+	TEST(p != db.postlist_end("flat"));
+	TEST_EQUAL(*p, 19990);
+	TEST_EQUAL(p.get_wdf(), 3);
+
+	for (auto op : ops) {
+	    for (const char* term : { "third", "rare" }) {
+		Xapian::Query query(op,
+				    Xapian::Query("common"),
+				    Xapian::Query(term));
+		Xapian::Enquire enq_ref(ref);
+		enq_ref.set_query(query);
+		Xapian::MSet mset_ref = enq_ref.get_mset(0, 10);
+		Xapian::Enquire enq(db);
+		enq.set_query(query);
+		Xapian::MSet mset = enq.get_mset(0, 10);
+		TEST_EQUAL(mset.size(), mset_ref.size());
+		for (Xapian::doccount i = 0; i != mset.size(); ++i) {
+		    TEST_EQUAL(*mset[i], *mset_ref[i]);
+		    TEST_EQUAL_DOUBLE(mset[i].get_weight(),
+				      mset_ref[i].get_weight());
+		}
+	    }
+	}
+
+	// A weighting scheme which isn't monotonic in document length
+	// mustn't have blocks skipped based on their minimum length.
+	Xapian::Enquire enq_ref(ref);
+	enq_ref.set_query(Xapian::Query("common"));
+	enq_ref.set_weighting_scheme(LongDocWeight());
+	Xapian::MSet mset_ref = enq_ref.get_mset(0, 10);
+	Xapian::Enquire enq(db);
+	enq.set_query(Xapian::Query("common"));
+	enq.set_weighting_scheme(LongDocWeight());
+	Xapian::MSet mset = enq.get_mset(0, 10);
+	TEST_EQUAL(mset.size(), mset_ref.size());
+	for (Xapian::doccount i = 0; i != mset.size(); ++i) {
+	    TEST_EQUAL(*mset[i], *mset_ref[i]);
+	    TEST_EQUAL_DOUBLE(mset[i].get_weight(), mset_ref[i].get_weight());
+	}
+    }
+#endif
+}
+
+/// Check skip data is generated correctly for sparse docids.
+DEFINE_TESTCASE(honeyskip2, glass) {
+#ifndef XAPIAN_HAS_HONEY_BACKEND
+    SKIP_TEST("Test requires honey backend");
+#else
+    string path = get_named_writable_database_path("honeyskip2");
+    {
+	Xapian::WritableDatabase db(path,
+				    Xapian::DB_CREATE_OR_OVERWRITE |
+				    Xapian::DB_BACKEND_GLASS);
+	// Runs of adjacent docids with gaps between them, so the document
+	// lengths for the skip data have to be looked up across gaps and
+	// doclen chunk boundaries.
+	for (Xapian::docid base : { 1u, 1234567u, 3000000u, 3001500u }) {
+	    for (Xapian::docid did = base; did != base + 1000; ++did) {
+		Xapian::Document doc;
+		bool hot = (did % 501 == 0);
+		doc.add_term("common", hot ? 20 + did % 7 : 1 + did % 2);
+		if (did % 3 == 0) doc.add_term("third", hot ? 9 : 1);
+		// The documents which should match best are much shorter than
+		// their neighbours, so using the wrong lengths would give wrong
+		// bounds.
+		doc.add_term("pad", hot ? 1 : 200 + did % 50);
+		db.replace_document(did, doc);
+	    }
+	}
+	db.commit();
+    }
+    Xapian::Database ref(path);
+
+    for (int flags : { 0, Xapian::DB_PACKED_POSTINGS }) {
+	string outpath = get_compaction_output_path("honeyskip2-out");
+	rm_rf(outpath);
+	ref.compact(outpath,
+		    Xapian::DB_BACKEND_HONEY | Xapian::DBCOMPACT_NO_RENUMBER |
+		    flags);
+	Xapian::Database db(outpath);
+	TEST_EQUAL(db.get_lastdocid(), ref.get_lastdocid());
+	check_same_postlists(db, ref);
+
+	for (auto op : { Xapian::Query::OP_OR, Xapian::Query::OP_AND }) {
+	    Xapian::Query query(op,
+				Xapian::Query("common"),
+				Xapian::Query("third"));
+	    Xapian::Enquire enq_ref(ref);
+	    enq_ref.set_query(query);
+	    Xapian::MSet mset_ref = enq_ref.get_mset(0, 3);
+	    Xapian::Enquire enq(db);
+	    enq.set_query(query);
+	    Xapian::MSet mset = enq.get_mset(0, 3);
+	    TEST_EQUAL(mset.size(), mset_ref.size());
+	    for (Xapian::doccount i = 0; i != mset.size(); ++i) {
+		TEST_EQUAL(*mset[i], *mset_ref[i]);
+		TEST_EQUAL_DOUBLE(mset[i].get_weight(),
+				  mset_ref[i].get_weight());
+	    }
+	}
+    }
+#endif
+}
+
+/// Check that merging ranges of terms in parallel gives the same output.
+DEFINE_TESTCASE(honeyranges1, glass) {
+#ifndef XAPIAN_HAS_HONEY_BACKEND
+    SKIP_TEST("Test requires honey backend");
+#else
+    // Two inputs, with enough terms that the postlist tables have several
+    // levels, and some terms with several chunks.
+    string path1 = get_named_writable_database_path("honeyranges1a");
+    string path2 = get_named_writable_database_path("honeyranges1b");
+    for (int i = 0; i != 2; ++i) {
+	Xapian::WritableDatabase db(i ? path2 : path1,
+				    Xapian::DB_CREATE_OR_OVERWRITE |
+				    Xapian::DB_BACKEND_GLASS);
+	db.set_metadata("key" + str(i), "value");
+	for (Xapian::docid did = 1; did <= 2000; ++did) {
+	    Xapian::Document doc;
+	    doc.add_term("common", 1 + did % 3);
+	    doc.add_term("shared" + str(did % 700));
+	    doc.add_term("unique" + str(i) + "_" + str(did));
+	    doc.add_term("pad", 1 + (did * 7919) % 50);
+	    doc.add_value(1, str(did));
+	    db.add_document(doc);
+	}
+	db.commit();
+    }
+    Xapian::Database in(path1);
+    in.add_database(Xapian::Database(path2));
+    // Compaction renumbers the documents of the second input to follow those
+    // of the first, so compare with compacting to glass.
+    string refpath = get_compaction_output_path("honeyranges1-ref");
+    rm_rf(refpath);
+    in.compact(refpath, Xapian::DB_BACKEND_GLASS);
+    Xapian::Database ref(refpath);
+
+    struct unset_compact_threads_helper {
+	~unset_compact_threads_helper() {
+	    setenv("XAPIAN_COMPACT_THREADS", "", 1);
+	}
+    } unset_compact_threads;
+
+    // Multipass merges the postlist table without splitting it into ranges.
+    string contents[3];
+    for (int i = 0; i != 3; ++i) {
+	string outpath = get_compaction_output_path("honeyranges1-out");
+	rm_rf(outpath);
+	setenv("XAPIAN_COMPACT_THREADS", i == 1 ? "1" : "4", 1);
+	unsigned flags = Xapian::DB_BACKEND_HONEY;
+	if (i == 2) flags |= Xapian::DBCOMPACT_MULTIPASS;
+	in.compact(outpath, flags);
+	Xapian::Database db(outpath);
+	check_same_postlists(db, ref);
+	TEST_EQUAL(db.get_metadata("key0"), "value");
+	TEST_EQUAL(db.get_metadata("key1"), "value");
+	TEST_EQUAL(db.get_value_freq(1), ref.get_value_freq(1));
+	// The temporary tables should have been removed.
+	TEST(!file_exists(outpath + "/tmprange0.honey"));
+	ostringstream out;
+	out << ifstream(outpath + "/postlist.honey", fstream::binary).rdbuf();
+	contents[i] = out.str();
+    }
+    TEST(!contents[0].empty());
+    TEST(contents[0] == contents[1]);
+    TEST(contents[0] == contents[2]);
+
+    // An error merging any of the ranges should be reported.
+    {
+	Xapian::WritableDatabase db(path2, Xapian::DB_OPEN);
+	Xapian::Document doc;
+	doc.add_term("zzz");
+	db.add_document(doc);
+	db.commit();
+    }
+    {
+	Xapian::WritableDatabase db(path1, Xapian::DB_OPEN);
+	Xapian::Document doc;
+	doc.add_boolean_term("zzz");
+	db.add_document(doc);
+	db.commit();
+    }
+    in = Xapian::Database(path1);
+    in.add_database(Xapian::Database(path2));
+    setenv("XAPIAN_COMPACT_THREADS", "4", 1);
+    string outpath = get_compaction_output_path("honeyranges1-bad");
+    rm_rf(outpath);
+    TEST_EXCEPTION(Xapian::DatabaseError,
+		   in.compact(outpath, Xapian::DB_BACKEND_HONEY));
+#endif
+}
+
+/// Test reading a single file honey database at a non-zero offset.
+DEFINE_TESTCASE(honeysinglefile1, glass) {
+#ifndef XAPIAN_HAS_HONEY_BACKEND
+    SKIP_TEST("Test requires honey backend");
+#else
+    Xapian::Database ref(get_database("apitest_simpledata"));
+    string outpath = get_compaction_output_path("honeysinglefile1-out");
+    rm_rf(outpath);
+    int fd = open(outpath.c_str(), O_CREAT|O_RDWR|O_BINARY, 0666);
+    TEST(fd != -1);
+    TEST(lseek(fd, 8192, SEEK_SET) == 8192);
+    ref.compact(fd, Xapian::DB_BACKEND_HONEY);
+
+    // Check reading via a memory mapping and via pread().
+    struct unset_no_mmap_helper {
+	~unset_no_mmap_helper() { setenv("XAPIAN_HONEY_NO_MMAP", "", 1); }
+    } unset_no_mmap;
+    for (const char* no_mmap : { "", "1" }) {
+	setenv("XAPIAN_HONEY_NO_MMAP", no_mmap, 1);
+	fd = open(outpath.c_str(), O_RDONLY|O_BINARY);
+	TEST(fd != -1);
+	TEST(lseek(fd, 8192, SEEK_SET) == 8192);
+	Xapian::Database db(fd);
+	TEST_EQUAL(db.get_doccount(), ref.get_doccount());
+	check_same_postlists(db, ref);
+	for (Xapian::docid did = 1; did <= ref.get_lastdocid(); ++did) {
+	    TEST_EQUAL(db.get_document(did).get_data(),
+		       ref.get_document(did).get_data());
+	}
+	Xapian::Enquire enq(db);
+	enq.set_query(Xapian::Query(Xapian::Query::OP_PHRASE,
+				    Xapian::Query("this"),
+				    Xapian::Query("paragraph")));
+	Xapian::Enquire enq_ref(ref);
+	enq_ref.set_query(enq.get_query());
+	TEST_EQUAL(enq.get_mset(0, 10).size(), enq_ref.get_mset(0, 10).size());
+	TEST_EXCEPTION(Xapian::DocNotFoundError,
+		       db.get_document(ref.get_lastdocid() + 1));
+    }
+#endif
+}
+
+/// Test compacting to honey with an Eytzinger layout index.
+DEFINE_TESTCASE(eytzingerindex1, glass) {
+#ifndef XAPIAN_HAS_HONEY_BACKEND
+    SKIP_TEST("Test requires honey backend");
+#else
+    string path = get_named_writable_database_path("eytzingerindex1");
+    {
+	Xapian::WritableDatabase db(path,
+				    Xapian::DB_CREATE_OR_OVERWRITE |
+				    Xapian::DB_BACKEND_GLASS);
+	for (Xapian::docid did = 1; did <= 3000; ++did) {
+	    Xapian::Document doc;
+	    doc.set_data("data " + str(did));
+	    doc.add_term("t" + str(did));
+	    doc.add_term("t" + str(did % 300));
+	    // Lots of terms longer than the index prefixes which share them.
+	    doc.add_term("longprefix" + str(did));
+	    // Short terms, and terms with zero bytes where the index prefix is
+	    // truncated.
+	    doc.add_term(string(1, char('a' + did % 26)));
+	    doc.add_term(string("ab\0\0\0\0\0\0", 8) + str(did % 50));
+	    doc.add_term(string("ab\0", 3) + str(did % 40));
+	    db.add_document(doc);
+	}
+	db.commit();
+    }
+    Xapian::Database ref(path);
+
+    static const char* const absent[] = {
+	"!", "longprefix", "longprefix0", "longprefix99999", "tt", "t3001",
+	"ab", "\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+    };
+    for (int flags : { 0, Xapian::DBCOMPACT_SINGLE_FILE }) {
+	string outpath = get_compaction_output_path("eytzingerindex1-out");
+	rm_rf(outpath);
+	ref.compact(outpath, Xapian::DB_BACKEND_HONEY |
+			     Xapian::DB_EYTZINGER_INDEX | flags);
+	Xapian::Database db(outpath);
+	check_same_postlists(db, ref);
+	for (const char* term : absent) {
+	    TEST(!db.term_exists(term));
+	}
+	TEST_EQUAL(db.get_document(2999).get_data(), "data 2999");
+
+	// Check iterating terms with a prefix, which uses a cursor.
+	Xapian::doccount count = 0;
+	for (auto t = db.allterms_begin("longprefix2"); t != db.allterms_end();
+	     ++t) {
+	    TEST(startswith(*t, "longprefix2"));
+	    ++count;
+	}
+	TEST_EQUAL(count, 1111);
+
+	// Compacting honey to honey should work too.
+	string outpath2 = get_compaction_output_path("eytzingerindex1-out2");
+	rm_rf(outpath2);
+	db.compact(outpath2, Xapian::DB_BACKEND_HONEY |
+			     Xapian::DB_EYTZINGER_INDEX);
+	check_same_postlists(Xapian::Database(outpath2), ref);
+    }
+#endif
+}
+
+/// Test compacting to honey with Bloom filters.
+DEFINE_TESTCASE(bloomfilters1, glass) {
+#ifndef XAPIAN_HAS_HONEY_BACKEND
+    SKIP_TEST("Test requires honey backend");
+#else
+    string path = get_named_writable_database_path("bloomfilters1");
+    {
+	Xapian::WritableDatabase db(path,
+				    Xapian::DB_CREATE_OR_OVERWRITE |
+				    Xapian::DB_BACKEND_GLASS);
+	for (Xapian::docid did = 1; did <= 2000; ++did) {
+	    Xapian::Document doc;
+	    doc.add_term("all");
+	    doc.add_posting("t" + str(did), 1);
+	    doc.add_posting("t" + str(did % 100), 2);
+	    db.add_document(doc);
+	}
+	db.add_synonym("t1", "t2");
+	db.add_spelling("spell", 3);
+	db.set_metadata("key", "value");
+	db.commit();
+    }
+    Xapian::Database ref(path);
+
+    string plain = get_compaction_output_path("bloomfilters1-plain");
+    rm_rf(plain);
+    ref.compact(plain, Xapian::DB_BACKEND_HONEY);
+
+    for (int flags : { 0,
+		       Xapian::DBCOMPACT_SINGLE_FILE,
+		       Xapian::DB_EYTZINGER_INDEX }) {
+	string outpath =
+	    get_compaction_output_path("bloomfilters1-out" + str(flags));
+	rm_rf(outpath);
+	ref.compact(outpath, Xapian::DB_BACKEND_HONEY |
+			     Xapian::DB_BLOOM_FILTERS | flags);
+	Xapian::Database db(outpath);
+	check_same_postlists(db, ref);
+	for (auto t = ref.allterms_begin(); t != ref.allterms_end(); ++t) {
+	    TEST(db.term_exists(*t));
+	}
+	for (Xapian::docid did = 2001; did <= 3000; ++did) {
+	    string term = "t" + str(did);
+	    TEST(!db.term_exists(term));
+	    TEST_EQUAL(db.get_termfreq(term), 0);
+	    TEST(db.postlist_begin(term) == db.postlist_end(term));
+	}
+	TEST_EQUAL(db.get_metadata("key"), "value");
+	TEST_EQUAL(db.get_metadata("nokey"), "");
+	TEST_EQUAL(db.get_spelling_suggestion("spel"), "spell");
+	TEST(db.synonyms_begin("t1") != db.synonyms_end("t1"));
+	TEST(db.synonyms_begin("t2") == db.synonyms_end("t2"));
+	TEST_EQUAL(db.get_doclength(2000), 3);
+	TEST_EQUAL(*db.positionlist_begin(7, "t7"), 1);
+	TEST(db.positionlist_begin(7, "t8") == db.positionlist_end(7, "t8"));
+
+	if (!(flags & Xapian::DBCOMPACT_SINGLE_FILE)) {
+	    // The filter is stored in the table.
+	    TEST_REL(file_size(outpath + "/postlist.honey"), >,
+		     file_size(plain + "/postlist.honey"));
+
+	    // Compacting honey to honey should rebuild the filters.
+	    string outpath2 = get_compaction_output_path("bloomfilters1-out2");
+	    rm_rf(outpath2);
+	    db.compact(outpath2, Xapian::DB_BACKEND_HONEY |
+				 Xapian::DB_BLOOM_FILTERS);
+	    check_same_postlists(Xapian::Database(outpath2), ref);
+	}
+    }
+
+    // Clear all the bits in the filters, which makes every key look absent,
+    // and check that opening a posting list or position list checks the
+    // filter rather than searching the table.
+    string outpath = get_compaction_output_path("bloomfilters1-out");
+    rm_rf(outpath);
+    ref.compact(outpath, Xapian::DB_BACKEND_HONEY | Xapian::DB_BLOOM_FILTERS);
+    for (const char* table : { "/postlist.honey", "/position.honey" }) {
+	// The filter is written after the index as a 4 byte block count
+	// followed by 32 bytes per block.
+	off_t filter_size = file_size(outpath + table) -
+			    file_size(plain + table);
+	TEST_REL(filter_size, >, 4);
+	TEST_EQUAL((filter_size - 4) % 32, 0);
+	fstream f(outpath + table, ios::in | ios::out | ios::binary);
+	TEST(f.is_open());
+	f.seekp(-(filter_size - 4), ios::end);
+	f << string(filter_size - 4, '\0');
+	TEST(f.good());
+    }
+    Xapian::Database db(outpath);
+    TEST(db.postlist_begin("t7") == db.postlist_end("t7"));
+    TEST(db.positionlist_begin(7, "t7") == db.positionlist_end(7, "t7"));
+    TEST_EQUAL(db.get_termfreq("t7"), 0);
+#endif
+}
+
+/// Test compacting with documents reordered by key.
+DEFINE_TESTCASE(compactreordered1, glass) {
+    string path = get_named_writable_database_path("compactreordered1");
+    const Xapian::docid n = 200;
+    {
+	Xapian::WritableDatabase db(path,
+				    Xapian::DB_CREATE_OR_OVERWRITE |
+				    Xapian::DB_BACKEND_GLASS);
+	for (Xapian::docid did = 1; did <= n; ++did) {
+	    Xapian::Document doc;
+	    doc.set_data("doc " + str(did));
+	    doc.add_posting("Q" + str(did), 1);
+	    doc.add_posting(did % 2 ? "odd" : "even", 2);
+	    // Documents with equal keys should keep their relative order.
+	    doc.add_value(0, str(9 - did % 10));
+	    doc.add_value(1, str(did));
+	    db.add_document(doc);
+	}
+	db.set_metadata("key", "value");
+	db.add_spelling("hello", 3);
+	db.add_synonym("hi", "hello");
+	db.commit();
+    }
+    Xapian::Database src(path);
+
+    Xapian::MultiValueKeyMaker sorter;
+    sorter.add_value(0);
+    TEST_EXCEPTION(Xapian::InvalidArgumentError,
+		   Xapian::compact_reordered(src,
+					     get_compaction_output_path("x"),
+					     sorter,
+					     Xapian::DBCOMPACT_NO_RENUMBER));
+
+    const int compact_flags[] = {
+	Xapian::DB_BACKEND_GLASS,
+#ifdef XAPIAN_HAS_HONEY_BACKEND
+	Xapian::DB_BACKEND_HONEY,
+#endif
+    };
+    for (int flags : compact_flags) {
+	string outpath = get_compaction_output_path("compactreordered1-out");
+	rm_rf(outpath);
+	Xapian::compact_reordered(src, outpath, sorter, flags);
+	TEST(!dir_exists(outpath + ".reorder"));
+
+	Xapian::Database db(outpath);
+	TEST_EQUAL(db.get_doccount(), n);
+	TEST_EQUAL(db.get_lastdocid(), n);
+	TEST_EQUAL(db.get_metadata("key"), "value");
+	Xapian::TermIterator t = db.spellings_begin();
+	TEST(t != db.spellings_end());
+	TEST_EQUAL(*t, "hello");
+	TEST_EQUAL(t.get_termfreq(), 3);
+	t = db.synonyms_begin("hi");
+	TEST(t != db.synonyms_end("hi"));
+	TEST_EQUAL(*t, "hello");
+
+	Xapian::docid did = 0;
+	for (unsigned key = 0; key != 10; ++key) {
+	    for (Xapian::docid old = 9 - key; old <= n; old += 10) {
+		if (old == 0) continue;
+		Xapian::Document doc = db.get_document(++did);
+		TEST_EQUAL(doc.get_data(), "doc " + str(old));
+		TEST_EQUAL(doc.get_value(1), str(old));
+		Xapian::PostingIterator p = db.postlist_begin("Q" + str(old));
+		TEST(p != db.postlist_end("Q" + str(old)));
+		TEST_EQUAL(*p, did);
+		string term = old % 2 ? "odd" : "even";
+		Xapian::PositionIterator pos = db.positionlist_begin(did, term);
+		TEST(pos != db.positionlist_end(did, term));
+		TEST_EQUAL(*pos, 2);
+	    }
+	}
+	TEST_EQUAL(did, n);
+    }
+}
+
+/// Compactor which joins the tags of duplicate user metadata keys.
+class JoinTagsCompactor : public Xapian::Compactor {
+  public:
+    std::string resolve_duplicate_metadata(const std::string&,
+					   size_t num_tags,
+					   const std::string tags[]) {
+	string result;
+	for (size_t i = 0; i != num_tags; ++i) {
+	    if (i) result += ',';
+	    result += tags[i];
+	}
+	return result;
+    }
+};
+
+/// Test the user metadata from all shards is kept when reordering.
+DEFINE_TESTCASE(compactreordered2, glass) {
+    Xapian::Database src;
+    for (int i = 0; i != 2; ++i) {
+	string path = get_named_writable_database_path("compactreordered2-" +
+						       str(i));
+	Xapian::WritableDatabase db(path,
+				    Xapian::DB_CREATE_OR_OVERWRITE |
+				    Xapian::DB_BACKEND_GLASS);
+	Xapian::Document doc;
+	doc.add_value(0, str(1 - i));
+	db.add_document(doc);
+	db.set_metadata("shard" + str(i), "only" + str(i));
+	db.set_metadata("both", "tag" + str(i));
+	db.commit();
+	src.add_database(Xapian::Database(path));
+    }
+
+    Xapian::MultiValueKeyMaker sorter;
+    sorter.add_value(0);
+    string outpath = get_compaction_output_path("compactreordered2-out");
+    for (bool join : { false, true }) {
+	rm_rf(outpath);
+	JoinTagsCompactor compactor;
+	Xapian::compact_reordered(src, outpath, sorter,
+				  Xapian::DB_BACKEND_GLASS,
+				  0, join ? &compactor : NULL);
+	Xapian::Database db(outpath);
+	TEST_EQUAL(db.get_doccount(), 2);
+	TEST_EQUAL(db.get_metadata("shard0"), "only0");
+	TEST_EQUAL(db.get_metadata("shard1"), "only1");
+	TEST_EQUAL(db.get_metadata("both"), join ? "tag0,tag1" : "tag0");
+    }
+}
+
+// Test tiered merging of the shards of a stub database.
+DEFINE_TESTCASE(mergeshards1, glass) {
+    const string stubdir = ".stub/mergeshards1";
+    mkdir(".stub", 0755);
+    rm_rf(stubdir);
+    mkdir(stubdir.c_str(), 0755);
+
+    // Four shards with one document each and one with five documents.
+    const Xapian::doccount sizes[] = { 5, 1, 1, 1, 1 };
+    Xapian::docid next_id = 0;
+    {
+	ofstream stub(stubdir + "/XAPIANDB");
+	TEST(stub.is_open());
+	stub << "# Comment" << endl;
+	for (size_t i = 0; i != sizeof(sizes) / sizeof(sizes[0]); ++i) {
+	    string name = "s" + str(i);
+	    Xapian::WritableDatabase db(stubdir + "/" + name,
+					Xapian::DB_CREATE_OR_OVERWRITE |
+					Xapian::DB_BACKEND_GLASS);
+	    for (Xapian::doccount j = 0; j != sizes[i]; ++j) {
+		Xapian::Document doc;
+		doc.add_boolean_term("Q" + str(++next_id));
+		doc.add_term("all");
+		db.add_document(doc);
+	    }
+	    db.commit();
+	    stub << "auto " << name << endl;
+	}
+    }
+
+    TEST_EXCEPTION(Xapian::InvalidArgumentError,
+		   Xapian::merge_shards(stubdir, 1));
+
+    // The four single document shards should get merged, but then there's
+    // only two shards with between 4 and 15 documents.
+    auto merged = Xapian::merge_shards(stubdir);
+    TEST_EQUAL(merged.size(), 4);
+    TEST_EQUAL(merged[0], stubdir + "/s1");
+    TEST_EQUAL(merged[3], stubdir + "/s4");
+    TEST(Xapian::merge_shards(stubdir).empty());
+
+    ifstream stub(stubdir + "/XAPIANDB");
+    string line;
+    TEST(getline(stub, line));
+    TEST_EQUAL(line, "# Comment");
+    TEST(getline(stub, line));
+    TEST_EQUAL(line, "auto s0");
+    TEST(getline(stub, line));
+    TEST(startswith(line, "auto "));
+    TEST(!getline(stub, line));
+
+    Xapian::Database db(stubdir);
+    TEST_EQUAL(db.size(), 2);
+    TEST_EQUAL(db.get_doccount(), next_id);
+    TEST_EQUAL(db.get_termfreq("all"), next_id);
+    for (Xapian::docid id = 1; id <= next_id; ++id) {
+	TEST_EQUAL(db.get_termfreq("Q" + str(id)), 1);
+    }
+}
+
+/// The number of documents in the database for overlay1.
+static const Xapian::docid OVERLAY1_DOCS = 3000;
+
+/// Populate a database for overlay1.
+static void
+make_overlay1_db(Xapian::WritableDatabase& db)
+{
+    for (Xapian::docid did = 1; did <= OVERLAY1_DOCS; ++did) {
+	Xapian::Document doc;
+	doc.set_data("data " + str(did));
+	doc.add_posting("all", 1);
+	doc.add_posting("t" + str(did % 7), 2, did % 3 + 1);
+	doc.add_boolean_term("Q" + str(did));
+	if (did % 2) doc.add_value(1, str(did));
+	if (did % 3 == 0) doc.add_value(2, "v" + str(did));
+	db.add_document(doc);
+    }
+    db.set_metadata("key", "value");
+    db.add_spelling("spell", 2);
+    db.commit();
+}
+
+/// Check that @a db has the same contents as @a ref.
+static void
+check_same_overlay1(const Xapian::Database& db, const Xapian::Database& ref)
+{
+    TEST_EQUAL(db.get_doccount(), ref.get_doccount());
+    TEST_EQUAL(db.get_lastdocid(), ref.get_lastdocid());
+    TEST_EQUAL(db.get_total_length(), ref.get_total_length());
+    check_same_postlists(db, ref);
+
+    // Check the termfreqs from iterating all terms, which should skip terms
+    // which only occur in deleted documents.
+    auto t = db.allterms_begin();
+    for (auto r = ref.allterms_begin(); r != ref.allterms_end(); ++r) {
+	TEST(t != db.allterms_end());
+	TEST_EQUAL(*t, *r);
+	TEST_EQUAL(t.get_termfreq(), r.get_termfreq());
+	++t;
+    }
+    TEST(t == db.allterms_end());
+
+    for (Xapian::valueno slot : { 1, 2 }) {
+	TEST_EQUAL(db.get_value_freq(slot), ref.get_value_freq(slot));
+	TEST_EQUAL(db.get_value_lower_bound(slot),
+		   ref.get_value_lower_bound(slot));
+	auto v = db.valuestream_begin(slot);
+	for (auto r = ref.valuestream_begin(slot);
+	     r != ref.valuestream_end(slot); ++r) {
+	    TEST(v != db.valuestream_end(slot));
+	    TEST_EQUAL(v.get_docid(), r.get_docid());
+	    TEST_EQUAL(*v, *r);
+	    ++v;
+	}
+	TEST(v == db.valuestream_end(slot));
+    }
+
+    for (auto p = ref.postlist_begin(""); p != ref.postlist_end(""); ++p) {
+	Xapian::docid did = *p;
+	TEST_EQUAL(db.get_document(did).get_data(),
+		   ref.get_document(did).get_data());
+	TEST_EQUAL(db.get_doclength(did), ref.get_doclength(did));
+	auto tl = db.termlist_begin(did);
+	for (auto r = ref.termlist_begin(did); r != ref.termlist_end(did);
+	     ++r) {
+	    TEST(tl != db.termlist_end(did));
+	    TEST_EQUAL(*tl, *r);
+	    TEST_EQUAL(tl.get_wdf(), r.get_wdf());
+	    TEST(equal(tl.positionlist_begin(), tl.positionlist_end(),
+		       r.positionlist_begin()));
+	    ++tl;
+	}
+	TEST(tl == db.termlist_end(did));
+    }
+
+    // The keys used to record masked documents shouldn't be visible.
+    auto k = db.metadata_keys_begin();
+    for (auto r = ref.metadata_keys_begin(); r != ref.metadata_keys_end();
+	 ++r) {
+	TEST(k != db.metadata_keys_end());
+	TEST_EQUAL(*k, *r);
+	TEST_EQUAL(db.get_metadata(*k), ref.get_metadata(*r));
+	++k;
+    }
+    TEST(k == db.metadata_keys_end());
+
+    TEST_EQUAL(db.get_spelling_suggestion("spel"),
+	       ref.get_spelling_suggestion("spel"));
+}
+
+/// Test updating a honey database via an overlay.
+DEFINE_TESTCASE(overlay1, glass) {
+#ifndef XAPIAN_HAS_HONEY_BACKEND
+    SKIP_TEST("Test requires honey backend");
+#else
+    string refpath = get_named_writable_database_path("overlay1-ref");
+    Xapian::WritableDatabase ref(refpath,
+				 Xapian::DB_CREATE_OR_OVERWRITE |
+				 Xapian::DB_BACKEND_GLASS);
+    make_overlay1_db(ref);
+
+    string honeypath = get_compaction_output_path("overlay1");
+    rm_rf(honeypath);
+    {
+	string path = get_named_writable_database_path("overlay1");
+	Xapian::WritableDatabase db(path,
+				    Xapian::DB_CREATE_OR_OVERWRITE |
+				    Xapian::DB_BACKEND_GLASS);
+	make_overlay1_db(db);
+	db.compact(honeypath, Xapian::DB_BACKEND_HONEY);
+    }
+
+    // Honey databases still can't be created directly.
+    TEST_EXCEPTION(Xapian::DatabaseCreateError,
+		   Xapian::WritableDatabase(honeypath, Xapian::DB_CREATE));
+
+    // Readers opened before the overlay is created should see it after
+    // reopen().
+    Xapian::Database early(honeypath);
+    Xapian::Database early_multi;
+    early_multi.add_database(Xapian::Database(honeypath));
+    early_multi.add_database(Xapian::Database(honeypath));
+    TEST(!early.reopen());
+    TEST(!early_multi.reopen());
+
+    {
+	Xapian::WritableDatabase db(honeypath);
+	for (Xapian::WritableDatabase* w : { &db, &ref }) {
+	    // Delete every fifth document, and replace every eleventh
+	    // including some which have been deleted.
+	    for (Xapian::docid did = 5; did <= OVERLAY1_DOCS; did += 5) {
+		w->delete_document(did);
+	    }
+	    for (Xapian::docid did = 11; did <= OVERLAY1_DOCS; did += 11) {
+		Xapian::Document doc;
+		doc.set_data("new " + str(did));
+		doc.add_posting("all", 1);
+		doc.add_posting("new", 2, 3);
+		doc.add_value(1, "new" + str(did));
+		w->replace_document(did, doc);
+	    }
+	    // Replacing a document with a term which only then occurs in the
+	    // overlay.
+	    w->replace_document("Q3", Xapian::Document());
+	    for (int i = 0; i != 3; ++i) {
+		Xapian::Document doc;
+		doc.set_data("added");
+		doc.add_term("all");
+		doc.add_term("t0");
+		w->add_document(doc);
+	    }
+	    w->set_metadata("key2", "value2");
+	    w->add_spelling("spelt", 5);
+	    w->commit();
+	}
+
+	// Changes in a cancelled transaction should be discarded.
+	db.begin_transaction();
+	db.delete_document(1);
+	db.add_document(Xapian::Document());
+	TEST_EQUAL(db.get_doccount(), ref.get_doccount());
+	db.cancel_transaction();
+	TEST_EQUAL(db.get_doccount(), ref.get_doccount());
+	TEST_EQUAL(db.get_document(1).get_data(), "data 1");
+	TEST_EXCEPTION(Xapian::InvalidArgumentError,
+		       db.set_metadata(string("\xff\xffmasked:", 9), "x"));
+	TEST_EXCEPTION(Xapian::UnimplementedError, db.set_metadata("key", ""));
+
+	// As for glass, a failed update should discard all uncommitted
+	// changes, including masking the document being replaced.
+	db.delete_document(1);
+	Xapian::Document bad;
+	bad.add_term(string(300, 'x'));
+	TEST_EXCEPTION(Xapian::InvalidArgumentError,
+		       db.replace_document(2, bad));
+	TEST_EQUAL(db.get_doccount(), ref.get_doccount());
+	TEST_EQUAL(db.get_termfreq("all"), ref.get_termfreq("all"));
+	TEST_EQUAL(db.get_document(1).get_data(), "data 1");
+	TEST_EQUAL(db.get_document(2).get_data(), "data 2");
+	TEST_EQUAL(db.get_doclength(2), ref.get_doclength(2));
+	db.commit();
+	TEST_EQUAL(db.get_doccount(), ref.get_doccount());
+    }
+
+    TEST(early.reopen());
+    check_same_overlay1(early, ref);
+
+    // Reopening after further changes only needs to read the new masks.
+    {
+	Xapian::WritableDatabase db(honeypath);
+	for (Xapian::WritableDatabase* w : { &db, &ref }) {
+	    w->delete_document(7);
+	    w->delete_document(OVERLAY1_DOCS + 2);
+	    w->commit();
+	}
+    }
+    TEST(early.reopen());
+    check_same_overlay1(early, ref);
+    TEST(early_multi.reopen());
+    TEST_EQUAL(early_multi.get_doccount(), ref.get_doccount() * 2);
+    TEST_EQUAL(early_multi.get_termfreq("new"), ref.get_termfreq("new") * 2);
+
+    Xapian::Database db(honeypath);
+    TEST_EQUAL(db.get_termfreq("Q5"), 0);
+    TEST(!db.term_exists("Q3"));
+    TEST_EQUAL(db.get_document(22).get_data(), "new 22");
+    TEST_EQUAL(db.get_document(OVERLAY1_DOCS + 1).get_data(), "added");
+    TEST_EXCEPTION(Xapian::DocNotFoundError, db.get_document(10));
+    check_same_overlay1(db, ref);
+
+    Xapian::Enquire enq(db);
+    enq.set_query(Xapian::Query("new"));
+    Xapian::MSet mset = enq.get_mset(0, OVERLAY1_DOCS);
+    TEST_EQUAL(mset.size(), ref.get_termfreq("new"));
+
+    // Compacting merges the overlay into a new honey database.
+    string outpath = get_compaction_output_path("overlay1-out");
+    rm_rf(outpath);
+    db.compact(outpath, Xapian::DB_BACKEND_HONEY);
+    Xapian::Database merged(outpath);
+    TEST_EQUAL(merged.size(), 1);
+    check_same_overlay1(merged, ref);
+    TEST(!dir_exists(outpath + "/overlay"));
+#endif
+}
+
+/// Check the positional data in @a db matches that in @a ref.
+static void
+check_same_positions(const Xapian::Database& db, const Xapian::Database& ref)
+{
+    for (auto t = ref.allterms_begin(); t != ref.allterms_end(); ++t) {
+	const string& term = *t;
+	tout << term << '\n';
+	// Positions read via a posting list, with a range of skips so we move
+	// both within and between chunks.
+	for (Xapian::docid step : { 1, 3, 150, 1000 }) {
+	    Xapian::PostingIterator p = db.postlist_begin(term);
+	    for (auto r = ref.postlist_begin(term); r != ref.postlist_end(term);
+		 r.skip_to(*r + step)) {
+		p.skip_to(*r);
+		TEST(p != db.postlist_end(term));
+		TEST_EQUAL(*p, *r);
+		TEST(equal(p.positionlist_begin(), p.positionlist_end(),
+			   r.positionlist_begin()));
+	    }
+	}
+	// Positions looked up for a document.
+	for (auto r = ref.postlist_begin(term); r != ref.postlist_end(term);
+	     r.skip_to(*r + 7)) {
+	    TEST(equal(db.positionlist_begin(*r, term),
+		       db.positionlist_end(*r, term),
+		       ref.positionlist_begin(*r, term)));
+	}
+    }
+
+    for (Xapian::docid did : { 1, 2, 10, 1234, 2000, 4999 }) {
+	auto r = ref.termlist_begin(did);
+	for (auto t = db.termlist_begin(did); t != db.termlist_end(did); ++t) {
+	    TEST_EQUAL(*t, *r);
+	    TEST_EQUAL(t.positionlist_count(), r.positionlist_count());
+	    ++r;
+	}
+    }
+    // A term which doesn't index the document.
+    TEST(db.positionlist_begin(3, "w4") == db.positionlist_end(3, "w4"));
+
+    static const char* const phrases[][2] = {
+	{ "all", "w3" }, { "all", "mixed" }, { "w1", "mixed" },
+	{ "two", "all" }, { "rare", "all" }
+    };
+    Xapian::Enquire enq(db), enq_ref(ref);
+    for (auto& phrase : phrases) {
+	for (auto op : { Xapian::Query::OP_PHRASE, Xapian::Query::OP_NEAR }) {
+	    Xapian::Query query(op, phrase, phrase + 2, 4);
+	    tout << query.get_description() << '\n';
+	    enq.set_query(query);
+	    enq_ref.set_query(query);
+	    Xapian::MSet mset = enq.get_mset(0, 5000);
+	    Xapian::MSet mset_ref = enq_ref.get_mset(0, 5000);
+	    TEST_EQUAL(mset.size(), mset_ref.size());
+	    TEST(mset_range_is_same(mset, 0, mset_ref, 0, mset.size()));
+	}
+    }
+}
+
+/// Test honey positional data aligned with the postlist.
+DEFINE_TESTCASE(alignedpositions1, glass) {
+#ifndef XAPIAN_HAS_HONEY_BACKEND
+    SKIP_TEST("Test requires honey backend");
+#else
+    string path = get_named_writable_database_path("alignedpositions1");
+    {
+	Xapian::WritableDatabase db(path,
+				    Xapian::DB_CREATE_OR_OVERWRITE |
+				    Xapian::DB_BACKEND_GLASS);
+	for (Xapian::docid did = 1; did <= 5000; ++did) {
+	    Xapian::Document doc;
+	    for (Xapian::termpos pos = 1; pos <= did % 4 + 1; ++pos) {
+		doc.add_posting("all", pos * 2 - 1);
+	    }
+	    doc.add_posting("w" + str(did % 7), 2 + did % 3);
+	    // Some postings with positional data and some without.
+	    if (did % 3 == 0) {
+		doc.add_term("mixed");
+	    } else {
+		doc.add_posting("mixed", did % 5 + 2);
+	    }
+	    // A term with no positional data.
+	    if (did % 500 == 0) doc.add_term("rare");
+	    if (did == 10 || did == 2000) doc.add_posting("two", 1);
+	    if (did == 5) doc.add_posting("one", 6);
+	    db.add_document(doc);
+	}
+	db.commit();
+    }
+    Xapian::Database ref(path);
+
+    for (int flags : { 0, Xapian::DBCOMPACT_SINGLE_FILE }) {
+	string outpath = get_compaction_output_path("alignedpositions1-" +
+						    str(flags));
+	rm_rf(outpath);
+	ref.compact(outpath, Xapian::DB_BACKEND_HONEY |
+			     Xapian::DB_ALIGNED_POSITIONS |
+			     Xapian::DB_PACKED_POSTINGS | flags);
+	Xapian::Database db(outpath);
+	check_same_positions(db, ref);
+
+	// Compacting from honey needs to split the aligned positional data
+	// up again, whether the output is aligned or not.  Compacting from a
+	// single file honey database currently only copies the postlist.
+	if (flags) continue;
+	for (int out_flags : { 0, Xapian::DB_ALIGNED_POSITIONS }) {
+	    string outpath2 =
+		get_compaction_output_path("alignedpositions1-out" +
+					   str(out_flags));
+	    rm_rf(outpath2);
+	    db.compact(outpath2, Xapian::DB_BACKEND_HONEY | out_flags);
+	    check_same_positions(Xapian::Database(outpath2), ref);
+	}
+    }
+#endif
+}
+
+/// Feature test for Xapian::DB_LOAD_INTO_MEMORY.
+DEFINE_TESTCASE(loadintomemory1, glass) {
+#ifndef XAPIAN_HAS_HONEY_BACKEND
+    SKIP_TEST("Test requires honey backend");
+#else
+    string path = get_named_writable_database_path("loadintomemory1");
+    {
+	Xapian::WritableDatabase db(path,
+				    Xapian::DB_CREATE_OR_OVERWRITE |
+				    Xapian::DB_BACKEND_GLASS);
+	for (Xapian::docid did = 1; did <= 2000; ++did) {
+	    Xapian::Document doc;
+	    doc.set_data("doc " + str(did));
+	    doc.add_value(0, str(did % 13));
+	    doc.add_posting("all", 1);
+	    doc.add_posting("t" + str(did % 100), 2);
+	    doc.add_term("Q" + str(did));
+	    db.add_document(doc);
+	}
+	db.add_synonym("t1", "t2");
+	db.add_spelling("spell", 3);
+	db.set_metadata("key", "value");
+	db.commit();
+    }
+    Xapian::Database ref(path);
+
+    for (int flags : { 0, Xapian::DBCOMPACT_SINGLE_FILE }) {
+	string outpath =
+	    get_compaction_output_path("loadintomemory1-" + str(flags));
+	rm_rf(outpath);
+	ref.compact(outpath, Xapian::DB_BACKEND_HONEY |
+			     Xapian::DB_BLOOM_FILTERS | flags);
+	Xapian::Database db(outpath, Xapian::DB_LOAD_INTO_MEMORY);
+
+	// All the tables should have been loaded, and the tables of a single
+	// file database should share one copy of the file.
+	off_t size = 0;
+	if (flags & Xapian::DBCOMPACT_SINGLE_FILE) {
+	    size = file_size(outpath);
+	} else {
+	    for (auto table : { "docdata", "postlist", "position", "spelling",
+				"synonym", "termlist" }) {
+		string file = outpath + "/" + table + ".honey";
+		if (file_exists(file)) size += file_size(file);
+	    }
+	}
+	TEST_REL(size, >, 0);
+	TEST_EQUAL(db.get_memory_footprint(), size_t(size));
+	TEST_REL(Xapian::Database(outpath).get_memory_footprint(), <,
+		 size_t(size));
+
+	check_same_postlists(db, ref);
+	for (Xapian::docid did : { 1, 99, 1000, 2000 }) {
+	    TEST_EQUAL(db.get_document(did).get_data(), "doc " + str(did));
+	    TEST_EQUAL(db.get_document(did).get_value(0), str(did % 13));
+	    TEST_EQUAL(db.get_doclength(did), 3);
+	    TEST_EQUAL(*db.positionlist_begin(did, "all"), 1);
+	    TEST_EQUAL(*db.termlist_begin(did), "Q" + str(did));
+	}
+	TEST(!db.term_exists("t100"));
+	TEST_EQUAL(db.get_metadata("key"), "value");
+	TEST_EQUAL(db.get_spelling_suggestion("spel"), "spell");
+	TEST_EQUAL(*db.synonyms_begin("t1"), "t2");
+
+	Xapian::Query query(Xapian::Query::OP_PHRASE,
+			    Xapian::Query("all"), Xapian::Query("t42"));
+	Xapian::Enquire enq(db), enq_ref(ref);
+	enq.set_query(query);
+	enq_ref.set_query(query);
+	Xapian::MSet mset = enq.get_mset(0, 100);
+	Xapian::MSet mset_ref = enq_ref.get_mset(0, 100);
+	TEST_EQUAL(mset.size(), 20);
+	TEST(mset_range_is_same(mset, 0, mset_ref, 0, mset.size()));
+
+	// The footprint of multiple shards is the sum over the shards.
+	Xapian::Database multi(db);
+	multi.add_database(ref);
+	multi.add_database(db);
+	TEST_EQUAL(multi.get_memory_footprint(), size_t(size) * 2);
+    }
+#endif
+}
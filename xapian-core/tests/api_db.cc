@@ -27,6 +27,8 @@
 #include "api_db.h"
 
 #include <algorithm>
+#include <cstdio> // For rename().
+#include <cstdlib>
 #include <fstream>
 #include <map>
 #include <string>
@@ -38,6 +40,7 @@
 #include <xapian.h>
 
 #include "backendmanager.h"
+#include "str.h"
 #include "testsuite.h"
 #include "testutils.h"
 #include "unixcmds.h"
@@ -863,6 +866,41 @@ DEFINE_TESTCASE(keepalive1, remote) {
 			      enquire.get_mset(0, 10));
 }
 
+/// Generate a database with the number of empty documents given by @a arg.
+static void
+gen_remotestub1_db(Xapian::WritableDatabase& db, const string& arg)
+{
+    for (int i = atoi(arg.c_str()); i > 0; --i) {
+	db.add_document(Xapian::Document());
+    }
+}
+
+/// Test a server notices when a stub database it serves is replaced.
+DEFINE_TESTCASE(remotestub1, remote) {
+    mkdir(".stub", 0755);
+    const string stubpath = ".stub/remotestub1";
+    for (Xapian::doccount n : { 2, 3 }) {
+	// Replace the stub by renaming a new version over it.
+	string tmp = stubpath + ".tmp";
+	ofstream out(tmp);
+	TEST(out.is_open());
+	out << "auto ../"
+	    << get_database_path("remotestub1_" + str(n), gen_remotestub1_db,
+				 str(n))
+	    << '\n';
+	out.close();
+	TEST_EQUAL(rename(tmp.c_str(), stubpath.c_str()), 0);
+
+	// A pooled server keeps the databases open between connections, so
+	// hold two connections open at once to make sure each of its threads
+	// serves one.
+	Xapian::Database db1 = get_database_by_path(stubpath);
+	Xapian::Database db2 = get_database_by_path(stubpath);
+	TEST_EQUAL(db1.get_doccount(), n);
+	TEST_EQUAL(db2.get_doccount(), n);
+    }
+}
+
 // test that iterating through all terms in a database works.
 DEFINE_TESTCASE(allterms1, backend) {
     Xapian::Database db(get_database("apitest_allterms"));
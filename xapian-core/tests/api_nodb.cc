@@ -564,4 +564,20 @@ DEFINE_TESTCASE(expanddeciderfilterprefix1, !backend) {
     TEST(decider("two"));
     TEST(decider("twitter"));
     TEST(decider(prefix));
+    TEST_EQUAL(decider.get_required_prefix(), prefix);
+}
+
+/// Test get_required_prefix() for ExpandDeciderAnd.
+DEFINE_TESTCASE(expanddecidergetrequiredprefix1, !backend) {
+    static const char* const terms[] = { "one" };
+    Xapian::ExpandDeciderFilterTerms no_prefix(terms, terms + 1);
+    TEST_EQUAL(no_prefix.get_required_prefix(), string());
+    Xapian::ExpandDeciderFilterPrefix t("t");
+    Xapian::ExpandDeciderFilterPrefix tw("tw");
+    TEST_EQUAL(Xapian::ExpandDeciderAnd(t, tw).get_required_prefix(), "tw");
+    TEST_EQUAL(Xapian::ExpandDeciderAnd(tw, t).get_required_prefix(), "tw");
+    TEST_EQUAL(Xapian::ExpandDeciderAnd(no_prefix, t).get_required_prefix(),
+	       "t");
+    TEST_EQUAL(Xapian::ExpandDeciderAnd(t, no_prefix).get_required_prefix(),
+	       "t");
 }
@@ -30,8 +30,10 @@
 
 #include <xapian.h>
 
+#include "dbcheck.h"
 #include "filetests.h"
 #include "omassert.h"
+#include "setenv.h"
 #include "str.h"
 #include "stringutils.h"
 #include "testsuite.h"
@@ -45,6 +47,7 @@
 #include <cstdlib>
 #include <map>
 #include <string>
+#include <vector>
 
 using namespace std;
 
@@ -1823,6 +1826,218 @@ DEFINE_TESTCASE(lazytablebug1, glass) {
     }
 }
 
+/// Test WritableDatabase::get_buffered_memory().
+DEFINE_TESTCASE(bufferedmemory1, glass) {
+    Xapian::WritableDatabase db = get_writable_database();
+    TEST_EQUAL(db.get_buffered_memory(), 0);
+
+    Xapian::Document doc;
+    doc.add_posting("foo", 1);
+    doc.add_posting("bar", 2);
+    db.add_document(doc);
+    size_t mem = db.get_buffered_memory();
+    TEST_REL(mem, >, 0);
+
+    // Adding a posting for the same terms and a new one should increase the
+    // estimate.
+    doc.add_term("baz");
+    db.add_document(doc);
+    TEST_REL(db.get_buffered_memory(), >, mem);
+
+    db.commit();
+    TEST_EQUAL(db.get_buffered_memory(), 0);
+
+    // Deleting buffers changes too.
+    db.delete_document(1);
+    TEST_REL(db.get_buffered_memory(), >, 0);
+}
+
+/// Test XAPIAN_FLUSH_MEMORY triggers an automatic commit.
+DEFINE_TESTCASE(flushmemory1, glass) {
+    struct unset_flush_memory_helper {
+	~unset_flush_memory_helper() { setenv("XAPIAN_FLUSH_MEMORY", "", 1); }
+    } unset_flush_memory_afterwards;
+    setenv("XAPIAN_FLUSH_MEMORY", "1", 1);
+    Xapian::WritableDatabase db = get_writable_database();
+    Xapian::Database reader(get_writable_database_as_database());
+
+    Xapian::Document doc;
+    doc.add_posting("foo", 1);
+    db.add_document(doc);
+    // The memory threshold should have caused the change to be committed.
+    TEST_EQUAL(db.get_buffered_memory(), 0);
+    TEST(reader.reopen());
+    TEST_EQUAL(reader.get_doccount(), 1);
+    TEST_EQUAL(reader.get_termfreq("foo"), 1);
+
+    setenv("XAPIAN_FLUSH_MEMORY", "x", 1);
+    TEST_EXCEPTION(Xapian::InvalidArgumentError,
+		   Xapian::WritableDatabase(get_named_writable_database_path(
+						"flushmemory1"),
+					    Xapian::DB_CREATE_OR_OVERWRITE));
+}
+
+/** Test buffered postlist changes made out of docid order.
+ *
+ *  Also checks that only the last of several changes to the same posting in
+ *  one batch takes effect.
+ */
+DEFINE_TESTCASE(postingorder1, writable) {
+    Xapian::WritableDatabase db = get_writable_database();
+
+    Xapian::Document doc;
+    doc.add_term("foo", 2);
+    doc.add_term("bar");
+    for (Xapian::docid did = 10; did > 0; --did) {
+	db.replace_document(did, doc);
+    }
+    db.commit();
+
+    // Several changes to the postings for "foo" in one batch, some
+    // superseding others.
+    Xapian::Document doc2;
+    doc2.add_term("foo", 5);
+    db.replace_document(7, doc2);
+    db.delete_document(3);
+    db.replace_document(3, doc2);
+    db.delete_document(5);
+    db.replace_document(7, doc);
+    db.replace_document(12, doc2);
+    db.replace_document(11, doc);
+    db.commit();
+
+    TEST_EQUAL(db.get_doccount(), 11);
+    TEST_EQUAL(db.get_termfreq("foo"), 11);
+    TEST_EQUAL(db.get_collection_freq("foo"), 9 * 2 + 2 * 5);
+    TEST_EQUAL(db.get_termfreq("bar"), 9);
+
+    static const Xapian::docid expected_dids[] = {
+	1, 2, 3, 4, 6, 7, 8, 9, 10, 11, 12
+    };
+    static const Xapian::termcount expected_wdfs[] = {
+	2, 2, 5, 2, 2, 2, 2, 2, 2, 2, 5
+    };
+    size_t n = 0;
+    for (auto p = db.postlist_begin("foo"); p != db.postlist_end("foo"); ++p) {
+	TEST_REL(n, <, sizeof(expected_dids) / sizeof(expected_dids[0]));
+	TEST_EQUAL(*p, expected_dids[n]);
+	TEST_EQUAL(p.get_wdf(), expected_wdfs[n]);
+	++n;
+    }
+    TEST_EQUAL(n, sizeof(expected_dids) / sizeof(expected_dids[0]));
+}
+
+/// Make a document for adddocuments1.
+static Xapian::Document
+make_batch_doc(unsigned i)
+{
+    Xapian::Document doc;
+    doc.set_data(str(i));
+    doc.add_value(0, str(i % 3));
+    doc.add_boolean_term("Q" + str(i));
+    for (Xapian::termpos pos = 1; pos <= i % 5 + 1; ++pos) {
+	doc.add_posting("t" + str(i % 7), pos);
+	doc.add_posting("all", pos * 2);
+    }
+    return doc;
+}
+
+/// Test WritableDatabase::add_documents().
+DEFINE_TESTCASE(adddocuments1, writable) {
+    Xapian::WritableDatabase db = get_writable_database();
+
+    vector<Xapian::Document> docs;
+    TEST_EQUAL(db.add_documents(docs.begin(), docs.end()), 0);
+
+    TEST_EQUAL(db.add_document(make_batch_doc(0)), 1);
+    for (unsigned i = 1; i <= 200; ++i) {
+	docs.push_back(make_batch_doc(i));
+    }
+    TEST_EQUAL(db.add_documents(docs.begin(), docs.end(), 4), 2);
+    // One thread, and the default.
+    TEST_EQUAL(db.add_documents(docs.begin(), docs.begin() + 10, 1), 202);
+    TEST_EQUAL(db.add_documents(docs.begin() + 10, docs.end()), 212);
+    // The same document more than once in a batch.
+    vector<Xapian::Document> same(100, docs[0]);
+    TEST_EQUAL(db.add_documents(same.begin(), same.end(), 4), 402);
+    db.commit();
+
+    TEST_EQUAL(db.get_doccount(), 501);
+    TEST_EQUAL(db.get_lastdocid(), 501);
+    for (Xapian::docid did = 1; did <= 501; ++did) {
+	unsigned i;
+	if (did <= 201) {
+	    i = did - 1;
+	} else if (did <= 211) {
+	    i = did - 201;
+	} else if (did <= 401) {
+	    i = did - 211 + 10;
+	} else {
+	    i = 1;
+	}
+	tout << "did " << did << " from doc " << i << '\n';
+	Xapian::Document doc = db.get_document(did);
+	TEST_EQUAL(doc.get_data(), str(i));
+	TEST_EQUAL(doc.get_value(0), str(i % 3));
+	TEST_EQUAL(doc.termlist_count(), 3);
+	Xapian::termcount n_pos = i % 5 + 1;
+	TEST_EQUAL(db.get_doclength(did), 2 * n_pos);
+	string term = "t" + str(i % 7);
+	Xapian::termcount count = 0;
+	for (auto p = db.positionlist_begin(did, term);
+	     p != db.positionlist_end(did, term); ++p) {
+	    TEST_EQUAL(*p, ++count);
+	}
+	TEST_EQUAL(count, n_pos);
+	Xapian::termpos expected = 2;
+	for (auto p = db.positionlist_begin(did, "all");
+	     p != db.positionlist_end(did, "all"); ++p) {
+	    TEST_EQUAL(*p, expected);
+	    expected += 2;
+	}
+	TEST_EQUAL(expected, 2 * n_pos + 2);
+    }
+    TEST_EQUAL(db.get_termfreq("all"), 501);
+    TEST_EQUAL(db.get_termfreq("Q1"), 102);
+
+    // Check postings are in docid order with the right wdfs.
+    Xapian::docid prev = 0;
+    for (auto p = db.postlist_begin("all"); p != db.postlist_end("all"); ++p) {
+	TEST_REL(*p, >, prev);
+	prev = *p;
+	TEST_EQUAL(p.get_wdf(), db.get_doclength(*p) / 2);
+    }
+    TEST_EQUAL(prev, 501);
+}
+
+/** With glass, a failure adding one document discards all uncommitted
+ *  changes, whether or not threads are used.
+ */
+DEFINE_TESTCASE(adddocuments2, glass) {
+    Xapian::WritableDatabase db = get_writable_database();
+
+    vector<Xapian::Document> docs;
+    for (unsigned i = 0; i != 100; ++i) {
+	docs.push_back(make_batch_doc(i));
+    }
+    docs[60].add_term(string(300, 'x'));
+    for (unsigned threads : { 1, 4 }) {
+	db.add_document(make_batch_doc(100));
+	TEST_EXCEPTION(Xapian::InvalidArgumentError,
+		       db.add_documents(docs.begin(), docs.end(), threads));
+	db.commit();
+	TEST_EQUAL(db.get_doccount(), 0);
+	TEST_EQUAL(db.get_lastdocid(), 0);
+    }
+
+    docs[60] = make_batch_doc(60);
+    TEST_EQUAL(db.add_documents(docs.begin(), docs.end(), 4), 1);
+    db.commit();
+    TEST_EQUAL(db.get_doccount(), 100);
+    TEST_EQUAL(db.get_termfreq("all"), 100);
+    dbcheck(db, 100, 100);
+}
+
 /// Regression test for bug #287 for flint.
 DEFINE_TESTCASE(cursordelbug1, writable && path) {
     static const int terms[] = { 219, 221, 222, 223, 224, 225, 226 };
@@ -83,6 +83,12 @@ get_database_path(const std::string &dbname,
     return backendmanager->get_database_path(dbname, gen, arg);
 }
 
+Xapian::Database
+get_database_by_path(const string& path)
+{
+    return backendmanager->get_database_by_path(path);
+}
+
 Xapian::WritableDatabase
 get_writable_database(const string &dbname)
 {
@@ -38,6 +38,8 @@ Xapian::Database get_database(const std::string &db,
 
 std::string get_database_path(const std::string &db);
 
+Xapian::Database get_database_by_path(const std::string& path);
+
 std::string get_database_path(const std::string &db,
 			      void (*gen)(Xapian::WritableDatabase&,
 					  const std::string &),
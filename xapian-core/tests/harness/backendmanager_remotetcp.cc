@@ -68,11 +68,35 @@ using namespace std;
 // Start at DEFAULT port and try higher ports until one isn't already in use.
 #define DEFAULT_PORT 1239
 
+/** Build the command to run xapian-tcpsrv.
+ *
+ *  If @a threads is non-zero, the server serves connections with a pool of
+ *  that many threads and keeps running until we kill it in clean_up().
+ *  Otherwise it serves a single connection and then exits.
+ */
+static string
+tcpsrv_command(int port, const string & args, unsigned threads)
+{
+    string cmd = XAPIAN_TCPSRV;
+    if (threads) {
+	cmd += " --threads ";
+	cmd += str(threads);
+    } else {
+	cmd += " --one-shot";
+    }
+    cmd += " --interface " LOCALHOST " --port ";
+    cmd += str(port);
+    cmd += " ";
+    cmd += args;
+    return cmd;
+}
+
 #ifdef HAVE_FORK
 
 // We can't dynamically allocate memory for this because it confuses the leak
-// detector.  We only have 1-3 child fds open at once anyway, so a fixed size
-// array isn't a problem, and linear scanning isn't a problem either.
+// detector.  We only have 1-3 child fds open at once anyway (a few more with
+// pooled servers, which run until the end of the test), so a fixed size array
+// isn't a problem, and linear scanning isn't a problem either.
 struct pid_fd {
     pid_t pid;
     int fd;
@@ -104,7 +128,7 @@ on_SIGCHLD(int /*sig*/)
 }
 
 static int
-launch_xapian_tcpsrv(const string & args)
+launch_xapian_tcpsrv(const string & args, unsigned threads)
 {
     int port = DEFAULT_PORT;
 
@@ -112,13 +136,13 @@ launch_xapian_tcpsrv(const string & args)
     // if xapian-tcpsrv doesn't start listening successfully.
     signal(SIGCHLD, SIG_DFL);
 try_next_port:
-    string cmd = XAPIAN_TCPSRV " --one-shot --interface " LOCALHOST " --port ";
-    cmd += str(port);
-    cmd += " ";
-    cmd += args;
+    string cmd = tcpsrv_command(port, args, threads);
 #ifdef HAVE_VALGRIND
     if (RUNNING_ON_VALGRIND) cmd = "./runsrv " + cmd;
 #endif
+    // A pooled server gets killed by clean_up(), so make sure that signal
+    // goes to the server rather than the shell.
+    if (threads) cmd = "exec " + cmd;
     int fds[2];
     if (socketpair(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC, PF_UNSPEC, fds) < 0) {
 	string msg("Couldn't create socketpair: ");
@@ -211,13 +235,20 @@ try_next_port:
 
     // Find a slot to track the pid->fd mapping in.  If we can't find a slot
     // it just means we'll leak the fd, so don't worry about that too much.
+    bool tracked = false;
     for (unsigned i = 0; i < sizeof(pid_to_fd) / sizeof(pid_fd); ++i) {
 	if (pid_to_fd[i].pid == 0) {
 	    pid_to_fd[i].fd = tracked_fd;
 	    pid_to_fd[i].pid = child;
+	    tracked = true;
 	    break;
 	}
     }
+    if (!tracked && threads) {
+	// A pooled server would never get killed, so don't leave it running.
+	kill(child, SIGTERM);
+	throw string("Too many pooled xapian-tcpsrv processes to track");
+    }
 
     // Set a signal handler to clean up the xapian-tcpsrv child process when it
     // finally exits.
@@ -258,15 +289,12 @@ static void win32_throw_error_string(const char * str)
 // This implementation uses the WIN32 API to start xapian-tcpsrv as a child
 // process and read its output using a pipe.
 static int
-launch_xapian_tcpsrv(const string & args)
+launch_xapian_tcpsrv(const string & args, unsigned threads)
 {
     int port = DEFAULT_PORT;
 
 try_next_port:
-    string cmd = XAPIAN_TCPSRV " --one-shot --interface " LOCALHOST " --port ";
-    cmd += str(port);
-    cmd += " ";
-    cmd += args;
+    string cmd = tcpsrv_command(port, args, threads);
 
     // Create a pipe so we can read stdout/stderr from the child process.
     HANDLE hRead, hWrite;
@@ -348,6 +376,8 @@ BackendManagerRemoteTcp::~BackendManagerRemoteTcp() {
 std::string
 BackendManagerRemoteTcp::get_dbtype() const
 {
+    if (threads)
+	return "remotetcp_threaded_" + sub_manager->get_dbtype();
     return "remotetcp_" + sub_manager->get_dbtype();
 }
 
@@ -364,7 +394,7 @@ BackendManagerRemoteTcp::get_writable_database(const string & name,
 					       const string & file)
 {
     string args = get_writable_database_args(name, file);
-    int port = launch_xapian_tcpsrv(args);
+    int port = launch_xapian_tcpsrv(args, threads);
     return Xapian::Remote::open_writable(LOCALHOST, port);
 }
 
@@ -373,15 +403,23 @@ BackendManagerRemoteTcp::get_remote_database(const vector<string> & files,
 					     unsigned int timeout)
 {
     string args = get_remote_database_args(files, timeout);
-    int port = launch_xapian_tcpsrv(args);
+    int port = launch_xapian_tcpsrv(args, threads);
     return Xapian::Remote::open(LOCALHOST, port);
 }
 
 Xapian::Database
 BackendManagerRemoteTcp::get_database_by_path(const string& path)
 {
+    if (threads && path == pooled_path) {
+	// The server keeps running until clean_up(), so connect to it again.
+	return Xapian::Remote::open(LOCALHOST, pooled_port);
+    }
     string args = get_remote_database_args(path, 300000);
-    int port = launch_xapian_tcpsrv(args);
+    int port = launch_xapian_tcpsrv(args, threads);
+    if (threads) {
+	pooled_path = path;
+	pooled_port = port;
+    }
     return Xapian::Remote::open(LOCALHOST, port);
 }
 
@@ -389,7 +427,7 @@ Xapian::Database
 BackendManagerRemoteTcp::get_writable_database_as_database()
 {
     string args = get_writable_database_as_database_args();
-    int port = launch_xapian_tcpsrv(args);
+    int port = launch_xapian_tcpsrv(args, threads);
     return Xapian::Remote::open(LOCALHOST, port);
 }
 
@@ -397,18 +435,21 @@ Xapian::WritableDatabase
 BackendManagerRemoteTcp::get_writable_database_again()
 {
     string args = get_writable_database_again_args();
-    int port = launch_xapian_tcpsrv(args);
+    int port = launch_xapian_tcpsrv(args, threads);
     return Xapian::Remote::open_writable(LOCALHOST, port);
 }
 
 void
 BackendManagerRemoteTcp::clean_up()
 {
+    pooled_path.clear();
 #ifdef HAVE_FORK
     signal(SIGCHLD, SIG_DFL);
     for (unsigned i = 0; i < sizeof(pid_to_fd) / sizeof(pid_fd); ++i) {
 	pid_t child = pid_to_fd[i].pid;
 	if (child) {
+	    // A pooled server won't exit by itself.
+	    if (threads) kill(child, SIGTERM);
 	    int status;
 	    while (waitpid(child, &status, 0) == -1 && errno == EINTR) { }
 	    // Other possible error from waitpid is ECHILD, which it seems can
@@ -423,6 +464,8 @@ BackendManagerRemoteTcp::clean_up()
     }
 #elif defined __WIN32__
     for (unsigned i = 0; i != tcpsrv_handles_index; ++i) {
+	// A pooled server won't exit by itself.
+	if (threads) TerminateProcess(tcpsrv_handles[i], 0);
 	WaitForSingleObject(tcpsrv_handles[i], INFINITE);
 	CloseHandle(tcpsrv_handles[i]);
     }
@@ -38,12 +38,28 @@ class BackendManagerRemoteTcp : public BackendManagerRemote {
     /// The path of the last writable database used.
     std::string last_wdb_name;
 
+    /** Number of threads for xapian-tcpsrv to serve connections with.
+     *
+     *  If 0, a separate xapian-tcpsrv is run for each connection using
+     *  --one-shot.
+     */
+    unsigned threads;
+
+    /** The path served by the last pooled server get_database_by_path()
+     *  started, or empty if there isn't one running.
+     */
+    std::string pooled_path;
+
+    /// The port of the pooled server serving pooled_path.
+    int pooled_port = 0;
+
     /// Create a Xapian::Database object indexing multiple files.
     Xapian::Database do_get_database(const std::vector<std::string> & files);
 
   public:
-    explicit BackendManagerRemoteTcp(BackendManager* sub_manager_)
-	: BackendManagerRemote(sub_manager_) { }
+    explicit BackendManagerRemoteTcp(BackendManager* sub_manager_,
+				     unsigned threads_ = 0)
+	: BackendManagerRemote(sub_manager_), threads(threads_) { }
 
     ~BackendManagerRemoteTcp();
 
@@ -58,7 +74,11 @@ class BackendManagerRemoteTcp : public BackendManagerRemote {
     Xapian::Database get_remote_database(const std::vector<std::string> & files,
 					 unsigned int timeout);
 
-    /// Get a RemoteTcp Xapian::Database instance of the database at path
+    /** Get a RemoteTcp Xapian::Database instance of the database at path.
+     *
+     *  When using pooled servers, the server started for a path is reused
+     *  for further calls with the same path.
+     */
     Xapian::Database get_database_by_path(const std::string& path);
 
     /// Create a Database object for the last opened WritableDatabase.
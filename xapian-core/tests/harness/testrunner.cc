@@ -91,6 +91,10 @@ TestRunner::set_properties_for_backend(const string & backend_name)
 	    BACKEND|TRANSACTIONS|POSITIONAL|WRITABLE|METADATA|VALUESTATS|
 	    GENERATED|SYNONYMS
 	},
+	{ "remotetcp_threaded_glass", REMOTE|
+	    BACKEND|TRANSACTIONS|POSITIONAL|WRITABLE|METADATA|VALUESTATS|
+	    GENERATED|SYNONYMS
+	},
 	{ "singlefile_glass", SINGLEFILE|
 	    BACKEND|POSITIONAL|VALUESTATS|COMPACT|PATH },
 	{ "honey", HONEY|
@@ -177,6 +181,9 @@ TestRunner::run_tests(int argc, char ** argv)
 
 	    do_tests_for_backend(BackendManagerRemoteProg(&glass_man));
 	    do_tests_for_backend(BackendManagerRemoteTcp(&glass_man));
+#  ifdef HAVE_STD_THREAD
+	    do_tests_for_backend(BackendManagerRemoteTcp(&glass_man, 2));
+#  endif
 # endif
 	}
 #endif
@@ -20,7 +20,8 @@ noinst_HEADERS += perftest/perftest.h
 collated_perftest_sources = \
  perftest/perftest_diversify.cc \
  perftest/perftest_matchdecider.cc \
- perftest/perftest_randomidx.cc
+ perftest/perftest_randomidx.cc \
+ perftest/perftest_termlookup.cc
 
 perftest_perftest_SOURCES = perftest/perftest.cc $(collated_perftest_sources) \
  perftest/perftest_all.h perftest/perftest_collated.h \
@@ -0,0 +1,161 @@
+/** @file
+ * @brief performance tests for looking up individual terms
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "perftest/perftest_termlookup.h"
+
+#include <xapian.h>
+
+#include "backendmanager.h"
+#include "perftest.h"
+#include "str.h"
+#include "testrunner.h"
+#include "testsuite.h"
+#include "testutils.h"
+#include "unixcmds.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/** Generate the term of rank @a rank in a Zipf distribution.
+ *
+ *  The terms are words made from a hash of the rank, so frequent terms are
+ *  spread through the table.
+ */
+static string
+zipf_term(unsigned rank)
+{
+    uint32_t h = rank * 2654435761u;
+    string result;
+    do {
+	result += char('a' + h % 26);
+	h /= 26;
+    } while (h);
+    return result;
+}
+
+/** Pick a rank from a Zipf distribution.
+ *
+ *  @param cumulative	Cumulative probabilities of each rank.
+ */
+static unsigned
+zipf_rank(const vector<double>& cumulative)
+{
+    double r = rand() / (RAND_MAX + 1.0);
+    auto i = upper_bound(cumulative.begin(), cumulative.end(), r);
+    return unsigned(i - cumulative.begin());
+}
+
+// Test the speed of looking up terms in honey databases with each index type.
+DEFINE_TESTCASE(termlookup1, glass) {
+#ifndef XAPIAN_HAS_HONEY_BACKEND
+    SKIP_TEST("Test requires honey backend");
+#else
+    logger.testcase_begin("termlookup1");
+
+    const unsigned vocab = 200000;
+    const unsigned runsize = 20000;
+    const unsigned terms_per_doc = 50;
+    const unsigned lookups = 20000;
+    const unsigned batch = 1000;
+    srand(42);
+
+    vector<double> cumulative;
+    cumulative.reserve(vocab);
+    double total = 0;
+    for (unsigned rank = 1; rank <= vocab; ++rank) {
+	total += 1.0 / rank;
+	cumulative.push_back(total);
+    }
+    for (double& c : cumulative) c /= total;
+
+    string dbname("termlookup1");
+    map<string, string> params;
+    params["runsize"] = str(runsize);
+    params["vocab"] = str(vocab);
+    params["terms_per_doc"] = str(terms_per_doc);
+    logger.indexing_begin(dbname, params);
+    Xapian::WritableDatabase db =
+	backendmanager->get_writable_database(dbname, "");
+    for (unsigned i = 0; i != runsize; ++i) {
+	Xapian::Document doc;
+	for (unsigned j = 0; j != terms_per_doc; ++j) {
+	    doc.add_term(zipf_term(zipf_rank(cumulative)));
+	}
+	db.add_document(doc);
+	logger.indexing_add();
+    }
+    db.commit();
+    logger.indexing_end();
+
+    // Look up a mix of terms drawn from the same distribution and terms
+    // which aren't present, the same sequence for each index type.
+    vector<string> terms;
+    terms.reserve(lookups);
+    for (unsigned i = 0; i != lookups; ++i) {
+	if (i % 4 == 0) {
+	    terms.push_back("u" + str(rand()));
+	} else {
+	    terms.push_back(zipf_term(zipf_rank(cumulative)));
+	}
+    }
+
+    static const struct { const char* name; int flags; } indexes[] = {
+	{ "default index", 0 },
+	{ "Eytzinger index", Xapian::DB_EYTZINGER_INDEX }
+    };
+    Xapian::doccount check = 0;
+    for (auto& index : indexes) {
+	string outpath =
+	    backendmanager->get_compaction_output_path(dbname + "-" +
+						       str(index.flags));
+	rm_rf(outpath);
+	db.compact(outpath, Xapian::DB_BACKEND_HONEY | index.flags);
+	Xapian::Database honey(outpath);
+
+	logger.searching_start(string("Term lookups: ") + index.name);
+	Xapian::doccount sum = 0;
+	for (unsigned i = 0; i != lookups; ++i) {
+	    sum += honey.get_termfreq(terms[i]);
+	    if ((i + 1) % batch == 0) {
+		logger.search_end(Xapian::Query(terms[i]), Xapian::MSet());
+	    }
+	}
+	logger.searching_end();
+
+	// Both index types should find the same terms.
+	if (index.flags == 0) {
+	    check = sum;
+	} else {
+	    TEST_EQUAL(sum, check);
+	}
+    }
+
+    logger.testcase_end();
+#endif
+}
@@ -76,22 +76,35 @@ using namespace std;
 
 // Code we're unit testing:
 #include "../common/closefrom.cc"
+#include "../common/crc32c.cc"
 #include "../common/errno_to_string.cc"
 #include "../common/fileutils.cc"
 #include "../common/overflow.h"
 #include "../common/pack.cc"
+#include "../common/packedpositions.cc"
 #include "../common/parseint.h"
 #include "../common/serialise-double.cc"
 #include "../common/str.cc"
 #include "../backends/uuids.cc"
 #include "../net/serialise-error.cc"
 #include "../api/error.cc"
+#include "../api/smallvector.cc"
 #include "../api/sortable-serialise.cc"
 #include "../include/xapian/intrusive_ptr.h"
 
 // fileutils.cc uses opendir(), etc though not in a function we currently test.
 #include "../common/msvc_dirent.cc"
 
+#ifdef XAPIAN_HAS_HONEY_BACKEND
+# include "../backends/honey/honey_bloomfilter.cc"
+# include "../backends/honey/honey_cursor.cc"
+# include "../backends/honey/honey_table.cc"
+# include "../backends/honey/honey_version.cc"
+# include "../common/compression_stream.cc"
+# include "../common/io_utils.cc"
+# include "setenv.h"
+#endif
+
 // The UUID code uses hexdigit().
 #include "../api/constinfo.cc"
 
@@ -860,6 +873,284 @@ static void test_parsesigned1()
     parsesigned_helper<long long>();
 }
 
+/// Simple bit-at-a-time CRC32C to check the optimised versions against.
+static uint32_t
+crc32c_bitwise(const unsigned char* p, size_t len)
+{
+    uint32_t crc = 0xffffffff;
+    while (len--) {
+	crc ^= *p++;
+	for (int i = 0; i != 8; ++i) {
+	    crc = (crc >> 1) ^ (0x82F63B78 & (0 - (crc & 1)));
+	}
+    }
+    return ~crc;
+}
+
+static void test_crc32c1()
+{
+    // Check values from RFC 3720 and the standard "check" value.
+    TEST_EQUAL(crc32c("123456789", 9), 0xe3069283);
+    TEST_EQUAL(crc32c("", 0), 0);
+    unsigned char buf[259];
+    memset(buf, 0, 32);
+    TEST_EQUAL(crc32c(buf, 32), 0x8a9136aa);
+    memset(buf, 0xff, 32);
+    TEST_EQUAL(crc32c(buf, 32), 0x62a8ab43);
+
+    for (size_t i = 0; i != sizeof(buf); ++i) {
+	buf[i] = static_cast<unsigned char>(i * 7 + (i >> 3));
+    }
+    // Check all lengths and a range of alignments, so we exercise the
+    // word-at-a-time loops and the code handling any remaining bytes.
+    for (size_t start = 0; start != 8; ++start) {
+	for (size_t len = 0; start + len <= 200; ++len) {
+	    uint32_t expect = crc32c_bitwise(buf + start, len);
+	    TEST_EQUAL(crc32c(buf + start, len), expect);
+	    // Check the table-driven version too, since crc32c() won't use it
+	    // if the CPU has CRC instructions.
+	    TEST_EQUAL(~crc32c_table(0xffffffff, buf + start, len), expect);
+	    // Check calculating the CRC in two pieces.
+	    size_t half = len / 2;
+	    uint32_t crc = crc32c(buf + start, half);
+	    TEST_EQUAL(crc32c(buf + start + half, len - half, crc), expect);
+	}
+    }
+}
+
+/// Encode @a vec bit-packed, then decode it and check we get it back.
+static void
+packedpositions_check(const Xapian::VecCOW<Xapian::termpos>& vec)
+{
+    string s;
+    encode_packed_positions(s, vec);
+    const char* p = s.data();
+    const char* end = p + s.size();
+    TEST(is_packed_positions(p, end));
+    TEST_EQUAL(packed_positions_count(p, end), vec.size());
+
+    PackedPositionReader rd;
+    Xapian::termpos first, last;
+    TEST_EQUAL(rd.init(p, end, first, last), vec.size());
+    TEST_EQUAL(first, vec[0]);
+    TEST_EQUAL(last, vec.back());
+    for (size_t i = 1; i != vec.size(); ++i) {
+	TEST_EQUAL(rd.decode_next(), vec[i]);
+    }
+    TEST(rd.check_all_gone());
+
+    // Truncated data should be reported as corrupt, not read off the end.
+    if (s.size() > 5) {
+	s.resize(s.size() - 1);
+	p = s.data();
+	end = p + s.size();
+	TEST_EXCEPTION(Xapian::DatabaseCorruptError,
+	    rd.init(p, end, first, last);
+	    for (size_t i = 1; i != vec.size(); ++i) rd.decode_next();
+	    if (!rd.check_all_gone()) throw Xapian::DatabaseCorruptError("");
+	);
+    }
+}
+
+static void test_packedpositions1()
+{
+    Xapian::VecCOW<Xapian::termpos> vec;
+    // Check every gap width.
+    for (unsigned width = 0; width <= 32; ++width) {
+	for (size_t n : { 2, 3, 9, 129, 130, 300 }) {
+	    vec.clear();
+	    Xapian::termpos pos = 1;
+	    Xapian::termpos max_gap = width ? Xapian::termpos(-1) >> (32 - width)
+					    : 0;
+	    // Limit the total so we don't overflow termpos.
+	    max_gap = min(max_gap, Xapian::termpos(0xfffffff0 / n));
+	    for (size_t i = 0; i != n; ++i) {
+		vec.push_back(pos);
+		pos += 1 + (i & 1 ? max_gap : max_gap / 3);
+	    }
+	    packedpositions_check(vec);
+	}
+    }
+
+    // Check the largest possible range.
+    vec.clear();
+    vec.push_back(1);
+    vec.push_back(2);
+    vec.push_back(0xffffffff);
+    packedpositions_check(vec);
+
+    // Zero bytes of interpolative coded data can't be bit-packed data.
+    TEST(!is_packed_positions("\0", "\0" + 1));
+    string s;
+    pack_uint(s, 128u);
+    TEST(!is_packed_positions(s.data(), s.data() + s.size()));
+
+    // Check entries which aren't strictly increasing are detected.
+    s.assign("\0\x01\x01\x02\x02\x03", 6);
+    PackedPositionReader rd;
+    Xapian::termpos first, last;
+    TEST_EQUAL(rd.init(s.data(), s.data() + s.size(), first, last), 3);
+    TEST_EXCEPTION(Xapian::DatabaseCorruptError, rd.decode_next());
+    // Count larger than the range.
+    s.assign("\0\x05\x01\x02", 4);
+    TEST_EXCEPTION(Xapian::DatabaseCorruptError,
+		   rd.init(s.data(), s.data() + s.size(), first, last));
+}
+
+#ifdef XAPIAN_HAS_HONEY_BACKEND
+/// The tag we store for key @a i in the table for honeymmap1.
+static string
+honeymmap1_tag(unsigned i)
+{
+    return string(i % 200 + 1, char('a' + i % 26));
+}
+
+/// Check the table written by honeymmap1 reads back correctly.
+static void
+honeymmap1_check(const string& path, const Honey::RootInfo& root_info)
+{
+    HoneyTable table("test", path, true);
+    table.open(0, root_info, 1);
+    HoneyCursor cursor(&table);
+    unsigned i = 0;
+    while (cursor.next()) {
+	TEST_EQUAL(cursor.current_key, "k" + str(1000 + i));
+	const string tag = honeymmap1_tag(i);
+	size_t len;
+	const char* view = cursor.read_tag_view(len);
+	TEST_EQUAL(string(view, len), tag);
+	// A second call should return the same tag, and read_tag() should
+	// still give us a copy after read_tag_view().
+	TEST_EQUAL(string(cursor.read_tag_view(len), len), tag);
+	cursor.read_tag();
+	TEST_EQUAL(cursor.current_tag, tag);
+	++i;
+    }
+    TEST_EQUAL(i, 1000);
+
+    // Closing the table while a cursor is live shouldn't invalidate a tag
+    // already read from the mapping, but further reads should fail.
+    TEST(cursor.find_exact("k1500"));
+    size_t len;
+    const char* view = cursor.read_tag_view(len);
+    table.close(true);
+    TEST_EQUAL(string(view, len), honeymmap1_tag(500));
+    TEST_EXCEPTION(Xapian::DatabaseClosedError, cursor.next());
+    TEST_EXCEPTION(Xapian::DatabaseClosedError, cursor.find_exact("k1000"));
+}
+
+static void test_honeymmap1()
+{
+    const string path = ".honeymmap1.";
+    Honey::RootInfo root_info;
+    root_info.init(0);
+    {
+	HoneyTable table("test", path, false);
+	table.create_and_open(Xapian::DB_NO_SYNC, root_info);
+	for (unsigned i = 0; i != 1000; ++i) {
+	    table.add("k" + str(1000 + i), honeymmap1_tag(i));
+	}
+	table.flush_db();
+	table.commit(1, &root_info);
+    }
+
+    // Read via a memory mapping, and also via pread().
+    honeymmap1_check(path, root_info);
+    setenv("XAPIAN_HONEY_NO_MMAP", "1", 1);
+    try {
+	honeymmap1_check(path, root_info);
+    } catch (...) {
+	setenv("XAPIAN_HONEY_NO_MMAP", "", 1);
+	throw;
+    }
+    setenv("XAPIAN_HONEY_NO_MMAP", "", 1);
+
+    // Reading via the mapping after a forced close should fail, as reading
+    // via the file descriptor would.
+    BufferedFile file;
+    TEST(file.open(path + HONEY_TABLE_EXTENSION, true));
+    file.map_for_reading();
+    TEST(file.is_mapped());
+    TEST(file.read() != EOF);
+    file.force_close(true);
+    TEST_EXCEPTION(Xapian::DatabaseClosedError, file.read());
+    TEST_EXCEPTION(Xapian::DatabaseClosedError, file.read_mapped(1));
+
+    unlink((path + HONEY_TABLE_EXTENSION).c_str());
+}
+
+/// Spacing of the pointers in honeyeytzinger1 (more than SSTIndex thins to).
+static const off_t HONEYEYTZINGER1_STEP = 65536;
+
+/** Write an Eytzinger index with pointers starting at @a base and check
+ *  lookups in it.
+ */
+static void
+honeyeytzinger_check(off_t base, int index_type, unsigned ptr_size)
+{
+    const string path = ".honeyeytzinger1";
+    const unsigned N = 100;
+    {
+	SSTIndex index;
+	index.set_eytzinger();
+	for (unsigned i = 0; i != N; ++i) {
+	    index.maybe_add_entry("k" + str(1000 + i),
+				  base + off_t(i) * HONEYEYTZINGER1_STEP);
+	}
+	BufferedFile store;
+	TEST(store.open(path, false));
+	TEST_EQUAL(index.write(store), 0);
+	store.flush();
+	store.close(true);
+    }
+
+    for (int mapped = 0; mapped != 2; ++mapped) {
+	BufferedFile store;
+	TEST(store.open(path, true));
+	if (mapped) {
+	    store.map_for_reading();
+	    TEST(store.is_mapped());
+	}
+	string prefix;
+	for (unsigned i = 0; i != N; ++i) {
+	    const string key = "k" + str(1000 + i);
+	    const off_t ptr = base + off_t(i) * HONEYEYTZINGER1_STEP;
+	    store.rewind(0);
+	    TEST_EQUAL(store.read(), index_type);
+	    TEST_EQUAL(SSTIndex::eytzinger_find(store, key, prefix, ptr_size),
+		       ptr);
+	    TEST_EQUAL(prefix, key);
+	    // A key after this entry's prefix should find the same entry.
+	    store.rewind(0);
+	    TEST_EQUAL(store.read(), index_type);
+	    TEST_EQUAL(SSTIndex::eytzinger_find(store, key + "zzzz", prefix,
+						ptr_size),
+		       ptr);
+	    TEST_EQUAL(prefix, key);
+	}
+	store.rewind(0);
+	TEST_EQUAL(store.read(), index_type);
+	TEST_EQUAL(SSTIndex::eytzinger_find(store, "a", prefix, ptr_size), -1);
+	store.close(true);
+    }
+    unlink(path.c_str());
+}
+
+// Check the Eytzinger index switches to 8 byte pointers when needed.
+static void test_honeyeytzinger1()
+{
+    honeyeytzinger_check(0, SSTIndex::EYTZINGER, 4);
+    if (sizeof(off_t) > 4) {
+	// The largest pointer fits in 4 bytes.
+	off_t base = off_t(0xffffffff) - 99 * HONEYEYTZINGER1_STEP;
+	honeyeytzinger_check(base, SSTIndex::EYTZINGER, 4);
+	// Only the largest pointer needs more than 4 bytes.
+	honeyeytzinger_check(base + 1, SSTIndex::EYTZINGER_WIDE, 8);
+	honeyeytzinger_check(off_t(5) << 32, SSTIndex::EYTZINGER_WIDE, 8);
+    }
+}
+#endif
+
 static const test_desc tests[] = {
     TESTCASE(simple_exceptions_work1),
     TESTCASE(class_exceptions_work1),
@@ -883,6 +1174,12 @@ static const test_desc tests[] = {
     TESTCASE(muloverflows1),
     TESTCASE(parseunsigned1),
     TESTCASE(parsesigned1),
+    TESTCASE(crc32c1),
+    TESTCASE(packedpositions1),
+#ifdef XAPIAN_HAS_HONEY_BACKEND
+    TESTCASE(honeymmap1),
+    TESTCASE(honeyeytzinger1),
+#endif
     END_OF_TESTCASES
 };
 